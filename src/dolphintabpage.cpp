@@ -13,6 +13,7 @@
 
 #include <QVariantAnimation>
 #include <QGridLayout>
+#include <QTimer>
 #include <QWidgetAction>
 #include <QStyle>
 
@@ -21,7 +22,8 @@ DolphinTabPage::DolphinTabPage(const QUrl &primaryUrl, const QUrl &secondaryUrl,
     m_expandingContainer{nullptr},
     m_primaryViewActive(true),
     m_splitViewEnabled(false),
-    m_active(true)
+    m_active(true),
+    m_hibernationTimer(nullptr)
 {
     QGridLayout *layout = new QGridLayout(this);
     layout->setSpacing(0);
@@ -55,6 +57,11 @@ DolphinTabPage::DolphinTabPage(const QUrl &primaryUrl, const QUrl &secondaryUrl,
     }
 
     m_primaryViewContainer->setActive(true);
+
+    m_hibernationTimer = new QTimer(this);
+    m_hibernationTimer->setSingleShot(true);
+    connect(m_hibernationTimer, &QTimer::timeout,
+            this, &DolphinTabPage::hibernateViews);
 }
 
 bool DolphinTabPage::primaryViewActive() const
@@ -87,6 +94,10 @@ void DolphinTabPage::setSplitViewEnabled(bool enabled, Animated animated, const
             QList<int> splitterSizes = m_splitter->sizes();
             const QUrl& url = (secondaryUrl.isEmpty()) ? m_primaryViewContainer->url() : secondaryUrl;
             m_secondaryViewContainer = createViewContainer(url);
+            if (m_primaryViewContainer->view()->itemsReleased()) {
+                // The tab page gets restored lazily
+                m_secondaryViewContainer->view()->setHibernated(true, true);
+            }
 
             auto secondaryNavigator = m_navigatorsWidget->secondaryUrlNavigator();
             if (!secondaryNavigator) {
@@ -327,18 +338,50 @@ void DolphinTabPage::restoreState(const QByteArray& state)
     m_splitter->restoreState(splitterState);
 }
 
+void DolphinTabPage::restoreStateLazily(const QByteArray& state)
+{
+    // Views with released items don't load their directories until they
+    // get woken up when the tab page is activated
+    m_primaryViewContainer->view()->setHibernated(true, true);
+    if (m_secondaryViewContainer) {
+        m_secondaryViewContainer->view()->setHibernated(true, true);
+    }
+
+    restoreState(state);
+}
+
 void DolphinTabPage::setActive(bool active)
 {
     if (active) {
         m_active = active;
+        m_hibernationTimer->stop();
+        wakeUpViews();
     } else {
         // we should bypass changing active view in split mode
         m_active = !m_splitViewEnabled;
+
+        const int hibernationDelay = GeneralSettings::hibernateTabsDelay();
+        if (hibernationDelay > 0) {
+            m_hibernationTimer->start(hibernationDelay * 1000);
+        }
     }
     // we want view to fire activated when goes from false to true
     activeViewContainer()->setActive(active);
 }
 
+void DolphinTabPage::hibernateViews()
+{
+    if (GeneralSettings::hibernateTabsDelay() <= 0) {
+        return;
+    }
+
+    const bool releaseItems = GeneralSettings::releaseHibernatedTabs();
+    m_primaryViewContainer->view()->setHibernated(true, releaseItems);
+    if (m_splitViewEnabled) {
+        m_secondaryViewContainer->view()->setHibernated(true, releaseItems);
+    }
+}
+
 void DolphinTabPage::slotAnimationFinished()
 {
     for (int i = 0; i < m_splitter->count(); ++i) {
@@ -475,6 +518,14 @@ DolphinViewContainer* DolphinTabPage::createViewContainer(const QUrl& url) const
     return container;
 }
 
+void DolphinTabPage::wakeUpViews()
+{
+    m_primaryViewContainer->view()->setHibernated(false);
+    if (m_secondaryViewContainer) {
+        m_secondaryViewContainer->view()->setHibernated(false);
+    }
+}
+
 void DolphinTabPage::startExpandViewAnimation(DolphinViewContainer *expandingContainer)
 {
     Q_CHECK_PTR(expandingContainer);
@@ -15,6 +15,7 @@
 
 class DolphinNavigatorsWidgetAction;
 class DolphinViewContainer;
+class QTimer;
 class QVariantAnimation;
 class KFileItemList;
 class DolphinTabPageSplitter;
@@ -129,9 +130,18 @@ public:
      */
     void restoreState(const QByteArray& state);
 
+    /**
+     * Restores all tab related properties like restoreState(), but postpones
+     * loading the directories until the tab page gets activated.
+     */
+    void restoreStateLazily(const QByteArray& state);
+
     /**
      * Set whether the tab page is active
      *
+     * The views of a tab page that is not active for the time configured by
+     * GeneralSettings::hibernateTabsDelay() get hibernated (see
+     * DolphinView::setHibernated()). They are woken up on activation.
      */
     void setActive(bool active);
 
@@ -169,6 +179,8 @@ private Q_SLOTS:
 
     void switchActiveView();
 
+    void hibernateViews();
+
 private:
     /**
      * Creates a new view container and does the default initialization.
@@ -185,6 +197,8 @@ private:
      */
     void startExpandViewAnimation(DolphinViewContainer *expandingContainer);
 
+    void wakeUpViews();
+
 private:
     DolphinTabPageSplitter *m_splitter;
 
@@ -198,6 +212,8 @@ private:
     bool m_primaryViewActive;
     bool m_splitViewEnabled;
     bool m_active;
+
+    QTimer* m_hibernationTimer;
 };
 
 class DolphinTabPageSplitterHandle : public QSplitterHandle
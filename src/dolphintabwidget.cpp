@@ -83,15 +83,21 @@ void DolphinTabWidget::saveProperties(KConfigGroup& group) const
 void DolphinTabWidget::readProperties(const KConfigGroup& group)
 {
     const int tabCount = group.readEntry("Tab Count", 0);
+    const int index = group.readEntry("Active Tab Index", 0);
     for (int i = 0; i < tabCount; ++i) {
         if (i >= count()) {
             openNewActivatedTab();
         }
         const QByteArray state = group.readEntry("Tab Data " % QString::number(i), QByteArray());
-        tabPageAt(i)->restoreState(state);
+        if (i != index && index >= 0 && index < tabCount) {
+            // The directories of tabs that are not shown get loaded when
+            // the tabs are activated the first time
+            tabPageAt(i)->restoreStateLazily(state);
+        } else {
+            tabPageAt(i)->restoreState(state);
+        }
     }
 
-    const int index = group.readEntry("Active Tab Index", 0);
     setCurrentIndex(index);
 }
 
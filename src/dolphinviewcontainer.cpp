@@ -47,6 +47,7 @@ DolphinViewContainer::DolphinViewContainer(const QUrl& url, QWidget* parent) :
     m_urlNavigatorConnected{nullptr},
     m_searchBox(nullptr),
     m_searchModeEnabled(false),
+    m_replacingLocation(false),
     m_messageWidget(nullptr),
     m_view(nullptr),
     m_filterBar(nullptr),
@@ -69,6 +70,7 @@ DolphinViewContainer::DolphinViewContainer(const QUrl& url, QWidget* parent) :
     connect(m_searchBox, &DolphinSearchBox::activated, this, &DolphinViewContainer::activate);
     connect(m_searchBox, &DolphinSearchBox::closeRequest, this, &DolphinViewContainer::closeSearchBox);
     connect(m_searchBox, &DolphinSearchBox::searchRequest, this, &DolphinViewContainer::startSearching);
+    connect(m_searchBox, &DolphinSearchBox::searchRefinementRequest, this, &DolphinViewContainer::refineSearch);
     connect(m_searchBox, &DolphinSearchBox::focusViewRequest, this, &DolphinViewContainer::requestFocus);
     m_searchBox->setWhatsThis(xi18nc("@info:whatsthis findbar",
         "<para>This helps you find files and folders. Enter a <emphasis>"
@@ -108,6 +110,7 @@ DolphinViewContainer::DolphinViewContainer(const QUrl& url, QWidget* parent) :
 
     // Initialize the main view
     m_view = new DolphinView(url, this);
+    m_searchBox->setView(m_view);
     connect(m_view, &DolphinView::urlChanged,
             m_filterBar, &FilterBar::slotUrlChanged);
     connect(m_view, &DolphinView::urlChanged,
@@ -711,7 +714,10 @@ void DolphinViewContainer::activate()
 
 void DolphinViewContainer::slotUrlNavigatorLocationAboutToBeChanged(const QUrl&)
 {
-    saveViewState();
+    // The state of a replaced location is dropped with its history entry
+    if (!m_replacingLocation) {
+        saveViewState();
+    }
 }
 
 void DolphinViewContainer::slotUrlNavigatorLocationChanged(const QUrl& url)
@@ -799,6 +805,21 @@ void DolphinViewContainer::startSearching()
     }
 }
 
+void DolphinViewContainer::refineSearch()
+{
+    // Each typed character refines the search, which must not add a history
+    // entry per character. Going back silently to the entry before the
+    // previous search lets setting the refined search drop the entry of the
+    // previous search.
+    const bool block = m_urlNavigator->signalsBlocked();
+    m_urlNavigator->blockSignals(true);
+    m_replacingLocation = m_urlNavigator->goBack();
+    m_urlNavigator->blockSignals(block);
+
+    startSearching();
+    m_replacingLocation = false;
+}
+
 void DolphinViewContainer::closeSearchBox()
 {
     setSearchModeEnabled(false);
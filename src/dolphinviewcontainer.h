@@ -350,6 +350,12 @@ private Q_SLOTS:
      * Gets the search URL from the searchbox and starts searching.
      */
     void startSearching();
+
+    /**
+     * Refines the search while the text is typed. The refined search
+     * replaces the previous search in the history.
+     */
+    void refineSearch();
     void closeSearchBox();
 
     /**
@@ -412,6 +418,7 @@ private:
     QPointer<DolphinUrlNavigator> m_urlNavigatorConnected;
     DolphinSearchBox* m_searchBox;
     bool m_searchModeEnabled;
+    bool m_replacingLocation; // True while the current history entry gets replaced
     KMessageWidget* m_messageWidget;
 
     DolphinView* m_view;
@@ -9,16 +9,17 @@
 #include "kfileitemlistwidget.h"
 #include "kfileitemmodel.h"
 #include "kfileitemmodelrolesupdater.h"
+#include "private/kitemlisticoncache.h"
 #include "private/kpixmapmodifier.h"
 
 #include <KIconLoader>
 
+#include <QApplication>
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QPainter>
 #include <QTimer>
 #include <QIcon>
-#include <QMimeDatabase>
 
 // #define KFILEITEMLISTVIEW_DEBUG
 
@@ -33,6 +34,10 @@ namespace {
     // the expensive re-generation of all previews is triggered repeatedly when
     // changing the zoom level.
     const int LongInterval = 300;
+
+    // Maximum number of distinct file extensions for which the icons
+    // get rendered in the background while a directory is loaded.
+    const int MaxPrewarmedIcons = 256;
 }
 
 KFileItemListView::KFileItemListView(QGraphicsWidget* parent) :
@@ -40,7 +45,9 @@ KFileItemListView::KFileItemListView(QGraphicsWidget* parent) :
     m_modelRolesUpdater(nullptr),
     m_updateVisibleIndexRangeTimer(nullptr),
     m_updateIconSizeTimer(nullptr),
-    m_scanDirectories(true)
+    m_scanDirectories(true),
+    m_hibernated(false),
+    m_prewarmedSuffixes()
 {
     setAcceptDrops(true);
 
@@ -220,6 +227,34 @@ void KFileItemListView::setHoverSequenceState(const QUrl& itemUrl, int seqIdx)
     }
 }
 
+void KFileItemListView::setHibernated(bool hibernated)
+{
+    if (m_hibernated == hibernated) {
+        return;
+    }
+    m_hibernated = hibernated;
+
+    if (!m_modelRolesUpdater) {
+        return;
+    }
+
+    if (hibernated) {
+        m_updateVisibleIndexRangeTimer->stop();
+        m_updateIconSizeTimer->stop();
+        m_modelRolesUpdater->setPaused(true);
+        m_modelRolesUpdater->releasePreviews();
+    } else {
+        // The icon size and the visible range might have been changed
+        // while hibernating, e.g. because the window has been resized
+        updateIconSize();
+    }
+}
+
+bool KFileItemListView::isHibernated() const
+{
+    return m_hibernated;
+}
+
 KItemListWidgetCreatorBase* KFileItemListView::defaultWidgetCreator() const
 {
     return new KItemListWidgetCreator<KFileItemListWidget>();
@@ -238,8 +273,8 @@ void KFileItemListView::initializeItemListWidget(KItemListWidget* item)
         const KFileItem fileItem = fileItemModel->fileItem(item->index());
         QString iconName = fileItem.iconName();
         if (!QIcon::hasThemeIcon(iconName)) {
-            QMimeDatabase mimeDb;
-            iconName = mimeDb.mimeTypeForName(fileItem.mimetype()).genericIconName();
+            // Don't read the contents of the file for a preliminary icon
+            iconName = fileItem.currentMimeType().genericIconName();
         }
         data.insert("iconName", iconName);
         item->setData(data, {"iconName"});
@@ -265,10 +300,24 @@ void KFileItemListView::onModelChanged(KItemModelBase* current, KItemModelBase*
     delete m_modelRolesUpdater;
     m_modelRolesUpdater = nullptr;
 
+    if (previous) {
+        disconnect(static_cast<KFileItemModel*>(previous), &KFileItemModel::directoryLoadingStarted,
+                   this, &KFileItemListView::resetPrewarmedIcons);
+        disconnect(previous, &KItemModelBase::itemsInserted,
+                   this, &KFileItemListView::prewarmIconCache);
+    }
+    resetPrewarmedIcons();
+
     if (current) {
+        connect(static_cast<KFileItemModel*>(current), &KFileItemModel::directoryLoadingStarted,
+                this, &KFileItemListView::resetPrewarmedIcons);
+        connect(current, &KItemModelBase::itemsInserted,
+                this, &KFileItemListView::prewarmIconCache);
+
         m_modelRolesUpdater = new KFileItemModelRolesUpdater(static_cast<KFileItemModel*>(current), this);
         m_modelRolesUpdater->setIconSize(availableIconSize());
         m_modelRolesUpdater->setScanDirectories(scanDirectories());
+        m_modelRolesUpdater->setPaused(m_hibernated);
 
         applyRolesToModel();
     }
@@ -330,7 +379,7 @@ void KFileItemListView::onTransactionEnd()
     // soon as the timer has been exceeded.
     const bool timerActive = m_updateVisibleIndexRangeTimer->isActive() ||
                              m_updateIconSizeTimer->isActive();
-    if (!timerActive) {
+    if (!timerActive && !m_hibernated) {
         m_modelRolesUpdater->setPaused(false);
     }
 }
@@ -380,7 +429,7 @@ void KFileItemListView::updateVisibleIndexRange()
     const int count = lastVisibleIndex() - index + 1;
     m_modelRolesUpdater->setMaximumVisibleItems(maximumVisibleItems());
     m_modelRolesUpdater->setVisibleIndexRange(index, count);
-    m_modelRolesUpdater->setPaused(isTransactionActive());
+    m_modelRolesUpdater->setPaused(isTransactionActive() || m_hibernated);
 }
 
 void KFileItemListView::triggerIconSizeUpdate()
@@ -411,7 +460,49 @@ void KFileItemListView::updateIconSize()
     const int count = lastVisibleIndex() - index + 1;
     m_modelRolesUpdater->setVisibleIndexRange(index, count);
 
-    m_modelRolesUpdater->setPaused(isTransactionActive());
+    m_modelRolesUpdater->setPaused(isTransactionActive() || m_hibernated);
+}
+
+void KFileItemListView::prewarmIconCache(const KItemRangeList& itemRanges)
+{
+    const KFileItemModel* fileItemModel = static_cast<KFileItemModel*>(model());
+    if (!fileItemModel || m_prewarmedSuffixes.count() >= MaxPrewarmedIcons) {
+        return;
+    }
+
+    // Pass one file name for each extension that has not been passed yet:
+    // The MIME types will be determined by the file names, which is sufficient
+    // for the icons of most items.
+    QStringList fileNames;
+    for (const KItemRange& range : itemRanges) {
+        const int lastIndex = range.index + range.count;
+        for (int i = range.index; i < lastIndex && m_prewarmedSuffixes.count() < MaxPrewarmedIcons; ++i) {
+            const KFileItem item = fileItemModel->fileItem(i);
+            if (item.isDir()) {
+                continue;
+            }
+
+            const QString fileName = item.name();
+            const int dotIndex = fileName.lastIndexOf(QLatin1Char('.'));
+            if (dotIndex > 0) {
+                const QString suffix = fileName.mid(dotIndex).toLower();
+                if (!m_prewarmedSuffixes.contains(suffix)) {
+                    m_prewarmedSuffixes.insert(suffix);
+                    fileNames.append(fileName);
+                }
+            }
+        }
+    }
+
+    if (!fileNames.isEmpty()) {
+        const int iconSize = styleOption().iconSize * qApp->devicePixelRatio();
+        KItemListIconCache::instance()->prewarm(fileNames, iconSize);
+    }
+}
+
+void KFileItemListView::resetPrewarmedIcons()
+{
+    m_prewarmedSuffixes.clear();
 }
 
 void KFileItemListView::applyRolesToModel()
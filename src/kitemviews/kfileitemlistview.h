@@ -12,6 +12,8 @@
 
 #include <KFileItem>
 
+#include <QSet>
+
 class KFileItemModelRolesUpdater;
 class QTimer;
 
@@ -90,6 +92,15 @@ public:
      */
     void setHoverSequenceState(const QUrl& itemUrl, int seqIdx);
 
+    /**
+     * If \a hibernated is set to true, the resolving of the roles is paused
+     * and the previews are released until the view gets woken up again by
+     * setHibernated(false). Hibernating makes sense for views that are not
+     * shown for a longer time.
+     */
+    void setHibernated(bool hibernated);
+    bool isHibernated() const;
+
 protected:
     KItemListWidgetCreatorBase* defaultWidgetCreator() const override;
     void initializeItemListWidget(KItemListWidget* item) override;
@@ -117,6 +128,16 @@ private Q_SLOTS:
     void triggerIconSizeUpdate();
     void updateIconSize();
 
+    /**
+     * Renders the icons for the file types of the inserted items in
+     * the background, so that they are available when scrolling.
+     * Called while the directory is loaded, so that the icons of
+     * large directories are ready early.
+     */
+    void prewarmIconCache(const KItemRangeList& itemRanges);
+
+    void resetPrewarmedIcons();
+
 private:
     /**
      * Applies the roles defined by KItemListView::visibleRoles() to the
@@ -138,6 +159,10 @@ private:
     QTimer* m_updateVisibleIndexRangeTimer;
     QTimer* m_updateIconSizeTimer;
     bool m_scanDirectories;
+    bool m_hibernated;
+
+    // Extensions of the files for which the icons have been prewarmed
+    QSet<QString> m_prewarmedSuffixes;
 
     friend class KFileItemListViewTest; // For unit testing
 };
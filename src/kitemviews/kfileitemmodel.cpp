@@ -11,13 +11,16 @@
 #include "dolphin_generalsettings.h"
 #include "dolphin_detailsmodesettings.h"
 #include "dolphindebug.h"
+#include "private/kfileitemmimedata.h"
+#include "private/kfileitemmimetyperesolver.h"
 #include "private/kfileitemmodelsortalgorithm.h"
+#include "private/klocaldirlister.h"
 
+#include <KCoreDirLister>
 #include <KDirLister>
 #include <KIO/Job>
 #include <KLocalizedString>
 #include <KLazyLocalizedString>
-#include <KUrlMimeData>
 
 #include <QElapsedTimer>
 #include <QMimeData>
@@ -31,11 +34,41 @@
 
 Q_GLOBAL_STATIC(QRecursiveMutex, s_collatorMutex)
 
+namespace {
+    // Maximum number of recently left directories whose items are cached
+    const int MaxCachedDirectoryCount = 3;
+
+    // Maximum number of items of all cached directories
+    const int MaxCachedItemCount = 200000;
+
+    // Directories with more items are not prefetched
+    const int MaxPrefetchedItemCount = 5000;
+
+    // Maximum time in ms for determining the MIME types of prefetched items
+    const int PrefetchMimeTypeTimeout = 50;
+
+    // The changes of a directory are applied after a delay of at least this
+    // factor multiplied by the time applying the previous changes took, so
+    // that the GUI thread is not starved by directories that change permanently
+    const int PendingChangesDelayFactor = 4;
+
+    // Maximum delay in ms for applying the changes of a directory
+    const int MaxPendingChangesDelay = 2000;
+
+    // Maximum number of folders that are listed at the same time by expandSubtree()
+    const int MaxConcurrentSubtreeListings = 4;
+
+    // expandSubtree() does not list further folders if this number
+    // of items has been listed
+    const int MaxSubtreeItemCount = 100000;
+}
+
 // #define KFILEITEMMODEL_DEBUG
 
 KFileItemModel::KFileItemModel(QObject* parent) :
     KItemModelBase("text", parent),
     m_dirLister(nullptr),
+    m_localDirLister(nullptr),
     m_sortDirsFirst(true),
     m_sortHiddenLast(false),
     m_sortRole(NameRole),
@@ -51,32 +84,34 @@ KFileItemModel::KFileItemModel(QObject* parent) :
     m_pendingItemsToInsert(),
     m_groups(),
     m_expandedDirs(),
-    m_urlsToExpand()
+    m_urlsToExpand(),
+    m_cachedDirectories(),
+    m_prefetchLister(nullptr),
+    m_prefetchUrl(),
+    m_prefetchedItems(),
+    m_reconciling(false),
+    m_reconciledUrls(),
+    m_reconciledChanges(),
+    m_pendingChanges(),
+    m_pendingChangesTimer(nullptr),
+    m_changeCoalescingInterval(GeneralSettings::changeCoalescingInterval()),
+    m_pendingChangesDuration(0),
+    m_listingCompleted(false),
+    m_completedAfterChanges(false),
+    m_subfoldersFlattened(false),
+    m_subtreeLister(nullptr),
+    m_subtreeDepth(0),
+    m_subtreeDirectories(),
+    m_subtreeDirectoryIndexes(),
+    m_subtreeListingIndex(0),
+    m_subtreeListingCount(0),
+    m_subtreeItemCount(0)
 {
     m_collator.setNumericMode(true);
 
     loadSortingSettings();
 
-    m_dirLister = new KDirLister(this);
-    m_dirLister->setAutoErrorHandlingEnabled(false);
-    m_dirLister->setDelayedMimeTypes(true);
-
-    const QWidget* parentWidget = qobject_cast<QWidget*>(parent);
-    if (parentWidget) {
-        m_dirLister->setMainWindow(parentWidget->window());
-    }
-
-    connect(m_dirLister, &KCoreDirLister::started, this, &KFileItemModel::directoryLoadingStarted);
-    connect(m_dirLister, &KCoreDirLister::canceled, this, &KFileItemModel::slotCanceled);
-    connect(m_dirLister, &KCoreDirLister::itemsAdded, this, &KFileItemModel::slotItemsAdded);
-    connect(m_dirLister, &KCoreDirLister::itemsDeleted, this, &KFileItemModel::slotItemsDeleted);
-    connect(m_dirLister, &KCoreDirLister::refreshItems, this, &KFileItemModel::slotRefreshItems);
-    connect(m_dirLister, &KCoreDirLister::clear, this, &KFileItemModel::slotClear);
-    connect(m_dirLister, &KCoreDirLister::infoMessage, this, &KFileItemModel::infoMessage);
-    connect(m_dirLister, &KCoreDirLister::jobError, this, &KFileItemModel::slotListerError);
-    connect(m_dirLister, &KCoreDirLister::percent, this, &KFileItemModel::directoryLoadingProgress);
-    connect(m_dirLister, &KCoreDirLister::redirection, this, &KFileItemModel::directoryRedirection);
-    connect(m_dirLister, &KCoreDirLister::listingDirCompleted, this, &KFileItemModel::slotCompleted);
+    createDirLister();
 
     // Apply default roles that should be determined
     resetRoles();
@@ -104,6 +139,12 @@ KFileItemModel::KFileItemModel(QObject* parent) :
     m_resortAllItemsTimer->setSingleShot(true);
     connect(m_resortAllItemsTimer, &QTimer::timeout, this, &KFileItemModel::resortAllItems);
 
+    // Changes of the listed directories are collected and applied together, as
+    // directories like build or log folders might change many times per second
+    m_pendingChangesTimer = new QTimer(this);
+    m_pendingChangesTimer->setSingleShot(true);
+    connect(m_pendingChangesTimer, &QTimer::timeout, this, &KFileItemModel::applyPendingChanges);
+
     connect(GeneralSettings::self(), &GeneralSettings::sortingChoiceChanged, this, &KFileItemModel::slotSortingChoiceChanged);
 }
 
@@ -112,11 +153,46 @@ KFileItemModel::~KFileItemModel()
     qDeleteAll(m_itemData);
     qDeleteAll(m_filteredItems);
     qDeleteAll(m_pendingItemsToInsert);
+    clearDirectoryCache();
 }
 
 void KFileItemModel::loadDirectory(const QUrl &url)
 {
-    m_dirLister->openUrl(url);
+    cancelPrefetching();
+
+    const bool directoryChanged = (url.adjusted(QUrl::StripTrailingSlash) != directory().adjusted(QUrl::StripTrailingSlash));
+    if (directoryChanged) {
+        cacheDirectory();
+    }
+
+    // Flattened sub-folders can only be listed by KLocalDirLister. File name
+    // searches are done by KLocalDirLister, as the filenamesearch worker
+    // walks the directory tree with one thread and streams the results
+    // over a socket.
+    const bool localListing = KLocalDirLister::isSupported(url) && !m_dirLister->dirOnlyMode();
+    const bool flattened = m_subfoldersFlattened && localListing;
+    const bool searching = localListing && !url.isLocalFile();
+    if (localListing && (flattened || searching || GeneralSettings::useLocalDirLister())) {
+        if (!m_dirLister->url().isEmpty()) {
+            // KDirLister must neither list nor watch the previous directory anymore
+            resetDirLister();
+        }
+        if (!m_localDirLister) {
+            createLocalDirLister();
+        }
+        m_localDirLister->setAutoUpdate(m_dirLister->autoUpdate());
+        m_localDirLister->setRecursive(flattened);
+        m_localDirLister->openUrl(url);
+    } else {
+        if (usesLocalDirLister()) {
+            m_localDirLister->close();
+        }
+        m_dirLister->openUrl(url);
+    }
+
+    if (directoryChanged && !flattened && !searching) {
+        restoreCachedDirectory(url);
+    }
 }
 
 void KFileItemModel::refreshDirectory(const QUrl &url)
@@ -128,17 +204,90 @@ void KFileItemModel::refreshDirectory(const QUrl &url)
         m_dirLister->openUrl(expandedDirs.value(), KDirLister::Reload);
     }
 
-    m_dirLister->openUrl(url, KDirLister::Reload);
+    if (usesLocalDirLister() && m_localDirLister->isRecursive() == m_subfoldersFlattened) {
+        m_localDirLister->openUrl(url);
+    } else if (m_subfoldersFlattened || usesLocalDirLister()) {
+        // Switch between the flattened and the normal listing
+        loadDirectory(url);
+    } else {
+        m_dirLister->openUrl(url, KDirLister::Reload);
+    }
+}
+
+bool KFileItemModel::canRefineSearch(const QUrl& url) const
+{
+    return usesLocalDirLister() && m_localDirLister->canRefineSearch(url);
 }
 
 QUrl KFileItemModel::directory() const
 {
-    return m_dirLister->url();
+    return usesLocalDirLister() ? m_localDirLister->url() : m_dirLister->url();
 }
 
 void KFileItemModel::cancelDirectoryLoading()
 {
     m_dirLister->stop();
+    if (usesLocalDirLister()) {
+        m_localDirLister->stop();
+    }
+}
+
+void KFileItemModel::releaseDirectory()
+{
+    resetDirLister();
+    if (m_localDirLister) {
+        m_localDirLister->close();
+    }
+
+    slotClear();
+    cancelPrefetching();
+    clearDirectoryCache();
+}
+
+void KFileItemModel::prefetchDirectory(const QUrl& url)
+{
+    const QUrl directoryUrl = url.adjusted(QUrl::StripTrailingSlash);
+    if (directoryUrl == m_prefetchUrl) {
+        return;
+    }
+    cancelPrefetching();
+
+    // Prefetching is restricted to local directories to keep the
+    // speculative I/O cheap
+    if (!directoryUrl.isLocalFile() || directoryUrl == directory().adjusted(QUrl::StripTrailingSlash)) {
+        return;
+    }
+    for (const CachedDirectory& cachedDirectory : qAsConst(m_cachedDirectories)) {
+        if (cachedDirectory.url == directoryUrl) {
+            return;
+        }
+    }
+
+    if (!m_prefetchLister) {
+        m_prefetchLister = new KCoreDirLister(this);
+        m_prefetchLister->setAutoErrorHandlingEnabled(false);
+        m_prefetchLister->setDelayedMimeTypes(true);
+        m_prefetchLister->setAutoUpdate(false);
+        connect(m_prefetchLister, &KCoreDirLister::itemsAdded, this, &KFileItemModel::slotPrefetchItemsAdded);
+        connect(m_prefetchLister, &KCoreDirLister::listingDirCompleted, this, &KFileItemModel::slotPrefetchCompleted);
+        connect(m_prefetchLister, &KCoreDirLister::canceled, this, &KFileItemModel::cancelPrefetching);
+    }
+    m_prefetchLister->setShowingDotFiles(m_dirLister->showingDotFiles());
+    m_prefetchLister->setDirOnlyMode(m_dirLister->dirOnlyMode());
+
+    m_prefetchUrl = directoryUrl;
+    m_prefetchLister->openUrl(directoryUrl);
+}
+
+void KFileItemModel::cancelPrefetching()
+{
+    if (m_prefetchUrl.isEmpty()) {
+        return;
+    }
+
+    m_prefetchUrl.clear();
+    m_prefetchedItems.clear();
+    m_prefetchLister->stop();
 }
 
 int KFileItemModel::count() const
@@ -240,6 +389,9 @@ void KFileItemModel::setShowHiddenFiles(bool show)
 {
     m_dirLister->setShowingDotFiles(show);
     m_dirLister->emitChanges();
+    if (m_localDirLister) {
+        m_localDirLister->setShowingDotFiles(show);
+    }
     if (show) {
         dispatchPendingItemsToInsert();
     }
@@ -255,6 +407,16 @@ void KFileItemModel::setShowDirectoriesOnly(bool enabled)
     m_dirLister->setDirOnlyMode(enabled);
 }
 
+void KFileItemModel::setSubfoldersFlattened(bool flattened)
+{
+    m_subfoldersFlattened = flattened;
+}
+
+bool KFileItemModel::subfoldersFlattened() const
+{
+    return m_subfoldersFlattened;
+}
+
 bool KFileItemModel::showDirectoriesOnly() const
 {
     return m_dirLister->dirOnlyMode();
@@ -262,13 +424,11 @@ bool KFileItemModel::showDirectoriesOnly() const
 
 QMimeData* KFileItemModel::createMimeData(const KItemSet& indexes) const
 {
-    QMimeData* data = new QMimeData();
-
     // The following code has been taken from KDirModel::mimeData()
     // (kdelibs/kio/kio/kdirmodel.cpp)
     // SPDX-FileCopyrightText: 2006 David Faure <faure@kde.org>
-    QList<QUrl> urls;
-    QList<QUrl> mostLocalUrls;
+    KFileItemList items;
+    items.reserve(indexes.count());
     const ItemData* lastAddedItem = nullptr;
 
     for (int index : indexes) {
@@ -287,15 +447,12 @@ QMimeData* KFileItemModel::createMimeData(const KItemSet& indexes) const
         lastAddedItem = itemData;
         const KFileItem& item = itemData->item;
         if (!item.isNull()) {
-            urls << item.url();
-
-            bool isLocal;
-            mostLocalUrls << item.mostLocalUrl(&isLocal);
+            items << item;
         }
     }
 
-    KUrlMimeData::setUrls(urls, mostLocalUrls, data);
-    return data;
+    // The URLs are serialized when the data is requested the first time
+    return new KFileItemMimeData(items);
 }
 
 int KFileItemModel::indexForKeyboardSearch(const QString& text, int startFromIndex) const
@@ -476,14 +633,75 @@ int KFileItemModel::index(const QUrl& url) const
 
 KFileItem KFileItemModel::rootItem() const
 {
-    return m_dirLister->rootItem();
+    return usesLocalDirLister() ? m_localDirLister->rootItem() : m_dirLister->rootItem();
 }
 
 void KFileItemModel::clear()
 {
+    // DolphinView clears the model before loading another directory.
+    // Keep the items, so that they are shown immediately when the
+    // directory is entered again.
+    cacheDirectory();
     slotClear();
 }
 
+bool KFileItemModel::clearRoleValues(const QSet<QByteArray>& roles)
+{
+    QVector<int> changedIndexes;
+    const int itemCount = count();
+    for (int index = 0; index < itemCount; ++index) {
+        QHash<QByteArray, QVariant>& values = m_itemData.at(index)->values;
+        bool changed = false;
+        for (const QByteArray& role : roles) {
+            // Check before removing, as removing detaches the shared values
+            if (values.contains(role)) {
+                values.remove(role);
+                changed = true;
+            }
+        }
+        if (changed) {
+            changedIndexes.append(index);
+        }
+    }
+
+    if (changedIndexes.isEmpty()) {
+        return false;
+    }
+
+    emitItemsChangedAndTriggerResorting(KItemRangeList::fromSortedContainer(changedIndexes), roles);
+    return true;
+}
+
+void KFileItemModel::setRoleValues(const QByteArray& role, const QVector<int>& indexes, const QVariantList& values)
+{
+    Q_ASSERT(indexes.count() == values.count());
+    Q_ASSERT(role != "text");
+
+    const QByteArray sharedRole = sharedValue(role);
+    QVector<int> changedIndexes;
+    changedIndexes.reserve(indexes.count());
+    for (int i = 0; i < indexes.count(); ++i) {
+        const int index = indexes.at(i);
+        if (index < 0 || index >= count()) {
+            continue;
+        }
+
+        // Make sure that the remaining values of the item have been retrieved
+        QHash<QByteArray, QVariant> currentValues = data(index);
+        const QVariant& value = values.at(i);
+        if (currentValues.value(sharedRole) != value) {
+            currentValues.insert(sharedRole, value);
+            m_itemData[index]->values = currentValues;
+            changedIndexes.append(index);
+        }
+    }
+
+    if (!changedIndexes.isEmpty()) {
+        std::sort(changedIndexes.begin(), changedIndexes.end());
+        emitItemsChangedAndTriggerResorting(KItemRangeList::fromSortedContainer(changedIndexes), {sharedRole});
+    }
+}
+
 void KFileItemModel::setRoles(const QSet<QByteArray>& roles)
 {
     if (m_roles == roles) {
@@ -553,7 +771,12 @@ bool KFileItemModel::setExpanded(int index, bool expanded)
     const QUrl url = item.url();
     const QUrl targetUrl = item.targetUrl();
     if (expanded) {
+        if (!m_subtreeDirectories.isEmpty() && m_subtreeDirectories.first().url == url.adjusted(QUrl::StripTrailingSlash)) {
+            cancelSubtreeExpansion();
+        }
+
         m_expandedDirs.insert(targetUrl, url);
+        m_listingCompleted = false;
         m_dirLister->openUrl(url, KDirLister::Keep);
 
         const QVariantList previouslyExpandedChildren = m_itemData.at(index)->values.value("previouslyExpandedChildren").value<QVariantList>();
@@ -605,6 +828,36 @@ bool KFileItemModel::setExpanded(int index, bool expanded)
     return true;
 }
 
+bool KFileItemModel::expandSubtree(int index, int depth)
+{
+    if (!isExpandable(index) || depth < 1 || !m_requestRole[ExpandedParentsCountRole]) {
+        return false;
+    }
+
+    if (isExpanded(index)) {
+        setExpanded(index, false);
+    }
+    cancelSubtreeExpansion();
+
+    if (!m_subtreeLister) {
+        m_subtreeLister = new KCoreDirLister(this);
+        m_subtreeLister->setAutoErrorHandlingEnabled(false);
+        m_subtreeLister->setDelayedMimeTypes(true);
+        m_subtreeLister->setAutoUpdate(false);
+        connect(m_subtreeLister, &KCoreDirLister::itemsAdded, this, &KFileItemModel::slotSubtreeItemsAdded);
+        connect(m_subtreeLister, &KCoreDirLister::listingDirCompleted, this, &KFileItemModel::slotSubtreeDirectoryCompleted);
+        connect(m_subtreeLister, &KCoreDirLister::listingDirCanceled, this, &KFileItemModel::slotSubtreeDirectoryCompleted);
+    }
+    m_subtreeLister->setShowingDotFiles(m_dirLister->showingDotFiles());
+    m_subtreeLister->setDirOnlyMode(m_dirLister->dirOnlyMode());
+
+    m_subtreeDepth = depth;
+    m_subtreeDirectories.append({m_itemData.at(index)->item.url().adjusted(QUrl::StripTrailingSlash), 1, false, KFileItemList()});
+    m_subtreeDirectoryIndexes.insert(m_subtreeDirectories.first().url, 0);
+    startSubtreeListings();
+    return true;
+}
+
 bool KFileItemModel::isExpanded(int index) const
 {
     if (index >= 0 && index < count()) {
@@ -653,10 +906,10 @@ void KFileItemModel::expandParentDirectories(const QUrl &url)
     // expanded is added to m_urlsToExpand. KDirLister
     // does not care whether the parent-URL has already been
     // expanded.
-    QUrl urlToExpand = m_dirLister->url();
+    QUrl urlToExpand = directory();
     const int pos = urlToExpand.path().length();
 
-    // first subdir can be empty, if m_dirLister->url().path() does not end with '/'
+    // first subdir can be empty, if directory().path() does not end with '/'
     // this happens if baseUrl is not root but a home directory, see FoldersPanel,
     // so using QString::SkipEmptyParts
     const QStringList subDirs = url.path().mid(pos).split(QDir::separator(), Qt::SkipEmptyParts);
@@ -985,6 +1238,11 @@ void KFileItemModel::slotCompleted()
 {
     m_maximumUpdateIntervalTimer->stop();
     dispatchPendingItemsToInsert();
+    m_listingCompleted = true;
+
+    if (m_reconciling) {
+        finishReconciling();
+    }
 
     if (!m_urlsToExpand.isEmpty()) {
         // Try to find a URL that can be expanded.
@@ -1017,6 +1275,12 @@ void KFileItemModel::slotCanceled()
 {
     m_maximumUpdateIntervalTimer->stop();
     dispatchPendingItemsToInsert();
+    m_listingCompleted = true;
+
+    // Keep the restored items, as it is unknown whether they are outdated
+    m_reconciling = false;
+    m_reconciledUrls.clear();
+    m_reconciledChanges.clear();
 
     Q_EMIT directoryLoadingCanceled();
 }
@@ -1025,6 +1289,16 @@ void KFileItemModel::slotItemsAdded(const QUrl &directoryUrl, const KFileItemLis
 {
     Q_ASSERT(!items.isEmpty());
 
+    if (m_reconciling) {
+        const KFileItemList unknownItems = reconcileItems(directoryUrl, items);
+        if (unknownItems.count() < items.count()) {
+            if (!unknownItems.isEmpty()) {
+                slotItemsAdded(directoryUrl, unknownItems);
+            }
+            return;
+        }
+    }
+
     const QUrl parentUrl = m_expandedDirs.value(directoryUrl, directoryUrl.adjusted(QUrl::StripTrailingSlash));
 
     if (m_requestRole[ExpandedParentsCountRole]) {
@@ -1033,7 +1307,7 @@ void KFileItemModel::slotItemsAdded(const QUrl &directoryUrl, const KFileItemLis
         // might result in emitting the same items twice due to the Keep-parameter.
         // This case happens if an item gets expanded, collapsed and expanded again
         // before the items could be loaded for the first expansion.
-        if (index(items.first().url()) >= 0) {
+        if (index(items.first().url()) >= 0 || m_filteredItems.contains(items.first())) {
             // The items are already part of the model.
             return;
         }
@@ -1054,36 +1328,12 @@ void KFileItemModel::slotItemsAdded(const QUrl &directoryUrl, const KFileItemLis
         }
     }
 
-    const QList<ItemData*> itemDataList = createItemDataList(parentUrl, items);
+    appendPendingItemsToInsert(createItemDataList(parentUrl, items));
 
-    if (!m_filter.hasSetFilters()) {
-        m_pendingItemsToInsert.append(itemDataList);
-    } else {
-        QSet<ItemData *> parentsToEnsureVisible;
-
-        // The name or type filter is active. Hide filtered items
-        // before inserting them into the model and remember
-        // the filtered items in m_filteredItems.
-        for (ItemData* itemData : itemDataList) {
-            if (m_filter.matches(itemData->item)) {
-                m_pendingItemsToInsert.append(itemData);
-                if (itemData->parent) {
-                    parentsToEnsureVisible.insert(itemData->parent);
-                }
-            } else {
-                m_filteredItems.insert(itemData->item, itemData);
-            }
-        }
-
-        // Entire parental chains must be shown
-        for (ItemData *parent : parentsToEnsureVisible) {
-            for (; parent && m_filteredItems.remove(parent->item); parent = parent->parent) {
-                m_pendingItemsToInsert.append(parent);
-            }
-        }
-    }
-
-    if (!m_maximumUpdateIntervalTimer->isActive()) {
+    if (m_itemData.isEmpty() && usesLocalDirLister() && m_localDirLister->isSearching()) {
+        // Show the first search results without waiting for more
+        dispatchPendingItemsToInsert();
+    } else if (!m_maximumUpdateIntervalTimer->isActive()) {
         // Assure that items get dispatched if no completed() or canceled() signal is
         // emitted during the maximum update interval.
         m_maximumUpdateIntervalTimer->start();
@@ -1376,6 +1626,227 @@ void KFileItemModel::slotClear()
     }
 
     m_expandedDirs.clear();
+    cancelSubtreeExpansion();
+
+    m_reconciling = false;
+    m_reconciledUrls.clear();
+    m_reconciledChanges.clear();
+
+    m_pendingChanges.clear();
+    m_pendingChangesTimer->stop();
+    m_listingCompleted = false;
+    m_completedAfterChanges = false;
+}
+
+void KFileItemModel::slotListerItemsAdded(const QUrl& directoryUrl, const KFileItemList& items)
+{
+    if (!coalescesChanges()) {
+        slotItemsAdded(directoryUrl, items);
+        return;
+    }
+
+    for (const KFileItem& item : items) {
+        // Adding a deleted item again results in refreshing it
+        PendingChange& change = m_pendingChanges[item.url()];
+        change.newItem = item;
+        change.directoryUrl = directoryUrl;
+    }
+    schedulePendingChanges();
+}
+
+void KFileItemModel::slotListerItemsDeleted(const KFileItemList& items)
+{
+    if (!coalescesChanges()) {
+        slotItemsDeleted(items);
+        return;
+    }
+
+    for (const KFileItem& item : items) {
+        auto it = m_pendingChanges.find(item.url());
+        if (it == m_pendingChanges.end()) {
+            m_pendingChanges.insert(item.url(), {item, KFileItem(), QUrl()});
+        } else if (it->oldItem.isNull()) {
+            // The item has been added and deleted in between
+            m_pendingChanges.erase(it);
+        } else {
+            it->newItem = KFileItem();
+        }
+    }
+    schedulePendingChanges();
+}
+
+void KFileItemModel::slotListerRefreshItems(const QList<QPair<KFileItem, KFileItem> >& items)
+{
+    if (!coalescesChanges()) {
+        slotRefreshItems(items);
+        return;
+    }
+
+    for (const auto& itemPair : items) {
+        const QUrl oldUrl = itemPair.first.url();
+        const QUrl newUrl = itemPair.second.url();
+        if (newUrl != oldUrl && m_pendingChanges.contains(newUrl)) {
+            // The renamed item replaces an item with a pending change,
+            // which cannot be merged
+            applyPendingChanges();
+        }
+
+        PendingChange change = {itemPair.first, itemPair.second, QUrl()};
+        auto it = m_pendingChanges.find(oldUrl);
+        if (it != m_pendingChanges.end()) {
+            // Keep the item that is part of the model, or keep
+            // adding the item if it is not part of the model yet
+            change.oldItem = it->oldItem;
+            change.directoryUrl = it->directoryUrl;
+            m_pendingChanges.erase(it);
+        }
+        m_pendingChanges.insert(newUrl, change);
+    }
+    schedulePendingChanges();
+}
+
+void KFileItemModel::slotListerCompleted()
+{
+    if (!m_pendingChanges.isEmpty() && coalescesChanges()) {
+        // Emit directoryLoadingCompleted() after the changes have been
+        // applied, as DolphinView selects e.g. pasted items then
+        m_completedAfterChanges = true;
+        return;
+    }
+
+    slotCompleted();
+}
+
+void KFileItemModel::applyPendingChanges()
+{
+    m_pendingChangesTimer->stop();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QHash<QUrl, PendingChange> changes;
+    changes.swap(m_pendingChanges);
+
+    KFileItemList deletedItems;
+    QList<QPair<KFileItem, KFileItem> > refreshedItems;
+    QHash<QUrl, KFileItemList> addedItems;
+    for (const PendingChange& change : qAsConst(changes)) {
+        if (change.newItem.isNull()) {
+            deletedItems.append(change.oldItem);
+        } else if (change.oldItem.isNull()) {
+            addedItems[change.directoryUrl].append(change.newItem);
+        } else {
+            refreshedItems.append(qMakePair(change.oldItem, change.newItem));
+        }
+    }
+
+    if (!deletedItems.isEmpty()) {
+        slotItemsDeleted(deletedItems);
+    }
+    if (!refreshedItems.isEmpty()) {
+        slotRefreshItems(refreshedItems);
+    }
+    for (auto it = addedItems.constBegin(); it != addedItems.constEnd(); ++it) {
+        slotItemsAdded(it.key(), it.value());
+    }
+    dispatchPendingItemsToInsert();
+
+    m_pendingChangesDuration = timer.elapsed();
+
+    if (m_completedAfterChanges) {
+        m_completedAfterChanges = false;
+        slotCompleted();
+    }
+}
+
+void KFileItemModel::slotPrefetchItemsAdded(const QUrl& directoryUrl, const KFileItemList& items)
+{
+    if (directoryUrl.adjusted(QUrl::StripTrailingSlash) != m_prefetchUrl) {
+        return;
+    }
+
+    m_prefetchedItems.append(items);
+    if (m_prefetchedItems.count() > MaxPrefetchedItemCount) {
+        cancelPrefetching();
+    }
+}
+
+void KFileItemModel::slotPrefetchCompleted()
+{
+    if (m_prefetchUrl.isEmpty() || m_prefetchedItems.isEmpty()) {
+        return;
+    }
+
+    // Determine the MIME types of the first items, which are most probably
+    // shown first, so that their final icons are known immediately
+    determineMimeTypes(m_prefetchedItems, PrefetchMimeTypeTimeout);
+
+    QList<ItemData*> itemDataList;
+    itemDataList.reserve(m_prefetchedItems.count());
+    for (const KFileItem& item : qAsConst(m_prefetchedItems)) {
+        ItemData* itemData = new ItemData();
+        itemData->item = item;
+        itemData->parent = nullptr;
+        itemDataList.append(itemData);
+    }
+    sortNewItems(itemDataList);
+
+    insertCachedDirectory(m_prefetchUrl, itemDataList, true);
+
+    m_prefetchUrl.clear();
+    m_prefetchedItems.clear();
+}
+
+void KFileItemModel::slotSubtreeItemsAdded(const QUrl& directoryUrl, const KFileItemList& items)
+{
+    const int directoryIndex = m_subtreeDirectoryIndexes.value(directoryUrl.adjusted(QUrl::StripTrailingSlash), -1);
+    if (directoryIndex < 0) {
+        return;
+    }
+
+    m_subtreeDirectories[directoryIndex].items.append(items);
+    m_subtreeItemCount += items.count();
+}
+
+void KFileItemModel::slotSubtreeDirectoryCompleted(const QUrl& directoryUrl)
+{
+    const int directoryIndex = m_subtreeDirectoryIndexes.value(directoryUrl.adjusted(QUrl::StripTrailingSlash), -1);
+    if (directoryIndex < 0 || directoryIndex >= m_subtreeListingIndex || m_subtreeDirectories.at(directoryIndex).completed) {
+        return;
+    }
+    --m_subtreeListingCount;
+
+    SubtreeDirectory& directory = m_subtreeDirectories[directoryIndex];
+    directory.completed = true;
+    if (directory.depth < m_subtreeDepth && m_subtreeItemCount < MaxSubtreeItemCount) {
+        const int depth = directory.depth + 1;
+        const KFileItemList items = directory.items;
+        for (const KFileItem& item : items) {
+            const QUrl url = item.url().adjusted(QUrl::StripTrailingSlash);
+            if (item.isDir() && !m_subtreeDirectoryIndexes.contains(url)) {
+                m_subtreeDirectoryIndexes.insert(url, m_subtreeDirectories.count());
+                m_subtreeDirectories.append({url, depth, false, KFileItemList()});
+            }
+        }
+    }
+
+    startSubtreeListings();
+    if (m_subtreeListingCount == 0 && m_subtreeListingIndex == m_subtreeDirectories.count()) {
+        finishSubtreeExpansion();
+    }
+}
+
+void KFileItemModel::slotLocalDirListerFailed(const QUrl& url)
+{
+    // KDirLister reports why the directory cannot be listed, e.g. that
+    // it does not exist or that the URL represents a file
+    m_dirLister->openUrl(url);
+}
+
+void KFileItemModel::slotLocalDirListerTruncated(int itemCount)
+{
+    Q_EMIT infoMessage(i18ncp("@info:status", "Only the first item is shown.",
+                              "Only the first %1 items are shown.", itemCount));
 }
 
 void KFileItemModel::slotSortingChoiceChanged()
@@ -1384,6 +1855,37 @@ void KFileItemModel::slotSortingChoiceChanged()
     resortAllItems();
 }
 
+void KFileItemModel::appendPendingItemsToInsert(const QList<ItemData*>& itemDataList)
+{
+    if (!m_filter.hasSetFilters()) {
+        m_pendingItemsToInsert.append(itemDataList);
+        return;
+    }
+
+    QSet<ItemData *> parentsToEnsureVisible;
+
+    // The name or type filter is active. Hide filtered items
+    // before inserting them into the model and remember
+    // the filtered items in m_filteredItems.
+    for (ItemData* itemData : itemDataList) {
+        if (m_filter.matches(itemData->item)) {
+            m_pendingItemsToInsert.append(itemData);
+            if (itemData->parent) {
+                parentsToEnsureVisible.insert(itemData->parent);
+            }
+        } else {
+            m_filteredItems.insert(itemData->item, itemData);
+        }
+    }
+
+    // Entire parental chains must be shown
+    for (ItemData *parent : parentsToEnsureVisible) {
+        for (; parent && m_filteredItems.remove(parent->item); parent = parent->parent) {
+            m_pendingItemsToInsert.append(parent);
+        }
+    }
+}
+
 void KFileItemModel::dispatchPendingItemsToInsert()
 {
     if (!m_pendingItemsToInsert.isEmpty()) {
@@ -1392,39 +1894,44 @@ void KFileItemModel::dispatchPendingItemsToInsert()
     }
 }
 
-void KFileItemModel::insertItems(QList<ItemData*>& newItems)
+void KFileItemModel::sortNewItems(QList<ItemData*>& itemDataList)
 {
-    if (newItems.isEmpty()) {
-        return;
-    }
-
-#ifdef KFILEITEMMODEL_DEBUG
-    QElapsedTimer timer;
-    timer.start();
-    qCDebug(DolphinDebug) << "===========================================================";
-    qCDebug(DolphinDebug) << "Inserting" << newItems.count() << "items";
-#endif
-
-    m_groups.clear();
-    prepareItemsForSorting(newItems);
+    prepareItemsForSorting(itemDataList);
 
     // Natural sorting of items can be very slow. However, it becomes much faster
     // if the input sequence is already mostly sorted. Therefore, we first sort
-    // 'newItems' according to the QStrings using QString::operator<(), which is quite fast.
+    // 'itemDataList' according to the QStrings using QString::operator<(), which is quite fast.
     if (m_naturalSorting) {
         if (m_sortRole == NameRole) {
-            parallelMergeSort(newItems.begin(), newItems.end(), nameLessThan, QThread::idealThreadCount());
+            parallelMergeSort(itemDataList.begin(), itemDataList.end(), nameLessThan, QThread::idealThreadCount());
         } else if (isRoleValueNatural(m_sortRole)) {
             auto lambdaLessThan = [&] (const KFileItemModel::ItemData* a, const KFileItemModel::ItemData* b)
             {
                 const QByteArray role = roleForType(m_sortRole);
                 return a->values.value(role).toString() < b->values.value(role).toString();
             };
-            parallelMergeSort(newItems.begin(), newItems.end(), lambdaLessThan, QThread::idealThreadCount());
+            parallelMergeSort(itemDataList.begin(), itemDataList.end(), lambdaLessThan, QThread::idealThreadCount());
         }
     }
 
-    sort(newItems.begin(), newItems.end());
+    sort(itemDataList.begin(), itemDataList.end());
+}
+
+void KFileItemModel::insertItems(QList<ItemData*>& newItems)
+{
+    if (newItems.isEmpty()) {
+        return;
+    }
+
+#ifdef KFILEITEMMODEL_DEBUG
+    QElapsedTimer timer;
+    timer.start();
+    qCDebug(DolphinDebug) << "===========================================================";
+    qCDebug(DolphinDebug) << "Inserting" << newItems.count() << "items";
+#endif
+
+    m_groups.clear();
+    sortNewItems(newItems);
 
 #ifdef KFILEITEMMODEL_DEBUG
     qCDebug(DolphinDebug) << "[TIME] Sorting:" << timer.elapsed();
@@ -1549,7 +2056,8 @@ QList<KFileItemModel::ItemData*> KFileItemModel::createItemDataList(const QUrl&
     if (m_sortRole == TypeRole) {
         // Try to resolve the MIME-types synchronously to prevent a reordering of
         // the items when sorting by type (per default MIME-types are resolved
-        // asynchronously by KFileItemModelRolesUpdater).
+        // asynchronously by KFileItemModelRolesUpdater). This is only done for
+        // items whose MIME type can be determined without reading their contents.
         determineMimeTypes(items, 200);
     }
 
@@ -1715,6 +2223,358 @@ void KFileItemModel::resetRoles()
     }
 }
 
+void KFileItemModel::createDirLister()
+{
+    m_dirLister = new KDirLister(this);
+    m_dirLister->setAutoErrorHandlingEnabled(false);
+    m_dirLister->setDelayedMimeTypes(true);
+
+    const QWidget* parentWidget = qobject_cast<QWidget*>(parent());
+    if (parentWidget) {
+        m_dirLister->setMainWindow(parentWidget->window());
+    }
+
+    connect(m_dirLister, &KCoreDirLister::started, this, &KFileItemModel::directoryLoadingStarted);
+    connect(m_dirLister, &KCoreDirLister::canceled, this, &KFileItemModel::slotCanceled);
+    connect(m_dirLister, &KCoreDirLister::itemsAdded, this, &KFileItemModel::slotListerItemsAdded);
+    connect(m_dirLister, &KCoreDirLister::itemsDeleted, this, &KFileItemModel::slotListerItemsDeleted);
+    connect(m_dirLister, &KCoreDirLister::refreshItems, this, &KFileItemModel::slotListerRefreshItems);
+    connect(m_dirLister, &KCoreDirLister::clear, this, &KFileItemModel::slotClear);
+    connect(m_dirLister, &KCoreDirLister::infoMessage, this, &KFileItemModel::infoMessage);
+    connect(m_dirLister, &KCoreDirLister::jobError, this, &KFileItemModel::slotListerError);
+    connect(m_dirLister, &KCoreDirLister::percent, this, &KFileItemModel::directoryLoadingProgress);
+    connect(m_dirLister, &KCoreDirLister::redirection, this, &KFileItemModel::directoryRedirection);
+    connect(m_dirLister, &KCoreDirLister::listingDirCompleted, this, &KFileItemModel::slotListerCompleted);
+}
+
+bool KFileItemModel::coalescesChanges() const
+{
+    // While a directory is loaded or expanded, the items are dispatched
+    // by m_maximumUpdateIntervalTimer and slotCompleted() instead
+    return m_changeCoalescingInterval > 0 && m_listingCompleted && !m_reconciling && m_urlsToExpand.isEmpty();
+}
+
+void KFileItemModel::schedulePendingChanges()
+{
+    if (m_pendingChanges.isEmpty() || m_pendingChangesTimer->isActive()) {
+        return;
+    }
+
+    // The timer is not restarted by later changes, so that the changes
+    // are applied even if the directory changes permanently
+    const qint64 delay = qMin<qint64>(PendingChangesDelayFactor * m_pendingChangesDuration, MaxPendingChangesDelay);
+    m_pendingChangesTimer->start(qMax<int>(m_changeCoalescingInterval, delay));
+}
+
+void KFileItemModel::resetDirLister()
+{
+    // The listed directories are only released from the cache of KDirLister
+    // and stopped being watched when the dir lister gets deleted
+    const bool showHiddenFiles = m_dirLister->showingDotFiles();
+    const bool dirOnlyMode = m_dirLister->dirOnlyMode();
+    const bool autoUpdate = m_dirLister->autoUpdate();
+    m_dirLister->stop();
+    delete m_dirLister;
+
+    createDirLister();
+    m_dirLister->setShowingDotFiles(showHiddenFiles);
+    m_dirLister->setDirOnlyMode(dirOnlyMode);
+    m_dirLister->setAutoUpdate(autoUpdate);
+}
+
+void KFileItemModel::createLocalDirLister()
+{
+    m_localDirLister = new KLocalDirLister(this);
+    m_localDirLister->setShowingDotFiles(m_dirLister->showingDotFiles());
+
+    connect(m_localDirLister, &KLocalDirLister::started, this, &KFileItemModel::directoryLoadingStarted);
+    connect(m_localDirLister, &KLocalDirLister::canceled, this, &KFileItemModel::slotCanceled);
+    connect(m_localDirLister, &KLocalDirLister::itemsAdded, this, &KFileItemModel::slotListerItemsAdded);
+    connect(m_localDirLister, &KLocalDirLister::itemsDeleted, this, &KFileItemModel::slotListerItemsDeleted);
+    connect(m_localDirLister, &KLocalDirLister::refreshItems, this, &KFileItemModel::slotListerRefreshItems);
+    connect(m_localDirLister, &KLocalDirLister::clear, this, &KFileItemModel::slotClear);
+    connect(m_localDirLister, &KLocalDirLister::listingDirCompleted, this, &KFileItemModel::slotListerCompleted);
+    connect(m_localDirLister, &KLocalDirLister::failed, this, &KFileItemModel::slotLocalDirListerFailed);
+    connect(m_localDirLister, &KLocalDirLister::truncated, this, &KFileItemModel::slotLocalDirListerTruncated);
+}
+
+bool KFileItemModel::usesLocalDirLister() const
+{
+    return m_localDirLister && !m_localDirLister->url().isEmpty();
+}
+
+void KFileItemModel::cacheDirectory()
+{
+    const int itemCount = m_itemData.count();
+    if (itemCount == 0 || itemCount > MaxCachedItemCount || m_reconciling
+        || (usesLocalDirLister() && (m_localDirLister->isRecursive() || m_localDirLister->isSearching()))
+        || !(usesLocalDirLister() ? m_localDirLister->isFinished() : m_dirLister->isFinished())
+        || !m_pendingItemsToInsert.isEmpty() || !m_pendingChanges.isEmpty() || !m_expandedDirs.isEmpty()
+        || !m_filteredItems.isEmpty() || m_filter.hasSetFilters()) {
+        return;
+    }
+
+    const QList<ItemData*> itemData = m_itemData;
+    m_itemData.clear();
+    m_items.clear();
+    m_groups.clear();
+    m_resortAllItemsTimer->stop();
+    Q_EMIT itemsRemoved(KItemRangeList() << KItemRange(0, itemCount));
+
+    // The previews would make up most of the memory of the cache. They are
+    // generated again by KFileItemModelRolesUpdater when the items are restored.
+    static const QByteArray pixmapRoles[] = {QByteArrayLiteral("iconPixmap"), QByteArrayLiteral("hoverSequencePixmaps")};
+    for (ItemData* data : itemData) {
+        for (const QByteArray& role : pixmapRoles) {
+            // Check before removing, as removing detaches the shared values
+            if (data->values.contains(role)) {
+                data->values.remove(role);
+            }
+        }
+    }
+
+    insertCachedDirectory(directory(), itemData);
+}
+
+void KFileItemModel::insertCachedDirectory(const QUrl& url, const QList<ItemData*>& itemData, bool prefetched)
+{
+    CachedDirectory cachedDirectory;
+    cachedDirectory.url = url.adjusted(QUrl::StripTrailingSlash);
+    cachedDirectory.itemData = itemData;
+    cachedDirectory.roles = m_roles;
+    cachedDirectory.sortRole = m_sortRole;
+    cachedDirectory.sortOrder = sortOrder();
+    cachedDirectory.sortDirsFirst = m_sortDirsFirst;
+    cachedDirectory.sortHiddenLast = m_sortHiddenLast;
+    cachedDirectory.naturalSorting = m_naturalSorting;
+    cachedDirectory.showHiddenFiles = m_dirLister->showingDotFiles();
+    cachedDirectory.dirOnlyMode = m_dirLister->dirOnlyMode();
+    cachedDirectory.prefetched = prefetched;
+
+    int cachedItemCount = itemData.count();
+    int leftDirectoryCount = prefetched ? 0 : 1;
+    for (int i = m_cachedDirectories.count() - 1; i >= 0; --i) {
+        const CachedDirectory& otherDirectory = m_cachedDirectories.at(i);
+        if (otherDirectory.url == cachedDirectory.url || (prefetched && otherDirectory.prefetched)) {
+            qDeleteAll(m_cachedDirectories.takeAt(i).itemData);
+        } else {
+            cachedItemCount += otherDirectory.itemData.count();
+            if (!otherDirectory.prefetched) {
+                ++leftDirectoryCount;
+            }
+        }
+    }
+    m_cachedDirectories.append(cachedDirectory);
+
+    while (leftDirectoryCount > MaxCachedDirectoryCount || cachedItemCount > MaxCachedItemCount) {
+        const CachedDirectory oldestDirectory = m_cachedDirectories.takeFirst();
+        cachedItemCount -= oldestDirectory.itemData.count();
+        if (!oldestDirectory.prefetched) {
+            --leftDirectoryCount;
+        }
+        qDeleteAll(oldestDirectory.itemData);
+    }
+}
+
+void KFileItemModel::restoreCachedDirectory(const QUrl& url)
+{
+    const QUrl directoryUrl = url.adjusted(QUrl::StripTrailingSlash);
+    int cacheIndex = -1;
+    for (int i = 0; i < m_cachedDirectories.count(); ++i) {
+        if (m_cachedDirectories.at(i).url == directoryUrl) {
+            cacheIndex = i;
+            break;
+        }
+    }
+    if (cacheIndex < 0) {
+        return;
+    }
+
+    const CachedDirectory cachedDirectory = m_cachedDirectories.takeAt(cacheIndex);
+    const bool upToDate = m_itemData.isEmpty() && m_pendingItemsToInsert.isEmpty()
+                          && !m_filter.hasSetFilters()
+                          && cachedDirectory.roles == m_roles
+                          && cachedDirectory.sortRole == m_sortRole
+                          && cachedDirectory.sortOrder == sortOrder()
+                          && cachedDirectory.sortDirsFirst == m_sortDirsFirst
+                          && cachedDirectory.sortHiddenLast == m_sortHiddenLast
+                          && cachedDirectory.naturalSorting == m_naturalSorting
+                          && cachedDirectory.showHiddenFiles == m_dirLister->showingDotFiles()
+                          && cachedDirectory.dirOnlyMode == m_dirLister->dirOnlyMode();
+    if (!upToDate) {
+        qDeleteAll(cachedDirectory.itemData);
+        return;
+    }
+
+    m_itemData = cachedDirectory.itemData;
+    m_items.clear();
+    m_groups.clear();
+
+    m_reconciling = true;
+    m_reconciledUrls.clear();
+    m_reconciledUrls.reserve(m_itemData.count());
+    m_reconciledChanges.clear();
+
+    Q_EMIT itemsInserted(KItemRangeList() << KItemRange(0, m_itemData.count()));
+}
+
+KFileItemList KFileItemModel::reconcileItems(const QUrl& directoryUrl, const KFileItemList& items)
+{
+    if (directoryUrl.adjusted(QUrl::StripTrailingSlash) != directory().adjusted(QUrl::StripTrailingSlash)) {
+        return items;
+    }
+
+    KFileItemList unknownItems;
+    for (const KFileItem& item : items) {
+        const QUrl url = item.url();
+        m_reconciledUrls.insert(url);
+
+        const int indexForItem = index(url);
+        if (indexForItem < 0) {
+            unknownItems.append(item);
+        } else {
+            const KFileItem& restoredItem = m_itemData.at(indexForItem)->item;
+            if (!restoredItem.cmp(item)) {
+                m_reconciledChanges.append(qMakePair(restoredItem, item));
+            }
+        }
+    }
+    return unknownItems;
+}
+
+void KFileItemModel::finishReconciling()
+{
+    m_reconciling = false;
+
+    KFileItemList staleItems;
+    for (const ItemData* itemData : qAsConst(m_itemData)) {
+        if (!itemData->parent && !m_reconciledUrls.contains(itemData->item.url())) {
+            staleItems.append(itemData->item);
+        }
+    }
+    for (const ItemData* itemData : qAsConst(m_filteredItems)) {
+        if (!itemData->parent && !m_reconciledUrls.contains(itemData->item.url())) {
+            staleItems.append(itemData->item);
+        }
+    }
+    m_reconciledUrls.clear();
+
+    const QList<QPair<KFileItem, KFileItem>> changedItems = m_reconciledChanges;
+    m_reconciledChanges.clear();
+
+    if (!staleItems.isEmpty()) {
+        slotItemsDeleted(staleItems);
+    }
+    if (!changedItems.isEmpty()) {
+        slotRefreshItems(changedItems);
+    }
+}
+
+void KFileItemModel::startSubtreeListings()
+{
+    while (m_subtreeListingCount < MaxConcurrentSubtreeListings && m_subtreeListingIndex < m_subtreeDirectories.count()) {
+        const QUrl url = m_subtreeDirectories.at(m_subtreeListingIndex).url;
+        ++m_subtreeListingIndex;
+        ++m_subtreeListingCount;
+
+        // The folders of the previous subtree are forgotten when the first
+        // folder is listed
+        m_subtreeLister->openUrl(url, m_subtreeListingIndex == 1 ? KDirLister::NoFlags : KDirLister::Keep);
+    }
+}
+
+void KFileItemModel::finishSubtreeExpansion()
+{
+    const int rootIndex = index(m_subtreeDirectories.first().url);
+    if (rootIndex < 0 || isExpanded(rootIndex)) {
+        // The folder has been removed or collapsed meanwhile
+        cancelSubtreeExpansion();
+        return;
+    }
+
+    // Expanding the folder requires that the items of its parent have been inserted
+    dispatchPendingItemsToInsert();
+
+    QHash<QByteArray, QVariant> values;
+    values.insert(sharedValue("isExpanded"), true);
+    setData(rootIndex, values);
+
+    QHash<QUrl, ItemData*> parents;
+    parents.insert(m_subtreeDirectories.first().url, m_itemData.at(rootIndex));
+
+    KFileItemList items;
+    items.reserve(m_subtreeItemCount);
+    QList<ItemData*> itemDataList;
+    itemDataList.reserve(m_subtreeItemCount);
+    QList<QUrl> expandedUrls;
+
+    // The parents of the folders precede them in m_subtreeDirectories
+    for (const SubtreeDirectory& directory : qAsConst(m_subtreeDirectories)) {
+        ItemData* parent = parents.value(directory.url);
+        if (!parent) {
+            continue;
+        }
+
+        if (parent->values.isEmpty() || !parent->values.value("isExpanded").toBool()) {
+            parent->values = retrieveData(parent->item, parent->parent);
+            parent->values.insert(sharedValue("isExpanded"), true);
+        }
+        m_expandedDirs.insert(parent->item.targetUrl(), parent->item.url());
+        expandedUrls.append(parent->item.url());
+
+        for (const KFileItem& item : directory.items) {
+            ItemData* itemData = new ItemData();
+            itemData->item = item;
+            itemData->parent = parent;
+            itemDataList.append(itemData);
+            items.append(item);
+
+            if (item.isDir()) {
+                parents.insert(item.url().adjusted(QUrl::StripTrailingSlash), itemData);
+            }
+        }
+    }
+
+    if (m_sortRole == TypeRole) {
+        determineMimeTypes(items, 200);
+    }
+
+    appendPendingItemsToInsert(itemDataList);
+    dispatchPendingItemsToInsert();
+
+    // m_dirLister watches the folders for changes from now on. It gets the
+    // items from the cache, as they are still held by m_subtreeLister, and
+    // slotItemsAdded() ignores them as they are part of the model already.
+    m_listingCompleted = false;
+    for (const QUrl& url : qAsConst(expandedUrls)) {
+        m_dirLister->openUrl(url, KDirLister::Keep);
+    }
+
+    cancelSubtreeExpansion();
+}
+
+void KFileItemModel::cancelSubtreeExpansion()
+{
+    if (m_subtreeDirectories.isEmpty()) {
+        return;
+    }
+
+    m_subtreeDirectories.clear();
+    m_subtreeDirectoryIndexes.clear();
+    m_subtreeListingIndex = 0;
+    m_subtreeListingCount = 0;
+    m_subtreeItemCount = 0;
+    m_subtreeLister->stop();
+}
+
+void KFileItemModel::clearDirectoryCache()
+{
+    for (const CachedDirectory& cachedDirectory : qAsConst(m_cachedDirectories)) {
+        qDeleteAll(cachedDirectory.itemData);
+    }
+    m_cachedDirectories.clear();
+}
+
 KFileItemModel::RoleType KFileItemModel::typeForRole(const QByteArray& role) const
 {
     static QHash<QByteArray, RoleType> roles;
@@ -2644,8 +3504,9 @@ void KFileItemModel::determineMimeTypes(const KFileItemList& items, int timeout)
         // KFileItem::determineMimeType() reads the .directory file inside to
         // load the icon, but this is not necessary at all if we just need the
         // type. Some special code for setting the correct mime type for
-        // directories is in retrieveData().
-        if (!item.isDir()) {
+        // directories is in retrieveData(). Files whose contents must be read
+        // are left to KFileItemModelRolesUpdater, which reads them in the background.
+        if (!item.isDir() && !KFileItemMimeTypeResolver::needsContentSniffing(item)) {
             item.determineMimeType();
         }
 
@@ -21,7 +21,9 @@
 
 #include <functional>
 
+class KCoreDirLister;
 class KDirLister;
+class KLocalDirLister;
 
 class QTimer;
 
@@ -52,6 +54,13 @@ public:
      * directoryLoadingStarted(), directoryLoadingProgress() and directoryLoadingCompleted()
      * indicate the current state of the loading process. The items
      * of the directory are added after the loading has been completed.
+     *
+     * The items of recently left directories are cached. If \a url is
+     * one of them, the cached items are shown immediately and reconciled
+     * with the listed items when the loading has been completed.
+     *
+     * If the setting UseLocalDirLister is enabled, local directories are
+     * listed by KLocalDirLister instead of KDirLister.
      */
     void loadDirectory(const QUrl& url);
 
@@ -61,6 +70,12 @@ public:
      */
     void refreshDirectory(const QUrl& url);
 
+    /**
+     * @return True if loading the search \a url refines the results of the
+     *         current search, which shows the results immediately.
+     */
+    bool canRefineSearch(const QUrl& url) const;
+
     /**
      * @return Parent directory of the items that are shown. In case
      *         if a directory tree is shown, KFileItemModel::dir() returns
@@ -75,6 +90,27 @@ public:
      */
     void cancelDirectoryLoading();
 
+    /**
+     * Removes all items and stops watching the directory, e.g. while the
+     * items are not shown for a longer time. Other than clear() this also
+     * releases the directory from the cache of KDirLister. loadDirectory()
+     * must be invoked to show the items again.
+     */
+    void releaseDirectory();
+
+    /**
+     * Lists the local directory \a url in the background and adds its
+     * items to the cache of recently left directories, so that
+     * loadDirectory() can show them immediately. Big directories are not
+     * prefetched. A running prefetch is canceled.
+     */
+    void prefetchDirectory(const QUrl& url);
+
+    /**
+     * Cancels the listing started by prefetchDirectory().
+     */
+    void cancelPrefetching();
+
     int count() const override;
     QHash<QByteArray, QVariant> data(int index) const override;
     bool setData(int index, const QHash<QByteArray, QVariant>& values) override;
@@ -102,6 +138,16 @@ public:
     void setShowDirectoriesOnly(bool enabled);
     bool showDirectoriesOnly() const;
 
+    /**
+     * If \a flattened is true, the files of all sub-folders of a local
+     * directory are shown as items of the directory. The sub-folders are
+     * read concurrently by KLocalDirLister, and the depth and the number of
+     * items are limited. The role "path" tells the folder of an item.
+     * Takes effect with the next loadDirectory() or refreshDirectory().
+     */
+    void setSubfoldersFlattened(bool flattened);
+    bool subfoldersFlattened() const;
+
     QMimeData* createMimeData(const KItemSet& indexes) const override;
 
     int indexForKeyboardSearch(const QString& text, int startFromIndex = 0) const override;
@@ -146,10 +192,27 @@ public:
     KFileItem rootItem() const;
 
     /**
-     * Clears all items of the model.
+     * Clears all items of the model. The items of a completely loaded
+     * directory are cached like in loadDirectory().
      */
     void clear();
 
+    /**
+     * Removes the values of the roles \a roles from all items, e.g. to release
+     * the memory of previews. Items whose data has not been retrieved yet
+     * are not touched.
+     * @return True if a value has been removed.
+     */
+    bool clearRoleValues(const QSet<QByteArray>& roles);
+
+    /**
+     * Sets the value of the role \a role of the items with the indexes
+     * \a indexes to \a values. In contrast to calling setData() for each
+     * item, the signal itemsChanged() is emitted only once and the items
+     * are resorted at most once. The role "text" may not be set this way.
+     */
+    void setRoleValues(const QByteArray& role, const QVector<int>& indexes, const QVariantList& values);
+
     /**
      * Sets the roles that should be shown for each item.
      */
@@ -161,6 +224,17 @@ public:
     bool isExpandable(int index) const override;
     int expandedParentsCount(int index) const override;
 
+    /**
+     * Expands the folder with the index \a index and all its sub-folders up
+     * to the depth \a depth, where a depth of 1 only expands the folder
+     * itself. The folders are listed concurrently and all their items are
+     * inserted at once when the listing has been finished. An expanded
+     * folder is collapsed first.
+     *
+     * @return True if the expanding has been started.
+     */
+    bool expandSubtree(int index, int depth) override;
+
     QSet<QUrl> expandedDirectories() const;
 
     /**
@@ -282,6 +356,34 @@ private Q_SLOTS:
     void slotRefreshItems(const QList<QPair<KFileItem, KFileItem> >& items);
     void slotClear();
     void slotSortingChoiceChanged();
+
+    /**
+     * Receive the changes of the dir listers. The changes of completely
+     * listed directories are collected and applied by applyPendingChanges().
+     */
+    void slotListerItemsAdded(const QUrl& directoryUrl, const KFileItemList& items);
+    void slotListerItemsDeleted(const KFileItemList& items);
+    void slotListerRefreshItems(const QList<QPair<KFileItem, KFileItem> >& items);
+    void slotListerCompleted();
+
+    /**
+     * Applies the collected changes of the listed directories with one
+     * call of slotItemsDeleted(), slotRefreshItems() and
+     * dispatchPendingItemsToInsert() each.
+     */
+    void applyPendingChanges();
+
+    void slotPrefetchItemsAdded(const QUrl& directoryUrl, const KFileItemList& items);
+    void slotPrefetchCompleted();
+
+    /**
+     * Collect the items listed for expandSubtree(). If a folder has been
+     * listed, its sub-folders are listed next until the depth is reached.
+     */
+    void slotSubtreeItemsAdded(const QUrl& directoryUrl, const KFileItemList& items);
+    void slotSubtreeDirectoryCompleted(const QUrl& directoryUrl);
+    void slotLocalDirListerFailed(const QUrl& url);
+    void slotLocalDirListerTruncated(int itemCount);
     void slotListerError(KIO::Job *job);
 
     void dispatchPendingItemsToInsert();
@@ -314,6 +416,12 @@ private:
         DeleteItemDataIfUnfiltered
     };
 
+    /**
+     * Appends the items \a itemDataList to m_pendingItemsToInsert, or to
+     * m_filteredItems if they are hidden by the filters.
+     */
+    void appendPendingItemsToInsert(const QList<ItemData*>& itemDataList);
+
     void insertItems(QList<ItemData*>& items);
     void removeItems(const KItemRangeList& itemRanges, RemoveItemsBehavior behavior);
 
@@ -348,6 +456,97 @@ private:
      */
     void resetRoles();
 
+    /**
+     * Creates m_dirLister and connects its signals.
+     */
+    void createDirLister();
+
+    /**
+     * Replaces m_dirLister by a new instance, which releases the listed
+     * directories from the cache of KDirLister and stops watching them.
+     */
+    void resetDirLister();
+
+    /**
+     * Creates m_localDirLister and connects its signals.
+     */
+    void createLocalDirLister();
+
+    /**
+     * @return True if the directory is listed by m_localDirLister
+     *         instead of m_dirLister. Expanded folders are listed
+     *         by m_dirLister in any case.
+     */
+    bool usesLocalDirLister() const;
+
+    /**
+     * @return True if the changes of the listed directories are
+     *         collected instead of being applied immediately.
+     */
+    bool coalescesChanges() const;
+
+    /**
+     * Starts m_pendingChangesTimer if it is not active yet. The delay grows with
+     * the time applying the previous changes took.
+     */
+    void schedulePendingChanges();
+
+    /**
+     * Moves the items of the current directory to m_cachedDirectories if
+     * they have been loaded completely and are not filtered or expanded.
+     */
+    void cacheDirectory();
+
+    /**
+     * Adds the items \a itemData of the directory \a url, which have been
+     * sorted with the current settings, to m_cachedDirectories. The cache
+     * takes the ownership of the items. Only the most recently prefetched
+     * directory is kept, so prefetching does not evict the left directories.
+     */
+    void insertCachedDirectory(const QUrl& url, const QList<ItemData*>& itemData, bool prefetched = false);
+
+    /**
+     * Sorts the new items \a itemDataList by the current sort role.
+     */
+    void sortNewItems(QList<ItemData*>& itemDataList);
+
+    /**
+     * Shows the cached items of the directory \a url if the sorting and
+     * the roles have not been changed since the items have been cached.
+     * The items are reconciled with the items of the dir lister by
+     * reconcileItems() and finishReconciling().
+     */
+    void restoreCachedDirectory(const QUrl& url);
+
+    /**
+     * Marks the items \a items of the directory \a directoryUrl that are
+     * part of the restored items as reconciled.
+     * @return Items that are not part of the model yet.
+     */
+    KFileItemList reconcileItems(const QUrl& directoryUrl, const KFileItemList& items);
+
+    /**
+     * Removes the restored items that have not been listed again and
+     * updates the restored items that have been changed.
+     */
+    void finishReconciling();
+
+    void clearDirectoryCache();
+
+    /**
+     * Lists the next folders of expandSubtree() as long as the
+     * number of concurrent listings permits it.
+     */
+    void startSubtreeListings();
+
+    /**
+     * Inserts the items of all folders listed by expandSubtree() with one
+     * call of insertItems(), and lets m_dirLister watch the folders.
+     */
+    void finishSubtreeExpansion();
+
+    void cancelSubtreeExpansion();
+
     /**
      * @return Role-type for the given role.
      *         Runtime complexity is O(1).
@@ -480,6 +679,7 @@ private:
 
 private:
     KDirLister *m_dirLister = nullptr;
+    KLocalDirLister* m_localDirLister;
 
     QCollator m_collator;
     bool m_naturalSorting;
@@ -517,7 +717,70 @@ private:
     // and done step after step in slotCompleted().
     QSet<QUrl> m_urlsToExpand;
 
-    friend class KFileItemModelRolesUpdater;   // Accesses emitSortProgress() method
+    struct CachedDirectory
+    {
+        QUrl url;
+        QList<ItemData*> itemData;
+        QSet<QByteArray> roles;
+        RoleType sortRole;
+        Qt::SortOrder sortOrder;
+        bool sortDirsFirst;
+        bool sortHiddenLast;
+        bool naturalSorting;
+        bool showHiddenFiles;
+        bool dirOnlyMode;
+        bool prefetched;
+    };
+
+    // Items of recently left directories, the most recently left one is last
+    QList<CachedDirectory> m_cachedDirectories;
+
+    // Listing of prefetchDirectory() and the items listed so far
+    KCoreDirLister* m_prefetchLister;
+    QUrl m_prefetchUrl;
+    KFileItemList m_prefetchedItems;
+
+    // True while restored items are reconciled with the listed items
+    bool m_reconciling;
+    QSet<QUrl> m_reconciledUrls;
+    QList<QPair<KFileItem, KFileItem>> m_reconciledChanges;
+
+    struct PendingChange
+    {
+        KFileItem oldItem; // Null if the item has been added
+        KFileItem newItem; // Null if the item has been deleted
+        QUrl directoryUrl; // Directory of an added item
+    };
+
+    // Collected changes of the listed directories, the key is the
+    // current URL of the item
+    QHash<QUrl, PendingChange> m_pendingChanges;
+    QTimer* m_pendingChangesTimer;
+    int m_changeCoalescingInterval;
+    qint64 m_pendingChangesDuration;
+    bool m_listingCompleted;
+    bool m_completedAfterChanges;
+    bool m_subfoldersFlattened;
+
+    struct SubtreeDirectory
+    {
+        QUrl url;
+        int depth; // The folder passed to expandSubtree() has the depth 1
+        bool completed;
+        KFileItemList items;
+    };
+
+    // Folders of expandSubtree() ordered by their depth. The folders before
+    // m_subtreeListingIndex have been listed or are being listed.
+    KCoreDirLister* m_subtreeLister;
+    int m_subtreeDepth;
+    QList<SubtreeDirectory> m_subtreeDirectories;
+    QHash<QUrl, int> m_subtreeDirectoryIndexes;
+    int m_subtreeListingIndex;
+    int m_subtreeListingCount;
+    int m_subtreeItemCount;
+
+    friend class KFileItemModelRolesUpdater;   // Accesses emitSortProgress() and slotRefreshItems()
     friend class KFileItemModelTest;           // For unit testing
     friend class KFileItemModelBenchmark;      // For unit testing
     friend class KFileItemListViewTest;        // For unit testing
@@ -9,6 +9,8 @@
 #include "dolphindebug.h"
 #include "kfileitemmodel.h"
 #include "private/kdirectorycontentscounter.h"
+#include "private/kfileitemmimetyperesolver.h"
+#include "private/kfileitempreviewcache.h"
 #include "private/kpixmapmodifier.h"
 
 #include <KConfig>
@@ -32,7 +34,9 @@
 #include <QPainter>
 #include <QPluginLoader>
 #include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QTimer>
+#include <QtConcurrentMap>
 
 // #define KFILEITEMMODELROLESUPDATER_DEBUG
 
@@ -48,6 +52,26 @@ namespace {
     // Not only the visible area, but up to ReadAheadPages before and after
     // this area will be resolved.
     const int ReadAheadPages = 5;
+
+    // The item is recreated by typeSortValue() from the entry, as KFileItem
+    // caches its MIME type and hence may not be shared between threads.
+    struct TypeSortValueInput
+    {
+        KIO::UDSEntry entry;
+        QUrl url;
+    };
+
+    /**
+     * @return Value of the sort role "type" for the item described by
+     *         \a input. Is invoked by worker threads. Only items that need
+     *         no content sniffing are passed, so the MIME type guessed by
+     *         the name is final, and the file is not read.
+     */
+    QString typeSortValue(const TypeSortValueInput& input)
+    {
+        const KFileItem item(input.entry, input.url, true);
+        return item.mimeComment();
+    }
 }
 
 KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QObject* parent) :
@@ -71,8 +95,11 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     m_localFileSizePreviewLimit(0),
     m_scanDirectories(true),
     m_pendingSortRoleItems(),
+    m_sortRoleJobItems(),
+    m_sortRoleWatcher(nullptr),
     m_pendingIndexes(),
     m_pendingPreviewItems(),
+    m_mimeTypePendingPreviewItems(),
     m_previewJob(),
     m_hoverSequenceItem(),
     m_hoverSequenceIndex(0),
@@ -81,7 +108,9 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     m_recentlyChangedItemsTimer(nullptr),
     m_recentlyChangedItems(),
     m_changedItems(),
-    m_directoryContentsCounter(nullptr)
+    m_directoryContentsCounter(nullptr),
+    m_mimeTypeResolver(nullptr),
+    m_previewCacheDirectories()
   #ifdef HAVE_BALOO
    , m_balooFileMonitor(nullptr)
   #endif
@@ -117,6 +146,16 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     m_resolvableRoles += KBalooRolesProvider::instance().roles();
 #endif
 
+    m_sortRoleWatcher = new QFutureWatcher<QString>(this);
+    connect(m_sortRoleWatcher, &QFutureWatcher<QString>::progressValueChanged,
+            this,              &KFileItemModelRolesUpdater::applySortProgressToModel);
+    connect(m_sortRoleWatcher, &QFutureWatcher<QString>::finished,
+            this,              &KFileItemModelRolesUpdater::slotSortRoleJobFinished);
+
+    m_mimeTypeResolver = new KFileItemMimeTypeResolver(this);
+    connect(m_mimeTypeResolver, &KFileItemMimeTypeResolver::mimeTypesResolved,
+            this,               &KFileItemModelRolesUpdater::slotMimeTypesResolved);
+
     m_directoryContentsCounter = new KDirectoryContentsCounter(m_model, this);
     connect(m_directoryContentsCounter, &KDirectoryContentsCounter::result,
             this,                       &KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived);
@@ -137,7 +176,9 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
 
 KFileItemModelRolesUpdater::~KFileItemModelRolesUpdater()
 {
+    cancelSortRoleJob();
     killPreviewJob();
+    releasePreviewCache();
 }
 
 void KFileItemModelRolesUpdater::setIconSize(const QSize& size)
@@ -237,6 +278,7 @@ void KFileItemModelRolesUpdater::setPaused(bool paused)
 
     if (paused) {
         m_state = Paused;
+        cancelSortRoleJob();
         killPreviewJob();
     } else {
         const bool updatePreviews = (m_iconSizeChangedDuringPausing && m_previewShown) ||
@@ -310,6 +352,27 @@ bool KFileItemModelRolesUpdater::isPaused() const
     return m_state == Paused;
 }
 
+void KFileItemModelRolesUpdater::releasePreviews()
+{
+    if (m_state != Paused) {
+        return;
+    }
+
+    disconnect(m_model, &KFileItemModel::itemsChanged,
+               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    const bool previewsCleared = m_model->clearRoleValues({"iconPixmap", "hoverSequencePixmaps"});
+    connect(m_model, &KFileItemModel::itemsChanged,
+            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+
+    releasePreviewCache();
+
+    // Generating the previews again after unpausing is only
+    // necessary if previews have been shown and removed
+    if (m_previewShown && previewsCleared) {
+        m_previewChangedDuringPausing = true;
+    }
+}
+
 QStringList KFileItemModelRolesUpdater::enabledPlugins() const
 {
     return m_enabledPlugins;
@@ -417,6 +480,7 @@ void KFileItemModelRolesUpdater::slotItemsRemoved(const KItemRangeList& itemRang
     if (allItemsRemoved) {
         m_state = Idle;
 
+        cancelSortRoleJob();
         m_finishedItems.clear();
         m_pendingSortRoleItems.clear();
         m_pendingIndexes.clear();
@@ -427,6 +491,7 @@ void KFileItemModelRolesUpdater::slotItemsRemoved(const KItemRangeList& itemRang
         m_hoverSequenceLoadedItems.clear();
 
         killPreviewJob();
+        releasePreviewCache();
     } else {
         // Only remove the items from m_finishedItems. They will be removed
         // from the other sets later on.
@@ -497,6 +562,8 @@ void KFileItemModelRolesUpdater::slotSortRoleChanged(const QByteArray& current,
     Q_UNUSED(current)
     Q_UNUSED(previous)
 
+    cancelSortRoleJob();
+
     if (m_resolvableRoles.contains(current)) {
         m_pendingSortRoleItems.clear();
         m_finishedItems.clear();
@@ -542,8 +609,16 @@ void KFileItemModelRolesUpdater::slotGotPreview(const KFileItem& item, const QPi
         return;
     }
 
-    QPixmap scaledPixmap = transformPreviewPixmap(pixmap);
+    const QPixmap scaledPixmap = transformPreviewPixmap(pixmap);
+    KFileItemPreviewCache::instance()->setPreview(item, previewCacheKey(), scaledPixmap);
+
+    applyPreview(index, item, scaledPixmap);
+    m_finishedItems.insert(item);
+}
 
+void KFileItemModelRolesUpdater::applyPreview(int index, const KFileItem& item, const QPixmap& pixmap)
+{
+    QPixmap scaledPixmap = pixmap;
     QHash<QByteArray, QVariant> data = rolesData(item);
 
     const QStringList overlays = data["iconOverlays"].toStringList();
@@ -570,8 +645,6 @@ void KFileItemModelRolesUpdater::slotGotPreview(const KFileItem& item, const QPi
     m_model->setData(index, data);
     connect(m_model, &KFileItemModel::itemsChanged,
             this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-
-    m_finishedItems.insert(item);
 }
 
 void KFileItemModelRolesUpdater::slotPreviewFailed(const KFileItem& item)
@@ -581,6 +654,7 @@ void KFileItemModelRolesUpdater::slotPreviewFailed(const KFileItem& item)
     }
 
     m_changedItems.remove(item);
+    KFileItemPreviewCache::instance()->setPreview(item, previewCacheKey(), QPixmap());
 
     const int index = m_model->index(item);
     if (index >= 0) {
@@ -729,6 +803,10 @@ void KFileItemModelRolesUpdater::resolveNextSortRole()
         return;
     }
 
+    if (m_model->sortRole() == "type" && startSortRoleJob()) {
+        return;
+    }
+
     QSet<KFileItem>::iterator it = m_pendingSortRoleItems.begin();
     while (it != m_pendingSortRoleItems.end()) {
         const KFileItem item = *it;
@@ -762,6 +840,37 @@ void KFileItemModelRolesUpdater::resolveNextSortRole()
     }
 }
 
+void KFileItemModelRolesUpdater::slotSortRoleJobFinished()
+{
+    if (m_sortRoleWatcher->isCanceled()) {
+        return;
+    }
+
+    QVector<int> indexes;
+    QVariantList values;
+    indexes.reserve(m_sortRoleJobItems.count());
+    values.reserve(m_sortRoleJobItems.count());
+    for (int i = 0; i < m_sortRoleJobItems.count(); ++i) {
+        // The items might have been moved or removed meanwhile
+        const int index = m_model->index(m_sortRoleJobItems.at(i));
+        if (index >= 0) {
+            indexes.append(index);
+            values.append(m_sortRoleWatcher->resultAt(i));
+        }
+    }
+    m_sortRoleJobItems.clear();
+
+    disconnect(m_model, &KFileItemModel::itemsChanged,
+               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    m_model->setRoleValues("type", indexes, values);
+    connect(m_model, &KFileItemModel::itemsChanged,
+            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+
+    // Items that have been changed or inserted while the job was
+    // running are still pending
+    resolveNextSortRole();
+}
+
 void KFileItemModelRolesUpdater::resolveNextPendingRoles()
 {
     if (m_state != ResolvingAllRoles) {
@@ -902,6 +1011,43 @@ void KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived(const QStrin
     }
 }
 
+void KFileItemModelRolesUpdater::slotMimeTypesResolved(const KFileItemList& items)
+{
+    QList<QPair<KFileItem, KFileItem> > refreshedItems;
+    bool previewsPending = false;
+    for (const KFileItem& item : items) {
+        const int index = m_model->index(item);
+        if (index < 0) {
+            continue;
+        }
+
+        // The item of the model might have been refreshed since the
+        // MIME type has been requested, so only its type is replaced
+        const KFileItem modelItem = m_model->fileItem(index);
+        const KFileItem resolvedItem = KFileItemMimeTypeResolver::itemWithMimeType(modelItem, item.mimetype());
+        refreshedItems.append(qMakePair(modelItem, resolvedItem));
+
+        if (m_mimeTypePendingPreviewItems.remove(modelItem)) {
+            m_pendingPreviewItems.append(resolvedItem);
+            previewsPending = true;
+        }
+    }
+
+    if (!refreshedItems.isEmpty()) {
+        // Refreshing the items updates the roles that depend on the MIME
+        // type, and applies the MIME type filters to the refined types
+        disconnect(m_model, &KFileItemModel::itemsChanged,
+                   this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+        m_model->slotRefreshItems(refreshedItems);
+        connect(m_model, &KFileItemModel::itemsChanged,
+                this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    }
+
+    if (previewsPending && m_previewShown && m_state == Idle) {
+        startPreviewJob();
+    }
+}
+
 void KFileItemModelRolesUpdater::startUpdating()
 {
     if (m_state == Paused) {
@@ -936,10 +1082,11 @@ void KFileItemModelRolesUpdater::startUpdating()
     if (m_previewShown) {
         m_pendingPreviewItems.clear();
         m_pendingPreviewItems.reserve(indexes.count());
+        m_mimeTypePendingPreviewItems.clear();
 
         for (int index : qAsConst(indexes)) {
             const KFileItem item = m_model->fileItem(index);
-            if (!m_finishedItems.contains(item)) {
+            if (!m_finishedItems.contains(item) && !applyCachedPreview(index)) {
                 m_pendingPreviewItems.append(item);
             }
         }
@@ -1013,15 +1160,26 @@ void KFileItemModelRolesUpdater::startPreviewJob()
         } while (!m_pendingPreviewItems.isEmpty() && m_pendingPreviewItems.first().isMimeTypeKnown());
     } else {
         // Determine mime types for MaxBlockTimeout ms, and start a preview
-        // job for the corresponding items.
+        // job for the corresponding items. Items whose files must be read
+        // for this are previewed after m_mimeTypeResolver is done with them.
         QElapsedTimer timer;
         timer.start();
 
         do {
             const KFileItem item = m_pendingPreviewItems.takeFirst();
-            item.determineMimeType();
-            itemSubSet.append(item);
+            if (KFileItemMimeTypeResolver::needsContentSniffing(item)) {
+                m_mimeTypeResolver->resolve(item);
+                m_mimeTypePendingPreviewItems.insert(item);
+            } else {
+                item.determineMimeType();
+                itemSubSet.append(item);
+            }
         } while (!m_pendingPreviewItems.isEmpty() && timer.elapsed() < MaxBlockTimeout);
+
+        if (itemSubSet.isEmpty()) {
+            QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
+            return;
+        }
     }
 
     KIO::PreviewJob* job = new KIO::PreviewJob(itemSubSet, cacheSize, &m_enabledPlugins);
@@ -1084,6 +1242,60 @@ QPixmap KFileItemModelRolesUpdater::transformPreviewPixmap(const QPixmap& pixmap
     return scaledPixmap;
 }
 
+bool KFileItemModelRolesUpdater::applyCachedPreview(int index)
+{
+    const KFileItem item = m_model->fileItem(index);
+    const QUrl directory = KFileItemPreviewCache::directory(item);
+    if (!m_previewCacheDirectories.contains(directory)) {
+        // Previews created by this view are stored for the other views
+        // as long as the directory is shown
+        KFileItemPreviewCache::instance()->acquire(directory);
+        m_previewCacheDirectories.insert(directory);
+    }
+
+    QPixmap pixmap;
+    if (!KFileItemPreviewCache::instance()->preview(item, previewCacheKey(), pixmap)) {
+        return false;
+    }
+
+    m_changedItems.remove(item);
+    if (pixmap.isNull()) {
+        // Creating the preview failed, like in slotPreviewFailed()
+        QHash<QByteArray, QVariant> data;
+        data.insert("iconPixmap", QPixmap());
+
+        disconnect(m_model, &KFileItemModel::itemsChanged,
+                   this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+        m_model->setData(index, data);
+        connect(m_model, &KFileItemModel::itemsChanged,
+                this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+
+        applyResolvedRoles(index, ResolveAll);
+    } else {
+        applyPreview(index, item, pixmap);
+    }
+
+    m_finishedItems.insert(item);
+    return true;
+}
+
+QString KFileItemModelRolesUpdater::previewCacheKey() const
+{
+    return QStringLiteral("%1x%2@%3/%4/%5").arg(m_iconSize.width())
+                                             .arg(m_iconSize.height())
+                                             .arg(qApp->devicePixelRatio())
+                                             .arg(m_enlargeSmallPreviews ? 1 : 0)
+                                             .arg(qHash(m_enabledPlugins.join(QLatin1Char(','))));
+}
+
+void KFileItemModelRolesUpdater::releasePreviewCache()
+{
+    for (const QUrl& directory : qAsConst(m_previewCacheDirectories)) {
+        KFileItemPreviewCache::instance()->release(directory);
+    }
+    m_previewCacheDirectories.clear();
+}
+
 void KFileItemModelRolesUpdater::loadNextHoverSequencePreview()
 {
     if (m_hoverSequenceItem.isNull() || m_hoverSequencePreviewJob) {
@@ -1244,7 +1456,11 @@ void KFileItemModelRolesUpdater::applySortRole(int index)
     const KFileItem item = m_model->fileItem(index);
 
     if (m_model->sortRole() == "type") {
-        if (!item.isMimeTypeKnown()) {
+        if (KFileItemMimeTypeResolver::needsContentSniffing(item)) {
+            // Sort by the type guessed by the name until the
+            // contents of the file have been read
+            m_mimeTypeResolver->resolve(item);
+        } else if (!item.isMimeTypeKnown()) {
             item.determineMimeType();
         }
 
@@ -1270,17 +1486,85 @@ void KFileItemModelRolesUpdater::applySortProgressToModel()
 {
     // Inform the model about the progress of the resolved items,
     // so that it can give an indication when the sorting has been finished.
-    const int resolvedCount = m_model->count() - m_pendingSortRoleItems.count();
+    int resolvedCount = m_model->count() - m_pendingSortRoleItems.count();
+    if (!m_sortRoleJobItems.isEmpty()) {
+        // The results of the job are applied to the model when all of them
+        // are available, so the sorting cannot be finished before.
+        resolvedCount -= m_sortRoleJobItems.count() - m_sortRoleWatcher->progressValue();
+        resolvedCount = qMin(resolvedCount, m_model->count() - 1);
+    }
     m_model->emitSortProgress(resolvedCount);
 }
 
+bool KFileItemModelRolesUpdater::startSortRoleJob()
+{
+    if (!m_sortRoleJobItems.isEmpty()) {
+        return true;
+    }
+
+    QVector<TypeSortValueInput> inputs;
+    inputs.reserve(m_pendingSortRoleItems.count());
+    m_sortRoleJobItems.reserve(m_pendingSortRoleItems.count());
+
+    for (const KFileItem& item : qAsConst(m_pendingSortRoleItems)) {
+        const int index = m_model->index(item);
+        if (index < 0) {
+            continue;
+        }
+
+        // Skip the item if the sort role has already been determined for it,
+        // and the item has not been changed recently.
+        if (!m_changedItems.contains(item) && m_model->data(index).contains("type")) {
+            continue;
+        }
+
+        const KIO::UDSEntry entry = item.entry();
+        if (!entry.contains(KIO::UDSEntry::UDS_FILE_TYPE) || KFileItemMimeTypeResolver::needsContentSniffing(item)) {
+            // The item cannot be recreated from its entry, or its file must
+            // be read by m_mimeTypeResolver, which must not block the pool
+            applySortRole(index);
+            continue;
+        }
+
+        inputs.append(TypeSortValueInput{entry, item.url()});
+        m_sortRoleJobItems.append(item);
+    }
+    m_pendingSortRoleItems.clear();
+
+    if (m_sortRoleJobItems.isEmpty()) {
+        return false;
+    }
+
+    m_sortRoleWatcher->setFuture(QtConcurrent::mapped(inputs, typeSortValue));
+    applySortProgressToModel();
+    return true;
+}
+
+void KFileItemModelRolesUpdater::cancelSortRoleJob()
+{
+    if (m_sortRoleJobItems.isEmpty()) {
+        return;
+    }
+
+    m_sortRoleWatcher->cancel();
+    for (const KFileItem& item : qAsConst(m_sortRoleJobItems)) {
+        m_pendingSortRoleItems.insert(item);
+    }
+    m_sortRoleJobItems.clear();
+}
+
 bool KFileItemModelRolesUpdater::applyResolvedRoles(int index, ResolveHint hint)
 {
     const KFileItem item = m_model->fileItem(index);
     const bool resolveAll = (hint == ResolveAll);
 
     bool iconChanged = false;
-    if (!item.isMimeTypeKnown() || !item.isFinalIconKnown()) {
+    if (KFileItemMimeTypeResolver::needsContentSniffing(item)) {
+        // Use the icon guessed by the name until the
+        // contents of the file have been read
+        m_mimeTypeResolver->resolve(item);
+        iconChanged = !m_model->data(index).contains("iconName");
+    } else if (!item.isMimeTypeKnown() || !item.isFinalIconKnown()) {
         item.determineMimeType();
         iconChanged = true;
     } else if (!m_model->data(index).contains("iconName")) {
@@ -19,12 +19,15 @@
 #include <QSet>
 #include <QSize>
 #include <QStringList>
+#include <QUrl>
 
 class KDirectoryContentsCounter;
+class KFileItemMimeTypeResolver;
 class KFileItemModel;
 class QPixmap;
 class QTimer;
 class KOverlayIconPlugin;
+template<typename T> class QFutureWatcher;
 
 namespace KIO {
     class PreviewJob;
@@ -55,7 +58,9 @@ namespace KIO {
  *
  * 1.   If the sort role is "slow", it is determined for all items. If this
  *      cannot be finished synchronously in 200 ms, the remaining items are
- *      handled asynchronously by \a resolveNextSortRole().
+ *      handled asynchronously by \a resolveNextSortRole(). The sort role
+ *      "type" is determined for the remaining items in parallel by worker
+ *      threads and applied to the model in one batch.
  *
  * 2.   The function startUpdating(), which is called if either the sort role
  *      has been successfully determined for all items, or items are inserted
@@ -120,6 +125,13 @@ public:
     void setPaused(bool paused);
     bool isPaused() const;
 
+    /**
+     * Removes the previews from the model to release their memory. The
+     * previews get generated again after unpausing. Only has an effect
+     * while the updater is paused.
+     */
+    void releasePreviews();
+
     /**
      * Sets the roles that should be resolved asynchronously.
      */
@@ -240,10 +252,18 @@ private Q_SLOTS:
     /**
      * Resolves the sort role of the next item in m_pendingSortRole, applies it
      * to the model, and invokes itself if there are any pending items left. If
-     * that is not the case, \a startUpdating() is called.
+     * that is not the case, \a startUpdating() is called. If the sort role
+     * can be resolved by worker threads, \a startSortRoleJob() is invoked
+     * instead.
      */
     void resolveNextSortRole();
 
+    /**
+     * Applies the sort role values determined by m_sortRoleWatcher to the
+     * model and continues with \a resolveNextSortRole().
+     */
+    void slotSortRoleJobFinished();
+
     /**
      * Resolves the icon name and (if previews are disabled) all other roles
      * for the next interesting item. If there are no pending items left, any
@@ -263,6 +283,14 @@ private Q_SLOTS:
 
     void slotDirectoryContentsCountReceived(const QString& path, int count, long size);
 
+    /**
+     * Is invoked when the MIME types of the items \a items have been
+     * determined by m_mimeTypeResolver. Updates the items whose type differs
+     * from the type guessed by their names, and starts the previews of items
+     * that waited for their MIME types.
+     */
+    void slotMimeTypesResolved(const KFileItemList& items);
+
 private:
     /**
      * Starts the updating of all roles. The visible items are handled first.
@@ -295,6 +323,32 @@ private:
      */
     QPixmap transformPreviewPixmap(const QPixmap& pixmap);
 
+    /**
+     * Applies the scaled preview \a pixmap of the item \a item with the
+     * index \a index to the model. The overlays of the item are drawn
+     * above the preview.
+     */
+    void applyPreview(int index, const KFileItem& item, const QPixmap& pixmap);
+
+    /**
+     * Applies the preview of the item with the index \a index from
+     * KFileItemPreviewCache if another view has created it already.
+     * @return True if the preview has been applied.
+     */
+    bool applyCachedPreview(int index);
+
+    /**
+     * @return Key for KFileItemPreviewCache that describes all properties
+     *         the look of the previews depends on.
+     */
+    QString previewCacheKey() const;
+
+    /**
+     * Releases all directories that have been acquired from
+     * KFileItemPreviewCache.
+     */
+    void releasePreviewCache();
+
     /**
      * Starts a PreviewJob for loading the next hover sequence image.
      */
@@ -318,6 +372,21 @@ private:
 
     void applySortProgressToModel();
 
+    /**
+     * Moves the items from m_pendingSortRoleItems whose sort role "type" is
+     * unknown to m_sortRoleJobItems and determines their sort role values
+     * by worker threads.
+     * @return True if a job has been started or is running already. False
+     *         if no item needs to be resolved.
+     */
+    bool startSortRoleJob();
+
+    /**
+     * Cancels the job started by \a startSortRoleJob(). Its items are
+     * added to m_pendingSortRoleItems again.
+     */
+    void cancelSortRoleJob();
+
     enum ResolveHint {
         ResolveFast,
         ResolveAll
@@ -383,6 +452,11 @@ private:
     // Items for which the sort role still has to be determined.
     QSet<KFileItem> m_pendingSortRoleItems;
 
+    // Items whose sort role is determined by the worker threads of
+    // m_sortRoleWatcher. The results have the same order as the items.
+    KFileItemList m_sortRoleJobItems;
+    QFutureWatcher<QString>* m_sortRoleWatcher;
+
     // Indexes of items which still have to be handled by
     // resolveNextPendingRoles().
     QList<int> m_pendingIndexes;
@@ -391,6 +465,9 @@ private:
     // A new preview job will be started from them once the first one finishes.
     KFileItemList m_pendingPreviewItems;
 
+    // Items which are previewed after m_mimeTypeResolver has determined their MIME types.
+    QSet<KFileItem> m_mimeTypePendingPreviewItems;
+
     KIO::PreviewJob* m_previewJob;
 
     // Info about the item that the user currently hovers, and the current sequence
@@ -413,6 +490,10 @@ private:
     QSet<KFileItem> m_changedItems;
 
     KDirectoryContentsCounter* m_directoryContentsCounter;
+    KFileItemMimeTypeResolver* m_mimeTypeResolver;
+
+    // Directories acquired from KFileItemPreviewCache
+    QSet<QUrl> m_previewCacheDirectories;
 
     QList<KOverlayIconPlugin*> m_overlayIconsPlugin;
 
@@ -13,6 +13,7 @@
 #include "kitemlistview.h"
 #include "private/kitemlistkeyboardsearchmanager.h"
 #include "private/kitemlistrubberband.h"
+#include "private/kitemlistviewlayouter.h"
 #include "private/ktwofingerswipe.h"
 #include "private/ktwofingertap.h"
 #include "views/draganddrophelper.h"
@@ -28,6 +29,11 @@
 #include <QTimer>
 #include <QTouchEvent>
 
+namespace {
+    // Number of folder levels that are expanded by pressing '*'
+    const int SubtreeExpansionDepth = 3;
+}
+
 KItemListController::KItemListController(KItemModelBase* model, KItemListView* view, QObject* parent) :
     QObject(parent),
     m_singleClickActivationEnforced(false),
@@ -52,6 +58,10 @@ KItemListController::KItemListController(KItemModelBase* model, KItemListView* v
     m_swipeGesture(Qt::CustomGesture),
     m_twoFingerTapGesture(Qt::CustomGesture),
     m_oldSelection(),
+    m_rubberBandItems(),
+    m_rubberBandRect(),
+    m_rubberBandItemCount(-1),
+    m_rubberBandLayoutGeneration(-1),
     m_keyboardAnchorIndex(-1),
     m_keyboardAnchorPos(0)
 {
@@ -96,13 +106,22 @@ void KItemListController::setModel(KItemModelBase* model)
 
     KItemModelBase* oldModel = m_model;
     if (oldModel) {
+        disconnect(oldModel, &KItemModelBase::itemsInserted, this, &KItemListController::slotInvalidateRubberBandItems);
+        disconnect(oldModel, &KItemModelBase::itemsRemoved, this, &KItemListController::slotInvalidateRubberBandItems);
+        disconnect(oldModel, &KItemModelBase::itemsMoved, this, &KItemListController::slotInvalidateRubberBandItems);
+        disconnect(oldModel, &KItemModelBase::itemsChanged, this, &KItemListController::slotInvalidateRubberBandItems);
         oldModel->deleteLater();
     }
 
     m_model = model;
     if (m_model) {
         m_model->setParent(this);
+        connect(m_model, &KItemModelBase::itemsInserted, this, &KItemListController::slotInvalidateRubberBandItems);
+        connect(m_model, &KItemModelBase::itemsRemoved, this, &KItemListController::slotInvalidateRubberBandItems);
+        connect(m_model, &KItemModelBase::itemsMoved, this, &KItemListController::slotInvalidateRubberBandItems);
+        connect(m_model, &KItemModelBase::itemsChanged, this, &KItemListController::slotInvalidateRubberBandItems);
     }
+    slotInvalidateRubberBandItems();
 
     if (m_view) {
         m_view->setModel(m_model);
@@ -233,6 +252,10 @@ bool KItemListController::keyPressEvent(QKeyEvent* event)
             if (m_model->setExpanded(index, false)) {
                 return true;
             }
+        } else if (key == Qt::Key_Asterisk) {
+            if (m_model->expandSubtree(index, SubtreeExpansionDepth)) {
+                return true;
+            }
         }
     }
 
@@ -1242,49 +1265,70 @@ void KItemListController::slotRubberBandChanged()
         }
     }
 
-    KItemSet selectedItems;
+    // Updates m_rubberBandItems for all items of the rows that intersect
+    // the interval [from, to] in scroll-direction
+    const KItemListViewLayouter* layouter = m_view->m_layouter;
+    const int layoutGeneration = layouter->layoutGeneration();
+    const auto updateRubberBandItems = [this, layouter, &rubberBandRect](qreal from, qreal to) {
+        const KItemRange range = layouter->itemRangeForInterval(from, to);
+        for (int index = range.index; index < range.index + range.count; ++index) {
+            if (m_view->itemRect(index).intersects(rubberBandRect)) {
+                m_rubberBandItems.insert(index);
+            } else {
+                m_rubberBandItems.remove(index);
+            }
+        }
+    };
+
+    // The rubberband rectangle independent from the scroll-offset
+    const QRectF contentRect = QRectF(startPos, endPos).normalized();
+    const qreal scrollOffset = m_view->scrollOffset();
+    const qreal start = scrollVertical ? rubberBandRect.top() : rubberBandRect.left();
+    const qreal end = scrollVertical ? rubberBandRect.bottom() : rubberBandRect.right();
+
+    const bool sameCrossExtent = scrollVertical
+            ? (contentRect.left() == m_rubberBandRect.left() && contentRect.right() == m_rubberBandRect.right())
+            : (contentRect.top() == m_rubberBandRect.top() && contentRect.bottom() == m_rubberBandRect.bottom());
+    if (m_rubberBandItemCount == m_model->count()
+        && m_rubberBandLayoutGeneration == layoutGeneration
+        && sameCrossExtent) {
+        // Only the edges of the rubberband in scroll-direction have been moved, which
+        // is the case while autoscrolling. Only the items of the rows between the
+        // previous and the current edges can have changed their state.
+        const qreal previousStart = (scrollVertical ? m_rubberBandRect.top() : m_rubberBandRect.left()) - scrollOffset;
+        const qreal previousEnd = (scrollVertical ? m_rubberBandRect.bottom() : m_rubberBandRect.right()) - scrollOffset;
+        if (previousStart != start) {
+            updateRubberBandItems(qMin(previousStart, start), qMax(previousStart, start));
+        }
+        if (previousEnd != end) {
+            updateRubberBandItems(qMin(previousEnd, end), qMax(previousEnd, end));
+        }
+    } else {
+        // Instead of iterating all items only the rows that are touched
+        // by the rubberband will be checked.
+        m_rubberBandItems.clear();
+        updateRubberBandItems(start, end);
+    }
+    m_rubberBandRect = contentRect;
+    m_rubberBandItemCount = m_model->count();
+    m_rubberBandLayoutGeneration = layoutGeneration;
 
-    // Select all visible items that intersect with the rubberband
+    // For visible items only the icon and the text are taken into account
+    KItemSet selectedItems = m_rubberBandItems;
     const auto widgets = m_view->visibleItemListWidgets();
     for (const KItemListWidget* widget : widgets) {
         const int index = widget->index();
-
-        const QRectF widgetRect = m_view->itemRect(index);
-        if (widgetRect.intersects(rubberBandRect)) {
-            const QRectF iconRect = widget->iconRect().translated(widgetRect.topLeft());
-            const QRectF textRect = widget->textRect().translated(widgetRect.topLeft());
-            if (iconRect.intersects(rubberBandRect) || textRect.intersects(rubberBandRect)) {
-                selectedItems.insert(index);
-            }
+        if (!selectedItems.contains(index)) {
+            continue;
         }
-    }
 
-    // Select all invisible items that intersect with the rubberband. Instead of
-    // iterating all items only the area which might be touched by the rubberband
-    // will be checked.
-    const bool increaseIndex = scrollVertical ?
-                               startPos.y() > endPos.y(): startPos.x() > endPos.x();
-
-    int index = increaseIndex ? m_view->lastVisibleIndex() + 1 : m_view->firstVisibleIndex() - 1;
-    bool selectionFinished = false;
-    do {
         const QRectF widgetRect = m_view->itemRect(index);
-        if (widgetRect.intersects(rubberBandRect)) {
-            selectedItems.insert(index);
+        const QRectF iconRect = widget->iconRect().translated(widgetRect.topLeft());
+        const QRectF textRect = widget->textRect().translated(widgetRect.topLeft());
+        if (!iconRect.intersects(rubberBandRect) && !textRect.intersects(rubberBandRect)) {
+            selectedItems.remove(index);
         }
-
-        if (increaseIndex) {
-            ++index;
-            selectionFinished = (index >= m_model->count()) ||
-                                ( scrollVertical && widgetRect.top()  > rubberBandRect.bottom()) ||
-                                (!scrollVertical && widgetRect.left() > rubberBandRect.right());
-        } else {
-            --index;
-            selectionFinished = (index < 0) ||
-                                ( scrollVertical && widgetRect.bottom() < rubberBandRect.top()) ||
-                                (!scrollVertical && widgetRect.right()  < rubberBandRect.left());
-        }
-    } while (!selectionFinished);
+    }
 
     if (QApplication::keyboardModifiers() & Qt::ControlModifier) {
         // If Control is pressed, the selection state of all items in the rubberband is toggled.
@@ -1298,6 +1342,11 @@ void KItemListController::slotRubberBandChanged()
     }
 }
 
+void KItemListController::slotInvalidateRubberBandItems()
+{
+    m_rubberBandItemCount = -1;
+}
+
 void KItemListController::startDragging()
 {
     if (!m_view || !m_model) {
@@ -1648,6 +1697,7 @@ bool KItemListController::onRelease(const QPointF& pos, const Qt::KeyboardModifi
         disconnect(rubberBand, &KItemListRubberBand::endPositionChanged, this, &KItemListController::slotRubberBandChanged);
         rubberBand->setActive(false);
         m_oldSelection.clear();
+        m_rubberBandItems.clear();
         m_view->setAutoScroll(false);
         rubberBandRelease = true;
         // We check for actual rubber band drag here: if delta between start and end is less than drag threshold,
@@ -1731,6 +1781,8 @@ void KItemListController::startRubberBand()
         }
 
         m_oldSelection = m_selectionManager->selectedItems();
+        m_rubberBandItems.clear();
+        m_rubberBandItemCount = -1;
         KItemListRubberBand* rubberBand = m_view->rubberBand();
         rubberBand->setStartPosition(startPos);
         rubberBand->setEndPosition(startPos);
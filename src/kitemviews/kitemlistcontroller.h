@@ -16,6 +16,7 @@
 
 #include <QObject>
 #include <QPointF>
+#include <QRectF>
 #include <QScroller>
 
 class QTimer;
@@ -231,6 +232,12 @@ private Q_SLOTS:
      */
     void slotRubberBandChanged();
 
+    /**
+     * Is invoked when the items of the model have been changed. The items
+     * that intersect with the rubberband must be determined again.
+     */
+    void slotInvalidateRubberBandItems();
+
     void slotChangeCurrentItem(const QString& text, bool searchFromNextItem);
 
     void slotAutoActivationTimeout();
@@ -347,6 +354,20 @@ private:
      */
     KItemSet m_oldSelection;
 
+    /**
+     * Items that intersect with the rubberband, which had the rectangle
+     * m_rubberBandRect (independent from the scroll-offset) when they have
+     * been determined. As long as neither the items nor the layout
+     * (m_rubberBandLayoutGeneration) have been changed, moving the edges of the
+     * rubberband in scroll-direction only requires to check the items between
+     * the previous and the current edges. m_rubberBandItemCount is -1 if the
+     * items must be determined again.
+     */
+    KItemSet m_rubberBandItems;
+    QRectF m_rubberBandRect;
+    int m_rubberBandItemCount;
+    int m_rubberBandLayoutGeneration;
+
     /**
      * Assuming a view is given with a vertical scroll-orientation, grouped items and
      * a maximum of 4 columns:
@@ -16,12 +16,12 @@
 #include "kitemlistviewaccessible.h"
 #include "kstandarditemlistwidget.h"
 
+#include "private/kitemlistcolumnwidthtracker.h"
 #include "private/kitemlistheaderwidget.h"
 #include "private/kitemlistrubberband.h"
 #include "private/kitemlistsizehintresolver.h"
 #include "private/kitemlistviewlayouter.h"
 
-#include <QElapsedTimer>
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsView>
 #include <QPropertyAnimation>
@@ -80,6 +80,8 @@ KItemListView::KItemListView(QGraphicsWidget* parent) :
     m_sizeHintResolver(nullptr),
     m_layouter(nullptr),
     m_animation(nullptr),
+    m_columnWidthTracker(nullptr),
+    m_rolesWithPreliminaryColumnWidth(),
     m_layoutTimer(nullptr),
     m_oldScrollOffset(0),
     m_oldMaximumScrollOffset(0),
@@ -100,9 +102,15 @@ KItemListView::KItemListView(QGraphicsWidget* parent) :
     setAcceptTouchEvents(true);
 
     m_sizeHintResolver = new KItemListSizeHintResolver(this);
+    connect(m_sizeHintResolver, &KItemListSizeHintResolver::sizeHintsChanged,
+            this, &KItemListView::slotSizeHintsChanged);
 
     m_layouter = new KItemListViewLayouter(m_sizeHintResolver, this);
 
+    m_columnWidthTracker = new KItemListColumnWidthTracker(this);
+    connect(m_columnWidthTracker, &KItemListColumnWidthTracker::preferredColumnWidthsChanged,
+            this, &KItemListView::slotPreferredColumnWidthsChanged);
+
     m_animation = new KItemListViewAnimation(this);
     connect(m_animation, &KItemListViewAnimation::finished,
             this, &KItemListView::slotAnimationFinished);
@@ -156,6 +164,9 @@ KItemListView::~KItemListView()
 
     delete m_sizeHintResolver;
     m_sizeHintResolver = nullptr;
+
+    delete m_columnWidthTracker;
+    m_columnWidthTracker = nullptr;
 }
 
 void KItemListView::setScrollOffset(qreal offset)
@@ -229,6 +240,7 @@ void KItemListView::setVisibleRoles(const QList<QByteArray>& roles)
 
     m_sizeHintResolver->clearCache();
     m_layouter->markAsDirty();
+    m_columnWidthTracker->setRoles(roles);
 
     if (m_itemSize.isEmpty()) {
         m_headerWidget->setColumns(roles);
@@ -236,10 +248,14 @@ void KItemListView::setVisibleRoles(const QList<QByteArray>& roles)
         if (!m_headerWidget->automaticColumnResizing()) {
             // The column-width of new roles are still 0. Apply the preferred
             // column-width as default with.
+            const bool complete = m_columnWidthTracker->isComplete();
             for (const QByteArray& role : qAsConst(m_visibleRoles)) {
                 if (m_headerWidget->columnWidth(role) == 0) {
                     const qreal width = m_headerWidget->preferredColumnWidth(role);
                     m_headerWidget->setColumnWidth(role, width);
+                    if (!complete) {
+                        m_rolesWithPreliminaryColumnWidth.insert(role);
+                    }
                 }
             }
 
@@ -319,6 +335,7 @@ void KItemListView::setWidgetCreator(KItemListWidgetCreatorBase* widgetCreator)
 {
     delete m_widgetCreator;
     m_widgetCreator = widgetCreator;
+    m_columnWidthTracker->invalidate();
 }
 
 KItemListWidgetCreatorBase* KItemListView::widgetCreator() const
@@ -463,10 +480,16 @@ void KItemListView::calculateItemSizeHints(QVector<std::pair<qreal, bool>>& logi
     widgetCreator()->calculateItemSizeHints(logicalHeightHints, logicalWidthHint, this);
 }
 
+QFuture<std::pair<qreal, bool>> KItemListView::calculateItemSizeHintsConcurrently(const QVector<int>& indexes, qreal& logicalWidthHint) const
+{
+    return widgetCreator()->calculateItemSizeHintsConcurrently(indexes, logicalWidthHint, this);
+}
+
 void KItemListView::setSupportsItemExpanding(bool supportsExpanding)
 {
     if (m_supportsItemExpanding != supportsExpanding) {
         m_supportsItemExpanding = supportsExpanding;
+        m_columnWidthTracker->invalidate();
         updateSiblingsInformation();
         onSupportsItemExpandingChanged(supportsExpanding);
     }
@@ -788,6 +811,7 @@ void KItemListView::setItemSize(const QSizeF& size)
                                               (!m_itemSize.isEmpty() && size.isEmpty()));
 
     m_itemSize = size;
+    m_columnWidthTracker->setEnabled(size.isEmpty());
 
     if (alternateBackgroundsChanged) {
         // For an empty item size alternate backgrounds are drawn if more than
@@ -854,6 +878,7 @@ void KItemListView::setStyleOption(const KItemListStyleOption& option)
     }
 
     m_sizeHintResolver->clearCache();
+    m_columnWidthTracker->invalidate();
     m_layouter->markAsDirty();
     doLayout(animate ? Animation : NoAnimation);
 
@@ -1071,9 +1096,7 @@ void KItemListView::updatePalette()
 
 void KItemListView::slotItemsInserted(const KItemRangeList& itemRanges)
 {
-    if (m_itemSize.isEmpty()) {
-        updatePreferredColumnWidths(itemRanges);
-    }
+    m_columnWidthTracker->itemsInserted(itemRanges);
 
     const bool hasMultipleRanges = (itemRanges.count() > 1);
     if (hasMultipleRanges) {
@@ -1180,11 +1203,7 @@ void KItemListView::slotItemsInserted(const KItemRangeList& itemRanges)
 
 void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
 {
-    if (m_itemSize.isEmpty()) {
-        // Don't pass the item-range: The preferred column-widths of
-        // all items must be adjusted when removing items.
-        updatePreferredColumnWidths();
-    }
+    m_columnWidthTracker->itemsRemoved(itemRanges);
 
     const bool hasMultipleRanges = (itemRanges.count() > 1);
     if (hasMultipleRanges) {
@@ -1299,6 +1318,7 @@ void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
 void KItemListView::slotItemsMoved(const KItemRange& itemRange, const QList<int>& movedToIndexes)
 {
     m_sizeHintResolver->itemsMoved(itemRange, movedToIndexes);
+    m_columnWidthTracker->itemsMoved(itemRange, movedToIndexes);
     m_layouter->markAsDirty();
 
     if (m_controller) {
@@ -1324,8 +1344,8 @@ void KItemListView::slotItemsChanged(const KItemRangeList& itemRanges,
                                      const QSet<QByteArray>& roles)
 {
     const bool updateSizeHints = itemSizeHintUpdateRequired(roles);
-    if (updateSizeHints && m_itemSize.isEmpty()) {
-        updatePreferredColumnWidths(itemRanges);
+    if (updateSizeHints) {
+        m_columnWidthTracker->itemsChanged(itemRanges);
     }
 
     for (const KItemRange& itemRange : itemRanges) {
@@ -1489,6 +1509,35 @@ void KItemListView::slotLayoutTimerFinished()
     doLayout(Animation);
 }
 
+void KItemListView::slotSizeHintsChanged()
+{
+    m_layouter->markAsDirty();
+    doLayout(NoAnimation);
+}
+
+void KItemListView::slotPreferredColumnWidthsChanged()
+{
+    if (!m_model || !m_itemSize.isEmpty()) {
+        return;
+    }
+
+    updatePreferredColumnWidths();
+
+    if (!m_headerWidget->automaticColumnResizing() && !m_rolesWithPreliminaryColumnWidth.isEmpty()) {
+        for (const QByteArray& role : qAsConst(m_rolesWithPreliminaryColumnWidth)) {
+            if (m_visibleRoles.contains(role)) {
+                m_headerWidget->setColumnWidth(role, m_headerWidget->preferredColumnWidth(role));
+            }
+        }
+        if (m_columnWidthTracker->isComplete()) {
+            m_rolesWithPreliminaryColumnWidth.clear();
+        }
+        applyColumnWidthsFromHeader();
+    }
+
+    doLayout(NoAnimation);
+}
+
 void KItemListView::slotRubberBandPosChanged()
 {
     update();
@@ -1537,10 +1586,12 @@ void KItemListView::slotHeaderColumnWidthChanged(const QByteArray& role,
                                                  qreal currentWidth,
                                                  qreal previousWidth)
 {
-    Q_UNUSED(role)
     Q_UNUSED(currentWidth)
     Q_UNUSED(previousWidth)
 
+    // Respect the width that has been chosen by the user
+    m_rolesWithPreliminaryColumnWidth.remove(role);
+
     m_headerWidget->setAutomaticColumnResizing(false);
     applyColumnWidthsFromHeader();
     doLayout(NoAnimation);
@@ -1706,6 +1757,7 @@ void KItemListView::setModel(KItemModelBase* model)
                    this,    &KItemListView::slotSortRoleChanged);
 
         m_sizeHintResolver->itemsRemoved(KItemRangeList() << KItemRange(0, m_model->count()));
+        m_columnWidthTracker->itemsRemoved(KItemRangeList() << KItemRange(0, m_model->count()));
     }
 
     m_model = model;
@@ -1780,6 +1832,7 @@ void KItemListView::doLayout(LayoutAnimationHint hint, int changedIndex, int cha
     }
 
     const int lastVisibleIndex = m_layouter->lastVisibleIndex();
+    m_sizeHintResolver->setVisibleRange(firstVisibleIndex, lastVisibleIndex);
 
     int firstSibblingIndex = -1;
     int lastSibblingIndex = -1;
@@ -2272,53 +2325,20 @@ bool KItemListView::useAlternateBackgrounds() const
     return m_alternateBackgrounds && m_itemSize.isEmpty();
 }
 
-QHash<QByteArray, qreal> KItemListView::preferredColumnWidths(const KItemRangeList& itemRanges) const
+QHash<QByteArray, qreal> KItemListView::preferredColumnWidths() const
 {
-    QElapsedTimer timer;
-    timer.start();
-
     QHash<QByteArray, qreal> widths;
 
     // Calculate the minimum width for each column that is required
-    // to show the headline unclipped.
+    // to show the headline unclipped and ignore preferred widths of
+    // the items that are smaller.
     const QFontMetricsF fontMetrics(m_headerWidget->font());
     const int gripMargin   = m_headerWidget->style()->pixelMetric(QStyle::PM_HeaderGripMargin);
     const int headerMargin = m_headerWidget->style()->pixelMetric(QStyle::PM_HeaderMargin);
     for (const QByteArray& visibleRole : qAsConst(m_visibleRoles)) {
         const QString headerText = m_model->roleDescription(visibleRole);
         const qreal headerWidth = fontMetrics.horizontalAdvance(headerText) + gripMargin + headerMargin * 2;
-        widths.insert(visibleRole, headerWidth);
-    }
-
-    // Calculate the preferred column widths for each item and ignore values
-    // smaller than the width for showing the headline unclipped.
-    const KItemListWidgetCreatorBase* creator = widgetCreator();
-    int calculatedItemCount = 0;
-    bool maxTimeExceeded = false;
-    for (const KItemRange& itemRange : itemRanges) {
-        const int startIndex = itemRange.index;
-        const int endIndex = startIndex + itemRange.count - 1;
-
-        for (int i = startIndex; i <= endIndex; ++i) {
-            for (const QByteArray& visibleRole : qAsConst(m_visibleRoles)) {
-                qreal maxWidth = widths.value(visibleRole, 0);
-                const qreal width = creator->preferredRoleColumnWidth(visibleRole, i, this);
-                maxWidth = qMax(width, maxWidth);
-                widths.insert(visibleRole, maxWidth);
-            }
-
-            if (calculatedItemCount > 100 && timer.elapsed() > 200) {
-                // When having several thousands of items calculating the sizes can get
-                // very expensive. We accept a possibly too small role-size in favour
-                // of having no blocking user interface.
-                maxTimeExceeded = true;
-                break;
-            }
-            ++calculatedItemCount;
-        }
-        if (maxTimeExceeded) {
-            break;
-        }
+        widths.insert(visibleRole, qMax(headerWidth, m_columnWidthTracker->preferredColumnWidth(visibleRole)));
     }
 
     return widths;
@@ -2348,45 +2368,16 @@ void KItemListView::updateWidgetColumnWidths(KItemListWidget* widget)
     widget->setLeadingPadding(m_headerWidget->leadingPadding());
 }
 
-void KItemListView::updatePreferredColumnWidths(const KItemRangeList& itemRanges)
+void KItemListView::updatePreferredColumnWidths()
 {
     Q_ASSERT(m_itemSize.isEmpty());
-    const int itemCount = m_model->count();
-    int rangesItemCount = 0;
-    for (const KItemRange& range : itemRanges) {
-        rangesItemCount += range.count;
+    if (!m_model) {
+        return;
     }
 
-    if (itemCount == rangesItemCount) {
-        const QHash<QByteArray, qreal> preferredWidths = preferredColumnWidths(itemRanges);
-        for (const QByteArray& role : qAsConst(m_visibleRoles)) {
-            m_headerWidget->setPreferredColumnWidth(role, preferredWidths.value(role));
-        }
-    } else {
-        // Only a sub range of the roles need to be determined.
-        // The chances are good that the widths of the sub ranges
-        // already fit into the available widths and hence no
-        // expensive update might be required.
-        bool changed = false;
-
-        const QHash<QByteArray, qreal> updatedWidths = preferredColumnWidths(itemRanges);
-        QHashIterator<QByteArray, qreal> it(updatedWidths);
-        while (it.hasNext()) {
-            it.next();
-            const QByteArray& role = it.key();
-            const qreal updatedWidth = it.value();
-            const qreal currentWidth = m_headerWidget->preferredColumnWidth(role);
-            if (updatedWidth > currentWidth) {
-                m_headerWidget->setPreferredColumnWidth(role, updatedWidth);
-                changed = true;
-            }
-        }
-
-        if (!changed) {
-            // All the updated sizes are smaller than the current sizes and no change
-            // of the stretched roles-widths is required
-            return;
-        }
+    const QHash<QByteArray, qreal> preferredWidths = preferredColumnWidths();
+    for (const QByteArray& role : qAsConst(m_visibleRoles)) {
+        m_headerWidget->setPreferredColumnWidth(role, preferredWidths.value(role));
     }
 
     if (m_headerWidget->automaticColumnResizing()) {
@@ -2394,13 +2385,6 @@ void KItemListView::updatePreferredColumnWidths(const KItemRangeList& itemRanges
     }
 }
 
-void KItemListView::updatePreferredColumnWidths()
-{
-    if (m_model) {
-        updatePreferredColumnWidths(KItemRangeList() << KItemRange(0, m_model->count()));
-    }
-}
-
 void KItemListView::applyAutomaticColumnWidths()
 {
     Q_ASSERT(m_itemSize.isEmpty());
@@ -21,6 +21,7 @@
 #include <QGraphicsWidget>
 #include <QSet>
 
+class KItemListColumnWidthTracker;
 class KItemListController;
 class KItemListGroupHeaderCreatorBase;
 class KItemListHeader;
@@ -193,6 +194,14 @@ public:
      */
     void calculateItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint) const;
 
+    /**
+     * Calculates the logical height hints for the items with the indexes \a indexes
+     * on worker threads. The future provides one result for each index in the order
+     * of \a indexes. A canceled future is returned if the widget creator does not
+     * support a concurrent calculation, calculateItemSizeHints() must be used in this case.
+     */
+    QFuture<std::pair<qreal, bool>> calculateItemSizeHintsConcurrently(const QVector<int>& indexes, qreal& logicalWidthHint) const;
+
     /**
      * If set to true, items having child-items can be expanded to show the child-items as
      * part of the view. Per default the expanding of items is disabled. If expanding of
@@ -420,6 +429,18 @@ private Q_SLOTS:
                                KItemListViewAnimation::AnimationType type);
     void slotLayoutTimerFinished();
 
+    /**
+     * Is invoked if size hints that have been calculated in the
+     * background are available. Triggers a relayout of the items.
+     */
+    void slotSizeHintsChanged();
+
+    /**
+     * Is invoked if the preferred column widths of the items have
+     * been changed. Applies the widths to the header.
+     */
+    void slotPreferredColumnWidthsChanged();
+
     void slotRubberBandPosChanged();
     void slotRubberBandActivationChanged(bool active);
 
@@ -583,13 +604,12 @@ private:
     bool useAlternateBackgrounds() const;
 
     /**
-     * @param itemRanges Items that must be checked for getting the widths of columns.
-     * @return           The preferred width of the column of each visible role. The width will
-     *                   be respected if the width of the item size is <= 0 (see
-     *                   KItemListView::setItemSize()). Per default an empty hash
-     *                   is returned.
+     * @return The preferred width of the column of each visible role. The width will
+     *         be respected if the width of the item size is <= 0 (see
+     *         KItemListView::setItemSize()). The widths of the items are provided
+     *         by m_columnWidthTracker, so no item gets measured.
      */
-    QHash<QByteArray, qreal> preferredColumnWidths(const KItemRangeList& itemRanges) const;
+    QHash<QByteArray, qreal> preferredColumnWidths() const;
 
     /**
      * Applies the column-widths from m_headerWidget to the layout
@@ -603,14 +623,8 @@ private:
     void updateWidgetColumnWidths(KItemListWidget* widget);
 
     /**
-     * Updates the preferred column-widths of m_groupHeaderWidget by
-     * invoking KItemListView::columnWidths().
-     */
-    void updatePreferredColumnWidths(const KItemRangeList& itemRanges);
-
-    /**
-     * Convenience method for
-     * updatePreferredColumnWidths(KItemRangeList() << KItemRange(0, m_model->count()).
+     * Updates the preferred column-widths of m_headerWidget by
+     * invoking KItemListView::preferredColumnWidths().
      */
     void updatePreferredColumnWidths();
 
@@ -746,6 +760,12 @@ private:
     int m_scrollBarExtent;
     KItemListViewLayouter* m_layouter;
     KItemListViewAnimation* m_animation;
+    KItemListColumnWidthTracker* m_columnWidthTracker;
+
+    // Roles whose column width has been initialized by the preferred
+    // column width before all items have been measured. The column width
+    // gets adjusted as soon as the measurement has been finished.
+    QSet<QByteArray> m_rolesWithPreliminaryColumnWidth;
 
     QTimer* m_layoutTimer; // Triggers an asynchronous doLayout() call.
     qreal m_oldScrollOffset;
@@ -825,9 +845,15 @@ public:
 
     virtual void calculateItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const = 0;
 
+    virtual QFuture<std::pair<qreal, bool>> calculateItemSizeHintsConcurrently(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const = 0;
+
     virtual qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
                                            const KItemListView* view) const = 0;
+
+    virtual QFuture<QVector<qreal>> preferredRoleColumnWidthsConcurrently(const QList<QByteArray>& roles,
+                                                                          const QVector<int>& indexes,
+                                                                          const KItemListView* view) const = 0;
 };
 
 /**
@@ -844,9 +870,15 @@ public:
 
     void calculateItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const override;
 
+    QFuture<std::pair<qreal, bool>> calculateItemSizeHintsConcurrently(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const override;
+
     qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
                                            const KItemListView* view) const override;
+
+    QFuture<QVector<qreal>> preferredRoleColumnWidthsConcurrently(const QList<QByteArray>& roles,
+                                                                  const QVector<int>& indexes,
+                                                                  const KItemListView* view) const override;
 private:
     KItemListWidgetInformant* m_informant;
 };
@@ -881,6 +913,12 @@ void KItemListWidgetCreator<T>::calculateItemSizeHints(QVector<std::pair<qreal,
     return m_informant->calculateItemSizeHints(logicalHeightHints, logicalWidthHint, view);
 }
 
+template<class T>
+QFuture<std::pair<qreal, bool>> KItemListWidgetCreator<T>::calculateItemSizeHintsConcurrently(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    return m_informant->calculateItemSizeHintsConcurrently(indexes, logicalWidthHint, view);
+}
+
 template<class T>
 qreal KItemListWidgetCreator<T>::preferredRoleColumnWidth(const QByteArray& role,
                                                           int index,
@@ -889,6 +927,14 @@ qreal KItemListWidgetCreator<T>::preferredRoleColumnWidth(const QByteArray& role
     return m_informant->preferredRoleColumnWidth(role, index, view);
 }
 
+template<class T>
+QFuture<QVector<qreal>> KItemListWidgetCreator<T>::preferredRoleColumnWidthsConcurrently(const QList<QByteArray>& roles,
+                                                                                          const QVector<int>& indexes,
+                                                                                          const KItemListView* view) const
+{
+    return m_informant->preferredRoleColumnWidthsConcurrently(roles, indexes, view);
+}
+
 /**
  * @brief Base class for creating KItemListGroupHeaders.
  *
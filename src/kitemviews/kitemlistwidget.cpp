@@ -27,6 +27,24 @@ KItemListWidgetInformant::~KItemListWidgetInformant()
 {
 }
 
+QFuture<std::pair<qreal, bool>> KItemListWidgetInformant::calculateItemSizeHintsConcurrently(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    Q_UNUSED(indexes)
+    Q_UNUSED(logicalWidthHint)
+    Q_UNUSED(view)
+    return QFuture<std::pair<qreal, bool>>();
+}
+
+QFuture<QVector<qreal>> KItemListWidgetInformant::preferredRoleColumnWidthsConcurrently(const QList<QByteArray>& roles,
+                                                                                         const QVector<int>& indexes,
+                                                                                         const KItemListView* view) const
+{
+    Q_UNUSED(roles)
+    Q_UNUSED(indexes)
+    Q_UNUSED(view)
+    return QFuture<QVector<qreal>>();
+}
+
 KItemListWidget::KItemListWidget(KItemListWidgetInformant* informant, QGraphicsItem* parent) :
     QGraphicsWidget(parent),
     m_informant(informant),
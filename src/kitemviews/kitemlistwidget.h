@@ -13,6 +13,7 @@
 #include "kitemviews/kitemliststyleoption.h"
 
 #include <QBitArray>
+#include <QFuture>
 #include <QGraphicsWidget>
 #include <QStyle>
 #include <QTimer>
@@ -37,9 +38,29 @@ public:
 
     virtual void calculateItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const = 0;
 
+    /**
+     * Calculates the logical height hints for the items with the indexes \a indexes
+     * outside the GUI thread. The model may only be accessed synchronously, the
+     * returned future must provide one result for each index in the order of \a indexes.
+     * The default implementation returns a canceled future, which indicates that
+     * only calculateItemSizeHints() is supported.
+     */
+    virtual QFuture<std::pair<qreal, bool>> calculateItemSizeHintsConcurrently(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const;
+
     virtual qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
                                            const KItemListView* view) const = 0;
+
+    /**
+     * Calculates the preferred column widths of the roles \a roles for the items with
+     * the indexes \a indexes outside the GUI thread. The returned future must provide
+     * one result for each index in the order of \a indexes. Each result contains the
+     * widths in the order of \a roles. The default implementation returns a canceled
+     * future, which indicates that only preferredRoleColumnWidth() is supported.
+     */
+    virtual QFuture<QVector<qreal>> preferredRoleColumnWidthsConcurrently(const QList<QByteArray>& roles,
+                                                                          const QVector<int>& indexes,
+                                                                          const KItemListView* view) const;
 };
 
 /**
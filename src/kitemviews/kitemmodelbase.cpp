@@ -91,6 +91,13 @@ bool KItemModelBase::setExpanded(int index, bool expanded)
     return false;
 }
 
+bool KItemModelBase::expandSubtree(int index, int depth)
+{
+    Q_UNUSED(index)
+    Q_UNUSED(depth)
+    return false;
+}
+
 bool KItemModelBase::isExpanded(int index) const
 {
     Q_UNUSED(index)
@@ -110,6 +110,16 @@ public:
      */
     virtual bool setExpanded(int index, bool expanded);
 
+    /**
+     * Expands the item with the index \a index and its expandable children
+     * up to the depth \a depth, where a depth of 1 only expands the item.
+     *
+     * Per default no expanding of items is implemented, see setExpanded().
+     *
+     * @return True if the operation has been successful.
+     */
+    virtual bool expandSubtree(int index, int depth);
+
     /**
      * @return True if the item with the index \a index is expanded.
      *         Per default no expanding of items is implemented. When implementing
@@ -6,174 +6,583 @@
 
 #include "kitemset.h"
 
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+    const quint64 AllBits = ~quint64(0);
+
+    /**
+     * Returns the index of the last range in \a ranges whose index is not
+     * larger than \a offset, or -1 if no such range exists.
+     */
+    int lastRangeNotBehind(const QVector<KItemRange>& ranges, int offset)
+    {
+        const auto it = std::upper_bound(ranges.constBegin(), ranges.constEnd(), offset,
+                                         [](int offset, const KItemRange& range) {
+                                             return offset < range.index;
+                                         });
+        return int(it - ranges.constBegin()) - 1;
+    }
 
-KItemSet::iterator KItemSet::insert(int i)
-{
-    if (m_itemRanges.empty()) {
-        m_itemRanges.push_back(KItemRange(i, 1));
-        return iterator(m_itemRanges.begin(), 0);
-    }
-
-    KItemRangeList::iterator rangeBegin = m_itemRanges.begin();
-    if (i < rangeBegin->index) {
-        // The inserted index is smaller than all existing items.
-        if (i == rangeBegin->index - 1) {
-            // Move the beginning of the first range one item to the front.
-            --rangeBegin->index;
-            ++rangeBegin->count;
+    /**
+     * Inserts \a offset, which must not be contained in \a ranges yet.
+     * Returns the index of the range that contains \a offset afterwards.
+     */
+    int insertIntoRanges(QVector<KItemRange>& ranges, int offset)
+    {
+        const int high = lastRangeNotBehind(ranges, offset) + 1;
+        const int low = high - 1;
+
+        const bool extendsLow = (low >= 0 && ranges.at(low).index + ranges.at(low).count == offset);
+        const bool extendsHigh = (high < ranges.count() && ranges.at(high).index == offset + 1);
+
+        if (extendsLow && extendsHigh) {
+            // offset closes the gap between low and high. Merge the two ranges.
+            ranges[low].count += 1 + ranges.at(high).count;
+            ranges.remove(high);
+            return low;
+        } else if (extendsLow) {
+            ++ranges[low].count;
+            return low;
+        } else if (extendsHigh) {
+            --ranges[high].index;
+            ++ranges[high].count;
+            return high;
+        }
+
+        ranges.insert(high, KItemRange(offset, 1));
+        return high;
+    }
+
+    /**
+     * Removes \a offset, which must be contained in the range \a index.
+     */
+    void eraseFromRanges(QVector<KItemRange>& ranges, int index, int offset)
+    {
+        KItemRange& range = ranges[index];
+        if (range.count == 1) {
+            ranges.remove(index);
+        } else if (offset == range.index) {
+            ++range.index;
+            --range.count;
+        } else if (offset == range.index + range.count - 1) {
+            --range.count;
         } else {
-            // Insert a new range at the beginning.
-            rangeBegin = m_itemRanges.insert(rangeBegin, KItemRange(i, 1));
+            // The removed offset is in the middle of the range.
+            const KItemRange behindRange(offset + 1, range.index + range.count - offset - 1);
+            range.count = offset - range.index;
+            ranges.insert(index + 1, behindRange);
         }
+    }
 
-        return iterator(rangeBegin, 0);
+    bool testBit(const QVector<quint64>& bitmap, int offset)
+    {
+        return bitmap.at(offset >> 6) & (quint64(1) << (offset & 63));
     }
 
-    KItemRangeList::iterator rangeEnd = m_itemRanges.end();
-    KItemRangeList::iterator lastRange = rangeEnd - 1;
-    if (i >= lastRange->index) {
-        // i either belongs to the last range, or it is larger than all existing items.
-        const int lastItemPlus1 = lastRange->index + lastRange->count;
-        if (i == lastItemPlus1) {
-            // Move the end of the last range one item to the back.
-            ++lastRange->count;
-        } else if (i > lastItemPlus1) {
-            // Append a new range.
-            lastRange = m_itemRanges.insert(rangeEnd, KItemRange(i, 1));
+    /**
+     * Returns the first bit that is set and not smaller than \a offset,
+     * or -1 if no such bit exists.
+     */
+    int nextBit(const QVector<quint64>& bitmap, int offset)
+    {
+        int word = offset >> 6;
+        quint64 bits = bitmap.at(word) & (AllBits << (offset & 63));
+        while (bits == 0) {
+            ++word;
+            if (word == bitmap.count()) {
+                return -1;
+            }
+            bits = bitmap.at(word);
         }
+        return word * 64 + qCountTrailingZeroBits(bits);
+    }
 
-        return iterator(lastRange, i - lastRange->index);
+    /**
+     * Returns the last bit that is set and not larger than \a offset,
+     * or -1 if no such bit exists.
+     */
+    int previousBit(const QVector<quint64>& bitmap, int offset)
+    {
+        int word = offset >> 6;
+        quint64 bits = bitmap.at(word) & (AllBits >> (63 - (offset & 63)));
+        while (bits == 0) {
+            --word;
+            if (word < 0) {
+                return -1;
+            }
+            bits = bitmap.at(word);
+        }
+        return word * 64 + 63 - qCountLeadingZeroBits(bits);
     }
 
-    // We know that i is between the smallest existing item and the first item
-    // of the last range. Find the lowest range whose 'index' is smaller than i.
-    KItemRangeList::iterator low = rangeBegin;
-    KItemRangeList::iterator high = lastRange;
+    int countBits(const QVector<quint64>& bitmap)
+    {
+        int count = 0;
+        for (const quint64 bits : bitmap) {
+            count += qPopulationCount(bits);
+        }
+        return count;
+    }
 
-    while (low + 1 != high) {
-        const int span = high - low;
-        Q_ASSERT(span >= 2);
+    /**
+     * Returns the number of ranges in \a bitmap, which is the number
+     * of set bits whose preceding bit is not set.
+     */
+    int countRanges(const QVector<quint64>& bitmap)
+    {
+        int count = 0;
+        quint64 carry = 0;
+        for (const quint64 bits : bitmap) {
+            count += qPopulationCount(bits & ~((bits << 1) | carry));
+            carry = bits >> 63;
+        }
+        return count;
+    }
 
-        KItemRangeList::iterator mid = low + span / 2;
-        if (mid->index > i) {
-            high = mid;
-        } else {
-            low = mid;
+    QVector<quint64> rangesToBitmap(const QVector<KItemRange>& ranges, int wordCount)
+    {
+        QVector<quint64> bitmap(wordCount, 0);
+        for (const KItemRange& range : ranges) {
+            const int begin = range.index;
+            const int end = range.index + range.count;
+            const int firstWord = begin >> 6;
+            const int lastWord = (end - 1) >> 6;
+
+            const quint64 firstMask = AllBits << (begin & 63);
+            const quint64 lastMask = AllBits >> (63 - ((end - 1) & 63));
+            if (firstWord == lastWord) {
+                bitmap[firstWord] |= firstMask & lastMask;
+            } else {
+                bitmap[firstWord] |= firstMask;
+                for (int word = firstWord + 1; word < lastWord; ++word) {
+                    bitmap[word] = AllBits;
+                }
+                bitmap[lastWord] |= lastMask;
+            }
         }
+        return bitmap;
     }
 
-    Q_ASSERT(low->index <= i && high->index > i);
+    QVector<KItemRange> bitmapToRanges(const QVector<quint64>& bitmap)
+    {
+        QVector<KItemRange> ranges;
+        int rangeBegin = -1;
 
-    if (i == low->index + low->count) {
-        // i is just one item behind the range low.
-        if (i == high->index - 1) {
-            // i closes the gap between low and high. Merge the two ranges.
-            const int newRangeCount = low->count + 1 + high->count;
-            KItemRangeList::iterator behindNewRange = m_itemRanges.erase(high);
-            KItemRangeList::iterator newRange = behindNewRange - 1;
-            newRange->count = newRangeCount;
-            return iterator(newRange, i - newRange->index);
-        } else {
-            // Extend low by one item.
-            ++low->count;
-            return iterator(low, low->count - 1);
-        }
-    } else if (i > low->index + low->count) {
-        if (i == high->index - 1) {
-            // Extend high by one item to the front.
-            --high->index;
-            ++high->count;
-            return iterator(high, 0);
-        } else {
-            // Insert a new range between low and high.
-            KItemRangeList::iterator newRange = m_itemRanges.insert(high, KItemRange(i, 1));
-            return iterator(newRange, 0);
+        for (int word = 0; word < bitmap.count(); ++word) {
+            const quint64 bits = bitmap.at(word);
+
+            // Skip words that neither begin nor end a range.
+            if ((rangeBegin < 0 && bits == 0) || (rangeBegin >= 0 && bits == AllBits)) {
+                continue;
+            }
+
+            int bit = 0;
+            while (bit < 64) {
+                if (rangeBegin < 0) {
+                    const quint64 remaining = bits >> bit;
+                    if (remaining == 0) {
+                        break;
+                    }
+                    bit += qCountTrailingZeroBits(remaining);
+                    rangeBegin = word * 64 + bit;
+                } else {
+                    const quint64 remaining = ~bits >> bit;
+                    if (remaining == 0) {
+                        break;
+                    }
+                    bit += qCountTrailingZeroBits(remaining);
+                    ranges.append(KItemRange(rangeBegin, word * 64 + bit - rangeBegin));
+                    rangeBegin = -1;
+                }
+            }
         }
-    } else {
-        // The range low already contains i.
-        return iterator(low, i - low->index);
+
+        if (rangeBegin >= 0) {
+            ranges.append(KItemRange(rangeBegin, bitmap.count() * 64 - rangeBegin));
+        }
+
+        return ranges;
+    }
+
+    QVector<KItemRange> uniteRanges(const QVector<KItemRange>& ranges1, const QVector<KItemRange>& ranges2)
+    {
+        QVector<KItemRange> sum;
+        sum.reserve(ranges1.count() + ranges2.count());
+
+        QVector<KItemRange>::const_iterator it1 = ranges1.constBegin();
+        QVector<KItemRange>::const_iterator it2 = ranges2.constBegin();
+
+        const QVector<KItemRange>::const_iterator end1 = ranges1.constEnd();
+        const QVector<KItemRange>::const_iterator end2 = ranges2.constEnd();
+
+        while (it1 != end1 || it2 != end2) {
+            if (it1 == end1) {
+                // We are past the end of ranges1 already. Append all remaining
+                // ranges from ranges2.
+                while (it2 != end2) {
+                    sum.append(*it2);
+                    ++it2;
+                }
+            } else if (it2 == end2) {
+                // We are past the end of ranges2 already. Append all remaining
+                // ranges from ranges1.
+                while (it1 != end1) {
+                    sum.append(*it1);
+                    ++it1;
+                }
+            } else {
+                // Find the beginning of the next range.
+                int index = qMin(it1->index, it2->index);
+                int count = 0;
+
+                do {
+                    if (it1 != end1 && it1->index <= index + count) {
+                        // The next range from ranges1 overlaps with the current range in the sum.
+                        count = qMax(count, it1->index + it1->count - index);
+                        ++it1;
+                    }
+
+                    if (it2 != end2 && it2->index <= index + count) {
+                        // The next range from ranges2 overlaps with the current range in the sum.
+                        count = qMax(count, it2->index + it2->count - index);
+                        ++it2;
+                    }
+                } while ((it1 != end1 && it1->index <= index + count)
+                        || (it2 != end2 && it2->index <= index + count));
+
+                sum.append(KItemRange(index, count));
+            }
+        }
+
+        return sum;
+    }
+
+    QVector<KItemRange> symmetricDifferenceOfRanges(const QVector<KItemRange>& ranges1, const QVector<KItemRange>& ranges2)
+    {
+        // We are looking for all ints which are either in ranges1 or in ranges2,
+        // but not in both.
+        QVector<KItemRange> result;
+
+        // When we go through all integers from INT_MIN to INT_MAX and start
+        // in the state "do not add to result", every beginning/end of a range
+        // of ranges1 and ranges2 toggles the "add/do not add to result" state.
+        // Therefore, we just have to put ints where any range starts/ends to
+        // a sorted array, and then we can calculate the result quite easily.
+        QVector<int> rangeBoundaries;
+        rangeBoundaries.resize(2 * (ranges1.count() + ranges2.count()));
+        const QVector<int>::iterator begin = rangeBoundaries.begin();
+        const QVector<int>::iterator end = rangeBoundaries.end();
+        QVector<int>::iterator it = begin;
+
+        for (const KItemRange& range : ranges1) {
+            *it++ = range.index;
+            *it++ = range.index + range.count;
+        }
+
+        const QVector<int>::iterator middle = it;
+
+        for (const KItemRange& range : ranges2) {
+            *it++ = range.index;
+            *it++ = range.index + range.count;
+        }
+        Q_ASSERT(it == end);
+
+        std::inplace_merge(begin, middle, end);
+
+        it = begin;
+        while (it != end) {
+            const int rangeBegin = *it;
+            ++it;
+
+            if (*it == rangeBegin) {
+                // It seems that ranges from both ranges1 and ranges2 start at
+                // rangeBegin. Do not start a new range, but read the next int.
+                //
+                // Example: Consider the symmetric difference of the sets
+                // {1, 2, 3, 4} and {1, 2}. The sorted list of range boundaries is
+                // 1 1 3 5. Discarding the duplicate 1 yields the result
+                // rangeBegin = 3, rangeEnd = 5, which corresponds to the set {3, 4}.
+                ++it;
+            } else {
+                // The end of the current range is the next *single* int that we
+                // find. If an int appears twice in rangeBoundaries, the range does
+                // not end.
+                //
+                // Example: Consider the symmetric difference of the sets
+                // {1, 2, 3, 4, 8, 9, 10} and {5, 6, 7}. The sorted list of range
+                // boundaries is 1 5 5 8 8 11, and discarding all duplicates yields
+                // the result rangeBegin = 1, rangeEnd = 11, which corresponds to
+                // the set {1, 2, 3, 4, 5, 6, 7, 8, 9, 10}.
+                bool foundEndOfRange = false;
+                int rangeEnd;
+                do {
+                    rangeEnd = *it;
+                    ++it;
+
+                    if (it == end || *it != rangeEnd) {
+                        foundEndOfRange = true;
+                    } else {
+                        ++it;
+                    }
+                } while (!foundEndOfRange);
+
+                result.append(KItemRange(rangeBegin, rangeEnd - rangeBegin));
+            }
+        }
+
+        return result;
+    }
+
+    QVector<KItemRange> intersectRanges(const QVector<KItemRange>& ranges1, const QVector<KItemRange>& ranges2)
+    {
+        QVector<KItemRange> result;
+
+        QVector<KItemRange>::const_iterator it1 = ranges1.constBegin();
+        QVector<KItemRange>::const_iterator it2 = ranges2.constBegin();
+
+        const QVector<KItemRange>::const_iterator end1 = ranges1.constEnd();
+        const QVector<KItemRange>::const_iterator end2 = ranges2.constEnd();
+
+        while (it1 != end1 && it2 != end2) {
+            const int end1Index = it1->index + it1->count;
+            const int end2Index = it2->index + it2->count;
+
+            const int index = qMax(it1->index, it2->index);
+            const int endIndex = qMin(end1Index, end2Index);
+            if (index < endIndex) {
+                result.append(KItemRange(index, endIndex - index));
+            }
+
+            // Continue with the next range of the set whose current range
+            // ends first, as it cannot overlap with any other range.
+            if (end1Index < end2Index) {
+                ++it1;
+            } else if (end2Index < end1Index) {
+                ++it2;
+            } else {
+                ++it1;
+                ++it2;
+            }
+        }
+
+        return result;
+    }
+
+    int countItems(const QVector<KItemRange>& ranges)
+    {
+        int count = 0;
+        for (const KItemRange& range : ranges) {
+            count += range.count;
+        }
+        return count;
     }
 }
 
+KItemSet::iterator KItemSet::insert(int i)
+{
+    const int key = blockKey(i);
+    const int offset = blockOffset(i);
+
+    const int index = blockIndex(key);
+    if (index == m_blocks.count() || m_blocks.at(index).key != key) {
+        Block block;
+        block.key = key;
+        block.count = 0;
+        block.bitmapRangeCount = 0;
+        m_blocks.insert(index, block);
+    }
+
+    Block& block = m_blocks[index];
+    if (block.bitmap.isEmpty()) {
+        int range = lastRangeNotBehind(block.ranges, offset);
+        if (range >= 0 && offset < block.ranges.at(range).index + block.ranges.at(range).count) {
+            // The range already contains i.
+            return iterator(this, index, range, i);
+        }
+
+        range = insertIntoRanges(block.ranges, offset);
+        ++block.count;
+
+        if (block.ranges.count() > MaxRangeCount) {
+            block.bitmapRangeCount = block.ranges.count();
+            block.bitmap = rangesToBitmap(block.ranges, WordCount);
+            block.ranges.clear();
+            range = 0;
+        }
+        return iterator(this, index, range, i);
+    }
+
+    if (!testBit(block.bitmap, offset)) {
+        const bool hasPrevious = (offset > 0 && testBit(block.bitmap, offset - 1));
+        const bool hasNext = (offset < BlockSize - 1 && testBit(block.bitmap, offset + 1));
+        if (hasPrevious && hasNext) {
+            // i merges two ranges.
+            --block.bitmapRangeCount;
+        } else if (!hasPrevious && !hasNext) {
+            ++block.bitmapRangeCount;
+        }
+
+        block.bitmap[offset >> 6] |= quint64(1) << (offset & 63);
+        ++block.count;
+    }
+
+    return iterator(this, index, 0, i);
+}
+
 KItemSet::iterator KItemSet::erase(iterator it)
 {
-    KItemRangeList::iterator rangeIt = it.m_rangeIt;
+    const int i = *it;
+    const int offset = blockOffset(i);
+    Block& block = m_blocks[it.m_block];
 
-    if (it.m_offset == 0) {
-        // Removed index is at the beginning of a range.
-        if (rangeIt->count > 1) {
-            ++rangeIt->index;
-            --rangeIt->count;
-        } else {
-            // The range only contains the removed index.
-            rangeIt = m_itemRanges.erase(rangeIt);
-        }
-        return iterator(rangeIt, 0);
-    } else if (it.m_offset == rangeIt->count - 1) {
-        // Removed index is at the end of a range.
-        --rangeIt->count;
-        ++rangeIt;
-        return iterator(rangeIt, 0);
+    if (block.bitmap.isEmpty()) {
+        eraseFromRanges(block.ranges, it.m_range, offset);
     } else {
-        // The removed index is in the middle of a range.
-        const int newRangeIndex = *it + 1;
-        const int newRangeCount = rangeIt->count - it.m_offset - 1;
-        const KItemRange newRange(newRangeIndex, newRangeCount);
+        const bool hasPrevious = (offset > 0 && testBit(block.bitmap, offset - 1));
+        const bool hasNext = (offset < BlockSize - 1 && testBit(block.bitmap, offset + 1));
+        if (hasPrevious && hasNext) {
+            // i splits a range.
+            ++block.bitmapRangeCount;
+        } else if (!hasPrevious && !hasNext) {
+            --block.bitmapRangeCount;
+        }
 
-        rangeIt->count = it.m_offset;
-        ++rangeIt;
-        rangeIt = m_itemRanges.insert(rangeIt, newRange);
+        block.bitmap[offset >> 6] &= ~(quint64(1) << (offset & 63));
 
-        return iterator(rangeIt, 0);
+        if (block.bitmapRangeCount <= MaxRangeCount / 2) {
+            block.ranges = bitmapToRanges(block.bitmap);
+            block.bitmap.clear();
+        }
     }
+
+    --block.count;
+    if (block.count == 0) {
+        m_blocks.remove(it.m_block);
+    }
+
+    if (i == std::numeric_limits<int>::max()) {
+        return end();
+    }
+    return lowerBound(i + 1);
+}
+
+bool KItemSet::operator==(const KItemSet& other) const
+{
+    if (m_blocks.count() != other.m_blocks.count()) {
+        return false;
+    }
+
+    for (int index = 0; index < m_blocks.count(); ++index) {
+        const Block& block1 = m_blocks.at(index);
+        const Block& block2 = other.m_blocks.at(index);
+        if (block1.key != block2.key || block1.count != block2.count) {
+            return false;
+        }
+
+        const bool isBitmap1 = !block1.bitmap.isEmpty();
+        const bool isBitmap2 = !block2.bitmap.isEmpty();
+        if (isBitmap1 && isBitmap2) {
+            if (block1.bitmap != block2.bitmap) {
+                return false;
+            }
+        } else if (!isBitmap1 && !isBitmap2) {
+            if (block1.ranges != block2.ranges) {
+                return false;
+            }
+        } else {
+            // The same items might be stored as ranges and as bitmap,
+            // depending on the operations that have created the blocks.
+            const QVector<KItemRange> ranges1 = isBitmap1 ? bitmapToRanges(block1.bitmap) : block1.ranges;
+            const QVector<KItemRange> ranges2 = isBitmap2 ? bitmapToRanges(block2.bitmap) : block2.ranges;
+            if (ranges1 != ranges2) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+KItemRangeList KItemSet::ranges() const
+{
+    KItemRangeList result;
+
+    for (const Block& block : m_blocks) {
+        const int firstItemOfBlock = firstItem(block.key);
+        const QVector<KItemRange> ranges = block.bitmap.isEmpty() ? block.ranges : bitmapToRanges(block.bitmap);
+
+        for (const KItemRange& range : ranges) {
+            const int index = firstItemOfBlock + range.index;
+            if (!result.isEmpty() && result.last().index + result.last().count == index) {
+                // Merge ranges that touch the border between two blocks.
+                result.last().count += range.count;
+            } else {
+                result.append(KItemRange(index, range.count));
+            }
+        }
+    }
+
+    return result;
 }
 
 KItemSet KItemSet::operator+(const KItemSet& other) const
 {
     KItemSet sum;
+    sum.m_blocks.reserve(m_blocks.count() + other.m_blocks.count());
 
-    KItemRangeList::const_iterator it1 = m_itemRanges.constBegin();
-    KItemRangeList::const_iterator it2 = other.m_itemRanges.constBegin();
+    QVector<Block>::const_iterator it1 = m_blocks.constBegin();
+    QVector<Block>::const_iterator it2 = other.m_blocks.constBegin();
 
-    const KItemRangeList::const_iterator end1 = m_itemRanges.constEnd();
-    const KItemRangeList::const_iterator end2 = other.m_itemRanges.constEnd();
+    const QVector<Block>::const_iterator end1 = m_blocks.constEnd();
+    const QVector<Block>::const_iterator end2 = other.m_blocks.constEnd();
 
     while (it1 != end1 || it2 != end2) {
-        if (it1 == end1) {
-            // We are past the end of 'this' already. Append all remaining
-            // item ranges from 'other'.
-            while (it2 != end2) {
-                sum.m_itemRanges.append(*it2);
-                ++it2;
-            }
-        } else if (it2 == end2) {
-            // We are past the end of 'other' already. Append all remaining
-            // item ranges from 'this'.
-            while (it1 != end1) {
-                sum.m_itemRanges.append(*it1);
-                ++it1;
-            }
+        if (it2 == end2 || (it1 != end1 && it1->key < it2->key)) {
+            sum.m_blocks.append(*it1);
+            ++it1;
+        } else if (it1 == end1 || it2->key < it1->key) {
+            sum.m_blocks.append(*it2);
+            ++it2;
         } else {
-            // Find the beginning of the next range.
-            int index = qMin(it1->index, it2->index);
-            int count = 0;
-
-            do {
-                if (it1 != end1 && it1->index <= index + count) {
-                    // The next range from 'this' overlaps with the current range in the sum.
-                    count = qMax(count, it1->index + it1->count - index);
-                    ++it1;
+            Block block;
+            block.key = it1->key;
+            block.bitmapRangeCount = 0;
+
+            if (it1->bitmap.isEmpty() && it2->bitmap.isEmpty()) {
+                block.ranges = uniteRanges(it1->ranges, it2->ranges);
+                block.count = countItems(block.ranges);
+                if (block.ranges.count() > MaxRangeCount) {
+                    block.bitmapRangeCount = block.ranges.count();
+                    block.bitmap = rangesToBitmap(block.ranges, WordCount);
+                    block.ranges.clear();
+                }
+            } else {
+                const QVector<quint64> bitmap1 = it1->bitmap.isEmpty() ? rangesToBitmap(it1->ranges, WordCount) : it1->bitmap;
+                const QVector<quint64> bitmap2 = it2->bitmap.isEmpty() ? rangesToBitmap(it2->ranges, WordCount) : it2->bitmap;
+
+                block.bitmap.resize(WordCount);
+                const quint64* bits1 = bitmap1.constData();
+                const quint64* bits2 = bitmap2.constData();
+                quint64* bits = block.bitmap.data();
+                for (int word = 0; word < WordCount; ++word) {
+                    bits[word] = bits1[word] | bits2[word];
                 }
 
-                if (it2 != end2 && it2->index <= index + count) {
-                    // The next range from 'other' overlaps with the current range in the sum.
-                    count = qMax(count, it2->index + it2->count - index);
-                    ++it2;
+                block.count = countBits(block.bitmap);
+                block.bitmapRangeCount = countRanges(block.bitmap);
+                if (block.bitmapRangeCount <= MaxRangeCount / 2) {
+                    block.ranges = bitmapToRanges(block.bitmap);
+                    block.bitmap.clear();
                 }
-            } while ((it1 != end1 && it1->index <= index + count)
-                    || (it2 != end2 && it2->index <= index + count));
+            }
 
-            sum.m_itemRanges.append(KItemRange(index, count));
+            sum.m_blocks.append(block);
+            ++it1;
+            ++it2;
         }
     }
 
@@ -182,74 +591,121 @@ KItemSet KItemSet::operator+(const KItemSet& other) const
 
 KItemSet KItemSet::operator^(const KItemSet& other) const
 {
-    // We are looking for all ints which are either in *this or in other,
-    // but not in both.
     KItemSet result;
+    result.m_blocks.reserve(m_blocks.count() + other.m_blocks.count());
 
-    // When we go through all integers from INT_MIN to INT_MAX and start
-    // in the state "do not add to result", every beginning/end of a range
-    // of *this and other toggles the "add/do not add to result" state.
-    // Therefore, we just have to put ints where any range starts/ends to
-    // a sorted array, and then we can calculate the result quite easily.
-    QVector<int> rangeBoundaries;
-    rangeBoundaries.resize(2 * (m_itemRanges.count() + other.m_itemRanges.count()));
-    const QVector<int>::iterator begin = rangeBoundaries.begin();
-    const QVector<int>::iterator end = rangeBoundaries.end();
-    QVector<int>::iterator it = begin;
-
-    for (const KItemRange& range : qAsConst(m_itemRanges)) {
-        *it++ = range.index;
-        *it++ = range.index + range.count;
-    }
-
-    const QVector<int>::iterator middle = it;
-
-    for (const KItemRange& range : qAsConst(other.m_itemRanges)) {
-        *it++ = range.index;
-        *it++ = range.index + range.count;
-    }
-    Q_ASSERT(it == end);
-
-    std::inplace_merge(begin, middle, end);
-
-    it = begin;
-    while (it != end) {
-        const int rangeBegin = *it;
-        ++it;
-
-        if (*it == rangeBegin) {
-            // It seems that ranges from both *this and other start at
-            // rangeBegin. Do not start a new range, but read the next int.
-            //
-            // Example: Consider the symmetric difference of the sets
-            // {1, 2, 3, 4} and {1, 2}. The sorted list of range boundaries is
-            // 1 1 3 5. Discarding the duplicate 1 yields the result
-            // rangeBegin = 3, rangeEnd = 5, which corresponds to the set {3, 4}.
-            ++it;
+    QVector<Block>::const_iterator it1 = m_blocks.constBegin();
+    QVector<Block>::const_iterator it2 = other.m_blocks.constBegin();
+
+    const QVector<Block>::const_iterator end1 = m_blocks.constEnd();
+    const QVector<Block>::const_iterator end2 = other.m_blocks.constEnd();
+
+    while (it1 != end1 || it2 != end2) {
+        if (it2 == end2 || (it1 != end1 && it1->key < it2->key)) {
+            result.m_blocks.append(*it1);
+            ++it1;
+        } else if (it1 == end1 || it2->key < it1->key) {
+            result.m_blocks.append(*it2);
+            ++it2;
         } else {
-            // The end of the current range is the next *single* int that we
-            // find. If an int appears twice in rangeBoundaries, the range does
-            // not end.
-            //
-            // Example: Consider the symmetric difference of the sets
-            // {1, 2, 3, 4, 8, 9, 10} and {5, 6, 7}. The sorted list of range
-            // boundaries is 1 5 5 8 8 11, and discarding all duplicates yields
-            // the result rangeBegin = 1, rangeEnd = 11, which corresponds to
-            // the set {1, 2, 3, 4, 5, 6, 7, 8, 9, 10}.
-            bool foundEndOfRange = false;
-            int rangeEnd;
-            do {
-                rangeEnd = *it;
-                ++it;
+            Block block;
+            block.key = it1->key;
+            block.bitmapRangeCount = 0;
+
+            if (it1->bitmap.isEmpty() && it2->bitmap.isEmpty()) {
+                block.ranges = symmetricDifferenceOfRanges(it1->ranges, it2->ranges);
+                block.count = countItems(block.ranges);
+                if (block.ranges.count() > MaxRangeCount) {
+                    block.bitmapRangeCount = block.ranges.count();
+                    block.bitmap = rangesToBitmap(block.ranges, WordCount);
+                    block.ranges.clear();
+                }
+            } else {
+                const QVector<quint64> bitmap1 = it1->bitmap.isEmpty() ? rangesToBitmap(it1->ranges, WordCount) : it1->bitmap;
+                const QVector<quint64> bitmap2 = it2->bitmap.isEmpty() ? rangesToBitmap(it2->ranges, WordCount) : it2->bitmap;
+
+                block.bitmap.resize(WordCount);
+                const quint64* bits1 = bitmap1.constData();
+                const quint64* bits2 = bitmap2.constData();
+                quint64* bits = block.bitmap.data();
+                for (int word = 0; word < WordCount; ++word) {
+                    bits[word] = bits1[word] ^ bits2[word];
+                }
 
-                if (it == end || *it != rangeEnd) {
-                    foundEndOfRange = true;
-                } else {
-                    ++it;
+                block.count = countBits(block.bitmap);
+                block.bitmapRangeCount = countRanges(block.bitmap);
+                if (block.bitmapRangeCount <= MaxRangeCount / 2) {
+                    block.ranges = bitmapToRanges(block.bitmap);
+                    block.bitmap.clear();
                 }
-            } while (!foundEndOfRange);
+            }
 
-            result.m_itemRanges.append(KItemRange(rangeBegin, rangeEnd - rangeBegin));
+            if (block.count > 0) {
+                result.m_blocks.append(block);
+            }
+            ++it1;
+            ++it2;
+        }
+    }
+
+    return result;
+}
+
+KItemSet KItemSet::operator&(const KItemSet& other) const
+{
+    KItemSet result;
+    result.m_blocks.reserve(qMin(m_blocks.count(), other.m_blocks.count()));
+
+    QVector<Block>::const_iterator it1 = m_blocks.constBegin();
+    QVector<Block>::const_iterator it2 = other.m_blocks.constBegin();
+
+    const QVector<Block>::const_iterator end1 = m_blocks.constEnd();
+    const QVector<Block>::const_iterator end2 = other.m_blocks.constEnd();
+
+    // Only blocks that are contained in both sets can contribute to the result.
+    while (it1 != end1 && it2 != end2) {
+        if (it1->key < it2->key) {
+            ++it1;
+        } else if (it2->key < it1->key) {
+            ++it2;
+        } else {
+            Block block;
+            block.key = it1->key;
+            block.bitmapRangeCount = 0;
+
+            if (it1->bitmap.isEmpty() && it2->bitmap.isEmpty()) {
+                block.ranges = intersectRanges(it1->ranges, it2->ranges);
+                block.count = countItems(block.ranges);
+                if (block.ranges.count() > MaxRangeCount) {
+                    block.bitmapRangeCount = block.ranges.count();
+                    block.bitmap = rangesToBitmap(block.ranges, WordCount);
+                    block.ranges.clear();
+                }
+            } else {
+                const QVector<quint64> bitmap1 = it1->bitmap.isEmpty() ? rangesToBitmap(it1->ranges, WordCount) : it1->bitmap;
+                const QVector<quint64> bitmap2 = it2->bitmap.isEmpty() ? rangesToBitmap(it2->ranges, WordCount) : it2->bitmap;
+
+                block.bitmap.resize(WordCount);
+                const quint64* bits1 = bitmap1.constData();
+                const quint64* bits2 = bitmap2.constData();
+                quint64* bits = block.bitmap.data();
+                for (int word = 0; word < WordCount; ++word) {
+                    bits[word] = bits1[word] & bits2[word];
+                }
+
+                block.count = countBits(block.bitmap);
+                block.bitmapRangeCount = countRanges(block.bitmap);
+                if (block.bitmapRangeCount <= MaxRangeCount / 2) {
+                    block.ranges = bitmapToRanges(block.bitmap);
+                    block.bitmap.clear();
+                }
+            }
+
+            if (block.count > 0) {
+                result.m_blocks.append(block);
+            }
+            ++it1;
+            ++it2;
         }
     }
 
@@ -258,17 +714,41 @@ KItemSet KItemSet::operator^(const KItemSet& other) const
 
 bool KItemSet::isValid() const
 {
-    const KItemRangeList::const_iterator begin = m_itemRanges.constBegin();
-    const KItemRangeList::const_iterator end = m_itemRanges.constEnd();
+    for (int index = 0; index < m_blocks.count(); ++index) {
+        const Block& block = m_blocks.at(index);
 
-    for (KItemRangeList::const_iterator it = begin; it != end; ++it) {
-        if (it->count <= 0) {
+        if (index > 0 && m_blocks.at(index - 1).key >= block.key) {
             return false;
         }
 
-        if (it != begin) {
-            const KItemRangeList::const_iterator previous = it - 1;
-            if (previous->index + previous->count >= it->index) {
+        if (block.count <= 0) {
+            return false;
+        }
+
+        if (block.bitmap.isEmpty()) {
+            const QVector<KItemRange>::const_iterator begin = block.ranges.constBegin();
+            const QVector<KItemRange>::const_iterator end = block.ranges.constEnd();
+
+            for (QVector<KItemRange>::const_iterator it = begin; it != end; ++it) {
+                if (it->count <= 0 || it->index < 0 || it->index + it->count > BlockSize) {
+                    return false;
+                }
+
+                if (it != begin) {
+                    const QVector<KItemRange>::const_iterator previous = it - 1;
+                    if (previous->index + previous->count >= it->index) {
+                        return false;
+                    }
+                }
+            }
+
+            if (countItems(block.ranges) != block.count) {
+                return false;
+            }
+        } else {
+            if (block.bitmap.count() != WordCount
+                    || countBits(block.bitmap) != block.count
+                    || countRanges(block.bitmap) != block.bitmapRangeCount) {
                 return false;
             }
         }
@@ -277,56 +757,158 @@ bool KItemSet::isValid() const
     return true;
 }
 
-KItemRangeList::iterator KItemSet::rangeForItem(int i)
+int KItemSet::blockIndex(int key) const
 {
-    const KItemRangeList::iterator end = m_itemRanges.end();
-    KItemRangeList::iterator low = m_itemRanges.begin();
-    KItemRangeList::iterator high = end;
+    const auto it = std::lower_bound(m_blocks.constBegin(), m_blocks.constEnd(), key,
+                                     [](const Block& block, int key) {
+                                         return block.key < key;
+                                     });
+    return int(it - m_blocks.constBegin());
+}
 
-    if (low == end || low->index > i) {
-        return end;
+void KItemSet::firstItemOfBlock(int block, int& range, int& item) const
+{
+    const Block& b = m_blocks.at(block);
+    range = 0;
+    if (b.bitmap.isEmpty()) {
+        item = firstItem(b.key) + b.ranges.first().index;
+    } else {
+        item = firstItem(b.key) + nextBit(b.bitmap, 0);
     }
+}
 
-    while (low != high && low + 1 != high) {
-        KItemRangeList::iterator mid = low + (high - low) / 2;
-        if (mid->index > i) {
-            high = mid;
-        } else {
-            low = mid;
+void KItemSet::lastItemOfBlock(int block, int& range, int& item) const
+{
+    const Block& b = m_blocks.at(block);
+    if (b.bitmap.isEmpty()) {
+        range = b.ranges.count() - 1;
+        const KItemRange& lastRange = b.ranges.last();
+        item = firstItem(b.key) + lastRange.index + lastRange.count - 1;
+    } else {
+        range = 0;
+        item = firstItem(b.key) + previousBit(b.bitmap, BlockSize - 1);
+    }
+}
+
+void KItemSet::increment(int& block, int& range, int& item) const
+{
+    const Block& b = m_blocks.at(block);
+    const int offset = item - firstItem(b.key);
+
+    if (b.bitmap.isEmpty()) {
+        const KItemRange& currentRange = b.ranges.at(range);
+        if (offset + 1 < currentRange.index + currentRange.count) {
+            ++item;
+            return;
+        }
+        if (range + 1 < b.ranges.count()) {
+            ++range;
+            item = firstItem(b.key) + b.ranges.at(range).index;
+            return;
+        }
+    } else if (offset + 1 < BlockSize) {
+        const int next = nextBit(b.bitmap, offset + 1);
+        if (next >= 0) {
+            item = firstItem(b.key) + next;
+            return;
         }
     }
 
-    Q_ASSERT(low->index <= i);
-    if (low->index + low->count > i) {
-        return low;
+    ++block;
+    if (block == m_blocks.count()) {
+        // The end has been reached.
+        range = 0;
+        item = 0;
+    } else {
+        firstItemOfBlock(block, range, item);
+    }
+}
+
+void KItemSet::decrement(int& block, int& range, int& item) const
+{
+    if (block < m_blocks.count()) {
+        const Block& b = m_blocks.at(block);
+        const int offset = item - firstItem(b.key);
+
+        if (b.bitmap.isEmpty()) {
+            if (offset > b.ranges.at(range).index) {
+                --item;
+                return;
+            }
+            if (range > 0) {
+                --range;
+                const KItemRange& previousRange = b.ranges.at(range);
+                item = firstItem(b.key) + previousRange.index + previousRange.count - 1;
+                return;
+            }
+        } else if (offset > 0) {
+            const int previous = previousBit(b.bitmap, offset - 1);
+            if (previous >= 0) {
+                item = firstItem(b.key) + previous;
+                return;
+            }
+        }
     }
 
-    return end;
+    --block;
+    lastItemOfBlock(block, range, item);
 }
 
-KItemRangeList::const_iterator KItemSet::constRangeForItem(int i) const
+bool KItemSet::findItem(int i, int& block, int& range) const
 {
-    const KItemRangeList::const_iterator end = m_itemRanges.constEnd();
-    KItemRangeList::const_iterator low = m_itemRanges.constBegin();
-    KItemRangeList::const_iterator high = end;
+    const int key = blockKey(i);
+    block = blockIndex(key);
+    if (block == m_blocks.count() || m_blocks.at(block).key != key) {
+        return false;
+    }
 
-    if (low == end || low->index > i) {
-        return end;
+    const Block& b = m_blocks.at(block);
+    const int offset = blockOffset(i);
+    if (b.bitmap.isEmpty()) {
+        range = lastRangeNotBehind(b.ranges, offset);
+        return range >= 0 && offset < b.ranges.at(range).index + b.ranges.at(range).count;
     }
 
-    while (low != high && low + 1 != high) {
-        KItemRangeList::const_iterator mid = low + (high - low) / 2;
-        if (mid->index > i) {
-            high = mid;
+    range = 0;
+    return testBit(b.bitmap, offset);
+}
+
+KItemSet::iterator KItemSet::lowerBound(int i)
+{
+    const int key = blockKey(i);
+    const int index = blockIndex(key);
+    if (index == m_blocks.count()) {
+        return end();
+    }
+
+    const Block& block = m_blocks.at(index);
+    if (block.key == key) {
+        const int offset = blockOffset(i);
+        if (block.bitmap.isEmpty()) {
+            const int range = lastRangeNotBehind(block.ranges, offset);
+            if (range >= 0 && offset < block.ranges.at(range).index + block.ranges.at(range).count) {
+                return iterator(this, index, range, i);
+            }
+            if (range + 1 < block.ranges.count()) {
+                return iterator(this, index, range + 1, firstItem(key) + block.ranges.at(range + 1).index);
+            }
         } else {
-            low = mid;
+            const int next = nextBit(block.bitmap, offset);
+            if (next >= 0) {
+                return iterator(this, index, 0, firstItem(key) + next);
+            }
         }
-    }
 
-    Q_ASSERT(low->index <= i);
-    if (low->index + low->count > i) {
-        return low;
+        // All items of the block are smaller than i.
+        if (index + 1 == m_blocks.count()) {
+            return end();
+        }
+        iterator it(this, index + 1, 0, 0);
+        firstItemOfBlock(index + 1, it.m_range, it.m_item);
+        return it;
     }
 
-    return end;
+    iterator it(this, index, 0, 0);
+    firstItemOfBlock(index, it.m_range, it.m_item);
+    return it;
 }
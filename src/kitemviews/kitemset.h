@@ -11,6 +11,8 @@
 #include "dolphin_export.h"
 #include "kitemviews/kitemrange.h"
 
+#include <QVector>
+
 /**
  * @brief Stores a set of integer numbers in a space-efficient way.
  *
@@ -26,7 +28,15 @@
  * 2. When iterating through a KItemSet using KItemSet::iterator or
  *    KItemSet::const_iterator, the numbers are traversed in ascending order.
  *
- * The complexity of most operations depends on the number of ranges.
+ * The numbers are split into blocks of 65536 consecutive numbers. Each block
+ * either stores its numbers as sorted list of ranges, or, if the numbers are
+ * fragmented into many ranges, as bitmap. Hence fragmented sets like the
+ * selection of every second item don't degrade insert(), contains(),
+ * operator+(), operator^() and operator&(), which work on whole 64-bit
+ * words of the bitmaps.
+ *
+ * The complexity of most operations depends on the number of ranges
+ * inside one block.
  */
 
 class DOLPHIN_EXPORT KItemSet
@@ -39,7 +49,7 @@ public:
 
     /**
      * Returns the number of items in the set.
-     * Complexity: O(log(number of ranges)).
+     * Complexity: O(number of blocks).
      */
     int count() const;
 
@@ -51,23 +61,29 @@ public:
 
     class iterator
     {
-        iterator(const KItemRangeList::iterator& rangeIt, int offset) :
-            m_rangeIt(rangeIt),
-            m_offset(offset)
+        iterator(const KItemSet* set, int block, int range, int item) :
+            m_set(set),
+            m_block(block),
+            m_range(range),
+            m_item(item)
         {
         }
 
     public:
         iterator(const iterator& other) :
-            m_rangeIt(other.m_rangeIt),
-            m_offset(other.m_offset)
+            m_set(other.m_set),
+            m_block(other.m_block),
+            m_range(other.m_range),
+            m_item(other.m_item)
         {
         }
 
         iterator& operator=(const iterator& other)
         {
-            m_rangeIt = other.m_rangeIt;
-            m_offset = other.m_offset;
+            m_set = other.m_set;
+            m_block = other.m_block;
+            m_range = other.m_range;
+            m_item = other.m_item;
             return *this;
         }
 
@@ -75,12 +91,12 @@ public:
 
         int operator*() const
         {
-            return m_rangeIt->index + m_offset;
+            return m_item;
         }
 
         inline bool operator==(const iterator& other) const
         {
-            return m_rangeIt == other.m_rangeIt && m_offset == other.m_offset;
+            return m_block == other.m_block && m_item == other.m_item;
         }
 
         inline bool operator!=(const iterator& other) const
@@ -90,13 +106,7 @@ public:
 
         inline iterator& operator++()
         {
-            ++m_offset;
-
-            if (m_offset == m_rangeIt->count) {
-                ++m_rangeIt;
-                m_offset = 0;
-            }
-
+            m_set->increment(m_block, m_range, m_item);
             return *this;
         }
 
@@ -109,13 +119,7 @@ public:
 
         inline iterator& operator--()
         {
-            if (m_offset == 0) {
-                --m_rangeIt;
-                m_offset = m_rangeIt->count - 1;
-            } else {
-                --m_offset;
-            }
-
+            m_set->decrement(m_block, m_range, m_item);
             return *this;
         }
 
@@ -127,8 +131,10 @@ public:
         }
 
     private:
-        KItemRangeList::iterator m_rangeIt;
-        int m_offset;
+        const KItemSet* m_set;
+        int m_block;
+        int m_range; // Only used for blocks that store ranges
+        int m_item;
 
         friend class const_iterator;
         friend class KItemSet;
@@ -137,29 +143,37 @@ public:
 
     class const_iterator
     {
-        const_iterator(KItemRangeList::const_iterator rangeIt, int offset) :
-            m_rangeIt(rangeIt),
-            m_offset(offset)
+        const_iterator(const KItemSet* set, int block, int range, int item) :
+            m_set(set),
+            m_block(block),
+            m_range(range),
+            m_item(item)
         {
         }
 
     public:
         const_iterator(const const_iterator& other) :
-            m_rangeIt(other.m_rangeIt),
-            m_offset(other.m_offset)
+            m_set(other.m_set),
+            m_block(other.m_block),
+            m_range(other.m_range),
+            m_item(other.m_item)
         {
         }
 
         explicit const_iterator(const iterator& other) :
-            m_rangeIt(other.m_rangeIt),
-            m_offset(other.m_offset)
+            m_set(other.m_set),
+            m_block(other.m_block),
+            m_range(other.m_range),
+            m_item(other.m_item)
         {
         }
 
         const_iterator& operator=(const const_iterator& other)
         {
-            m_rangeIt = other.m_rangeIt;
-            m_offset = other.m_offset;
+            m_set = other.m_set;
+            m_block = other.m_block;
+            m_range = other.m_range;
+            m_item = other.m_item;
             return *this;
         }
 
@@ -167,12 +181,12 @@ public:
 
         int operator*() const
         {
-            return m_rangeIt->index + m_offset;
+            return m_item;
         }
 
         inline bool operator==(const const_iterator& other) const
         {
-            return m_rangeIt == other.m_rangeIt && m_offset == other.m_offset;
+            return m_block == other.m_block && m_item == other.m_item;
         }
 
         inline bool operator!=(const const_iterator& other) const
@@ -182,13 +196,7 @@ public:
 
         inline const_iterator& operator++()
         {
-            ++m_offset;
-
-            if (m_offset == m_rangeIt->count) {
-                ++m_rangeIt;
-                m_offset = 0;
-            }
-
+            m_set->increment(m_block, m_range, m_item);
             return *this;
         }
 
@@ -201,13 +209,7 @@ public:
 
         inline const_iterator& operator--()
         {
-            if (m_offset == 0) {
-                --m_rangeIt;
-                m_offset = m_rangeIt->count - 1;
-            } else {
-                --m_offset;
-            }
-
+            m_set->decrement(m_block, m_range, m_item);
             return *this;
         }
 
@@ -219,8 +221,10 @@ public:
         }
 
     private:
-        KItemRangeList::const_iterator m_rangeIt;
-        int m_offset;
+        const KItemSet* m_set;
+        int m_block;
+        int m_range;
+        int m_item;
 
         friend class KItemSet;
     };
@@ -235,6 +239,12 @@ public:
     int first() const;
     int last() const;
 
+    /**
+     * Returns the items of the set as sorted list of non-adjacent ranges.
+     * Complexity: O(number of ranges).
+     */
+    KItemRangeList ranges() const;
+
     bool contains(int i) const;
     iterator insert(int i);
     iterator find(int i);
@@ -255,40 +265,94 @@ public:
      */
     KItemSet operator^(const KItemSet& other) const;
 
+    /**
+     * Returns a new set which contains all items that are contained both in
+     * this KItemSet and in \a other (the intersection of both KItemSets).
+     */
+    KItemSet operator&(const KItemSet& other) const;
+
     KItemSet& operator<<(int i);
 
 private:
+    enum {
+        BlockBits = 16,
+        BlockSize = 1 << BlockBits,
+        WordCount = BlockSize / 64,
+
+        // A block that stores more ranges is converted to a bitmap. A bitmap
+        // is converted back to ranges if it contains at most half as many
+        // ranges, which prevents converting a block back and forth.
+        MaxRangeCount = 512
+    };
+
+    /**
+     * Stores the items key * BlockSize ... key * BlockSize + BlockSize - 1.
+     * The ranges and the bits of the bitmap are relative to the first item.
+     * If the bitmap is empty, the items are stored as ranges.
+     */
+    struct Block
+    {
+        int key;
+        int count;
+        int bitmapRangeCount; // Number of ranges in the bitmap
+        QVector<KItemRange> ranges;
+        QVector<quint64> bitmap;
+    };
+
     /**
      * Returns true if the KItemSet is valid, and false otherwise.
-     * A valid KItemSet must store the item ranges in ascending order, and
-     * the ranges must not overlap.
+     * A valid KItemSet must store the blocks in ascending order, each block
+     * must contain at least one item, and the ranges of a block must be
+     * stored in ascending order and must neither overlap nor be adjacent.
      */
     bool isValid() const;
 
     /**
-     * This function returns an iterator that points to the KItemRange which
-     * contains i, or m_itemRanges.end() if no such range exists.
+     * Returns the index of the first block whose key is not smaller than \a key.
      */
-    KItemRangeList::iterator rangeForItem(int i);
+    int blockIndex(int key) const;
 
     /**
-     * This function returns an iterator that points to the KItemRange which
-     * contains i, or m_itemRanges.constEnd() if no such range exists.
+     * Sets \a range and \a item to the first or last item of the block \a block.
      */
-    KItemRangeList::const_iterator constRangeForItem(int i) const;
+    void firstItemOfBlock(int block, int& range, int& item) const;
+    void lastItemOfBlock(int block, int& range, int& item) const;
 
-    KItemRangeList m_itemRanges;
+    /**
+     * Moves the position given by \a block, \a range and \a item
+     * to the next or previous item. Used by the iterators.
+     */
+    void increment(int& block, int& range, int& item) const;
+    void decrement(int& block, int& range, int& item) const;
+
+    /**
+     * Returns false if \a i is not contained. Otherwise the position
+     * of \a i is stored in \a block and \a range.
+     */
+    bool findItem(int i, int& block, int& range) const;
+
+    /**
+     * Returns an iterator that points to the smallest item which
+     * is equal to or larger than \a i.
+     */
+    iterator lowerBound(int i);
+
+    static int blockKey(int i);
+    static int blockOffset(int i);
+    static int firstItem(int key);
+
+    QVector<Block> m_blocks;
 
     friend class KItemSetTest;
 };
 
 inline KItemSet::KItemSet() :
-    m_itemRanges()
+    m_blocks()
 {
 }
 
 inline KItemSet::KItemSet(const KItemSet& other) :
-    m_itemRanges(other.m_itemRanges)
+    m_blocks(other.m_blocks)
 {
 }
 
@@ -296,50 +360,47 @@ inline KItemSet::~KItemSet() = default;
 
 inline KItemSet& KItemSet::operator=(const KItemSet& other)
 {
-    m_itemRanges=other.m_itemRanges;
+    m_blocks = other.m_blocks;
     return *this;
 }
 
 inline int KItemSet::count() const
 {
     int result = 0;
-    for (const KItemRange& range : qAsConst(m_itemRanges)) {
-        result += range.count;
+    for (const Block& block : qAsConst(m_blocks)) {
+        result += block.count;
     }
     return result;
 }
 
 inline bool KItemSet::isEmpty() const
 {
-    return m_itemRanges.isEmpty();
+    return m_blocks.isEmpty();
 }
 
 inline void KItemSet::clear()
 {
-    m_itemRanges.clear();
-}
-
-inline bool KItemSet::operator==(const KItemSet& other) const
-{
-    return m_itemRanges == other.m_itemRanges;
+    m_blocks.clear();
 }
 
 inline bool KItemSet::operator!=(const KItemSet& other) const
 {
-    return m_itemRanges != other.m_itemRanges;
+    return !(*this == other);
 }
 
 inline bool KItemSet::contains(int i) const
 {
-    const KItemRangeList::const_iterator it = constRangeForItem(i);
-    return it != m_itemRanges.end();
+    int block;
+    int range;
+    return findItem(i, block, range);
 }
 
 inline KItemSet::iterator KItemSet::find(int i)
 {
-    const KItemRangeList::iterator it = rangeForItem(i);
-    if (it != m_itemRanges.end()) {
-        return iterator(it, i - it->index);
+    int block;
+    int range;
+    if (findItem(i, block, range)) {
+        return iterator(this, block, range, i);
     } else {
         return end();
     }
@@ -347,9 +408,10 @@ inline KItemSet::iterator KItemSet::find(int i)
 
 inline KItemSet::const_iterator KItemSet::constFind(int i) const
 {
-    const KItemRangeList::const_iterator it = constRangeForItem(i);
-    if (it != m_itemRanges.constEnd()) {
-        return const_iterator(it, i - it->index);
+    int block;
+    int range;
+    if (findItem(i, block, range)) {
+        return const_iterator(this, block, range, i);
     } else {
         return constEnd();
     }
@@ -368,43 +430,58 @@ inline bool KItemSet::remove(int i)
 
 inline KItemSet::iterator KItemSet::begin()
 {
-    return iterator(m_itemRanges.begin(), 0);
+    if (m_blocks.isEmpty()) {
+        return end();
+    }
+    iterator it(this, 0, 0, 0);
+    firstItemOfBlock(0, it.m_range, it.m_item);
+    return it;
 }
 
 inline KItemSet::const_iterator KItemSet::begin() const
 {
-    return const_iterator(m_itemRanges.begin(), 0);
+    return constBegin();
 }
 
 inline KItemSet::const_iterator KItemSet::constBegin() const
 {
-    return const_iterator(m_itemRanges.constBegin(), 0);
+    if (m_blocks.isEmpty()) {
+        return constEnd();
+    }
+    const_iterator it(this, 0, 0, 0);
+    firstItemOfBlock(0, it.m_range, it.m_item);
+    return it;
 }
 
 inline KItemSet::iterator KItemSet::end()
 {
-    return iterator(m_itemRanges.end(), 0);
+    return iterator(this, m_blocks.count(), 0, 0);
 }
 
 inline KItemSet::const_iterator KItemSet::end() const
 {
-    return const_iterator(m_itemRanges.end(), 0);
+    return constEnd();
 }
 
 inline KItemSet::const_iterator KItemSet::constEnd() const
 {
-    return const_iterator(m_itemRanges.constEnd(), 0);
+    return const_iterator(this, m_blocks.count(), 0, 0);
 }
 
 inline int KItemSet::first() const
 {
-    return m_itemRanges.first().index;
+    int range;
+    int item;
+    firstItemOfBlock(0, range, item);
+    return item;
 }
 
 inline int KItemSet::last() const
 {
-    const KItemRange& lastRange = m_itemRanges.last();
-    return lastRange.index + lastRange.count - 1;
+    int range;
+    int item;
+    lastItemOfBlock(m_blocks.count() - 1, range, item);
+    return item;
 }
 
 inline KItemSet& KItemSet::operator<<(int i)
@@ -413,4 +490,20 @@ inline KItemSet& KItemSet::operator<<(int i)
     return *this;
 }
 
+inline int KItemSet::blockKey(int i)
+{
+    // Negative items belong to blocks with negative keys
+    return i >> BlockBits;
+}
+
+inline int KItemSet::blockOffset(int i)
+{
+    return i & (BlockSize - 1);
+}
+
+inline int KItemSet::firstItem(int key)
+{
+    return key * BlockSize;
+}
+
 #endif
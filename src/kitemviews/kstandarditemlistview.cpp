@@ -12,7 +12,8 @@
 
 KStandardItemListView::KStandardItemListView(QGraphicsWidget* parent) :
     KItemListView(parent),
-    m_itemLayout(DetailsLayout)
+    m_itemLayout(DetailsLayout),
+    m_itemRenderCacheEnabled(false)
 {
     setAcceptDrops(true);
     setScrollOrientation(Qt::Vertical);
@@ -50,6 +51,19 @@ KStandardItemListView::ItemLayout KStandardItemListView::itemLayout() const
     return m_itemLayout;
 }
 
+void KStandardItemListView::setItemRenderCacheEnabled(bool enabled)
+{
+    if (m_itemRenderCacheEnabled != enabled) {
+        m_itemRenderCacheEnabled = enabled;
+        updateLayoutOfVisibleItems();
+    }
+}
+
+bool KStandardItemListView::itemRenderCacheEnabled() const
+{
+    return m_itemRenderCacheEnabled;
+}
+
 KItemListWidgetCreatorBase* KStandardItemListView::defaultWidgetCreator() const
 {
     return new KItemListWidgetCreator<KStandardItemListWidget>();
@@ -74,6 +88,7 @@ void KStandardItemListView::initializeItemListWidget(KItemListWidget* item)
 
     standardItemListWidget->setHighlightEntireRow(highlightEntireRow());
     standardItemListWidget->setSupportsItemExpanding(supportsItemExpanding());
+    standardItemListWidget->setRenderCacheEnabled(m_itemRenderCacheEnabled);
 }
 
 
@@ -44,6 +44,14 @@ public:
     void setItemLayout(ItemLayout layout);
     ItemLayout itemLayout() const;
 
+    /**
+     * If set to true, the item widgets cache their rendered content in a
+     * pixmap (see KStandardItemListWidget::setRenderCacheEnabled()).
+     * Per default the render cache is disabled.
+     */
+    void setItemRenderCacheEnabled(bool enabled);
+    bool itemRenderCacheEnabled() const;
+
 protected:
     KItemListWidgetCreatorBase* defaultWidgetCreator() const override;
     KItemListGroupHeaderCreatorBase* defaultGroupHeaderCreator() const override;
@@ -61,6 +69,7 @@ private:
 
 private:
     ItemLayout m_itemLayout;
+    bool m_itemRenderCacheEnabled;
 };
 
 #endif
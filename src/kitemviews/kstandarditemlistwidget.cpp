@@ -9,7 +9,9 @@
 #include "kfileitemlistview.h"
 #include "kfileitemmodel.h"
 #include "private/kfileitemclipboard.h"
+#include "private/kitemlisticoncache.h"
 #include "private/kitemlistroleeditor.h"
+#include "private/kitemlisttextlayoutcache.h"
 #include "private/kpixmapmodifier.h"
 
 #include <KIconEffect>
@@ -22,11 +24,226 @@
 #include <QGraphicsSceneResizeEvent>
 #include <QGraphicsView>
 #include <QGuiApplication>
-#include <QPixmapCache>
 #include <QStyleOption>
+#include <QThreadStorage>
+#include <QtConcurrentMap>
 
 // #define KSTANDARDITEMLISTWIDGET_DEBUG
 
+namespace {
+    /**
+     * Texts of one item that get measured outside the GUI thread. The texts
+     * are read from the model before the measurement gets started.
+     */
+    struct TextMeasurementInput
+    {
+        QStringList texts;
+        bool isLink;
+    };
+
+    /**
+     * @return Font for the description \a description that may only be
+     *         used by the calling thread. QFont is reentrant, but instances
+     *         may not be shared between threads.
+     */
+    const QFont& threadLocalFont(const QString& description)
+    {
+        static QThreadStorage<QHash<QString, QFont>> fontsStorage;
+        QHash<QString, QFont>& fonts = fontsStorage.localData();
+
+        auto it = fonts.find(description);
+        if (it == fonts.end()) {
+            QFont font;
+            font.fromString(description);
+            it = fonts.insert(description, font);
+        }
+        return it.value();
+    }
+
+    class IconsLayoutTextMeasurer
+    {
+    public:
+        typedef std::pair<qreal, bool> result_type;
+
+        IconsLayoutTextMeasurer(const QFont& normalFont, const QFont& linkFont,
+                                qreal maxWidth, int maxTextLines, qreal additionalHeight) :
+            m_normalFontDescription(normalFont.toString()),
+            m_linkFontDescription(linkFont.toString()),
+            m_maxWidth(maxWidth),
+            m_maxTextLines(maxTextLines),
+            m_additionalHeight(additionalHeight)
+        {
+        }
+
+        result_type operator()(const TextMeasurementInput& input) const
+        {
+            // If the current item is a link, we use the customized link font instead of the normal font.
+            const QFont& font = threadLocalFont(input.isLink ? m_linkFontDescription : m_normalFontDescription);
+
+            const QString text = KStringHandler::preProcessWrap(input.texts.first());
+
+            // Calculate the number of lines required for wrapping the name
+            const KItemListTextLayoutCache::Layout layout =
+                KItemListTextLayoutCache::instance()->wrappedText(text, font, m_maxWidth, m_maxTextLines);
+
+            return std::make_pair(layout.height + m_additionalHeight, layout.isElided);
+        }
+
+    private:
+        QString m_normalFontDescription;
+        QString m_linkFontDescription;
+        qreal m_maxWidth;
+        int m_maxTextLines;
+        qreal m_additionalHeight;
+    };
+
+    class CompactLayoutTextMeasurer
+    {
+    public:
+        typedef std::pair<qreal, bool> result_type;
+
+        CompactLayoutTextMeasurer(const QFont& normalFont, const QFont& linkFont,
+                                  qreal maxWidth, qreal paddingAndIconWidth) :
+            m_normalFontDescription(normalFont.toString()),
+            m_linkFontDescription(linkFont.toString()),
+            m_maxWidth(maxWidth),
+            m_paddingAndIconWidth(paddingAndIconWidth)
+        {
+        }
+
+        result_type operator()(const TextMeasurementInput& input) const
+        {
+            // If the current item is a link, we use the customized link font metrics instead of the normal font metrics.
+            const QFont& font = threadLocalFont(input.isLink ? m_linkFontDescription : m_normalFontDescription);
+            KItemListTextLayoutCache* textLayoutCache = KItemListTextLayoutCache::instance();
+
+            // For each row exactly one role is shown. Calculate the maximum required width that is necessary
+            // to show all roles without horizontal clipping.
+            qreal maximumRequiredWidth = 0.0;
+            for (const QString& text : input.texts) {
+                const qreal requiredWidth = textLayoutCache->horizontalAdvance(text, font);
+                maximumRequiredWidth = qMax(maximumRequiredWidth, requiredWidth);
+            }
+
+            qreal width = m_paddingAndIconWidth + maximumRequiredWidth;
+            if (m_maxWidth > 0 && width > m_maxWidth) {
+                width = m_maxWidth;
+            }
+
+            return std::make_pair(width, false);
+        }
+
+    private:
+        QString m_normalFontDescription;
+        QString m_linkFontDescription;
+        qreal m_maxWidth;
+        qreal m_paddingAndIconWidth;
+    };
+
+    /**
+     * Role texts of one item whose column widths get measured outside the GUI thread.
+     */
+    struct ColumnWidthMeasurementInput
+    {
+        QStringList texts;
+        bool isLink;
+        int expandedParentsCount;
+    };
+
+    /**
+     * Measures the preferred column widths like
+     * KStandardItemListWidgetInformant::preferredRoleColumnWidth().
+     */
+    class ColumnWidthMeasurer
+    {
+    public:
+        typedef QVector<qreal> result_type;
+
+        ColumnWidthMeasurer(const QList<QByteArray>& roles, const QFont& normalFont, const QFont& linkFont,
+                            const KItemListStyleOption& option, qreal columnPadding, qreal ratingWidth,
+                            bool supportsItemExpanding) :
+            m_roles(roles),
+            m_normalFontDescription(normalFont.toString()),
+            m_linkFontDescription(linkFont.toString()),
+            m_normalFontHeight(QFontMetrics(normalFont).height()),
+            m_linkFontHeight(QFontMetrics(linkFont).height()),
+            m_columnPadding(columnPadding),
+            m_ratingWidth(ratingWidth),
+            m_padding(option.padding),
+            m_iconSize(option.iconSize),
+            m_supportsItemExpanding(supportsItemExpanding)
+        {
+        }
+
+        result_type operator()(const ColumnWidthMeasurementInput& input) const
+        {
+            // If current item is a link, we use the customized link font instead of the normal font.
+            const QFont& font = threadLocalFont(input.isLink ? m_linkFontDescription : m_normalFontDescription);
+            const int fontHeight = input.isLink ? m_linkFontHeight : m_normalFontHeight;
+
+            result_type widths;
+            widths.reserve(m_roles.count());
+            for (int i = 0; i < m_roles.count(); ++i) {
+                const QByteArray& role = m_roles.at(i);
+                qreal width = m_columnPadding;
+
+                if (role == "rating") {
+                    width += m_ratingWidth;
+                } else {
+                    width += KItemListTextLayoutCache::instance()->horizontalAdvance(input.texts.at(i), font);
+
+                    if (role == "text") {
+                        if (m_supportsItemExpanding) {
+                            // Increase the width by the expansion-toggle and the current expansion level
+                            const qreal height = m_padding * 2 + qMax(m_iconSize, fontHeight);
+                            width += (input.expandedParentsCount + 1) * height;
+                        }
+
+                        // Increase the width by the required space for the icon
+                        width += m_padding * 2 + m_iconSize;
+                    }
+                }
+
+                widths.append(width);
+            }
+            return widths;
+        }
+
+    private:
+        QList<QByteArray> m_roles;
+        QString m_normalFontDescription;
+        QString m_linkFontDescription;
+        int m_normalFontHeight;
+        int m_linkFontHeight;
+        qreal m_columnPadding;
+        qreal m_ratingWidth;
+        qreal m_padding;
+        int m_iconSize;
+        bool m_supportsItemExpanding;
+    };
+
+    QVector<int> unresolvedIndexes(const QVector<std::pair<qreal, bool>>& logicalHeightHints)
+    {
+        QVector<int> indexes;
+        for (int index = 0; index < logicalHeightHints.count(); ++index) {
+            if (logicalHeightHints.at(index).first <= 0.0) {
+                indexes.append(index);
+            }
+        }
+        return indexes;
+    }
+
+    void applyMeasurement(QVector<std::pair<qreal, bool>>& logicalHeightHints,
+                          const QVector<int>& indexes,
+                          QFuture<std::pair<qreal, bool>> future)
+    {
+        future.waitForFinished();
+        for (int i = 0; i < indexes.count(); ++i) {
+            logicalHeightHints[indexes.at(i)] = future.resultAt(i);
+        }
+    }
+}
+
 KStandardItemListWidgetInformant::KStandardItemListWidgetInformant() :
     KItemListWidgetInformant()
 {
@@ -57,6 +274,24 @@ void KStandardItemListWidgetInformant::calculateItemSizeHints(QVector<std::pair<
     }
 }
 
+QFuture<std::pair<qreal, bool>> KStandardItemListWidgetInformant::calculateItemSizeHintsConcurrently(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    switch (static_cast<const KStandardItemListView*>(view)->itemLayout()) {
+    case KStandardItemListView::IconsLayout:
+        return startIconsLayoutMeasurement(indexes, logicalWidthHint, view);
+
+    case KStandardItemListView::CompactLayout:
+        return startCompactLayoutMeasurement(indexes, logicalWidthHint, view);
+
+    default:
+        // All items of the details-layout have the same height, no
+        // text measurement is required.
+        break;
+    }
+
+    return KItemListWidgetInformant::calculateItemSizeHintsConcurrently(indexes, logicalWidthHint, view);
+}
+
 qreal KStandardItemListWidgetInformant::preferredRoleColumnWidth(const QByteArray& role,
                                                                  int index,
                                                                  const KItemListView* view) const
@@ -67,16 +302,14 @@ qreal KStandardItemListWidgetInformant::preferredRoleColumnWidth(const QByteArra
     const QString text = roleText(role, values);
     qreal width = KStandardItemListWidget::columnPadding(option);
 
-    const QFontMetrics& normalFontMetrics = option.fontMetrics;
-    const QFontMetrics linkFontMetrics(customizedFontForLinks(option.font));
-
     if (role == "rating") {
         width += KStandardItemListWidget::preferredRatingSize(option).width();
     } else {
-        // If current item is a link, we use the customized link font metrics instead of the normal font metrics.
-        const QFontMetrics& fontMetrics = itemIsLink(index, view) ? linkFontMetrics : normalFontMetrics;
+        // If current item is a link, we use the customized link font instead of the normal font.
+        const QFont font = itemIsLink(index, view) ? customizedFontForLinks(option.font) : option.font;
+        const QFontMetrics fontMetrics(font);
 
-        width += fontMetrics.horizontalAdvance(text);
+        width += KItemListTextLayoutCache::instance()->horizontalAdvance(text, font);
 
         if (role == "text") {
             if (view->supportsItemExpanding()) {
@@ -94,6 +327,33 @@ qreal KStandardItemListWidgetInformant::preferredRoleColumnWidth(const QByteArra
     return width;
 }
 
+QFuture<QVector<qreal>> KStandardItemListWidgetInformant::preferredRoleColumnWidthsConcurrently(const QList<QByteArray>& roles,
+                                                                                                 const QVector<int>& indexes,
+                                                                                                 const KItemListView* view) const
+{
+    const KItemListStyleOption& option = view->styleOption();
+
+    QVector<ColumnWidthMeasurementInput> inputs;
+    inputs.reserve(indexes.count());
+    for (const int index : indexes) {
+        const QHash<QByteArray, QVariant> values = view->model()->data(index);
+
+        QStringList texts;
+        texts.reserve(roles.count());
+        for (const QByteArray& role : roles) {
+            texts.append(role == "rating" ? QString() : roleText(role, values));
+        }
+
+        inputs.append({texts, itemIsLink(index, view), values.value("expandedParentsCount", 0).toInt()});
+    }
+
+    const ColumnWidthMeasurer measurer(roles, option.font, customizedFontForLinks(option.font), option,
+                                       KStandardItemListWidget::columnPadding(option),
+                                       KStandardItemListWidget::preferredRatingSize(option).width(),
+                                       view->supportsItemExpanding());
+    return QtConcurrent::mapped(inputs, measurer);
+}
+
 QString KStandardItemListWidgetInformant::itemText(int index, const KItemListView* view) const
 {
     return view->model()->data(index).value("text").toString();
@@ -122,9 +382,28 @@ QFont KStandardItemListWidgetInformant::customizedFontForLinks(const QFont& base
 }
 
 void KStandardItemListWidgetInformant::calculateIconsLayoutItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    const QVector<int> indexes = unresolvedIndexes(logicalHeightHints);
+    applyMeasurement(logicalHeightHints, indexes, startIconsLayoutMeasurement(indexes, logicalWidthHint, view));
+}
+
+void KStandardItemListWidgetInformant::calculateCompactLayoutItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    const QVector<int> indexes = unresolvedIndexes(logicalHeightHints);
+    applyMeasurement(logicalHeightHints, indexes, startCompactLayoutMeasurement(indexes, logicalWidthHint, view));
+}
+
+void KStandardItemListWidgetInformant::calculateDetailsLayoutItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    const KItemListStyleOption& option = view->styleOption();
+    const qreal height = option.padding * 2 + qMax(option.iconSize, option.fontMetrics.height());
+    logicalHeightHints.fill(std::make_pair(height, false));
+    logicalWidthHint = -1.0;
+}
+
+QFuture<std::pair<qreal, bool>> KStandardItemListWidgetInformant::startIconsLayoutMeasurement(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const
 {
     const KItemListStyleOption& option = view->styleOption();
-    const QFont& normalFont = option.font;
     const int additionalRolesCount = qMax(view->visibleRoles().count() - 1, 0);
 
     const qreal itemWidth = view->itemSize().width();
@@ -132,106 +411,51 @@ void KStandardItemListWidgetInformant::calculateIconsLayoutItemSizeHints(QVector
     const qreal additionalRolesSpacing = additionalRolesCount * option.fontMetrics.lineSpacing();
     const qreal spacingAndIconHeight = option.iconSize + option.padding * 3;
 
-    const QFont linkFont = customizedFontForLinks(normalFont);
-
-    QTextOption textOption(Qt::AlignHCenter);
-    textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
-
-    for (int index = 0; index < logicalHeightHints.count(); ++index) {
-        if (logicalHeightHints.at(index).first > 0.0) {
-            continue;
-        }
-
-        // If the current item is a link, we use the customized link font instead of the normal font.
-        const QFont& font = itemIsLink(index, view) ? linkFont : normalFont;
-
-        const QString& text = KStringHandler::preProcessWrap(itemText(index, view));
-        
-        // Calculate the number of lines required for wrapping the name
-        qreal textHeight = 0;
-        QTextLayout layout(text, font);
-        layout.setTextOption(textOption);
-        layout.beginLayout();
-        QTextLine line;
-        int lineCount = 0;
-        bool isElided = false;
-        while ((line = layout.createLine()).isValid()) {
-            line.setLineWidth(maxWidth);
-            line.naturalTextWidth();
-            textHeight += line.height();
-
-            ++lineCount;
-            if (lineCount == option.maxTextLines) {
-                isElided = layout.createLine().isValid();
-                break;
-            }
-        }
-        layout.endLayout();
-
-        // Add one line for each additional information
-        textHeight += additionalRolesSpacing;
-
-        logicalHeightHints[index].first = textHeight + spacingAndIconHeight;
-        logicalHeightHints[index].second = isElided;
+    QVector<TextMeasurementInput> inputs;
+    inputs.reserve(indexes.count());
+    for (const int index : indexes) {
+        inputs.append({QStringList(itemText(index, view)), itemIsLink(index, view)});
     }
 
     logicalWidthHint = itemWidth;
+
+    // Add one line for each additional information
+    const IconsLayoutTextMeasurer measurer(option.font, customizedFontForLinks(option.font),
+                                           maxWidth, option.maxTextLines,
+                                           additionalRolesSpacing + spacingAndIconHeight);
+    return QtConcurrent::mapped(inputs, measurer);
 }
 
-void KStandardItemListWidgetInformant::calculateCompactLayoutItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+QFuture<std::pair<qreal, bool>> KStandardItemListWidgetInformant::startCompactLayoutMeasurement(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const
 {
     const KItemListStyleOption& option = view->styleOption();
-    const QFontMetrics& normalFontMetrics = option.fontMetrics;
     const int additionalRolesCount = qMax(view->visibleRoles().count() - 1, 0);
 
     const QList<QByteArray>& visibleRoles = view->visibleRoles();
     const bool showOnlyTextRole = (visibleRoles.count() == 1) && (visibleRoles.first() == "text");
-    const qreal maxWidth = option.maxTextWidth;
     const qreal paddingAndIconWidth = option.padding * 4 + option.iconSize;
-    const qreal height = option.padding * 2 + qMax(option.iconSize, (1 + additionalRolesCount) * normalFontMetrics.lineSpacing());
-
-    const QFontMetrics linkFontMetrics(customizedFontForLinks(option.font));
-
-    for (int index = 0; index < logicalHeightHints.count(); ++index) {
-        if (logicalHeightHints.at(index).first > 0.0) {
-            continue;
-        }
-
-        // If the current item is a link, we use the customized link font metrics instead of the normal font metrics.
-        const QFontMetrics& fontMetrics = itemIsLink(index, view) ? linkFontMetrics : normalFontMetrics;
-
-        // For each row exactly one role is shown. Calculate the maximum required width that is necessary
-        // to show all roles without horizontal clipping.
-        qreal maximumRequiredWidth = 0.0;
+    const qreal height = option.padding * 2 + qMax(option.iconSize, (1 + additionalRolesCount) * option.fontMetrics.lineSpacing());
 
+    QVector<TextMeasurementInput> inputs;
+    inputs.reserve(indexes.count());
+    for (const int index : indexes) {
+        QStringList texts;
         if (showOnlyTextRole) {
-            maximumRequiredWidth = fontMetrics.horizontalAdvance(itemText(index, view));
+            texts.append(itemText(index, view));
         } else {
             const QHash<QByteArray, QVariant>& values = view->model()->data(index);
             for (const QByteArray& role : visibleRoles) {
-                const QString& text = roleText(role, values);
-                const qreal requiredWidth = fontMetrics.horizontalAdvance(text);
-                maximumRequiredWidth = qMax(maximumRequiredWidth, requiredWidth);
+                texts.append(roleText(role, values));
             }
         }
-
-        qreal width = paddingAndIconWidth + maximumRequiredWidth;
-        if (maxWidth > 0 && width > maxWidth) {
-            width = maxWidth;
-        }
-
-        logicalHeightHints[index].first = width;
+        inputs.append({texts, itemIsLink(index, view)});
     }
 
     logicalWidthHint = height;
-}
 
-void KStandardItemListWidgetInformant::calculateDetailsLayoutItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
-{
-    const KItemListStyleOption& option = view->styleOption();
-    const qreal height = option.padding * 2 + qMax(option.iconSize, option.fontMetrics.height());
-    logicalHeightHints.fill(std::make_pair(height, false));
-    logicalWidthHint = -1.0;
+    const CompactLayoutTextMeasurer measurer(option.font, customizedFontForLinks(option.font),
+                                             option.maxTextWidth, paddingAndIconWidth);
+    return QtConcurrent::mapped(inputs, measurer);
 }
 
 KStandardItemListWidget::KStandardItemListWidget(KItemListWidgetInformant* informant, QGraphicsItem* parent) :
@@ -261,7 +485,11 @@ KStandardItemListWidget::KStandardItemListWidget(KItemListWidgetInformant* infor
     m_overlay(),
     m_rating(),
     m_roleEditor(nullptr),
-    m_oldRoleEditor(nullptr)
+    m_oldRoleEditor(nullptr),
+    m_renderCacheEnabled(false),
+    m_renderCacheDirty(true),
+    m_renderCache(),
+    m_renderCacheState()
 {
 }
 
@@ -320,7 +548,52 @@ bool KStandardItemListWidget::supportsItemExpanding() const
     return m_supportsItemExpanding;
 }
 
+void KStandardItemListWidget::setRenderCacheEnabled(bool enabled)
+{
+    if (m_renderCacheEnabled != enabled) {
+        m_renderCacheEnabled = enabled;
+        m_renderCache = QPixmap();
+        m_renderCacheDirty = true;
+        update();
+    }
+}
+
+bool KStandardItemListWidget::renderCacheEnabled() const
+{
+    return m_renderCacheEnabled;
+}
+
 void KStandardItemListWidget::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    // Don't use the render cache during a hover animation, as each
+    // animation step would require rendering the item again.
+    const bool hoverAnimationRunning = hoverOpacity() > 0.0 && hoverOpacity() < 1.0;
+    if (!m_renderCacheEnabled || hoverAnimationRunning || index() < 0) {
+        m_renderCache = QPixmap();
+        paintItem(painter, option, widget);
+        return;
+    }
+
+    const qreal dpr = painter->device() ? painter->device()->devicePixelRatioF() : qApp->devicePixelRatio();
+    const RenderCacheState state = renderCacheState(dpr);
+
+    if (m_renderCacheDirty || m_dirtyContent || m_dirtyLayout || m_renderCache.isNull() || state != m_renderCacheState) {
+        m_renderCache = QPixmap((size() * dpr).toSize());
+        m_renderCache.setDevicePixelRatio(dpr);
+        m_renderCache.fill(Qt::transparent);
+
+        QPainter cachePainter(&m_renderCache);
+        cachePainter.setRenderHints(painter->renderHints());
+        paintItem(&cachePainter, option, widget);
+
+        m_renderCacheState = state;
+        m_renderCacheDirty = false;
+    }
+
+    painter->drawPixmap(0, 0, m_renderCache);
+}
+
+void KStandardItemListWidget::paintItem(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
     const_cast<KStandardItemListWidget*>(this)->triggerCacheRefreshing();
 
@@ -944,6 +1217,40 @@ void KStandardItemListWidget::triggerCacheRefreshing()
     m_dirtyLayout = false;
     m_dirtyContent = false;
     m_dirtyContentRoles.clear();
+    m_renderCacheDirty = true;
+}
+
+bool KStandardItemListWidget::RenderCacheState::operator==(const RenderCacheState& other) const
+{
+    return size == other.size
+           && devicePixelRatio == other.devicePixelRatio
+           && hoverOpacity == other.hoverOpacity
+           && selected == other.selected
+           && current == other.current
+           && expansionAreaHovered == other.expansionAreaHovered
+           && alternateBackground == other.alternateBackground
+           && activeWindow == other.activeWindow
+           && editing == other.editing;
+}
+
+bool KStandardItemListWidget::RenderCacheState::operator!=(const RenderCacheState& other) const
+{
+    return !(*this == other);
+}
+
+KStandardItemListWidget::RenderCacheState KStandardItemListWidget::renderCacheState(qreal devicePixelRatio) const
+{
+    RenderCacheState state;
+    state.size = size();
+    state.devicePixelRatio = devicePixelRatio;
+    state.hoverOpacity = hoverOpacity();
+    state.selected = isSelected();
+    state.current = isCurrent();
+    state.expansionAreaHovered = expansionAreaHovered();
+    state.alternateBackground = alternateBackground();
+    state.activeWindow = isActiveWindow();
+    state.editing = !editedRole().isEmpty();
+    return state;
 }
 
 void KStandardItemListWidget::updateExpansionArea()
@@ -1184,26 +1491,6 @@ void KStandardItemListWidget::updateTextsCache()
     }
 }
 
-QString KStandardItemListWidget::elideRightKeepExtension(const QString &text, int elidingWidth) const
-{
-    const auto extensionIndex = text.lastIndexOf('.');
-    if (extensionIndex != -1) {
-        // has file extension
-        const auto extensionLength = text.length() - extensionIndex;
-        const auto extensionWidth = m_customizedFontMetrics.horizontalAdvance(text.right(extensionLength));
-        if (elidingWidth > extensionWidth && extensionLength < 6 && (float(extensionWidth) / float(elidingWidth)) < 0.3) {
-            // if we have room to display the file extension and the extension is not too long
-            QString ret = m_customizedFontMetrics.elidedText(text.chopped(extensionLength),
-                                                             Qt::ElideRight,
-                                                             elidingWidth - extensionWidth);
-            ret.append(text.rightRef(extensionLength));
-            return ret;
-        }
-    }
-    return m_customizedFontMetrics.elidedText(text,Qt::ElideRight,
-                                              elidingWidth);
-}
-
 void KStandardItemListWidget::updateIconsLayoutTextCache()
 {
     //      +------+
@@ -1227,51 +1514,14 @@ void KStandardItemListWidget::updateIconsLayoutTextCache()
     // for initializing the position of the other roles.
     TextInfo* nameTextInfo = m_textInfo.value("text");
     const QString nameText = KStringHandler::preProcessWrap(values["text"].toString());
-    nameTextInfo->staticText.setText(nameText);
-
-    // Calculate the number of lines required for the name and the required width
-    qreal nameWidth = 0;
-    qreal nameHeight = 0;
-    QTextLine line;
-
-    QTextLayout layout(nameTextInfo->staticText.text(), m_customizedFont);
-    layout.setTextOption(nameTextInfo->staticText.textOption());
-    layout.beginLayout();
-    int nameLineIndex = 0;
-    while ((line = layout.createLine()).isValid()) {
-        line.setLineWidth(maxWidth);
-        nameWidth = qMax(nameWidth, line.naturalTextWidth());
-        nameHeight += line.height();
-
-        ++nameLineIndex;
-        if (nameLineIndex == option.maxTextLines) {
-            // The maximum number of textlines has been reached. If this is
-            // the case provide an elided text if necessary.
-            const int textLength = line.textStart() + line.textLength();
-            if (textLength < nameText.length()) {
-                // Elide the last line of the text
-                qreal elidingWidth = maxWidth;
-                qreal lastLineWidth;
-                do {
-                    QString lastTextLine = nameText.mid(line.textStart());
-                    lastTextLine = elideRightKeepExtension(lastTextLine, elidingWidth);
-                    const QString elidedText = nameText.left(line.textStart()) + lastTextLine;
-                    nameTextInfo->staticText.setText(elidedText);
-
-                    lastLineWidth = m_customizedFontMetrics.horizontalAdvance(lastTextLine);
-
-                    // We do the text eliding in a loop with decreasing width (1 px / iteration)
-                    // to avoid problems related to different width calculation code paths
-                    // within Qt. (see bug 337104)
-                    elidingWidth -= 1.0;
-                } while (lastLineWidth > maxWidth);
-
-                nameWidth = qMax(nameWidth, lastLineWidth);
-            }
-            break;
-        }
-    }
-    layout.endLayout();
+
+    // Calculate the number of lines required for the name and the required width.
+    // If the maximum number of lines is exceeded, the layout provides an elided text.
+    const KItemListTextLayoutCache::Layout nameLayout =
+        KItemListTextLayoutCache::instance()->wrappedText(nameText, m_customizedFont, maxWidth, option.maxTextLines);
+    nameTextInfo->staticText.setText(nameLayout.text);
+    const qreal nameWidth = nameLayout.width;
+    const qreal nameHeight = nameLayout.height;
 
     // Use one line for each additional information
     nameTextInfo->staticText.setTextWidth(maxWidth);
@@ -1292,28 +1542,15 @@ void KStandardItemListWidget::updateIconsLayoutTextCache()
         TextInfo* textInfo = m_textInfo.value(role);
         textInfo->staticText.setText(text);
 
-        qreal requiredWidth = 0;
-
-        QTextLayout layout(text, m_customizedFont);
-        QTextOption textOption;
-        textOption.setWrapMode(QTextOption::NoWrap);
-        layout.setTextOption(textOption);
-
-        layout.beginLayout();
-        QTextLine textLine = layout.createLine();
-        if (textLine.isValid()) {
-            textLine.setLineWidth(maxWidth);
-            requiredWidth = textLine.naturalTextWidth();
-            if (requiredWidth > maxWidth) {
-                const QString elidedText = elideRightKeepExtension(text, maxWidth);
-                textInfo->staticText.setText(elidedText);
-                requiredWidth = m_customizedFontMetrics.horizontalAdvance(elidedText);
-            } else if (role == "rating") {
-                // Use the width of the rating pixmap, because the rating text is empty.
-                requiredWidth = m_rating.width();
-            }
+        const KItemListTextLayoutCache::Layout layout =
+            KItemListTextLayoutCache::instance()->singleLineText(text, m_customizedFont, maxWidth);
+        qreal requiredWidth = layout.width;
+        if (layout.isElided) {
+            textInfo->staticText.setText(layout.text);
+        } else if (role == "rating") {
+            // Use the width of the rating pixmap, because the rating text is empty.
+            requiredWidth = m_rating.width();
         }
-        layout.endLayout();
 
         textInfo->pos = QPointF(padding, y);
         textInfo->staticText.setTextWidth(maxWidth);
@@ -1350,11 +1587,12 @@ void KStandardItemListWidget::updateCompactLayoutTextCache()
         TextInfo* textInfo = m_textInfo.value(role);
         textInfo->staticText.setText(text);
 
-        qreal requiredWidth = m_customizedFontMetrics.horizontalAdvance(text);
-        if (requiredWidth > maxWidth) {
+        const KItemListTextLayoutCache::Layout layout =
+            KItemListTextLayoutCache::instance()->singleLineText(text, m_customizedFont, maxWidth);
+        qreal requiredWidth = layout.width;
+        if (layout.isElided) {
             requiredWidth = maxWidth;
-            const QString elidedText = elideRightKeepExtension(text, maxWidth);
-            textInfo->staticText.setText(elidedText);
+            textInfo->staticText.setText(layout.text);
         }
 
         textInfo->pos = QPointF(x, y);
@@ -1398,8 +1636,6 @@ void KStandardItemListWidget::updateDetailsLayoutTextCache()
     for (const QByteArray& role : qAsConst(m_sortedVisibleRoles)) {
         QString text = roleText(role, values);
 
-        // Elide the text in case it does not fit into the available column-width
-        qreal requiredWidth = m_customizedFontMetrics.horizontalAdvance(text);
         const qreal roleWidth = columnWidth(role);
         qreal availableTextWidth = roleWidth - columnWidthInc;
 
@@ -1408,10 +1644,11 @@ void KStandardItemListWidget::updateDetailsLayoutTextCache()
             availableTextWidth -= firstColumnInc - leadingPadding();
         }
 
-        if (requiredWidth > availableTextWidth) {
-            text = elideRightKeepExtension(text, availableTextWidth);
-            requiredWidth = m_customizedFontMetrics.horizontalAdvance(text);
-        }
+        // Elide the text in case it does not fit into the available column-width
+        const KItemListTextLayoutCache::Layout layout =
+            KItemListTextLayoutCache::instance()->singleLineText(text, m_customizedFont, availableTextWidth);
+        text = layout.text;
+        const qreal requiredWidth = layout.width;
 
         TextInfo* textInfo = m_textInfo.value(role);
         textInfo->staticText.setText(text);
@@ -1549,60 +1786,9 @@ void KStandardItemListWidget::closeRoleEditor()
 
 QPixmap KStandardItemListWidget::pixmapForIcon(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode)
 {
-    static const QIcon fallbackIcon = QIcon::fromTheme(QStringLiteral("unknown"));
-
     size *= qApp->devicePixelRatio();
 
-    const QString key = "KStandardItemListWidget:" % name % ":" % overlays.join(QLatin1Char(':')) % ":" % QString::number(size) % ":" % QString::number(mode);
-    QPixmap pixmap;
-
-    if (!QPixmapCache::find(key, &pixmap)) {
-        QIcon icon = QIcon::fromTheme(name);
-        if (icon.isNull()) {
-            icon = QIcon(name);
-        }
-        if (icon.isNull()
-            || icon.pixmap(size / qApp->devicePixelRatio(), size / qApp->devicePixelRatio(), mode).isNull()) {
-            icon = fallbackIcon;
-        }
-
-        pixmap = icon.pixmap(size / qApp->devicePixelRatio(), size / qApp->devicePixelRatio(), mode);
-        if (pixmap.width() != size || pixmap.height() != size) {
-            KPixmapModifier::scale(pixmap, QSize(size, size));
-        }
-
-        // Strangely KFileItem::overlays() returns empty string-values, so
-        // we need to check first whether an overlay must be drawn at all.
-        // It is more efficient to do it here, as KIconLoader::drawOverlays()
-        // assumes that an overlay will be drawn and has some additional
-        // setup time.
-        for (const QString& overlay : overlays) {
-            if (!overlay.isEmpty()) {
-                int state = KIconLoader::DefaultState;
-
-                switch (mode) {
-                case QIcon::Normal:
-                    break;
-                case QIcon::Active:
-                    state = KIconLoader::ActiveState;
-                    break;
-                case QIcon::Disabled:
-                    state = KIconLoader::DisabledState;
-                    break;
-                case QIcon::Selected:
-                    state = KIconLoader::SelectedState;
-                    break;
-                }
-
-                // There is at least one overlay, draw all overlays above m_pixmap
-                // and cancel the check
-                KIconLoader::global()->drawOverlays(overlays, pixmap, KIconLoader::Desktop, state);
-                break;
-            }
-        }
-
-        QPixmapCache::insert(key, pixmap);
-    }
+    QPixmap pixmap = KItemListIconCache::instance()->pixmap(name, overlays, size, mode);
     pixmap.setDevicePixelRatio(qApp->devicePixelRatio());
 
     return pixmap;
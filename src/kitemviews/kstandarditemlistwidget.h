@@ -26,10 +26,16 @@ public:
     
     void calculateItemSizeHints(QVector<std::pair<qreal /* height */, bool /* isElided */>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const override;
 
+    QFuture<std::pair<qreal, bool>> calculateItemSizeHintsConcurrently(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const override;
+
     qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
                                            const KItemListView* view) const override;
 
+    QFuture<QVector<qreal>> preferredRoleColumnWidthsConcurrently(const QList<QByteArray>& roles,
+                                                                  const QVector<int>& indexes,
+                                                                  const KItemListView* view) const override;
+
 protected:
     /**
      * @return The value of the "text" role. The default implementation returns
@@ -64,6 +70,14 @@ protected:
     void calculateCompactLayoutItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
     void calculateDetailsLayoutItemSizeHints(QVector<std::pair<qreal, bool>>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
 
+    /**
+     * Starts measuring the texts of the items \a indexes for the icons- or compact-layout.
+     * Only the texts are read from the model synchronously, the text layouting is done on
+     * worker threads using per-thread font instances.
+     */
+    QFuture<std::pair<qreal, bool>> startIconsLayoutMeasurement(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const;
+    QFuture<std::pair<qreal, bool>> startCompactLayoutMeasurement(const QVector<int>& indexes, qreal& logicalWidthHint, const KItemListView* view) const;
+
     friend class KStandardItemListWidget; // Accesses roleText()
 };
 
@@ -94,6 +108,16 @@ public:
     void setSupportsItemExpanding(bool supportsItemExpanding);
     bool supportsItemExpanding() const;
 
+    /**
+     * If set to true, the item is rendered into a pixmap that is reused for
+     * all following repaints until the content, the layout or the visual state
+     * of the item changes. This speeds up repainting (e.g. during smooth
+     * scrolling) if the painting is expensive, like for software rendering.
+     * Per default the render cache is disabled.
+     */
+    void setRenderCacheEnabled(bool enabled);
+    bool renderCacheEnabled() const;
+
     void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
 
     QRectF iconRect() const override;
@@ -198,6 +222,33 @@ private Q_SLOTS:
     void slotRoleEditingFinished(const QByteArray& role, const QVariant& value);
 
 private:
+    /**
+     * State of the item that has an influence on the rendering, but
+     * is not covered by m_dirtyContent and m_dirtyLayout.
+     */
+    struct RenderCacheState
+    {
+        QSizeF size;
+        qreal devicePixelRatio;
+        qreal hoverOpacity;
+        bool selected;
+        bool current;
+        bool expansionAreaHovered;
+        bool alternateBackground;
+        bool activeWindow;
+        bool editing;
+
+        bool operator==(const RenderCacheState& other) const;
+        bool operator!=(const RenderCacheState& other) const;
+    };
+
+    RenderCacheState renderCacheState(qreal devicePixelRatio) const;
+
+    /**
+     * Paints the item without using the render cache.
+     */
+    void paintItem(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+
     void triggerCacheRefreshing();
     void updateExpansionArea();
     void updatePixmapCache();
@@ -214,8 +265,6 @@ private:
 
     QRectF roleEditingRect(const QByteArray &role) const;
 
-    QString elideRightKeepExtension(const QString &text, int elidingWidth) const;
-
     /**
      * Closes the role editor and returns the focus back
      * to the KItemListContainer.
@@ -277,6 +326,11 @@ private:
     KItemListRoleEditor* m_roleEditor;
     KItemListRoleEditor* m_oldRoleEditor;
 
+    bool m_renderCacheEnabled;
+    bool m_renderCacheDirty;
+    QPixmap m_renderCache;
+    RenderCacheState m_renderCacheState;
+
     friend class KStandardItemListWidgetInformant; // Accesses private static methods to be able to
                                                    // share a common layout calculation
 };
@@ -0,0 +1,337 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kdirectorysizecounter.h"
+
+#include <QByteArrayList>
+#include <QFile>
+#include <QRunnable>
+#include <QUrl>
+
+#ifndef Q_OS_WIN
+#include <qplatformdefs.h>
+#endif
+
+namespace {
+    // Maximum number of directories that are walked at the same time
+    const int MaxWalkerCount = 2;
+
+    // Interval in milliseconds for announcing partial sizes
+    const int ProgressInterval = 250;
+
+    // Time in milliseconds a cached size is used
+    const int CacheLifetime = 30000;
+
+    // Maximum number of cached sizes
+    const int MaxCacheEntryCount = 5000;
+
+    // Subdirectories with less entries are not cached, as walking
+    // them again is cheaper than filling the cache with them
+    const int MinCachedEntryCount = 1000;
+}
+
+class KDirectorySizeCounterSingleton
+{
+public:
+    KDirectorySizeCounter instance;
+};
+Q_GLOBAL_STATIC(KDirectorySizeCounterSingleton, s_KDirectorySizeCounter)
+
+/**
+ * Walks a directory in a thread of the pool of KDirectorySizeCounter.
+ */
+class DirectorySizeWalker : public QRunnable
+{
+public:
+    DirectorySizeWalker(KDirectorySizeCounter* counter,
+                        const QString& path,
+                        const QSharedPointer<KDirectorySizeCounter::Task>& task);
+
+    void run() override;
+
+private:
+    /**
+     * Adds the sizes of the files inside \a path and its subdirectories
+     * to m_size and the number of entries to \a entryCount.
+     * @return False if the calculation has been canceled.
+     */
+    bool walk(const QByteArray& path, int& entryCount);
+
+    void reportProgress();
+
+private:
+    KDirectorySizeCounter* m_counter;
+    QString m_path;
+    QSharedPointer<KDirectorySizeCounter::Task> m_task;
+    int m_generation;
+    KIO::filesize_t m_size;
+    QElapsedTimer m_progressTimer;
+};
+
+DirectorySizeWalker::DirectorySizeWalker(KDirectorySizeCounter* counter,
+                                         const QString& path,
+                                         const QSharedPointer<KDirectorySizeCounter::Task>& task) :
+    m_counter(counter),
+    m_path(path),
+    m_task(task),
+    m_generation(0),
+    m_size(0),
+    m_progressTimer()
+{
+}
+
+void DirectorySizeWalker::run()
+{
+    // Sizes that are calculated while the directory gets invalidated
+    // might be outdated and must not be cached
+    m_generation = m_counter->generation();
+    m_progressTimer.start();
+
+    int entryCount = 0;
+    if (!walk(QFile::encodeName(m_path), entryCount)) {
+        return;
+    }
+
+    m_counter->cacheSize(m_path, m_size, m_generation);
+
+    KDirectorySizeCounter* counter = m_counter;
+    const QString path = m_path;
+    const QSharedPointer<KDirectorySizeCounter::Task> task = m_task;
+    const KIO::filesize_t size = m_size;
+    QMetaObject::invokeMethod(counter, [counter, path, task, size]() {
+        counter->updateTask(path, task, size, true);
+    }, Qt::QueuedConnection);
+}
+
+bool DirectorySizeWalker::walk(const QByteArray& path, int& entryCount)
+{
+#ifndef Q_OS_WIN
+    auto dir = QT_OPENDIR(path.constData());
+    if (!dir) {
+        // Unreadable directories don't contribute to the size
+        return true;
+    }
+
+    const QByteArray prefix = (path == "/") ? path : path + '/';
+    QByteArrayList subDirectories;
+    QT_DIRENT* dirEntry = nullptr;
+    QT_STATBUF buf;
+
+    // Sum up the files first and close the directory before entering the
+    // subdirectories. This keeps the number of open directories small and
+    // lets the announced partial sizes grow continuously.
+    while ((dirEntry = QT_READDIR(dir))) {
+        if (m_task->canceled.loadRelaxed()) {
+            QT_CLOSEDIR(dir);
+            return false;
+        }
+
+        const char* name = dirEntry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            // Skip "." and ".."
+            continue;
+        }
+        ++entryCount;
+
+        const QByteArray entryPath = prefix + name;
+        bool isDirectory = (dirEntry->d_type == DT_DIR);
+        if (dirEntry->d_type == DT_UNKNOWN && QT_LSTAT(entryPath.constData(), &buf) == 0) {
+            isDirectory = S_ISDIR(buf.st_mode);
+        }
+
+        if (isDirectory) {
+            subDirectories.append(entryPath);
+        } else if (QT_STAT(entryPath.constData(), &buf) == 0 && !S_ISDIR(buf.st_mode)) {
+            // Like KIO, the size of the target is used for links. Links to
+            // directories are not entered to prevent endless recursions.
+            m_size += buf.st_size;
+        }
+    }
+    QT_CLOSEDIR(dir);
+
+    for (const QByteArray& subDirectory : qAsConst(subDirectories)) {
+        reportProgress();
+
+        const QString subDirectoryPath = QFile::decodeName(subDirectory);
+        KIO::filesize_t cachedSize = 0;
+        if (m_counter->cachedSize(subDirectoryPath, cachedSize)) {
+            m_size += cachedSize;
+            continue;
+        }
+
+        const KIO::filesize_t previousSize = m_size;
+        int subEntryCount = 0;
+        if (!walk(subDirectory, subEntryCount)) {
+            return false;
+        }
+        entryCount += subEntryCount;
+
+        if (subEntryCount >= MinCachedEntryCount) {
+            m_counter->cacheSize(subDirectoryPath, m_size - previousSize, m_generation);
+        }
+    }
+#else
+    Q_UNUSED(path)
+    Q_UNUSED(entryCount)
+#endif
+    return true;
+}
+
+void DirectorySizeWalker::reportProgress()
+{
+    if (m_progressTimer.elapsed() < ProgressInterval) {
+        return;
+    }
+    m_progressTimer.start();
+
+    KDirectorySizeCounter* counter = m_counter;
+    const QString path = m_path;
+    const QSharedPointer<KDirectorySizeCounter::Task> task = m_task;
+    const KIO::filesize_t size = m_size;
+    QMetaObject::invokeMethod(counter, [counter, path, task, size]() {
+        counter->updateTask(path, task, size, false);
+    }, Qt::QueuedConnection);
+}
+
+KDirectorySizeCounter* KDirectorySizeCounter::instance()
+{
+    return &s_KDirectorySizeCounter->instance;
+}
+
+bool KDirectorySizeCounter::isSupported(const QUrl& url)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(url)
+    return false;
+#else
+    return url.isLocalFile();
+#endif
+}
+
+bool KDirectorySizeCounter::request(const QString& path, KIO::filesize_t& size)
+{
+    if (cachedSize(path, size)) {
+        return true;
+    }
+
+    QSharedPointer<Task> task = m_tasks.value(path);
+    if (!task) {
+        task = QSharedPointer<Task>::create();
+        m_tasks.insert(path, task);
+        m_threadPool.start(new DirectorySizeWalker(this, path, task));
+    }
+    ++task->requestCount;
+
+    return false;
+}
+
+void KDirectorySizeCounter::cancel(const QString& path)
+{
+    auto it = m_tasks.find(path);
+    if (it == m_tasks.end()) {
+        return;
+    }
+
+    const QSharedPointer<Task> task = it.value();
+    --task->requestCount;
+    if (task->requestCount <= 0) {
+        task->canceled.storeRelaxed(1);
+        m_tasks.erase(it);
+    }
+}
+
+void KDirectorySizeCounter::invalidate(const QString& path)
+{
+    QMutexLocker locker(&m_cacheMutex);
+    ++m_generation;
+
+    // The sizes of the parent directories contain the size of the directory
+    QString parentPath = path;
+    while (!parentPath.isEmpty()) {
+        m_cache.remove(parentPath);
+        if (parentPath == QLatin1String("/")) {
+            break;
+        }
+        const int index = parentPath.lastIndexOf(QLatin1Char('/'));
+        parentPath = (index > 0) ? parentPath.left(index) : QStringLiteral("/");
+    }
+
+    const QString prefix = path.endsWith(QLatin1Char('/')) ? path : path + QLatin1Char('/');
+    const QList<QString> keys = m_cache.keys();
+    for (const QString& key : keys) {
+        if (key.startsWith(prefix)) {
+            m_cache.remove(key);
+        }
+    }
+}
+
+KDirectorySizeCounter::~KDirectorySizeCounter()
+{
+    for (const QSharedPointer<Task>& task : qAsConst(m_tasks)) {
+        task->canceled.storeRelaxed(1);
+    }
+    m_threadPool.waitForDone();
+}
+
+KDirectorySizeCounter::KDirectorySizeCounter() :
+    QObject(),
+    m_tasks(),
+    m_cacheMutex(),
+    m_cache(MaxCacheEntryCount),
+    m_generation(0),
+    m_threadPool()
+{
+    m_threadPool.setMaxThreadCount(MaxWalkerCount);
+}
+
+void KDirectorySizeCounter::updateTask(const QString& path, const QSharedPointer<Task>& task, KIO::filesize_t size, bool finished)
+{
+    if (m_tasks.value(path) != task) {
+        // The task has been canceled in the meantime
+        return;
+    }
+
+    if (finished) {
+        m_tasks.remove(path);
+    }
+    Q_EMIT sizeChanged(path, size, finished);
+}
+
+bool KDirectorySizeCounter::cachedSize(const QString& path, KIO::filesize_t& size)
+{
+    QMutexLocker locker(&m_cacheMutex);
+    const CacheEntry* entry = m_cache.object(path);
+    if (!entry) {
+        return false;
+    }
+
+    if (entry->age.elapsed() > CacheLifetime) {
+        m_cache.remove(path);
+        return false;
+    }
+
+    size = entry->size;
+    return true;
+}
+
+void KDirectorySizeCounter::cacheSize(const QString& path, KIO::filesize_t size, int generation)
+{
+    QMutexLocker locker(&m_cacheMutex);
+    if (generation != m_generation) {
+        return;
+    }
+
+    CacheEntry* entry = new CacheEntry;
+    entry->size = size;
+    entry->age.start();
+    m_cache.insert(path, entry);
+}
+
+int KDirectorySizeCounter::generation()
+{
+    QMutexLocker locker(&m_cacheMutex);
+    return m_generation;
+}
@@ -0,0 +1,126 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KDIRECTORYSIZECOUNTER_H
+#define KDIRECTORYSIZECOUNTER_H
+
+#include "dolphin_export.h"
+
+#include <KIO/Global>
+
+#include <QAtomicInt>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+class QUrl;
+
+/**
+ * @brief Calculates the recursive size of local directories.
+ *
+ * The size of a directory is the sum of the sizes of all files inside the
+ * directory and its subdirectories. The directories are walked in-process
+ * by a small thread pool, which is shared by all views and panels:
+ *
+ * - Several requests for the same directory share one calculation.
+ * - Partial sizes are announced periodically while a directory is walked.
+ * - The sizes of the requested directories and of big subdirectories are
+ *   cached for a while. Walking a directory reuses the cached sizes of its
+ *   subdirectories, so navigating inside a big tree does not walk it again.
+ *
+ * The counter may only be used from the GUI thread.
+ */
+class DOLPHIN_EXPORT KDirectorySizeCounter : public QObject
+{
+    Q_OBJECT
+
+public:
+    static KDirectorySizeCounter* instance();
+
+    /**
+     * @return True if the size of the directory \a url can be calculated
+     *         by the counter. Otherwise KIO::StatRecursiveSize must be used.
+     */
+    static bool isSupported(const QUrl& url);
+
+    /**
+     * Requests the size of the directory \a path, which must be given like
+     * QUrl::toLocalFile() returns it for an URL without trailing slash.
+     * Each request must either be finished, which is announced by
+     * sizeChanged(), or be canceled by cancel().
+     *
+     * @return True if the size is cached. In this case \a size is set to
+     *         the cached size and no request is started.
+     */
+    bool request(const QString& path, KIO::filesize_t& size);
+
+    /**
+     * Cancels a request for the directory \a path. The calculation is
+     * stopped when all requests for the directory have been canceled.
+     */
+    void cancel(const QString& path);
+
+    /**
+     * Removes the cached sizes of \a path, its parent directories and its
+     * subdirectories. Must be invoked if the contents of \a path have been
+     * changed.
+     */
+    void invalidate(const QString& path);
+
+Q_SIGNALS:
+    /**
+     * Is emitted periodically while the directory \a path is walked and
+     * with \a finished set to true when the calculation is finished.
+     */
+    void sizeChanged(const QString& path, KIO::filesize_t size, bool finished);
+
+protected:
+    ~KDirectorySizeCounter() override;
+
+private:
+    KDirectorySizeCounter();
+
+    struct Task
+    {
+        QAtomicInt canceled;
+        int requestCount = 0;
+    };
+
+    struct CacheEntry
+    {
+        KIO::filesize_t size;
+        QElapsedTimer age;
+    };
+
+    void updateTask(const QString& path, const QSharedPointer<Task>& task, KIO::filesize_t size, bool finished);
+
+    /**
+     * Thread-safe access to the cache for the walkers.
+     */
+    bool cachedSize(const QString& path, KIO::filesize_t& size);
+    void cacheSize(const QString& path, KIO::filesize_t size, int generation);
+    int generation();
+
+private:
+    QHash<QString, QSharedPointer<Task>> m_tasks;
+
+    QMutex m_cacheMutex;
+    QCache<QString, CacheEntry> m_cache;
+    int m_generation;
+
+    // Must be the last member, so that the running walkers are finished
+    // before the cache gets destroyed.
+    QThreadPool m_threadPool;
+
+    friend class KDirectorySizeCounterSingleton;
+    friend class DirectorySizeWalker;
+};
+
+#endif
@@ -6,6 +6,8 @@
 
 #include "kfileitemclipboard.h"
 
+#include "kfileitemmimedata.h"
+
 #include <KUrlMimeData>
 
 #include <QApplication>
@@ -54,7 +56,10 @@ void KFileItemClipboard::updateCutItems()
     const QByteArray data = mimeData->data(QStringLiteral("application/x-kde-cutselection"));
     const bool isCutSelection = (!data.isEmpty() && data.at(0) == QLatin1Char('1'));
     if (isCutSelection) {
-        const auto urlsFromMimeData = KUrlMimeData::urlsFromMimeData(mimeData);
+        // Items that have been cut in Dolphin itself don't need to be deserialized
+        const auto fileItemMimeData = qobject_cast<const KFileItemMimeData*>(mimeData);
+        const auto urlsFromMimeData = fileItemMimeData ? fileItemMimeData->itemUrls()
+                                                       : KUrlMimeData::urlsFromMimeData(mimeData);
         m_cutItems = QSet<QUrl>(urlsFromMimeData.constBegin(), urlsFromMimeData.constEnd());
     } else {
         m_cutItems.clear();
@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemmimedata.h"
+
+#include <KUrlMimeData>
+
+KFileItemMimeData::KFileItemMimeData(const KFileItemList& items) :
+    QMimeData(),
+    m_items(items),
+    m_urlsSerialized(false)
+{
+}
+
+KFileItemMimeData::~KFileItemMimeData()
+{
+}
+
+QList<QUrl> KFileItemMimeData::itemUrls() const
+{
+    return m_items.urlList();
+}
+
+QStringList KFileItemMimeData::formats() const
+{
+    QStringList formats = QMimeData::formats();
+    if (!m_urlsSerialized) {
+        const QStringList urlFormats = KUrlMimeData::mimeDataTypes();
+        for (const QString& format : urlFormats) {
+            if (!formats.contains(format)) {
+                formats.append(format);
+            }
+        }
+    }
+    return formats;
+}
+
+bool KFileItemMimeData::hasFormat(const QString& mimeType) const
+{
+    return formats().contains(mimeType);
+}
+
+QVariant KFileItemMimeData::retrieveData(const QString& mimeType, QVariant::Type type) const
+{
+    // Data that has been set explicitly, like the cut-selection flag, is
+    // available without serializing the URLs. Any other format might be
+    // derived from the URLs by QMimeData (e.g. text/plain).
+    if (!m_urlsSerialized && !QMimeData::formats().contains(mimeType)) {
+        const_cast<KFileItemMimeData*>(this)->serializeUrls();
+    }
+    return QMimeData::retrieveData(mimeType, type);
+}
+
+void KFileItemMimeData::serializeUrls()
+{
+    m_urlsSerialized = true;
+
+    QList<QUrl> urls;
+    QList<QUrl> mostLocalUrls;
+    urls.reserve(m_items.count());
+    mostLocalUrls.reserve(m_items.count());
+    for (const KFileItem& item : qAsConst(m_items)) {
+        urls << item.url();
+
+        bool isLocal;
+        mostLocalUrls << item.mostLocalUrl(&isLocal);
+    }
+
+    KUrlMimeData::setUrls(urls, mostLocalUrls, this);
+}
@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMMIMEDATA_H
+#define KFILEITEMMIMEDATA_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QMimeData>
+
+/**
+ * @brief MIME data for dragging or copying file items.
+ *
+ * The URLs of the items are only serialized when a format that contains
+ * them is requested the first time, e.g. by the drop target. Hence starting
+ * to drag or copying a huge number of items does not block. The serialized
+ * data is kept for further requests.
+ *
+ * Like KUrlMimeData::setUrls(), the most local URLs are provided as
+ * text/uri-list and the real KIO URLs as KDE-specific format.
+ */
+class DOLPHIN_EXPORT KFileItemMimeData : public QMimeData
+{
+    Q_OBJECT
+
+public:
+    explicit KFileItemMimeData(const KFileItemList& items);
+    ~KFileItemMimeData() override;
+
+    /**
+     * @return URLs of the items. Other than KUrlMimeData::urlsFromMimeData()
+     *         this does not require to serialize the URLs.
+     */
+    QList<QUrl> itemUrls() const;
+
+    QStringList formats() const override;
+    bool hasFormat(const QString& mimeType) const override;
+
+protected:
+    QVariant retrieveData(const QString& mimeType, QVariant::Type type) const override;
+
+private:
+    /**
+     * Stores the serialized URLs of the items as data of the MIME data.
+     */
+    void serializeUrls();
+
+private:
+    KFileItemList m_items;
+    bool m_urlsSerialized;
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemmimetyperesolver.h"
+
+#include <QMimeDatabase>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace {
+    // The sniffed items are passed to the GUI thread in batches of this
+    // size, so that the icons get updated while sniffing is in progress
+    const int SniffedItemsBatchSize = 20;
+
+    QThreadPool* threadPool()
+    {
+        // Reading files in parallel does not pay off on rotating disks.
+        // The pool is leaked intentionally, as deleting it would wait for
+        // reads that hang on dead network mounts.
+        static QThreadPool* pool = [] {
+            QThreadPool* pool = new QThreadPool();
+            pool->setMaxThreadCount(2);
+            return pool;
+        }();
+        return pool;
+    }
+}
+
+struct KFileItemMimeTypeResolver::State
+{
+    // Protects resolver, which is reset when the resolver is destroyed
+    QMutex mutex;
+    KFileItemMimeTypeResolver* resolver = nullptr;
+};
+
+/**
+ * Reads the contents of the files that are needed for determining their
+ * MIME types in a thread, and passes the items together with the names
+ * of their MIME types to the resolver afterwards.
+ */
+class MimeTypeSniffer : public QRunnable
+{
+public:
+    MimeTypeSniffer(const QSharedPointer<KFileItemMimeTypeResolver::State>& state, const KFileItemList& items);
+
+    void run() override;
+
+private:
+    bool passItems(const KFileItemList& items, const QStringList& mimeTypes);
+
+private:
+    QSharedPointer<KFileItemMimeTypeResolver::State> m_state;
+    KFileItemList m_items;
+    QStringList m_paths;
+};
+
+MimeTypeSniffer::MimeTypeSniffer(const QSharedPointer<KFileItemMimeTypeResolver::State>& state, const KFileItemList& items) :
+    m_state(state),
+    m_items(items),
+    m_paths()
+{
+    // The items are only passed back to the GUI thread by the thread pool
+    m_paths.reserve(items.count());
+    for (const KFileItem& item : items) {
+        m_paths.append(item.localPath());
+    }
+}
+
+void MimeTypeSniffer::run()
+{
+    QMimeDatabase db;
+    QStringList mimeTypes;
+    mimeTypes.reserve(m_paths.count());
+    int passedCount = 0;
+    for (int i = 0; i < m_paths.count(); ++i) {
+        mimeTypes.append(db.mimeTypeForFile(m_paths.at(i)).name());
+
+        const int sniffedCount = i + 1;
+        if (sniffedCount - passedCount >= SniffedItemsBatchSize || sniffedCount == m_paths.count()) {
+            const int count = sniffedCount - passedCount;
+            if (!passItems(m_items.mid(passedCount, count), mimeTypes.mid(passedCount, count))) {
+                return;
+            }
+            passedCount = sniffedCount;
+        }
+    }
+}
+
+bool MimeTypeSniffer::passItems(const KFileItemList& items, const QStringList& mimeTypes)
+{
+    QMutexLocker locker(&m_state->mutex);
+    KFileItemMimeTypeResolver* resolver = m_state->resolver;
+    if (!resolver) {
+        return false;
+    }
+
+    QMetaObject::invokeMethod(resolver, [resolver, items, mimeTypes]() {
+        resolver->slotItemsSniffed(items, mimeTypes);
+    }, Qt::QueuedConnection);
+    return true;
+}
+
+KFileItemMimeTypeResolver::KFileItemMimeTypeResolver(QObject* parent) :
+    QObject(parent),
+    m_state(QSharedPointer<State>::create()),
+    m_pendingItems(),
+    m_requestedUrls(),
+    m_startTimer(nullptr)
+{
+    m_state->resolver = this;
+
+    // Collect the items requested within one event loop iteration
+    m_startTimer = new QTimer(this);
+    m_startTimer->setSingleShot(true);
+    m_startTimer->setInterval(0);
+    connect(m_startTimer, &QTimer::timeout, this, &KFileItemMimeTypeResolver::startResolving);
+}
+
+KFileItemMimeTypeResolver::~KFileItemMimeTypeResolver()
+{
+    QMutexLocker locker(&m_state->mutex);
+    m_state->resolver = nullptr;
+}
+
+bool KFileItemMimeTypeResolver::needsContentSniffing(const KFileItem& item)
+{
+    if (item.isMimeTypeKnown() || item.isDir() || !item.isLocalFile()) {
+        return false;
+    }
+
+    // QMimeDatabase only reads the contents of a file if its
+    // name matches no or several glob patterns
+    return QMimeDatabase().mimeTypesForFileName(item.name()).count() != 1;
+}
+
+KFileItem KFileItemMimeTypeResolver::itemWithMimeType(const KFileItem& item, const QString& mimeType)
+{
+    KIO::UDSEntry entry = item.entry();
+    if (entry.count() == 0) {
+        // The item has not been created by a directory lister
+        return KFileItem(item.url(), mimeType, item.mode());
+    }
+
+    entry.replace(KIO::UDSEntry::UDS_MIME_TYPE, mimeType);
+    return KFileItem(entry, item.url());
+}
+
+void KFileItemMimeTypeResolver::resolve(const KFileItem& item)
+{
+    if (item.isMimeTypeKnown() || m_requestedUrls.contains(item.url())) {
+        return;
+    }
+
+    m_requestedUrls.insert(item.url());
+    m_pendingItems.append(item);
+    if (!m_startTimer->isActive()) {
+        m_startTimer->start();
+    }
+}
+
+void KFileItemMimeTypeResolver::startResolving()
+{
+    if (m_pendingItems.isEmpty()) {
+        return;
+    }
+
+    threadPool()->start(new MimeTypeSniffer(m_state, m_pendingItems));
+    m_pendingItems.clear();
+}
+
+void KFileItemMimeTypeResolver::slotItemsSniffed(const KFileItemList& items, const QStringList& mimeTypes)
+{
+    Q_ASSERT(items.count() == mimeTypes.count());
+
+    KFileItemList resolvedItems;
+    resolvedItems.reserve(items.count());
+    for (int i = 0; i < items.count(); ++i) {
+        const KFileItem& item = items.at(i);
+        m_requestedUrls.remove(item.url());
+        resolvedItems.append(itemWithMimeType(item, mimeTypes.at(i)));
+    }
+
+    Q_EMIT mimeTypesResolved(resolvedItems);
+}
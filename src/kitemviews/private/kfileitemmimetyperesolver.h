@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMMIMETYPERESOLVER_H
+#define KFILEITEMMIMETYPERESOLVER_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QUrl>
+
+class QTimer;
+
+/**
+ * @brief Determines the MIME types of local files by their contents
+ *        in the background.
+ *
+ * The MIME type of most files is known from their names without any I/O.
+ * Only if the name of a file matches no or several glob patterns, the
+ * contents of the file must be read, which blocks the GUI thread on slow
+ * disks. Until then the MIME type guessed from the name can be used, e.g.
+ * by KFileItem::iconName() and KFileItem::mimeComment().
+ *
+ * The contents of the files are read by a small thread pool, which passes
+ * the names of the determined MIME types to the GUI thread. As the MIME type
+ * of a KFileItem cannot be changed, new items with the known MIME types are
+ * created there without reading the files again.
+ */
+class DOLPHIN_EXPORT KFileItemMimeTypeResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KFileItemMimeTypeResolver(QObject* parent = nullptr);
+    ~KFileItemMimeTypeResolver() override;
+
+    /**
+     * @return True if determining the MIME type of \a item
+     *         requires reading the contents of the file.
+     */
+    static bool needsContentSniffing(const KFileItem& item);
+
+    /**
+     * @return Copy of \a item with the known MIME type \a mimeType.
+     */
+    static KFileItem itemWithMimeType(const KFileItem& item, const QString& mimeType);
+
+    /**
+     * Determines the MIME type of \a item in the background. The signal
+     * mimeTypesResolved() is emitted afterwards. Items that are resolved
+     * already are ignored.
+     */
+    void resolve(const KFileItem& item);
+
+Q_SIGNALS:
+    /**
+     * Is emitted if the MIME types of the requested items have been
+     * determined. \a items contains copies of the requested items, for
+     * which KFileItem::isMimeTypeKnown() is true.
+     */
+    void mimeTypesResolved(const KFileItemList& items);
+
+private:
+    struct State;
+
+    void startResolving();
+    void slotItemsSniffed(const KFileItemList& items, const QStringList& mimeTypes);
+
+private:
+    QSharedPointer<State> m_state;
+    KFileItemList m_pendingItems;
+    QSet<QUrl> m_requestedUrls;
+    QTimer* m_startTimer;
+
+    friend class MimeTypeSniffer;
+};
+
+#endif
@@ -6,6 +6,8 @@
 
 #include "kfileitemmodelfilter.h"
 
+#include "kfileitemmimetyperesolver.h"
+
 #include <QRegularExpression>
 
 #include <KFileItem>
@@ -96,11 +98,21 @@ bool KFileItemModelFilter::matchesPattern(const KFileItem& item) const
 
 bool KFileItemModelFilter::matchesType(const KFileItem& item) const
 {
+    if (m_mimeTypes.isEmpty()) {
+        return true;
+    }
+
+    // Only read the contents of files without a meaningful name. Their guessed
+    // MIME type might be wrong, and filtered items are never refined by
+    // KFileItemModelRolesUpdater.
+    const QString itemMimeType = KFileItemMimeTypeResolver::needsContentSniffing(item)
+                                 ? item.determineMimeType().name()
+                                 : item.currentMimeType().name();
     for (const QString& mimeType : qAsConst(m_mimeTypes)) {
-        if (item.mimetype() == mimeType) {
+        if (itemMimeType == mimeType) {
             return true;
         }
     }
 
-    return m_mimeTypes.isEmpty();
+    return false;
 }
@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitempreviewcache.h"
+
+#include <KFileItem>
+
+namespace {
+    // Maximum number of previews per item. Views showing the same directory
+    // with different icon sizes can share their previews, while zooming
+    // does not accumulate previews of all sizes.
+    const int MaxPreviewCount = 2;
+}
+
+class KFileItemPreviewCacheSingleton
+{
+public:
+    KFileItemPreviewCache instance;
+};
+Q_GLOBAL_STATIC(KFileItemPreviewCacheSingleton, s_KFileItemPreviewCache)
+
+KFileItemPreviewCache* KFileItemPreviewCache::instance()
+{
+    return &s_KFileItemPreviewCache->instance;
+}
+
+void KFileItemPreviewCache::acquire(const QUrl& directory)
+{
+    ++m_directories[directory].refCount;
+}
+
+void KFileItemPreviewCache::release(const QUrl& directory)
+{
+    auto it = m_directories.find(directory);
+    if (it == m_directories.end()) {
+        return;
+    }
+
+    --it->refCount;
+    if (it->refCount <= 0) {
+        m_directories.erase(it);
+    }
+}
+
+bool KFileItemPreviewCache::preview(const KFileItem& item, const QString& key, QPixmap& pixmap) const
+{
+    const auto directoryIt = m_directories.constFind(directory(item));
+    if (directoryIt == m_directories.constEnd()) {
+        return false;
+    }
+
+    const auto entryIt = directoryIt->entries.constFind(item.url());
+    if (entryIt == directoryIt->entries.constEnd()
+        || entryIt->modificationTime != item.time(KFileItem::ModificationTime)
+        || entryIt->size != item.size()) {
+        return false;
+    }
+
+    for (const auto& preview : entryIt->previews) {
+        if (preview.first == key) {
+            pixmap = preview.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+void KFileItemPreviewCache::setPreview(const KFileItem& item, const QString& key, const QPixmap& pixmap)
+{
+    auto directoryIt = m_directories.find(directory(item));
+    if (directoryIt == m_directories.end()) {
+        return;
+    }
+
+    Entry& entry = directoryIt->entries[item.url()];
+    const QDateTime modificationTime = item.time(KFileItem::ModificationTime);
+    if (entry.modificationTime != modificationTime || entry.size != item.size()) {
+        // The previews of the previous version of the item are outdated
+        entry.modificationTime = modificationTime;
+        entry.size = item.size();
+        entry.previews.clear();
+    }
+
+    for (int i = 0; i < entry.previews.count(); ++i) {
+        if (entry.previews.at(i).first == key) {
+            entry.previews.remove(i);
+            break;
+        }
+    }
+    if (entry.previews.count() >= MaxPreviewCount) {
+        entry.previews.removeFirst();
+    }
+    entry.previews.append(qMakePair(key, pixmap));
+}
+
+QUrl KFileItemPreviewCache::directory(const KFileItem& item)
+{
+    return item.url().adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash);
+}
+
+KFileItemPreviewCache::KFileItemPreviewCache() :
+    m_directories()
+{
+}
@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMPREVIEWCACHE_H
+#define KFILEITEMPREVIEWCACHE_H
+
+#include "dolphin_export.h"
+
+#include <KIO/Global>
+
+#include <QDateTime>
+#include <QHash>
+#include <QPixmap>
+#include <QUrl>
+#include <QVector>
+
+class KFileItem;
+
+/**
+ * @brief Shares the previews of items between all instances of
+ *        KFileItemModelRolesUpdater.
+ *
+ * The items themselves are shared already by the cache of KDirLister, but
+ * every model used to generate and keep its own previews. Hence showing the
+ * same directory in a split view, in another tab or in the folders panel
+ * required running the preview jobs and scaling the previews once per view.
+ *
+ * The previews are stored per directory. A directory is kept in the cache as
+ * long as at least one roles updater has acquired it, so the memory of the
+ * cache is bounded by the directories that are actually shown. As QPixmap is
+ * implicitly shared, all models showing a directory share the pixmap data of
+ * the previews, too.
+ *
+ * A preview is only returned if the modification time and the size of the
+ * item have not changed since the preview has been stored.
+ *
+ * The cache may only be used from the GUI thread.
+ */
+class DOLPHIN_EXPORT KFileItemPreviewCache
+{
+public:
+    static KFileItemPreviewCache* instance();
+
+    /**
+     * Increases the reference count of the directory \a directory.
+     */
+    void acquire(const QUrl& directory);
+
+    /**
+     * Decreases the reference count of the directory \a directory. The
+     * previews of the directory are removed if the count drops to zero.
+     */
+    void release(const QUrl& directory);
+
+    /**
+     * @return True if a preview of the item \a item has been stored for
+     *         the key \a key. A null pixmap indicates that creating the
+     *         preview failed.
+     */
+    bool preview(const KFileItem& item, const QString& key, QPixmap& pixmap) const;
+
+    /**
+     * Stores the preview \a pixmap of the item \a item for the key \a key,
+     * which must describe everything the preview depends on except of the
+     * item, e.g. the icon size. The preview is ignored if the directory of
+     * the item has not been acquired.
+     */
+    void setPreview(const KFileItem& item, const QString& key, const QPixmap& pixmap);
+
+    /**
+     * @return The directory of \a item, which must be acquired to store
+     *         previews of the item.
+     */
+    static QUrl directory(const KFileItem& item);
+
+private:
+    KFileItemPreviewCache();
+
+    struct Entry
+    {
+        QDateTime modificationTime;
+        KIO::filesize_t size = 0;
+        QVector<QPair<QString, QPixmap>> previews;
+    };
+
+    struct Directory
+    {
+        int refCount = 0;
+        QHash<QUrl, Entry> entries;
+    };
+
+    QHash<QUrl, Directory> m_directories;
+
+    friend class KFileItemPreviewCacheSingleton;
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemselectionsummary.h"
+
+#include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kitemset.h"
+
+KFileItemSelectionSummary::KFileItemSelectionSummary(KFileItemModel* model, QObject* parent) :
+    QObject(parent),
+    m_model(model),
+    m_prefixSumsValid(false),
+    m_folderCounts(),
+    m_fileSizes()
+{
+    connect(m_model, &KFileItemModel::itemsInserted, this, &KFileItemSelectionSummary::invalidate);
+    connect(m_model, &KFileItemModel::itemsRemoved, this, &KFileItemSelectionSummary::invalidate);
+    connect(m_model, &KFileItemModel::itemsMoved, this, &KFileItemSelectionSummary::invalidate);
+    connect(m_model, &KFileItemModel::itemsChanged, this, &KFileItemSelectionSummary::slotItemsChanged);
+}
+
+KFileItemSelectionSummary::~KFileItemSelectionSummary()
+{
+}
+
+KFileItemSelectionSummary::Summary KFileItemSelectionSummary::summary(const KItemSet& items)
+{
+    updatePrefixSums();
+
+    Summary summary{0, 0, 0};
+    const int count = m_folderCounts.count() - 1;
+
+    const KItemRangeList ranges = items.ranges();
+    for (const KItemRange& range : ranges) {
+        const int begin = qBound(0, range.index, count);
+        const int end = qBound(0, range.index + range.count, count);
+
+        const int folderCount = m_folderCounts.at(end) - m_folderCounts.at(begin);
+        summary.folderCount += folderCount;
+        summary.fileCount += end - begin - folderCount;
+        summary.totalFileSize += m_fileSizes.at(end) - m_fileSizes.at(begin);
+    }
+
+    return summary;
+}
+
+KFileItemSelectionSummary::Summary KFileItemSelectionSummary::totalSummary()
+{
+    updatePrefixSums();
+
+    const int count = m_folderCounts.count() - 1;
+    const int folderCount = m_folderCounts.at(count);
+    return Summary{folderCount, count - folderCount, m_fileSizes.at(count)};
+}
+
+void KFileItemSelectionSummary::slotItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& roles)
+{
+    if (roles.isEmpty() || roles.contains("isDir")) {
+        invalidate();
+        return;
+    }
+
+    if (roles.contains("size") && m_prefixSumsValid) {
+        // The sizes of folders are not part of the summary. This prevents
+        // rebuilding the prefix sums while the folder contents are counted.
+        for (const KItemRange& range : itemRanges) {
+            for (int i = range.index; i < range.index + range.count; ++i) {
+                if (!m_model->fileItem(i).isDir()) {
+                    invalidate();
+                    return;
+                }
+            }
+        }
+    }
+}
+
+void KFileItemSelectionSummary::invalidate()
+{
+    m_prefixSumsValid = false;
+}
+
+void KFileItemSelectionSummary::updatePrefixSums()
+{
+    if (m_prefixSumsValid) {
+        return;
+    }
+    m_prefixSumsValid = true;
+
+    const int count = m_model->count();
+    m_folderCounts.resize(count + 1);
+    m_fileSizes.resize(count + 1);
+
+    int folderCount = 0;
+    KIO::filesize_t fileSize = 0;
+    m_folderCounts[0] = 0;
+    m_fileSizes[0] = 0;
+    for (int i = 0; i < count; ++i) {
+        const KFileItem item = m_model->fileItem(i);
+        if (item.isDir()) {
+            ++folderCount;
+        } else {
+            fileSize += item.size();
+        }
+        m_folderCounts[i + 1] = folderCount;
+        m_fileSizes[i + 1] = fileSize;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMSELECTIONSUMMARY_H
+#define KFILEITEMSELECTIONSUMMARY_H
+
+#include "dolphin_export.h"
+#include "kitemviews/kitemmodelbase.h"
+
+#include <KIO/Global>
+
+#include <QObject>
+#include <QVector>
+
+class KFileItemModel;
+class KItemSet;
+
+/**
+ * @brief Counts the folders and files of a set of items of KFileItemModel
+ *        and sums up the sizes of the files.
+ *
+ * The number of folders and the file sizes are stored as prefix sums over
+ * all items of the model. Hence summarizing a selection only requires one
+ * subtraction per selected range, independent from the number of selected
+ * items. The prefix sums are rebuilt lazily after the items of the model
+ * have been changed.
+ */
+class DOLPHIN_EXPORT KFileItemSelectionSummary : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Summary
+    {
+        int folderCount;
+        int fileCount;
+        KIO::filesize_t totalFileSize;
+    };
+
+    explicit KFileItemSelectionSummary(KFileItemModel* model, QObject* parent = nullptr);
+    ~KFileItemSelectionSummary() override;
+
+    /**
+     * @return Summary of the items \a items of the model.
+     */
+    Summary summary(const KItemSet& items);
+
+    /**
+     * @return Summary of all items of the model.
+     */
+    Summary totalSummary();
+
+private Q_SLOTS:
+    void slotItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& roles);
+    void invalidate();
+
+private:
+    void updatePrefixSums();
+
+private:
+    KFileItemModel* m_model;
+    bool m_prefixSumsValid;
+
+    // Number of folders and sum of the file sizes of the items [0, i[
+    QVector<int> m_folderCounts;
+    QVector<KIO::filesize_t> m_fileSizes;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfilenamematcher.h"
+
+namespace {
+    bool containsSpecialCharacters(const QString& pattern)
+    {
+        static const QString specialCharacters = QStringLiteral("\\^$.|?*+()[]{}");
+        for (const QChar c : pattern) {
+            if (specialCharacters.contains(c)) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+KFileNameMatcher::KFileNameMatcher() :
+    m_pattern(),
+    m_mode(SubString),
+    m_stringMatcher(),
+    m_regExp()
+{
+}
+
+KFileNameMatcher::KFileNameMatcher(const QString& pattern) :
+    m_pattern(pattern),
+    m_mode(SubString),
+    m_stringMatcher(),
+    m_regExp()
+{
+    if (!containsSpecialCharacters(pattern)) {
+        m_stringMatcher = QStringMatcher(pattern, Qt::CaseInsensitive);
+        return;
+    }
+
+    m_mode = RegularExpression;
+    m_regExp = QRegularExpression(pattern, QRegularExpression::CaseInsensitiveOption);
+    if (!m_regExp.isValid()) {
+        m_mode = Wildcard;
+        m_regExp.setPattern(QRegularExpression::wildcardToRegularExpression(pattern));
+    }
+
+    // The expression is used by several threads, so it gets compiled
+    // before and not when matching the first name
+    m_regExp.optimize();
+}
+
+bool KFileNameMatcher::isValid() const
+{
+    return !m_pattern.isEmpty() && (m_mode == SubString || m_regExp.isValid());
+}
+
+QString KFileNameMatcher::pattern() const
+{
+    return m_pattern;
+}
+
+KFileNameMatcher::Mode KFileNameMatcher::mode() const
+{
+    return m_mode;
+}
+
+bool KFileNameMatcher::matches(const QString& name) const
+{
+    if (m_mode == SubString) {
+        return m_stringMatcher.indexIn(name) >= 0;
+    }
+    return m_regExp.match(name).hasMatch();
+}
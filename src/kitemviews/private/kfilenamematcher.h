@@ -0,0 +1,57 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILENAMEMATCHER_H
+#define KFILENAMEMATCHER_H
+
+#include "dolphin_export.h"
+
+#include <QRegularExpression>
+#include <QString>
+#include <QStringMatcher>
+
+/**
+ * @brief Checks whether file names match the search text of a file name search.
+ *
+ * The pattern is compiled once, so that matches() is cheap enough for being
+ * called for every entry of a directory tree. A pattern without special
+ * characters matches case-insensitive as sub-string. Otherwise the pattern
+ * is used as case-insensitive regular expression, like it is done by the
+ * filenamesearch worker. Patterns that are no valid regular expression,
+ * like "*.txt", are used as wildcard pattern for the whole name.
+ *
+ * matches() may be called by several threads at the same time.
+ */
+class DOLPHIN_EXPORT KFileNameMatcher
+{
+public:
+    enum Mode {
+        SubString,
+        Wildcard,
+        RegularExpression
+    };
+
+    KFileNameMatcher();
+    explicit KFileNameMatcher(const QString& pattern);
+
+    /**
+     * @return True if the pattern is not empty and valid.
+     */
+    bool isValid() const;
+
+    QString pattern() const;
+    Mode mode() const;
+
+    bool matches(const QString& name) const;
+
+private:
+    QString m_pattern;
+    Mode m_mode;
+    QStringMatcher m_stringMatcher;
+    QRegularExpression m_regExp;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemlistadvancetable.h"
+
+#include <QFontMetrics>
+#include <QFontMetricsF>
+#include <QHash>
+#include <QMutex>
+#include <QThreadStorage>
+
+#include <cstring>
+
+namespace {
+    /**
+     * @return Width \a width in 1/64 pixels, which is the
+     *         precision used by the font engines.
+     */
+    int toFixed(qreal width)
+    {
+        return qRound(width * 64);
+    }
+
+    /**
+     * Table that has been used last by the current thread. Checking it
+     * first prevents building the font key for each measurement.
+     */
+    struct LastUsedTable
+    {
+        QFont font;
+        const KItemListAdvanceTable* table = nullptr;
+    };
+}
+
+class KItemListAdvanceTableRegistry
+{
+public:
+    ~KItemListAdvanceTableRegistry()
+    {
+        qDeleteAll(tables);
+    }
+
+    QMutex mutex;
+    QHash<QString, const KItemListAdvanceTable*> tables;
+};
+Q_GLOBAL_STATIC(KItemListAdvanceTableRegistry, s_advanceTables)
+
+const KItemListAdvanceTable* KItemListAdvanceTable::forFont(const QFont& font)
+{
+    static QThreadStorage<LastUsedTable> lastUsedTables;
+    LastUsedTable& lastUsedTable = lastUsedTables.localData();
+    if (lastUsedTable.table && lastUsedTable.font == font) {
+        return lastUsedTable.table;
+    }
+
+    const QString fontKey = font.key();
+    KItemListAdvanceTableRegistry* registry = s_advanceTables;
+
+    const KItemListAdvanceTable* table = nullptr;
+    {
+        QMutexLocker locker(&registry->mutex);
+        table = registry->tables.value(fontKey);
+    }
+
+    if (!table) {
+        // Creating the table requires measuring all pairs of characters,
+        // don't block other threads in the meantime.
+        KItemListAdvanceTable* createdTable = new KItemListAdvanceTable(font);
+
+        QMutexLocker locker(&registry->mutex);
+        table = registry->tables.value(fontKey);
+        if (table) {
+            // Another thread has been faster
+            delete createdTable;
+        } else {
+            registry->tables.insert(fontKey, createdTable);
+            table = createdTable;
+        }
+    }
+
+    lastUsedTable.font = font;
+    lastUsedTable.table = table;
+    return table;
+}
+
+int KItemListAdvanceTable::horizontalAdvance(const QString& text) const
+{
+    const int length = text.length();
+    if (length == 0) {
+        return 0;
+    }
+
+    const ushort* characters = text.utf16();
+
+    // Check whether all characters are part of the table. The loop
+    // does not exit early, so that the compiler can vectorize it.
+    ushort minCharacter = 0xFFFF;
+    ushort maxCharacter = 0;
+    for (int i = 0; i < length; ++i) {
+        minCharacter = qMin(minCharacter, characters[i]);
+        maxCharacter = qMax(maxCharacter, characters[i]);
+    }
+    if (minCharacter < FirstCharacter || maxCharacter > LastCharacter) {
+        return -1;
+    }
+
+    if (m_hasUnverifiedPairs) {
+        for (int i = 1; i < length; ++i) {
+            if (!isPairVerified(characters[i - 1], characters[i])) {
+                return -1;
+            }
+        }
+    }
+
+    int width = 0;
+    for (int i = 0; i < length; ++i) {
+        width += m_advances[characters[i]];
+    }
+
+    // Round like QFontMetrics::horizontalAdvance() does
+    return (width + 32) >> 6;
+}
+
+int KItemListAdvanceTable::horizontalAdvance(const QString& text, const QFont& font)
+{
+    const int width = forFont(font)->horizontalAdvance(text);
+    if (width >= 0) {
+        return width;
+    }
+    return QFontMetrics(font).horizontalAdvance(text);
+}
+
+KItemListAdvanceTable::KItemListAdvanceTable(const QFont& font) :
+    m_hasUnverifiedPairs(false)
+{
+    std::memset(m_advances, 0, sizeof(m_advances));
+    std::memset(m_unverifiedPairs, 0, sizeof(m_unverifiedPairs));
+
+    const QFontMetricsF fontMetrics(font);
+
+    QString text(1, QChar());
+    for (ushort c = FirstCharacter; c <= LastCharacter; ++c) {
+        text[0] = QChar(c);
+        m_advances[c] = toFixed(fontMetrics.horizontalAdvance(text));
+    }
+
+    // Verify that the font does not apply kerning or ligatures, which would
+    // make the width of a text differ from the sum of the advances.
+    QString pair(2, QChar());
+    for (ushort first = FirstCharacter; first <= LastCharacter; ++first) {
+        pair[0] = QChar(first);
+        for (ushort second = FirstCharacter; second <= LastCharacter; ++second) {
+            pair[1] = QChar(second);
+            const int pairAdvance = toFixed(fontMetrics.horizontalAdvance(pair));
+            if (pairAdvance != m_advances[first] + m_advances[second]) {
+                m_unverifiedPairs[first][second / 64] |= quint64(1) << (second % 64);
+                m_hasUnverifiedPairs = true;
+            }
+        }
+    }
+}
+
+bool KItemListAdvanceTable::isPairVerified(ushort first, ushort second) const
+{
+    return !(m_unverifiedPairs[first][second / 64] & (quint64(1) << (second % 64)));
+}
@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTADVANCETABLE_H
+#define KITEMLISTADVANCETABLE_H
+
+#include "dolphin_export.h"
+
+#include <QFont>
+#include <QString>
+
+/**
+ * @brief Fast measurement of the width of ASCII texts.
+ *
+ * Most file names, sizes and dates only contain printable ASCII characters.
+ * For those texts the width can be calculated by summing up the advances of
+ * the characters, as long as the font does not apply kerning or ligatures.
+ *
+ * The table contains the advance of each printable ASCII character in 1/64
+ * pixels. When creating the table, the advance of each pair of characters is
+ * compared with the sum of the advances of both characters. Pairs that differ,
+ * e.g. because of kerning, are remembered and texts containing them are not
+ * measured by the table.
+ *
+ * The tables are immutable and may be used by any thread.
+ */
+class DOLPHIN_EXPORT KItemListAdvanceTable
+{
+public:
+    /**
+     * @return Table for \a font. The table gets created on the first
+     *         request and is kept until the application is closed.
+     */
+    static const KItemListAdvanceTable* forFont(const QFont& font);
+
+    /**
+     * @return The width of \a text like QFontMetrics::horizontalAdvance()
+     *         or -1 if \a text cannot be measured by the table.
+     */
+    int horizontalAdvance(const QString& text) const;
+
+    /**
+     * @return The width of \a text. QFontMetrics::horizontalAdvance() is used
+     *         if \a text cannot be measured by the table of \a font.
+     */
+    static int horizontalAdvance(const QString& text, const QFont& font);
+
+private:
+    explicit KItemListAdvanceTable(const QFont& font);
+
+    bool isPairVerified(ushort first, ushort second) const;
+
+private:
+    enum {
+        FirstCharacter = 0x20,
+        LastCharacter = 0x7E,
+        TableSize = 0x80
+    };
+
+    // Advances in 1/64 pixels, 0 for characters that are not supported
+    int m_advances[TableSize];
+
+    // Bit n of m_unverifiedPairs[c][n / 64] is set if the pair of the
+    // characters c and n has a different width than the sum of the advances.
+    quint64 m_unverifiedPairs[TableSize][TableSize / 64];
+    bool m_hasUnverifiedPairs;
+};
+
+#endif
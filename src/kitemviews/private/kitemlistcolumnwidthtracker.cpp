@@ -0,0 +1,440 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemlistcolumnwidthtracker.h"
+#include "kitemviews/kitemlistview.h"
+
+#include <QTimer>
+#include <QtMath>
+
+namespace {
+    // Maximum number of items that get measured at once. The preferred
+    // column widths get updated after each chunk.
+    const int MaxMeasuredItemCount = 1000;
+}
+
+KItemListColumnWidthTracker::KItemListColumnWidthTracker(const KItemListView* itemListView) :
+    QObject(),
+    m_itemListView(itemListView),
+    m_enabled(true),
+    m_itemCount(0),
+    m_roleWidths(),
+    m_emittedMaximumWidths(),
+    m_timer(nullptr),
+    m_resumeIndex(0),
+    m_measuredIndexes(),
+    m_invalidatedIndexes(),
+    m_watcher(nullptr)
+{
+    // Several changes of the model are usually done within one
+    // event loop iteration, measure them together.
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(0);
+    connect(m_timer, &QTimer::timeout, this, &KItemListColumnWidthTracker::slotTimeout);
+
+    m_watcher = new QFutureWatcher<QVector<qreal>>(this);
+    connect(m_watcher, &QFutureWatcher<QVector<qreal>>::finished,
+            this, &KItemListColumnWidthTracker::slotMeasurementFinished);
+}
+
+KItemListColumnWidthTracker::~KItemListColumnWidthTracker()
+{
+    cancelMeasurement();
+}
+
+void KItemListColumnWidthTracker::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled) {
+        return;
+    }
+
+    m_enabled = enabled;
+    if (enabled) {
+        scheduleUpdate();
+    } else {
+        cancelMeasurement();
+    }
+}
+
+bool KItemListColumnWidthTracker::isEnabled() const
+{
+    return m_enabled;
+}
+
+void KItemListColumnWidthTracker::setRoles(const QList<QByteArray>& roles)
+{
+    cancelMeasurement();
+
+    QVector<RoleWidths> roleWidths;
+    roleWidths.reserve(roles.count());
+    for (const QByteArray& role : roles) {
+        auto it = std::find_if(m_roleWidths.begin(), m_roleWidths.end(), [&role](const RoleWidths& widths) {
+            return widths.role == role;
+        });
+        if (it != m_roleWidths.end()) {
+            roleWidths.append(*it);
+        } else {
+            roleWidths.append(RoleWidths{role, QVector<int>(m_itemCount, 0), QMap<int, int>(), m_itemCount});
+            resumeAt(0);
+        }
+    }
+    m_roleWidths = roleWidths;
+
+    scheduleUpdate();
+}
+
+qreal KItemListColumnWidthTracker::preferredColumnWidth(const QByteArray& role) const
+{
+    for (const RoleWidths& roleWidths : m_roleWidths) {
+        if (roleWidths.role == role) {
+            return roleWidths.histogram.isEmpty() ? 0 : roleWidths.histogram.lastKey();
+        }
+    }
+    return 0;
+}
+
+bool KItemListColumnWidthTracker::isComplete() const
+{
+    for (const RoleWidths& roleWidths : m_roleWidths) {
+        if (roleWidths.unmeasuredCount > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void KItemListColumnWidthTracker::itemsInserted(const KItemRangeList& itemRanges)
+{
+    cancelMeasurement();
+
+    int insertedCount = 0;
+    for (const KItemRange& range : itemRanges) {
+        insertedCount += range.count;
+    }
+
+    for (RoleWidths& roleWidths : m_roleWidths) {
+        QVector<int>& widths = roleWidths.widths;
+        const int currentCount = widths.count();
+
+        // Build the new list from the end to the beginning to minimize the
+        // number of moves, see KItemListSizeHintResolver::itemsInserted().
+        widths.insert(widths.end(), insertedCount, 0);
+
+        int sourceIndex = currentCount - 1;
+        int targetIndex = widths.count() - 1;
+        int itemsToInsertBeforeCurrentRange = insertedCount;
+
+        for (int rangeIndex = itemRanges.count() - 1; rangeIndex >= 0; --rangeIndex) {
+            const KItemRange& range = itemRanges.at(rangeIndex);
+            itemsToInsertBeforeCurrentRange -= range.count;
+
+            while (targetIndex >= itemsToInsertBeforeCurrentRange + range.index + range.count) {
+                widths[targetIndex] = widths[sourceIndex];
+                --sourceIndex;
+                --targetIndex;
+            }
+
+            while (targetIndex >= itemsToInsertBeforeCurrentRange + range.index) {
+                widths[targetIndex] = 0;
+                --targetIndex;
+            }
+        }
+
+        roleWidths.unmeasuredCount += insertedCount;
+    }
+
+    if (!itemRanges.isEmpty()) {
+        resumeAt(itemRanges.first().index);
+    }
+
+    m_itemCount += insertedCount;
+    scheduleUpdate();
+}
+
+void KItemListColumnWidthTracker::itemsRemoved(const KItemRangeList& itemRanges)
+{
+    if (itemRanges.isEmpty()) {
+        return;
+    }
+
+    cancelMeasurement();
+
+    for (RoleWidths& roleWidths : m_roleWidths) {
+        QVector<int>& widths = roleWidths.widths;
+
+        // The histogram contains the widths of all items that are not
+        // unmeasured, no other item must be checked.
+        for (const KItemRange& range : itemRanges) {
+            const int end = range.index + range.count;
+            for (int index = range.index; index < end; ++index) {
+                const int width = widths.at(index);
+                if (width != 0) {
+                    removeFromHistogram(roleWidths, qAbs(width));
+                }
+                if (width <= 0) {
+                    --roleWidths.unmeasuredCount;
+                }
+            }
+        }
+
+        const QVector<int>::iterator begin = widths.begin();
+        const QVector<int>::iterator end = widths.end();
+
+        KItemRangeList::const_iterator rangeIt = itemRanges.constBegin();
+        const KItemRangeList::const_iterator rangeEnd = itemRanges.constEnd();
+
+        QVector<int>::iterator destIt = begin + rangeIt->index;
+        QVector<int>::iterator srcIt = destIt + rangeIt->count;
+
+        ++rangeIt;
+
+        while (srcIt != end) {
+            *destIt = *srcIt;
+            ++destIt;
+            ++srcIt;
+
+            if (rangeIt != rangeEnd && srcIt == begin + rangeIt->index) {
+                // Skip the items in the next removed range.
+                srcIt += rangeIt->count;
+                ++rangeIt;
+            }
+        }
+
+        widths.erase(destIt, end);
+    }
+
+    for (const KItemRange& range : itemRanges) {
+        m_itemCount -= range.count;
+    }
+    resumeAt(itemRanges.first().index);
+
+    scheduleUpdate();
+}
+
+void KItemListColumnWidthTracker::itemsMoved(const KItemRange& range, const QList<int>& movedToIndexes)
+{
+    cancelMeasurement();
+
+    // Moving items does not change any width, hence the histograms
+    // stay untouched.
+    for (RoleWidths& roleWidths : m_roleWidths) {
+        const QVector<int> previousWidths = roleWidths.widths;
+        const int movedRangeEnd = range.index + range.count;
+        for (int i = range.index; i < movedRangeEnd; ++i) {
+            const int newIndex = movedToIndexes.at(i - range.index);
+            roleWidths.widths[newIndex] = previousWidths.at(i);
+        }
+    }
+    resumeAt(range.index);
+
+    scheduleUpdate();
+}
+
+void KItemListColumnWidthTracker::itemsChanged(const KItemRangeList& itemRanges)
+{
+    const bool measurementRunning = !m_measuredIndexes.isEmpty();
+
+    for (const KItemRange& range : itemRanges) {
+        const int end = range.index + range.count;
+        for (RoleWidths& roleWidths : m_roleWidths) {
+            for (int index = range.index; index < end; ++index) {
+                // Keep the previous width until the item has been measured again
+                int& width = roleWidths.widths[index];
+                if (width > 0) {
+                    width = -width;
+                    ++roleWidths.unmeasuredCount;
+                }
+            }
+        }
+        resumeAt(range.index);
+
+        if (measurementRunning) {
+            // The running measurement might provide outdated widths
+            for (int index = range.index; index < end; ++index) {
+                m_invalidatedIndexes.insert(index);
+            }
+        }
+    }
+
+    scheduleUpdate();
+}
+
+void KItemListColumnWidthTracker::invalidate()
+{
+    cancelMeasurement();
+
+    for (RoleWidths& roleWidths : m_roleWidths) {
+        for (int& width : roleWidths.widths) {
+            if (width > 0) {
+                width = -width;
+            }
+        }
+        roleWidths.unmeasuredCount = roleWidths.widths.count();
+    }
+    resumeAt(0);
+
+    scheduleUpdate();
+}
+
+void KItemListColumnWidthTracker::slotTimeout()
+{
+    const QVector<int> widths = maximumWidths();
+    if (widths != m_emittedMaximumWidths) {
+        m_emittedMaximumWidths = widths;
+        Q_EMIT preferredColumnWidthsChanged();
+    }
+
+    startMeasurement();
+}
+
+void KItemListColumnWidthTracker::slotMeasurementFinished()
+{
+    if (m_measuredIndexes.isEmpty()) {
+        // The measurement has been canceled
+        return;
+    }
+
+    const QFuture<QVector<qreal>> future = m_watcher->future();
+    for (int i = 0; i < m_measuredIndexes.count(); ++i) {
+        const int index = m_measuredIndexes.at(i);
+        if (m_invalidatedIndexes.contains(index)) {
+            continue;
+        }
+
+        const QVector<qreal> widths = future.resultAt(i);
+        for (int roleIndex = 0; roleIndex < m_roleWidths.count(); ++roleIndex) {
+            applyWidth(m_roleWidths[roleIndex], index, qCeil(widths.at(roleIndex)));
+        }
+    }
+
+    m_measuredIndexes.clear();
+    m_invalidatedIndexes.clear();
+
+    // Emit the changed widths and measure the remaining items
+    slotTimeout();
+}
+
+void KItemListColumnWidthTracker::startMeasurement()
+{
+    if (!m_enabled || !m_measuredIndexes.isEmpty() || isComplete()) {
+        return;
+    }
+
+    // Continue at the first item that might be unmeasured. Items that
+    // have been measured meanwhile are skipped by moving the resume index,
+    // so each item is only checked once until it gets invalidated.
+    QVector<int> indexes;
+    for (int index = m_resumeIndex; index < m_itemCount && indexes.count() < MaxMeasuredItemCount; ++index) {
+        bool measured = true;
+        for (const RoleWidths& roleWidths : qAsConst(m_roleWidths)) {
+            if (roleWidths.widths.at(index) <= 0) {
+                measured = false;
+                break;
+            }
+        }
+
+        if (!measured) {
+            indexes.append(index);
+        } else if (indexes.isEmpty()) {
+            m_resumeIndex = index + 1;
+        }
+    }
+
+    if (indexes.isEmpty()) {
+        return;
+    }
+
+    QList<QByteArray> roles;
+    for (const RoleWidths& roleWidths : qAsConst(m_roleWidths)) {
+        roles.append(roleWidths.role);
+    }
+
+    const KItemListWidgetCreatorBase* creator = m_itemListView->widgetCreator();
+    const QFuture<QVector<qreal>> future = creator->preferredRoleColumnWidthsConcurrently(roles, indexes, m_itemListView);
+    if (future.isCanceled()) {
+        // The widget creator does not support a concurrent calculation. Measure
+        // the chunk synchronously and continue in the next event loop iteration.
+        for (const int index : qAsConst(indexes)) {
+            for (RoleWidths& roleWidths : m_roleWidths) {
+                const qreal width = creator->preferredRoleColumnWidth(roleWidths.role, index, m_itemListView);
+                applyWidth(roleWidths, index, qCeil(width));
+            }
+        }
+        m_timer->start();
+        return;
+    }
+
+    m_measuredIndexes = indexes;
+    m_watcher->setFuture(future);
+}
+
+void KItemListColumnWidthTracker::cancelMeasurement()
+{
+    if (m_measuredIndexes.isEmpty()) {
+        return;
+    }
+
+    m_watcher->cancel();
+    m_measuredIndexes.clear();
+    m_invalidatedIndexes.clear();
+}
+
+void KItemListColumnWidthTracker::scheduleUpdate()
+{
+    if (!m_timer->isActive()) {
+        m_timer->start();
+    }
+}
+
+void KItemListColumnWidthTracker::resumeAt(int index)
+{
+    m_resumeIndex = qMin(m_resumeIndex, index);
+}
+
+void KItemListColumnWidthTracker::applyWidth(RoleWidths& roleWidths, int index, int width)
+{
+    // Measured widths must be positive to be distinguishable from
+    // unmeasured items.
+    width = qMax(1, width);
+
+    int& currentWidth = roleWidths.widths[index];
+    if (currentWidth > 0) {
+        // Has already been measured
+        return;
+    }
+
+    if (currentWidth < 0) {
+        removeFromHistogram(roleWidths, -currentWidth);
+    }
+    currentWidth = width;
+    --roleWidths.unmeasuredCount;
+    addToHistogram(roleWidths, width);
+}
+
+void KItemListColumnWidthTracker::addToHistogram(RoleWidths& roleWidths, int width)
+{
+    ++roleWidths.histogram[width];
+}
+
+void KItemListColumnWidthTracker::removeFromHistogram(RoleWidths& roleWidths, int width)
+{
+    auto it = roleWidths.histogram.find(width);
+    Q_ASSERT(it != roleWidths.histogram.end());
+    if (it != roleWidths.histogram.end() && --it.value() <= 0) {
+        roleWidths.histogram.erase(it);
+    }
+}
+
+QVector<int> KItemListColumnWidthTracker::maximumWidths() const
+{
+    QVector<int> widths;
+    widths.reserve(m_roleWidths.count());
+    for (const RoleWidths& roleWidths : m_roleWidths) {
+        widths.append(roleWidths.histogram.isEmpty() ? 0 : roleWidths.histogram.lastKey());
+    }
+    return widths;
+}
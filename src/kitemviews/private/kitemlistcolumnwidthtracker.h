@@ -0,0 +1,138 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTCOLUMNWIDTHTRACKER_H
+#define KITEMLISTCOLUMNWIDTHTRACKER_H
+
+#include "dolphin_export.h"
+#include "kitemviews/kitemmodelbase.h"
+
+#include <QFutureWatcher>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QVector>
+
+class KItemListView;
+class QTimer;
+
+/**
+ * @brief Keeps track of the preferred column widths of the visible roles in KItemListView.
+ *
+ * The preferred width of each role is remembered for each item, and the widths
+ * of all items are counted in a histogram with one bucket per pixel. Hence
+ * the preferred column width is available without iterating the items, and
+ * removing items does not require measuring the remaining items again.
+ *
+ * Only inserted and changed items get measured. The measuring is done in
+ * chunks on worker threads. Changed items keep their previous width until
+ * the new width is available, which prevents a flickering of the columns.
+ * If the preferred column widths have been changed, preferredColumnWidthsChanged()
+ * is emitted.
+ */
+class DOLPHIN_EXPORT KItemListColumnWidthTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KItemListColumnWidthTracker(const KItemListView* itemListView);
+    ~KItemListColumnWidthTracker() override;
+
+    /**
+     * If disabled, the items are not measured. Per default the tracker is enabled.
+     */
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    /**
+     * Sets the roles whose widths are tracked. The widths of roles that have
+     * already been tracked before are kept.
+     */
+    void setRoles(const QList<QByteArray>& roles);
+
+    /**
+     * @return Maximum preferred width of all measured items for \a role.
+     */
+    qreal preferredColumnWidth(const QByteArray& role) const;
+
+    /**
+     * @return True if the widths of all items are known.
+     */
+    bool isComplete() const;
+
+    void itemsInserted(const KItemRangeList& itemRanges);
+    void itemsRemoved(const KItemRangeList& itemRanges);
+    void itemsMoved(const KItemRange& range, const QList<int>& movedToIndexes);
+    void itemsChanged(const KItemRangeList& itemRanges);
+
+    /**
+     * Measures all items again, e.g. because the font has been changed.
+     */
+    void invalidate();
+
+Q_SIGNALS:
+    void preferredColumnWidthsChanged();
+
+private Q_SLOTS:
+    void slotTimeout();
+    void slotMeasurementFinished();
+
+private:
+    /**
+     * Widths of one role. A positive width is the measured width of an item.
+     * A negative width is the previous width of an item, which has to be
+     * measured again. 0 is used for items that have never been measured.
+     * The histogram contains the positive and the previous widths.
+     */
+    struct RoleWidths
+    {
+        QByteArray role;
+        QVector<int> widths;
+        QMap<int /* width */, int /* count */> histogram;
+        int unmeasuredCount; // Number of widths that are not positive
+    };
+
+    void startMeasurement();
+    void cancelMeasurement();
+    void scheduleUpdate();
+
+    /**
+     * Moves the resume index of the measurement back to \a index,
+     * if \a index might not be measured anymore.
+     */
+    void resumeAt(int index);
+
+    /**
+     * Applies the measured width \a width to the item \a index of \a roleWidths.
+     */
+    static void applyWidth(RoleWidths& roleWidths, int index, int width);
+    static void addToHistogram(RoleWidths& roleWidths, int width);
+    static void removeFromHistogram(RoleWidths& roleWidths, int width);
+
+    QVector<int> maximumWidths() const;
+
+private:
+    const KItemListView* m_itemListView;
+    bool m_enabled;
+    int m_itemCount;
+    QVector<RoleWidths> m_roleWidths;
+
+    // Maximum widths of the roles when preferredColumnWidthsChanged()
+    // has been emitted the last time.
+    QVector<int> m_emittedMaximumWidths;
+
+    QTimer* m_timer;
+
+    // All items before this index have been measured for all roles, so
+    // startMeasurement() does not need to check them again.
+    int m_resumeIndex;
+
+    QVector<int> m_measuredIndexes;
+    QSet<int> m_invalidatedIndexes;
+    QFutureWatcher<QVector<qreal>>* m_watcher;
+};
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemlisticoncache.h"
+
+#include "kpixmapmodifier.h"
+
+#include <KIconLoader>
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QGuiApplication>
+#include <QMimeDatabase>
+#include <QSet>
+#include <QTimer>
+#include <QtConcurrentRun>
+
+namespace {
+    // Maximum size of all cached pixmaps in KB
+    const int MaxCacheCost = 20 * 1024;
+
+    // Layout of a cache key: The icon name ID uses the upper 32 bits, followed
+    // by 16 bits for the overlay set ID, 14 bits for the size and 2 bits for the mode.
+    const int OverlaySetShift = 16;
+    const int SizeShift = 2;
+    const quint32 MaxOverlaySetId = 0xFFFF;
+    const int MaxSize = 0x3FFF;
+
+    // Maximum time in milliseconds that is spent for rendering prewarmed
+    // icons before the event loop gets the control back.
+    const int MaxRenderTime = 5;
+
+    /**
+     * @return Names of the distinct MIME types for \a fileNames. The MIME types
+     *         are determined by the file names only, so no disk access is required.
+     */
+    QStringList mimeTypeNames(const QStringList& fileNames)
+    {
+        QMimeDatabase db;
+        QSet<QString> names;
+        for (const QString& fileName : fileNames) {
+            names.insert(db.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension).name());
+        }
+        return QStringList(names.constBegin(), names.constEnd());
+    }
+
+    int cost(const QPixmap& pixmap)
+    {
+        return qMax(1, pixmap.width() * pixmap.height() * pixmap.depth() / (8 * 1024));
+    }
+}
+
+class KItemListIconCacheSingleton
+{
+public:
+    KItemListIconCache instance;
+};
+Q_GLOBAL_STATIC(KItemListIconCacheSingleton, s_iconCache)
+
+KItemListIconCache* KItemListIconCache::instance()
+{
+    return &s_iconCache->instance;
+}
+
+KItemListIconCache::KItemListIconCache() :
+    QObject(nullptr),
+    m_iconNameIds(),
+    m_overlaySetIds(),
+    m_pixmaps(MaxCacheCost),
+    m_prewarmSize(0),
+    m_pendingFileNames(),
+    m_pendingIconNames(),
+    m_iconNamesWatcher(new QFutureWatcher<QStringList>(this)),
+    m_renderTimer(new QTimer(this))
+{
+    connect(m_iconNamesWatcher, &QFutureWatcher<QStringList>::finished,
+            this, &KItemListIconCache::slotIconNamesResolved);
+
+    m_renderTimer->setInterval(0);
+    connect(m_renderTimer, &QTimer::timeout,
+            this, &KItemListIconCache::renderPendingIcons);
+
+    // The pixmaps depend on the icon theme
+    connect(KIconLoader::global(), &KIconLoader::iconLoaderSettingsChanged,
+            this, &KItemListIconCache::clear);
+}
+
+KItemListIconCache::~KItemListIconCache()
+{
+    cancelPrewarming();
+}
+
+KItemListIconCache::Key KItemListIconCache::key(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode)
+{
+    // Strangely KFileItem::overlays() returns empty string-values. Sets
+    // that only contain empty values are treated like an empty set.
+    quint32 overlaySetId = 0;
+    for (const QString& overlay : overlays) {
+        if (!overlay.isEmpty()) {
+            auto it = m_overlaySetIds.constFind(overlays);
+            if (it == m_overlaySetIds.constEnd()) {
+                if (quint32(m_overlaySetIds.count()) >= MaxOverlaySetId) {
+                    // No more IDs are available. Start from scratch, as
+                    // the IDs are part of all existing keys.
+                    clear();
+                }
+                it = m_overlaySetIds.insert(overlays, m_overlaySetIds.count() + 1);
+            }
+            overlaySetId = it.value();
+            break;
+        }
+    }
+
+    auto it = m_iconNameIds.constFind(name);
+    if (it == m_iconNameIds.constEnd()) {
+        it = m_iconNameIds.insert(name, m_iconNameIds.count());
+    }
+    const quint32 iconNameId = it.value();
+
+    return (Key(iconNameId) << 32)
+           | (Key(overlaySetId) << OverlaySetShift)
+           | (Key(qBound(0, size, MaxSize)) << SizeShift)
+           | Key(mode);
+}
+
+bool KItemListIconCache::find(Key key, QPixmap& pixmap) const
+{
+    const QPixmap* cachedPixmap = m_pixmaps.object(key);
+    if (cachedPixmap) {
+        pixmap = *cachedPixmap;
+        return true;
+    }
+    return false;
+}
+
+void KItemListIconCache::insert(Key key, const QPixmap& pixmap)
+{
+    m_pixmaps.insert(key, new QPixmap(pixmap), cost(pixmap));
+}
+
+QPixmap KItemListIconCache::pixmap(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode)
+{
+    const Key pixmapKey = key(name, overlays, size, mode);
+    QPixmap pixmap;
+    if (!find(pixmapKey, pixmap)) {
+        pixmap = renderPixmap(name, overlays, size, mode);
+        insert(pixmapKey, pixmap);
+    }
+    return pixmap;
+}
+
+void KItemListIconCache::prewarm(const QStringList& fileNames, int size)
+{
+    size = qBound(1, size, MaxSize);
+    if (size != m_prewarmSize) {
+        cancelPrewarming();
+        m_prewarmSize = size;
+    }
+
+    if (fileNames.isEmpty()) {
+        return;
+    }
+
+    m_pendingFileNames.append(fileNames);
+    if (!m_iconNamesWatcher->isRunning()) {
+        m_iconNamesWatcher->setFuture(QtConcurrent::run(mimeTypeNames, m_pendingFileNames));
+        m_pendingFileNames.clear();
+    }
+}
+
+void KItemListIconCache::clear()
+{
+    cancelPrewarming();
+    m_pixmaps.clear();
+    m_iconNameIds.clear();
+    m_overlaySetIds.clear();
+}
+
+void KItemListIconCache::slotIconNamesResolved()
+{
+    if (m_iconNamesWatcher->isCanceled()) {
+        return;
+    }
+
+    QMimeDatabase db;
+    const QStringList mimeTypes = m_iconNamesWatcher->result();
+    for (const QString& mimeType : mimeTypes) {
+        const QMimeType type = db.mimeTypeForName(mimeType);
+        QString iconName = type.iconName();
+        if (!QIcon::hasThemeIcon(iconName)) {
+            iconName = type.genericIconName();
+        }
+
+        if (!m_pendingIconNames.contains(iconName)
+            && !m_pixmaps.contains(key(iconName, QStringList(), m_prewarmSize, QIcon::Normal))) {
+            m_pendingIconNames.append(iconName);
+        }
+    }
+
+    if (!m_pendingIconNames.isEmpty()) {
+        m_renderTimer->start();
+    }
+
+    if (!m_pendingFileNames.isEmpty()) {
+        m_iconNamesWatcher->setFuture(QtConcurrent::run(mimeTypeNames, m_pendingFileNames));
+        m_pendingFileNames.clear();
+    }
+}
+
+void KItemListIconCache::renderPendingIcons()
+{
+    // The icons are rendered exactly like the icons requested by pixmap(),
+    // so that a prewarmed icon cannot differ from an icon rendered on demand.
+    // Only render a few icons at once to keep the user interface responsive.
+    QElapsedTimer timer;
+    timer.start();
+    while (!m_pendingIconNames.isEmpty() && timer.elapsed() < MaxRenderTime) {
+        pixmap(m_pendingIconNames.takeFirst(), QStringList(), m_prewarmSize, QIcon::Normal);
+    }
+
+    if (m_pendingIconNames.isEmpty()) {
+        m_renderTimer->stop();
+    }
+}
+
+void KItemListIconCache::cancelPrewarming()
+{
+    m_iconNamesWatcher->cancel();
+    m_iconNamesWatcher->setFuture(QFuture<QStringList>());
+    m_renderTimer->stop();
+    m_pendingFileNames.clear();
+    m_pendingIconNames.clear();
+}
+
+QPixmap KItemListIconCache::renderPixmap(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode)
+{
+    static const QIcon fallbackIcon = QIcon::fromTheme(QStringLiteral("unknown"));
+
+    const qreal dpr = qApp->devicePixelRatio();
+
+    QIcon icon = QIcon::fromTheme(name);
+    if (icon.isNull()) {
+        icon = QIcon(name);
+    }
+    if (icon.isNull() || icon.pixmap(size / dpr, size / dpr, mode).isNull()) {
+        icon = fallbackIcon;
+    }
+
+    QPixmap pixmap = icon.pixmap(size / dpr, size / dpr, mode);
+    if (pixmap.width() != size || pixmap.height() != size) {
+        KPixmapModifier::scale(pixmap, QSize(size, size));
+    }
+
+    // Strangely KFileItem::overlays() returns empty string-values, so
+    // we need to check first whether an overlay must be drawn at all.
+    // It is more efficient to do it here, as KIconLoader::drawOverlays()
+    // assumes that an overlay will be drawn and has some additional
+    // setup time.
+    for (const QString& overlay : overlays) {
+        if (!overlay.isEmpty()) {
+            int state = KIconLoader::DefaultState;
+
+            switch (mode) {
+            case QIcon::Normal:
+                break;
+            case QIcon::Active:
+                state = KIconLoader::ActiveState;
+                break;
+            case QIcon::Disabled:
+                state = KIconLoader::DisabledState;
+                break;
+            case QIcon::Selected:
+                state = KIconLoader::SelectedState;
+                break;
+            }
+
+            // There is at least one overlay, draw all overlays above the pixmap
+            // and cancel the check
+            KIconLoader::global()->drawOverlays(overlays, pixmap, KIconLoader::Desktop, state);
+            break;
+        }
+    }
+
+    return pixmap;
+}
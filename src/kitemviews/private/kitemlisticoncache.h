@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTICONCACHE_H
+#define KITEMLISTICONCACHE_H
+
+#include "dolphin_export.h"
+
+#include <QCache>
+#include <QHash>
+#include <QIcon>
+#include <QObject>
+#include <QPixmap>
+#include <QStringList>
+
+class QTimer;
+template<typename T> class QFutureWatcher;
+
+/**
+ * @brief Cache for the icon pixmaps shown by KStandardItemListWidget.
+ *
+ * Icon names and overlay sets are interned to integer IDs, so that the
+ * cache key of a pixmap is a single 64-bit integer built from the icon name
+ * ID, the overlay set ID, the size and the mode. This avoids building and
+ * hashing a string key for each icon lookup.
+ *
+ * Additionally the cache can be prewarmed with the icons for a list of
+ * file names: The MIME types get resolved outside the GUI thread. The icons
+ * get rendered in small portions by the same routine as pixmap() uses, as
+ * QIcon and KIconLoader may only be used in the GUI thread.
+ *
+ * The cache may only be used from the GUI thread.
+ */
+class DOLPHIN_EXPORT KItemListIconCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef quint64 Key;
+
+    static KItemListIconCache* instance();
+
+    /**
+     * @return Cache key for the icon \a name with the overlays \a overlays
+     *         and the size \a size in device pixels.
+     */
+    Key key(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode);
+
+    bool find(Key key, QPixmap& pixmap) const;
+    void insert(Key key, const QPixmap& pixmap);
+
+    /**
+     * @return Pixmap for the icon \a name with the overlays \a overlays and
+     *         the size \a size in device pixels. If the pixmap is not cached
+     *         yet, it gets rendered and inserted into the cache.
+     */
+    QPixmap pixmap(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode);
+
+    /**
+     * Renders the MIME-type icons without overlays for the files \a fileNames
+     * in the background and inserts them into the cache. \a size is given in
+     * device pixels. The files are added to a running prewarming, unless the
+     * prewarming has been started for another size.
+     */
+    void prewarm(const QStringList& fileNames, int size);
+
+    void clear();
+
+protected:
+    ~KItemListIconCache() override;
+
+private Q_SLOTS:
+    void slotIconNamesResolved();
+    void renderPendingIcons();
+
+private:
+    KItemListIconCache();
+
+    void cancelPrewarming();
+
+    static QPixmap renderPixmap(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode);
+
+private:
+    QHash<QString, quint32> m_iconNameIds;
+    QHash<QStringList, quint32> m_overlaySetIds;
+    QCache<Key, QPixmap> m_pixmaps;
+
+    int m_prewarmSize;
+    QStringList m_pendingFileNames;
+    QStringList m_pendingIconNames;
+    QFutureWatcher<QStringList>* m_iconNamesWatcher;
+    QTimer* m_renderTimer;
+
+    friend class KItemListIconCacheSingleton;
+};
+
+#endif
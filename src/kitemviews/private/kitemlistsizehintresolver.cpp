@@ -7,17 +7,36 @@
 #include "kitemlistsizehintresolver.h"
 #include "kitemviews/kitemlistview.h"
 
+namespace {
+    // Minimum number of unresolved items outside the visible range before
+    // their size hints get calculated in the background.
+    const int MinimumDeferredCount = 2000;
+
+    // Number of items that are assumed to be visible if no layout has been
+    // done yet.
+    const int DefaultVisibleCount = 500;
+}
+
 KItemListSizeHintResolver::KItemListSizeHintResolver(const KItemListView* itemListView) :
+    QObject(),
     m_itemListView(itemListView),
     m_logicalHeightHintCache(),
     m_logicalWidthHint(0.0),
     m_minHeightHint(0.0),
-    m_needsResolving(false)
+    m_needsResolving(false),
+    m_firstVisibleIndex(-1),
+    m_lastVisibleIndex(-1),
+    m_deferredIndexes(),
+    m_deferredWatcher(nullptr)
 {
+    m_deferredWatcher = new QFutureWatcher<std::pair<qreal, bool>>(this);
+    connect(m_deferredWatcher, &QFutureWatcher<std::pair<qreal, bool>>::finished,
+            this, &KItemListSizeHintResolver::slotDeferredSizeHintsCalculated);
 }
 
 KItemListSizeHintResolver::~KItemListSizeHintResolver()
 {
+    cancelDeferredCalculation();
 }
 
 QSizeF KItemListSizeHintResolver::minSizeHint()
@@ -29,7 +48,7 @@ QSizeF KItemListSizeHintResolver::minSizeHint()
 QSizeF KItemListSizeHintResolver::sizeHint(int index)
 {
     updateCache();
-    return QSizeF(m_logicalWidthHint, m_logicalHeightHintCache.at(index).first);
+    return QSizeF(m_logicalWidthHint, qAbs(m_logicalHeightHintCache.at(index).first));
 }
 
 bool KItemListSizeHintResolver::isElided(int index)
@@ -39,6 +58,8 @@ bool KItemListSizeHintResolver::isElided(int index)
 
 void KItemListSizeHintResolver::itemsInserted(const KItemRangeList& itemRanges)
 {
+    cancelDeferredCalculation();
+
     int insertedCount = 0;
     for (const KItemRange& range : itemRanges) {
         insertedCount += range.count;
@@ -80,6 +101,8 @@ void KItemListSizeHintResolver::itemsInserted(const KItemRangeList& itemRanges)
 
 void KItemListSizeHintResolver::itemsRemoved(const KItemRangeList& itemRanges)
 {
+    cancelDeferredCalculation();
+
     const QVector<std::pair<qreal, bool>>::iterator begin = m_logicalHeightHintCache.begin();
     const QVector<std::pair<qreal, bool>>::iterator end = m_logicalHeightHintCache.end();
 
@@ -104,6 +127,11 @@ void KItemListSizeHintResolver::itemsRemoved(const KItemRangeList& itemRanges)
     }
 
     m_logicalHeightHintCache.erase(destIt, end);
+    if (m_logicalHeightHintCache.isEmpty()) {
+        // Release the memory if all items have been removed, e.g. when the
+        // items of a hibernated view get released
+        m_logicalHeightHintCache.squeeze();
+    }
 
     // Note that the cache size might temporarily not match the model size if
     // this function is called from KItemListView::setModel() to empty the cache.
@@ -114,6 +142,8 @@ void KItemListSizeHintResolver::itemsRemoved(const KItemRangeList& itemRanges)
 
 void KItemListSizeHintResolver::itemsMoved(const KItemRange& range, const QList<int>& movedToIndexes)
 {
+    cancelDeferredCalculation();
+
     QVector<std::pair<qreal, bool>> newLogicalHeightHintCache(m_logicalHeightHintCache);
 
     const int movedRangeEnd = range.index + range.count;
@@ -139,14 +169,151 @@ void KItemListSizeHintResolver::itemsChanged(int index, int count, const QSet<QB
 
 void KItemListSizeHintResolver::clearCache()
 {
+    cancelDeferredCalculation();
     m_logicalHeightHintCache.fill(std::make_pair(0.0, false));
     m_needsResolving = true;
 }
 
 void KItemListSizeHintResolver::updateCache()
 {
-    if (m_needsResolving) {
+    if (!m_needsResolving) {
+        return;
+    }
+    m_needsResolving = false;
+
+    // Estimated size hints are only unresolved if they are not part
+    // of a running calculation.
+    const bool deferredCalculationRunning = !m_deferredIndexes.isEmpty();
+
+    int firstPriorityIndex = 0;
+    int lastPriorityIndex = DefaultVisibleCount - 1;
+    if (m_firstVisibleIndex >= 0) {
+        // Also resolve one page before and after the visible range synchronously,
+        // so that scrolling does not show estimated size hints.
+        const int visibleCount = m_lastVisibleIndex - m_firstVisibleIndex + 1;
+        firstPriorityIndex = m_firstVisibleIndex - visibleCount;
+        lastPriorityIndex = m_lastVisibleIndex + visibleCount;
+    }
+
+    QVector<int> priorityIndexes;
+    QVector<int> deferredIndexes;
+    const int count = m_logicalHeightHintCache.count();
+    for (int index = 0; index < count; ++index) {
+        const qreal height = m_logicalHeightHintCache.at(index).first;
+        if (height > 0.0 || (height < 0.0 && deferredCalculationRunning)) {
+            continue;
+        }
+
+        if (index >= firstPriorityIndex && index <= lastPriorityIndex) {
+            priorityIndexes.append(index);
+        } else {
+            deferredIndexes.append(index);
+        }
+    }
+
+    if (priorityIndexes.isEmpty() && deferredIndexes.isEmpty()) {
+        return;
+    }
+
+    if (deferredIndexes.count() < MinimumDeferredCount || deferredCalculationRunning) {
+        priorityIndexes.append(deferredIndexes);
+        deferredIndexes.clear();
+    }
+
+    QFuture<std::pair<qreal, bool>> future = m_itemListView->calculateItemSizeHintsConcurrently(priorityIndexes, m_logicalWidthHint);
+    if (future.isCanceled()) {
+        // The widget creator does not support a concurrent calculation
         m_itemListView->calculateItemSizeHints(m_logicalHeightHintCache, m_logicalWidthHint);
-        m_needsResolving = false;
+        return;
+    }
+
+    future.waitForFinished();
+    for (int i = 0; i < priorityIndexes.count(); ++i) {
+        m_logicalHeightHintCache[priorityIndexes.at(i)] = future.resultAt(i);
+    }
+
+    if (deferredIndexes.isEmpty()) {
+        return;
     }
+
+    const qreal estimatedHeight = estimatedLogicalHeight();
+    if (estimatedHeight <= 0.0) {
+        // No reference for an estimation is available, resolve all items synchronously
+        future = m_itemListView->calculateItemSizeHintsConcurrently(deferredIndexes, m_logicalWidthHint);
+        future.waitForFinished();
+        for (int i = 0; i < deferredIndexes.count(); ++i) {
+            m_logicalHeightHintCache[deferredIndexes.at(i)] = future.resultAt(i);
+        }
+        return;
+    }
+
+    for (const int index : qAsConst(deferredIndexes)) {
+        m_logicalHeightHintCache[index] = std::make_pair(-estimatedHeight, false);
+    }
+
+    m_deferredIndexes = deferredIndexes;
+    m_deferredWatcher->setFuture(m_itemListView->calculateItemSizeHintsConcurrently(m_deferredIndexes, m_logicalWidthHint));
+}
+
+void KItemListSizeHintResolver::setVisibleRange(int firstVisibleIndex, int lastVisibleIndex)
+{
+    m_firstVisibleIndex = firstVisibleIndex;
+    m_lastVisibleIndex = lastVisibleIndex;
+}
+
+void KItemListSizeHintResolver::slotDeferredSizeHintsCalculated()
+{
+    if (m_deferredIndexes.isEmpty()) {
+        // The calculation has been canceled
+        return;
+    }
+
+    const QFuture<std::pair<qreal, bool>> future = m_deferredWatcher->future();
+    const int count = m_logicalHeightHintCache.count();
+    for (int i = 0; i < m_deferredIndexes.count(); ++i) {
+        const int index = m_deferredIndexes.at(i);
+        // Items that have been changed in the meantime have been marked as
+        // unresolved and must not get the outdated size hint.
+        if (index < count && m_logicalHeightHintCache.at(index).first < 0.0) {
+            m_logicalHeightHintCache[index] = future.resultAt(i);
+        }
+    }
+    m_deferredIndexes.clear();
+
+    Q_EMIT sizeHintsChanged();
+}
+
+void KItemListSizeHintResolver::cancelDeferredCalculation()
+{
+    if (m_deferredIndexes.isEmpty()) {
+        return;
+    }
+
+    m_deferredWatcher->cancel();
+    m_deferredIndexes.clear();
+
+    // The estimated size hints are resolved again by the next updateCache()
+    m_needsResolving = true;
+}
+
+qreal KItemListSizeHintResolver::estimatedLogicalHeight() const
+{
+    // Use the largest resolved size hint around the visible range as estimation. This
+    // prevents that items get clipped until the real size hints are available.
+    qreal estimatedHeight = 0.0;
+    const int first = qMax(0, m_firstVisibleIndex);
+    const int last = qMin(m_logicalHeightHintCache.count(), first + DefaultVisibleCount);
+    for (int index = first; index < last; ++index) {
+        estimatedHeight = qMax(estimatedHeight, m_logicalHeightHintCache.at(index).first);
+    }
+
+    if (estimatedHeight <= 0.0) {
+        for (const auto& hint : qAsConst(m_logicalHeightHintCache)) {
+            if (hint.first > 0.0) {
+                return hint.first;
+            }
+        }
+    }
+
+    return estimatedHeight;
 }
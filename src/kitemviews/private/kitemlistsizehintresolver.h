@@ -10,6 +10,8 @@
 #include "dolphin_export.h"
 #include "kitemviews/kitemmodelbase.h"
 
+#include <QFutureWatcher>
+#include <QObject>
 #include <QSizeF>
 #include <QVector>
 
@@ -17,9 +19,16 @@ class KItemListView;
 
 /**
  * @brief Calculates and caches the sizehints of items in KItemListView.
+ *
+ * If many items must be resolved at once, only the items around the visible
+ * range get resolved synchronously. The size hints of the remaining items are
+ * estimated and get calculated on worker threads. As soon as the calculation has
+ * been finished, sizeHintsChanged() is emitted so that the view can do a relayout.
  */
-class DOLPHIN_EXPORT KItemListSizeHintResolver
+class DOLPHIN_EXPORT KItemListSizeHintResolver : public QObject
 {
+    Q_OBJECT
+
 public:
     explicit KItemListSizeHintResolver(const KItemListView* itemListView);
     virtual ~KItemListSizeHintResolver();
@@ -35,12 +44,49 @@ public:
     void clearCache();
     void updateCache();
 
+    /**
+     * Sets the range of the currently visible items. The size hints of the
+     * items within this range get resolved before all other items.
+     */
+    void setVisibleRange(int firstVisibleIndex, int lastVisibleIndex);
+
+Q_SIGNALS:
+    /**
+     * Is emitted if the estimated size hints have been replaced by
+     * the size hints calculated on the worker threads.
+     */
+    void sizeHintsChanged();
+
+private Q_SLOTS:
+    void slotDeferredSizeHintsCalculated();
+
+private:
+    /**
+     * Cancels the calculation of the deferred size hints. Must be invoked
+     * whenever the indexes of the cache get changed.
+     */
+    void cancelDeferredCalculation();
+
+    /**
+     * @return Size hint that is used for the items whose size hints
+     *         are still calculated on the worker threads.
+     */
+    qreal estimatedLogicalHeight() const;
+
 private:
     const KItemListView* m_itemListView;
+    // Size hints with a negative height are estimations: The real
+    // size hint is calculated by m_deferredWatcher.
     mutable QVector<std::pair<qreal /* height */, bool /* isElided */>> m_logicalHeightHintCache;
     mutable qreal m_logicalWidthHint;
     mutable qreal m_minHeightHint;
     bool m_needsResolving;
+
+    int m_firstVisibleIndex;
+    int m_lastVisibleIndex;
+
+    QVector<int> m_deferredIndexes;
+    QFutureWatcher<std::pair<qreal, bool>>* m_deferredWatcher;
 };
 
 #endif
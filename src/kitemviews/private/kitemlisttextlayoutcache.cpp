@@ -0,0 +1,212 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemlisttextlayoutcache.h"
+
+#include "kitemlistadvancetable.h"
+
+#include <QFontMetrics>
+#include <QHash>
+#include <QTextLayout>
+
+namespace {
+    // Maximum number of cached layouts. Each entry contains at least one
+    // file name, so the memory consumption stays in the range of a few MB.
+    const int MaxCachedLayouts = 50000;
+
+    // Width of the key for horizontalAdvance(), which does not depend on an available width.
+    const qreal UnlimitedWidth = -1.0;
+
+    // Marks keys of singleLineText() to distinguish them from wrappedText() keys
+    const int SingleLine = -1;
+}
+
+class KItemListTextLayoutCacheSingleton
+{
+public:
+    KItemListTextLayoutCache instance;
+};
+Q_GLOBAL_STATIC(KItemListTextLayoutCacheSingleton, s_textLayoutCache)
+
+uint qHash(const KItemListTextLayoutCache::Key& key, uint seed)
+{
+    return qHash(key.text, seed) ^ qHash(key.fontKey, seed) ^ qHash(key.width, seed) ^ qHash(key.maxLines, seed);
+}
+
+bool KItemListTextLayoutCache::Key::operator==(const Key& other) const
+{
+    return width == other.width
+           && maxLines == other.maxLines
+           && text == other.text
+           && fontKey == other.fontKey;
+}
+
+KItemListTextLayoutCache* KItemListTextLayoutCache::instance()
+{
+    return &s_textLayoutCache->instance;
+}
+
+KItemListTextLayoutCache::Layout KItemListTextLayoutCache::wrappedText(const QString& text, const QFont& font, qreal maxWidth, int maxLines)
+{
+    const Key key{text, font.key(), maxWidth, qMax(0, maxLines)};
+
+    Layout layout;
+    if (!find(key, layout)) {
+        layout = createWrappedText(text, font, maxWidth, maxLines);
+        insert(key, layout);
+    }
+    return layout;
+}
+
+KItemListTextLayoutCache::Layout KItemListTextLayoutCache::singleLineText(const QString& text, const QFont& font, qreal maxWidth)
+{
+    const qreal requiredWidth = horizontalAdvance(text, font);
+    if (requiredWidth <= maxWidth) {
+        // Nothing to elide: The layout is available without an additional lookup.
+        const QFontMetrics fontMetrics(font);
+        return Layout{text, requiredWidth, qreal(fontMetrics.height()), false};
+    }
+
+    const Key key{text, font.key(), maxWidth, SingleLine};
+
+    Layout layout;
+    if (!find(key, layout)) {
+        layout = createSingleLineText(text, font, maxWidth);
+        insert(key, layout);
+    }
+    return layout;
+}
+
+qreal KItemListTextLayoutCache::horizontalAdvance(const QString& text, const QFont& font)
+{
+    // Most texts only contain ASCII characters and can be measured
+    // without a lookup in the cache.
+    const int asciiWidth = KItemListAdvanceTable::forFont(font)->horizontalAdvance(text);
+    if (asciiWidth >= 0) {
+        return asciiWidth;
+    }
+
+    const Key key{text, font.key(), UnlimitedWidth, SingleLine};
+
+    Layout layout;
+    if (!find(key, layout)) {
+        const QFontMetrics fontMetrics(font);
+        layout = Layout{text, qreal(fontMetrics.horizontalAdvance(text)), qreal(fontMetrics.height()), false};
+        insert(key, layout);
+    }
+    return layout.width;
+}
+
+QString KItemListTextLayoutCache::elideRightKeepExtension(const QString& text, const QFontMetrics& fontMetrics, int elidingWidth)
+{
+    const auto extensionIndex = text.lastIndexOf('.');
+    if (extensionIndex != -1) {
+        // has file extension
+        const auto extensionLength = text.length() - extensionIndex;
+        const auto extensionWidth = fontMetrics.horizontalAdvance(text.right(extensionLength));
+        if (elidingWidth > extensionWidth && extensionLength < 6 && (float(extensionWidth) / float(elidingWidth)) < 0.3) {
+            // if we have room to display the file extension and the extension is not too long
+            QString ret = fontMetrics.elidedText(text.chopped(extensionLength),
+                                                 Qt::ElideRight,
+                                                 elidingWidth - extensionWidth);
+            ret.append(text.rightRef(extensionLength));
+            return ret;
+        }
+    }
+    return fontMetrics.elidedText(text, Qt::ElideRight, elidingWidth);
+}
+
+void KItemListTextLayoutCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+}
+
+KItemListTextLayoutCache::KItemListTextLayoutCache() :
+    m_mutex(),
+    m_cache(MaxCachedLayouts)
+{
+}
+
+KItemListTextLayoutCache::~KItemListTextLayoutCache()
+{
+}
+
+bool KItemListTextLayoutCache::find(const Key& key, Layout& layout)
+{
+    QMutexLocker locker(&m_mutex);
+    const Layout* cachedLayout = m_cache.object(key);
+    if (cachedLayout) {
+        layout = *cachedLayout;
+        return true;
+    }
+    return false;
+}
+
+void KItemListTextLayoutCache::insert(const Key& key, const Layout& layout)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(key, new Layout(layout));
+}
+
+KItemListTextLayoutCache::Layout KItemListTextLayoutCache::createWrappedText(const QString& text, const QFont& font, qreal maxWidth, int maxLines)
+{
+    const QFontMetrics fontMetrics(font);
+
+    QTextOption textOption(Qt::AlignHCenter);
+    textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+
+    Layout result{text, 0.0, 0.0, false};
+
+    QTextLayout layout(text, font);
+    layout.setTextOption(textOption);
+    layout.beginLayout();
+    QTextLine line;
+    int lineIndex = 0;
+    while ((line = layout.createLine()).isValid()) {
+        line.setLineWidth(maxWidth);
+        result.width = qMax(result.width, line.naturalTextWidth());
+        result.height += line.height();
+
+        ++lineIndex;
+        if (lineIndex == maxLines) {
+            // The maximum number of textlines has been reached. If this is
+            // the case provide an elided text if necessary.
+            const int textLength = line.textStart() + line.textLength();
+            if (textLength < text.length()) {
+                // Elide the last line of the text
+                qreal elidingWidth = maxWidth;
+                qreal lastLineWidth;
+                do {
+                    QString lastTextLine = text.mid(line.textStart());
+                    lastTextLine = elideRightKeepExtension(lastTextLine, fontMetrics, elidingWidth);
+                    result.text = text.left(line.textStart()) + lastTextLine;
+
+                    lastLineWidth = fontMetrics.horizontalAdvance(lastTextLine);
+
+                    // We do the text eliding in a loop with decreasing width (1 px / iteration)
+                    // to avoid problems related to different width calculation code paths
+                    // within Qt. (see bug 337104)
+                    elidingWidth -= 1.0;
+                } while (lastLineWidth > maxWidth);
+
+                result.width = qMax(result.width, lastLineWidth);
+                result.isElided = true;
+            }
+            break;
+        }
+    }
+    layout.endLayout();
+
+    return result;
+}
+
+KItemListTextLayoutCache::Layout KItemListTextLayoutCache::createSingleLineText(const QString& text, const QFont& font, qreal maxWidth)
+{
+    const QFontMetrics fontMetrics(font);
+    const QString elidedText = elideRightKeepExtension(text, fontMetrics, maxWidth);
+    return Layout{elidedText, qreal(fontMetrics.horizontalAdvance(elidedText)), qreal(fontMetrics.height()), true};
+}
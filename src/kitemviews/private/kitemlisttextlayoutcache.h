@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTTEXTLAYOUTCACHE_H
+#define KITEMLISTTEXTLAYOUTCACHE_H
+
+#include "dolphin_export.h"
+
+#include <QCache>
+#include <QFont>
+#include <QMutex>
+#include <QString>
+
+/**
+ * @brief Process-wide cache for the results of wrapping and eliding texts.
+ *
+ * Wrapping and eliding file names is expensive and is done for the same
+ * texts again and again: by KStandardItemListWidgetInformant when calculating
+ * the size hints, and by KStandardItemListWidget whenever a widget gets
+ * recycled for another index or gets resized. The results are cached in a
+ * least-recently-used manner and are keyed by the text, the font, the
+ * available width and the maximum number of lines.
+ *
+ * The cache may be used from any thread. The passed fonts must be owned
+ * by the calling thread.
+ */
+class DOLPHIN_EXPORT KItemListTextLayoutCache
+{
+public:
+    struct Layout
+    {
+        QString text;   // Text that should be shown, elided if required
+        qreal width;    // Width of the widest line of 'text'
+        qreal height;   // Height of all lines of 'text'
+        bool isElided;
+    };
+
+    static KItemListTextLayoutCache* instance();
+
+    /**
+     * @return Layout of \a text wrapped at word boundaries into lines with
+     *         the width \a maxWidth. If more than \a maxLines lines are
+     *         required, the last line gets elided. A value <= 0 for \a maxLines
+     *         means that the number of lines is not limited.
+     */
+    Layout wrappedText(const QString& text, const QFont& font, qreal maxWidth, int maxLines);
+
+    /**
+     * @return Layout of \a text shown in one line. If \a text does not fit into
+     *         \a maxWidth, it gets elided while keeping the file extension visible.
+     */
+    Layout singleLineText(const QString& text, const QFont& font, qreal maxWidth);
+
+    /**
+     * @return Width of \a text shown in one line.
+     */
+    qreal horizontalAdvance(const QString& text, const QFont& font);
+
+    /**
+     * Elides \a text at the right, but keeps a short file extension visible
+     * if possible.
+     */
+    static QString elideRightKeepExtension(const QString& text, const QFontMetrics& fontMetrics, int elidingWidth);
+
+    void clear();
+
+private:
+    KItemListTextLayoutCache();
+    ~KItemListTextLayoutCache();
+
+    struct Key
+    {
+        QString text;
+        QString fontKey;
+        qreal width;
+        int maxLines;
+
+        bool operator==(const Key& other) const;
+    };
+    friend uint qHash(const Key& key, uint seed);
+
+    bool find(const Key& key, Layout& layout);
+    void insert(const Key& key, const Layout& layout);
+
+    static Layout createWrappedText(const QString& text, const QFont& font, qreal maxWidth, int maxLines);
+    static Layout createSingleLineText(const QString& text, const QFont& font, qreal maxWidth);
+
+private:
+    QMutex m_mutex;
+    QCache<Key, Layout> m_cache;
+
+    friend class KItemListTextLayoutCacheSingleton;
+};
+
+#endif
@@ -12,12 +12,15 @@
 #include <QGuiApplication>
 #include <QScopeGuard>
 
+#include <limits>
+
 // #define KITEMLISTVIEWLAYOUTER_DEBUG
 
 KItemListViewLayouter::KItemListViewLayouter(KItemListSizeHintResolver* sizeHintResolver, QObject* parent) :
     QObject(parent),
     m_dirty(true),
     m_visibleIndexesDirty(true),
+    m_layoutGeneration(0),
     m_scrollOrientation(Qt::Vertical),
     m_size(),
     m_itemSize(128, 128),
@@ -311,6 +314,56 @@ int KItemListViewLayouter::itemRow(int index) const
             : m_itemInfos[index].column;
 }
 
+KItemRange KItemListViewLayouter::itemRangeForInterval(qreal from, qreal to) const
+{
+    const_cast<KItemListViewLayouter*>(this)->doLayout();
+    const int itemCount = m_itemInfos.count();
+    if (itemCount <= 0 || from > to) {
+        return KItemRange();
+    }
+
+    from += m_scrollOffset;
+    to += m_scrollOffset;
+
+    // A row ends where the next row starts. m_rowOffsets might contain
+    // more entries than rows, so the last row is taken from the last item.
+    const int lastRow = m_itemInfos.last().row;
+    const auto rowEnd = [this, lastRow](int index) {
+        const int row = m_itemInfos.at(index).row;
+        return (row < lastRow) ? m_rowOffsets.at(row + 1) : std::numeric_limits<qreal>::max();
+    };
+
+    // The first item whose row ends behind 'from'
+    int min = 0;
+    int max = itemCount;
+    while (min < max) {
+        const int mid = (min + max) / 2;
+        if (rowEnd(mid) >= from) {
+            max = mid;
+        } else {
+            min = mid + 1;
+        }
+    }
+    const int firstIndex = min;
+
+    // The first item whose row starts behind 'to'
+    max = itemCount;
+    while (min < max) {
+        const int mid = (min + max) / 2;
+        if (m_rowOffsets.at(m_itemInfos.at(mid).row) > to) {
+            max = mid;
+        } else {
+            min = mid + 1;
+        }
+    }
+    const int lastIndex = min - 1;
+
+    if (lastIndex < firstIndex) {
+        return KItemRange();
+    }
+    return KItemRange(firstIndex, lastIndex - firstIndex + 1);
+}
+
 int KItemListViewLayouter::maximumVisibleItems() const
 {
     const_cast<KItemListViewLayouter*>(this)->doLayout();
@@ -336,6 +389,12 @@ void KItemListViewLayouter::markAsDirty()
     m_dirty = true;
 }
 
+int KItemListViewLayouter::layoutGeneration() const
+{
+    const_cast<KItemListViewLayouter*>(this)->doLayout();
+    return m_layoutGeneration;
+}
+
 
 #ifndef QT_NO_DEBUG
     bool KItemListViewLayouter::isDirty()
@@ -358,6 +417,7 @@ void KItemListViewLayouter::doLayout()
     timer.start();
 #endif
     m_visibleIndexesDirty = true;
+    ++m_layoutGeneration;
 
     QSizeF itemSize = m_itemSize;
     QSizeF itemMargin = m_itemMargin;
@@ -8,6 +8,7 @@
 #define KITEMLISTVIEWLAYOUTER_H
 
 #include "dolphin_export.h"
+#include "kitemviews/kitemrange.h"
 
 #include <QObject>
 #include <QRectF>
@@ -131,6 +132,17 @@ public:
      */
     int itemRow(int index) const;
 
+    /**
+     * @return Range of the items whose rows intersect the interval
+     *         [\a from, \a to] in scroll-direction. The interval is given
+     *         in the same coordinates as itemRect(). The range is determined
+     *         by binary searches over the row offsets, so it may contain
+     *         items of the border rows that don't reach into the interval
+     *         themselves. An empty range is returned if no row intersects
+     *         the interval.
+     */
+    KItemRange itemRangeForInterval(qreal from, qreal to) const;
+
     /**
      * @return Maximum number of (at least partly) visible items for
      *         the given size.
@@ -149,6 +161,13 @@ public:
      */
     void markAsDirty();
 
+    /**
+     * @return Number of layouts that have been done. Allows to check
+     *         whether the item rectangles might have been changed since
+     *         they have been read.
+     */
+    int layoutGeneration() const;
+
     inline int columnCount() const
     {
         return m_columnCount;
@@ -181,6 +200,7 @@ private:
 private:
     bool m_dirty;
     bool m_visibleIndexesDirty;
+    int m_layoutGeneration;
 
     Qt::Orientation m_scrollOrientation;
     QSizeF m_size;
@@ -0,0 +1,1208 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "klocaldirlister.h"
+
+#include <KDirNotify>
+#include <KDirWatch>
+#include <KIO/UDSEntry>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrlQuery>
+#include <QtConcurrent>
+
+#include <qplatformdefs.h>
+
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <limits.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+namespace {
+    // Size of the buffer for reading the entries of a directory
+    const int ReadBufferSize = 1024 * 1024;
+
+    // The listed items are emitted if there are that many or if
+    // BatchInterval ms have passed since the last items were emitted
+    const int BatchSize = 5000;
+    const int BatchInterval = 100;
+
+    // Delay in ms for updating a changed directory. Changes
+    // during the delay are handled by the same update.
+    const int UpdateDelay = 500;
+
+    // Limits of recursive listings
+    const int MaxRecursionDepth = 64;
+    const int MaxRecursiveItemCount = 1000000;
+
+    QThreadPool* threadPool()
+    {
+        // The pool is leaked intentionally, as deleting it would
+        // wait for listings that hang on dead network mounts
+        static QThreadPool* pool = [] {
+            QThreadPool* pool = new QThreadPool();
+            pool->setMaxThreadCount(2);
+            return pool;
+        }();
+        return pool;
+    }
+
+    QThreadPool* recursiveThreadPool()
+    {
+        // Recursive listings and searches read many small directories, which
+        // benefits from several concurrent requests even on a single disk.
+        // Each directory is a task of the pool, so idle threads take over the
+        // directories found by the busy ones.
+        static QThreadPool* pool = [] {
+            QThreadPool* pool = new QThreadPool();
+            pool->setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+            return pool;
+        }();
+        return pool;
+    }
+
+    bool isFileNameSearchUrl(const QUrl& url)
+    {
+        return url.scheme() == QLatin1String("filenamesearch");
+    }
+
+    struct NameMatches
+    {
+        using result_type = bool;
+
+        explicit NameMatches(const KFileNameMatcher& matcher) : matcher(matcher) {}
+        bool operator()(const KFileItem& item) const { return matcher.matches(item.name()); }
+
+        KFileNameMatcher matcher;
+    };
+
+    QUrl searchedDirectory(const QUrl& searchUrl)
+    {
+        const QUrlQuery query(searchUrl);
+        return QUrl::fromUserInput(query.queryItemValue(QStringLiteral("url")), QString(), QUrl::AssumeLocalFile)
+                   .adjusted(QUrl::StripTrailingSlash);
+    }
+}
+
+struct KLocalDirLister::Listing
+{
+    bool recursive = false;
+    bool showingDotFiles = false;
+    KFileNameMatcher nameMatcher; // Only valid for searches
+    QAtomicInt canceled;
+    QAtomicInt itemsPassed;
+    QAtomicInt truncated;
+
+    // Number of directories that are still read, and
+    // number of items of a recursive listing
+    QAtomicInt pendingReaders = 1;
+    QAtomicInt itemCount;
+
+    // For updates of a watched directory: The items of the previous listing
+    // and the inodes of their entries. Entries with the same inode are not
+    // stated again, unless their names are in changedNames. If
+    // changedEntriesOnly is set, only the entries in changedNames are read.
+    QHash<QString, KFileItem> knownItems;
+    QHash<QString, quint64> knownInodes;
+    QSet<QString> changedNames;
+    bool changedEntriesOnly = false;
+
+    // Protects the members below. lister is reset when the listing is canceled.
+    QMutex mutex;
+    KLocalDirLister* lister = nullptr;
+    KFileItemList items; // Listed items that have not been passed to lister yet
+    QElapsedTimer batchTimer;
+    KFileItem rootItem;
+    QHash<QString, quint64> inodes; // Only set for listings that are not recursive
+    bool success = true;
+};
+
+#ifdef Q_OS_UNIX
+/**
+ * Reads the entries of a directory in a thread and passes the items to
+ * the KLocalDirLister that has started the listing, as long as the
+ * listing has not been canceled. For recursive listings, the readers of
+ * the sub-directories are started, and the items of all readers are
+ * passed in common batches.
+ */
+class LocalDirectoryReader : public QRunnable
+{
+public:
+    LocalDirectoryReader(const QSharedPointer<KLocalDirLister::Listing>& listing, const QUrl& url, int depth);
+
+    void run() override;
+
+private:
+    struct FileStat
+    {
+        mode_t mode;
+        uid_t uid;
+        gid_t gid;
+        qint64 size;
+        qint64 accessTime;
+        qint64 modificationTime;
+        qint64 creationTime;
+        quint64 inode;
+    };
+
+    bool readDirectory();
+    bool readEntries(int dirFd);
+
+    /**
+     * Adds the entry \a name. \a type and \a inode are 0 if they are unknown.
+     */
+    void addEntry(int dirFd, const char* name, unsigned char type, quint64 inode);
+    void addItem(const KFileItem& item);
+    void readSubDirectory(const char* name);
+    bool createEntry(int dirFd, const char* name, KIO::UDSEntry& entry, quint64* inode = nullptr);
+    bool statEntry(int dirFd, const char* name, bool followLinks, FileStat& stat) const;
+    QString userName(uid_t uid);
+    QString groupName(gid_t gid);
+
+    /**
+     * Passes the items to the lister like passItems().
+     */
+    void flushItems(bool force);
+    void finish(bool success);
+
+    /**
+     * Passes the items to the lister if \a force is true or if the
+     * batch is complete. m_listing->mutex must be locked.
+     */
+    void passItems(bool force);
+
+private:
+    QSharedPointer<KLocalDirLister::Listing> m_listing;
+    QUrl m_url;
+    int m_depth;
+    KFileItemList m_items;
+    QElapsedTimer m_batchTimer;
+    QHash<uid_t, QString> m_userNames;
+    QHash<gid_t, QString> m_groupNames;
+    QHash<QString, quint64> m_inodes;
+};
+
+LocalDirectoryReader::LocalDirectoryReader(const QSharedPointer<KLocalDirLister::Listing>& listing, const QUrl& url, int depth) :
+    m_listing(listing),
+    m_url(url),
+    m_depth(depth),
+    m_items(),
+    m_batchTimer(),
+    m_userNames(),
+    m_groupNames(),
+    m_inodes()
+{
+}
+
+void LocalDirectoryReader::run()
+{
+    const bool success = !m_listing->canceled.loadRelaxed() && readDirectory();
+    finish(success);
+}
+
+bool LocalDirectoryReader::readDirectory()
+{
+    const QByteArray path = QFile::encodeName(m_url.toLocalFile());
+    const int dirFd = ::open(path.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return false;
+    }
+
+    if (m_depth == 0) {
+        KIO::UDSEntry rootEntry;
+        if (!createEntry(dirFd, ".", rootEntry)) {
+            ::close(dirFd);
+            return false;
+        }
+
+        QMutexLocker locker(&m_listing->mutex);
+        m_listing->rootItem = KFileItem(rootEntry, m_url, true, true);
+    }
+
+    m_batchTimer.start();
+
+    if (m_listing->changedEntriesOnly) {
+        for (const QString& name : qAsConst(m_listing->changedNames)) {
+            addEntry(dirFd, QFile::encodeName(name).constData(), 0, 0);
+        }
+        ::close(dirFd);
+        return true;
+    }
+
+    return readEntries(dirFd);
+}
+
+bool LocalDirectoryReader::readEntries(int dirFd)
+{
+#ifdef Q_OS_LINUX
+    // getdents64() fills a large buffer with one system call, while
+    // readdir() uses a buffer of only a few kilobytes
+    struct LinuxDirent64
+    {
+        quint64 d_ino;
+        qint64 d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+
+    // Recursive listings read many small directories, so each thread of the
+    // pools keeps its buffer instead of allocating one for every directory
+    thread_local QByteArray buffer(ReadBufferSize, Qt::Uninitialized);
+    while (true) {
+        const long count = ::syscall(SYS_getdents64, dirFd, buffer.data(), buffer.size());
+        if (count < 0) {
+            ::close(dirFd);
+            return false;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        for (long offset = 0; offset < count;) {
+            const auto* dirent = reinterpret_cast<const LinuxDirent64*>(buffer.constData() + offset);
+            offset += dirent->d_reclen;
+            addEntry(dirFd, dirent->d_name, dirent->d_type, dirent->d_ino);
+        }
+
+        if (m_listing->canceled.loadRelaxed()) {
+            break;
+        }
+    }
+
+    ::close(dirFd);
+    return true;
+#else
+    DIR* dir = ::fdopendir(dirFd);
+    if (!dir) {
+        ::close(dirFd);
+        return false;
+    }
+
+    while (const dirent* entry = ::readdir(dir)) {
+#ifdef DT_UNKNOWN
+        addEntry(dirFd, entry->d_name, entry->d_type, entry->d_ino);
+#else
+        addEntry(dirFd, entry->d_name, 0, entry->d_ino);
+#endif
+        if (m_listing->canceled.loadRelaxed()) {
+            break;
+        }
+    }
+
+    // Closes dirFd, too
+    ::closedir(dir);
+    return true;
+#endif
+}
+
+void LocalDirectoryReader::addEntry(int dirFd, const char* name, unsigned char type, quint64 inode)
+{
+    if (qstrcmp(name, ".") == 0 || qstrcmp(name, "..") == 0) {
+        return;
+    }
+
+    if (!m_listing->recursive && inode != 0 && !m_listing->knownItems.isEmpty()) {
+        // Files that are replaced, e.g. by saving them atomically, get a new
+        // inode. Files that are changed in place are reported by KDirWatch.
+        const QString fileName = QFile::decodeName(name);
+        const auto it = m_listing->knownItems.constFind(fileName);
+        if (it != m_listing->knownItems.constEnd() && m_listing->knownInodes.value(fileName) == inode
+                && !m_listing->changedNames.contains(fileName)) {
+            m_inodes.insert(fileName, inode);
+            addItem(*it);
+            return;
+        }
+    }
+
+    const bool searching = m_listing->nameMatcher.isValid();
+    bool matched = false;
+#ifdef DT_UNKNOWN
+    if (searching && type != DT_UNKNOWN) {
+        // Stating the entries is most of the work of a listing, so only
+        // matching entries are stated if the type is known without it
+        if (!m_listing->nameMatcher.matches(QFile::decodeName(name))) {
+            if (type == DT_DIR) {
+                readSubDirectory(name);
+            }
+            return;
+        }
+        matched = true;
+    }
+#else
+    Q_UNUSED(type)
+#endif
+
+    KIO::UDSEntry entry;
+    quint64 statedInode = 0;
+    if (!createEntry(dirFd, name, entry, &statedInode)) {
+        // The entry has been removed while listing
+        return;
+    }
+
+    if (m_listing->recursive) {
+        // For recursive listings only the files of the sub-directories are
+        // listed, searches list the matching directories, too. Symbolic
+        // links to directories are not followed to prevent loops.
+        const mode_t fileType = entry.numberValue(KIO::UDSEntry::UDS_FILE_TYPE);
+        if (S_ISDIR(fileType) && !entry.contains(KIO::UDSEntry::UDS_LINK_DEST)) {
+            readSubDirectory(name);
+            if (!searching) {
+                return;
+            }
+        }
+        if (searching && !matched && !m_listing->nameMatcher.matches(entry.stringValue(KIO::UDSEntry::UDS_NAME))) {
+            return;
+        }
+        if (m_listing->itemCount.fetchAndAddRelaxed(1) >= MaxRecursiveItemCount) {
+            m_listing->truncated.storeRelaxed(1);
+            return;
+        }
+    } else {
+        m_inodes.insert(entry.stringValue(KIO::UDSEntry::UDS_NAME), statedInode);
+    }
+
+    // The MIME types are determined later by KFileItemModelRolesUpdater,
+    // as KDirLister does it when delayed MIME types are enabled
+    addItem(KFileItem(entry, m_url, true, true));
+}
+
+void LocalDirectoryReader::addItem(const KFileItem& item)
+{
+    m_items.append(item);
+
+    // The first results of a search are passed immediately, without
+    // waiting for a complete batch
+    const bool firstResults = m_listing->nameMatcher.isValid() && !m_listing->itemsPassed.loadRelaxed();
+    if (firstResults || m_items.count() >= BatchSize || m_batchTimer.elapsed() >= BatchInterval) {
+        flushItems(firstResults);
+    }
+}
+
+void LocalDirectoryReader::readSubDirectory(const char* name)
+{
+    // Hidden directories like .git often contain lots of files nobody is
+    // interested in, so they are only read if hidden files are shown
+    if (m_depth >= MaxRecursionDepth || (name[0] == '.' && !m_listing->showingDotFiles)) {
+        return;
+    }
+    if (m_listing->itemCount.loadRelaxed() >= MaxRecursiveItemCount) {
+        m_listing->truncated.storeRelaxed(1);
+        return;
+    }
+
+    QString path = m_url.toLocalFile();
+    if (!path.endsWith(QLatin1Char('/'))) {
+        path.append(QLatin1Char('/'));
+    }
+    path.append(QFile::decodeName(name));
+
+    // The listing is finished when the last reader has been finished
+    m_listing->pendingReaders.ref();
+    recursiveThreadPool()->start(new LocalDirectoryReader(m_listing, QUrl::fromLocalFile(path), m_depth + 1));
+}
+
+bool LocalDirectoryReader::createEntry(int dirFd, const char* name, KIO::UDSEntry& entry, quint64* inode)
+{
+    FileStat stat;
+    if (!statEntry(dirFd, name, false, stat)) {
+        return false;
+    }
+    if (inode) {
+        *inode = stat.inode;
+    }
+
+    // Like the file worker, describe symbolic links by their target
+    // and keep the properties of the link if the target is missing
+    QString linkDest;
+    if (S_ISLNK(stat.mode)) {
+        char target[PATH_MAX];
+        const ssize_t length = ::readlinkat(dirFd, name, target, sizeof(target));
+        if (length > 0) {
+            linkDest = QFile::decodeName(QByteArray(target, length));
+        }
+
+        FileStat targetStat;
+        if (statEntry(dirFd, name, true, targetStat)) {
+            stat = targetStat;
+        }
+    }
+
+    entry.reserve(linkDest.isEmpty() ? 9 : 10);
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, QFile::decodeName(name));
+    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, stat.mode & S_IFMT);
+    entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, stat.mode & 07777);
+    entry.fastInsert(KIO::UDSEntry::UDS_SIZE, stat.size);
+    entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, stat.modificationTime);
+    entry.fastInsert(KIO::UDSEntry::UDS_ACCESS_TIME, stat.accessTime);
+    if (stat.creationTime >= 0) {
+        entry.fastInsert(KIO::UDSEntry::UDS_CREATION_TIME, stat.creationTime);
+    }
+    entry.fastInsert(KIO::UDSEntry::UDS_USER, userName(stat.uid));
+    entry.fastInsert(KIO::UDSEntry::UDS_GROUP, groupName(stat.gid));
+    if (!linkDest.isEmpty()) {
+        entry.fastInsert(KIO::UDSEntry::UDS_LINK_DEST, linkDest);
+    }
+    return true;
+}
+
+bool LocalDirectoryReader::statEntry(int dirFd, const char* name, bool followLinks, FileStat& stat) const
+{
+#if defined(Q_OS_LINUX) && defined(STATX_BASIC_STATS)
+    // Unlike fstatat(), statx() provides the creation time. Automounts are
+    // not triggered, as the listed directory might contain many of them.
+    struct statx buffer;
+    const int flags = AT_NO_AUTOMOUNT | (followLinks ? 0 : AT_SYMLINK_NOFOLLOW);
+    if (::statx(dirFd, name, flags, STATX_BASIC_STATS | STATX_BTIME, &buffer) != 0) {
+        return false;
+    }
+
+    stat.mode = buffer.stx_mode;
+    stat.uid = buffer.stx_uid;
+    stat.gid = buffer.stx_gid;
+    stat.size = buffer.stx_size;
+    stat.accessTime = buffer.stx_atime.tv_sec;
+    stat.modificationTime = buffer.stx_mtime.tv_sec;
+    stat.creationTime = (buffer.stx_mask & STATX_BTIME) ? buffer.stx_btime.tv_sec : -1;
+    stat.inode = buffer.stx_ino;
+#else
+    struct stat buffer;
+    if (::fstatat(dirFd, name, &buffer, followLinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+
+    stat.mode = buffer.st_mode;
+    stat.uid = buffer.st_uid;
+    stat.gid = buffer.st_gid;
+    stat.size = buffer.st_size;
+    stat.accessTime = buffer.st_atime;
+    stat.modificationTime = buffer.st_mtime;
+    stat.creationTime = -1;
+    stat.inode = buffer.st_ino;
+#endif
+    return true;
+}
+
+QString LocalDirectoryReader::userName(uid_t uid)
+{
+    auto it = m_userNames.constFind(uid);
+    if (it != m_userNames.constEnd()) {
+        return *it;
+    }
+
+    QString name = QString::number(uid);
+    struct passwd entry;
+    struct passwd* result = nullptr;
+    char buffer[4096];
+    if (::getpwuid_r(uid, &entry, buffer, sizeof(buffer), &result) == 0 && result) {
+        name = QString::fromLocal8Bit(result->pw_name);
+    }
+    m_userNames.insert(uid, name);
+    return name;
+}
+
+QString LocalDirectoryReader::groupName(gid_t gid)
+{
+    auto it = m_groupNames.constFind(gid);
+    if (it != m_groupNames.constEnd()) {
+        return *it;
+    }
+
+    QString name = QString::number(gid);
+    struct group entry;
+    struct group* result = nullptr;
+    char buffer[4096];
+    if (::getgrgid_r(gid, &entry, buffer, sizeof(buffer), &result) == 0 && result) {
+        name = QString::fromLocal8Bit(result->gr_name);
+    }
+    m_groupNames.insert(gid, name);
+    return name;
+}
+
+void LocalDirectoryReader::flushItems(bool force)
+{
+    m_batchTimer.restart();
+
+    QMutexLocker locker(&m_listing->mutex);
+    passItems(force);
+}
+
+void LocalDirectoryReader::finish(bool success)
+{
+    QMutexLocker locker(&m_listing->mutex);
+
+    // Sub-directories that cannot be read are skipped
+    if (!success && m_depth == 0) {
+        m_listing->success = false;
+    }
+
+    if (!m_listing->recursive) {
+        m_listing->inodes.swap(m_inodes);
+    }
+
+    const bool finished = !m_listing->pendingReaders.deref();
+    passItems(finished);
+    if (!finished) {
+        return;
+    }
+
+    if (KLocalDirLister* lister = m_listing->lister) {
+        const QSharedPointer<KLocalDirLister::Listing> listing = m_listing;
+        const KFileItem rootItem = m_listing->success ? m_listing->rootItem : KFileItem();
+        const bool success = m_listing->success;
+        QMetaObject::invokeMethod(lister, [lister, listing, rootItem, success]() {
+            lister->slotListingFinished(listing, rootItem, success);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void LocalDirectoryReader::passItems(bool force)
+{
+    m_listing->items.append(m_items);
+    m_items.clear();
+
+    if (m_listing->items.isEmpty()) {
+        return;
+    }
+    if (!force && m_listing->items.count() < BatchSize && m_listing->batchTimer.elapsed() < BatchInterval) {
+        return;
+    }
+
+    const KFileItemList items = m_listing->items;
+    m_listing->items.clear();
+    m_listing->batchTimer.restart();
+    m_listing->itemsPassed.storeRelaxed(1);
+
+    if (KLocalDirLister* lister = m_listing->lister) {
+        const QSharedPointer<KLocalDirLister::Listing> listing = m_listing;
+        QMetaObject::invokeMethod(lister, [lister, listing, items]() {
+            lister->slotItemsListed(listing, items);
+        }, Qt::QueuedConnection);
+    }
+}
+#endif
+
+KLocalDirLister::KLocalDirLister(QObject* parent) :
+    QObject(parent),
+    m_url(),
+    m_directoryUrl(),
+    m_nameMatcher(),
+    m_rootItem(),
+    m_listing(),
+    m_updating(false),
+    m_items(),
+    m_listedItems(),
+    m_showingDotFiles(false),
+    m_autoUpdate(true),
+    m_recursive(false),
+    m_truncated(false),
+    m_updatePending(false),
+    m_directoryChanged(false),
+    m_changedNames(),
+    m_inodes(),
+    m_watchedPath(),
+    m_updateTimer(nullptr)
+{
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(UpdateDelay);
+    connect(m_updateTimer, &QTimer::timeout, this, &KLocalDirLister::slotUpdateTimeout);
+
+    KDirWatch* dirWatch = KDirWatch::self();
+    connect(dirWatch, &KDirWatch::dirty, this, &KLocalDirLister::slotDirectoryChanged);
+    connect(dirWatch, &KDirWatch::created, this, &KLocalDirLister::slotDirectoryChanged);
+    connect(dirWatch, &KDirWatch::deleted, this, &KLocalDirLister::slotDirectoryChanged);
+
+    org::kde::KDirNotify* dirNotify = new org::kde::KDirNotify(QString(), QString(),
+                                                               QDBusConnection::sessionBus(), this);
+    connect(dirNotify, &OrgKdeKDirNotifyInterface::FilesAdded, this, &KLocalDirLister::slotFilesAdded);
+    connect(dirNotify, &OrgKdeKDirNotifyInterface::FilesRemoved, this, &KLocalDirLister::slotFilesRemoved);
+    connect(dirNotify, &OrgKdeKDirNotifyInterface::FileRenamed, this, &KLocalDirLister::slotFileRenamed);
+}
+
+KLocalDirLister::~KLocalDirLister()
+{
+    cancelListing();
+    watch(QString());
+}
+
+bool KLocalDirLister::isSupported(const QUrl& url)
+{
+#ifdef Q_OS_UNIX
+    if (isFileNameSearchUrl(url)) {
+        // Searching the contents of files is left to the filenamesearch worker
+        const QUrlQuery query(url);
+        return KFileNameMatcher(query.queryItemValue(QStringLiteral("search"))).isValid()
+            && query.queryItemValue(QStringLiteral("checkContent")) != QLatin1String("yes")
+            && searchedDirectory(url).isLocalFile();
+    }
+    return url.isLocalFile();
+#else
+    Q_UNUSED(url)
+    return false;
+#endif
+}
+
+void KLocalDirLister::openUrl(const QUrl& url)
+{
+    if (refineSearch(url)) {
+        return;
+    }
+
+    cancelListing();
+    m_updateTimer->stop();
+    m_updatePending = false;
+
+    m_url = url.adjusted(QUrl::StripTrailingSlash);
+    if (isFileNameSearchUrl(m_url)) {
+        m_directoryUrl = searchedDirectory(m_url);
+        m_nameMatcher = KFileNameMatcher(QUrlQuery(m_url).queryItemValue(QStringLiteral("search")));
+    } else {
+        m_directoryUrl = m_url;
+        m_nameMatcher = KFileNameMatcher();
+    }
+    m_rootItem = KFileItem();
+    m_truncated = false;
+    m_items.clear();
+    m_listedItems.clear();
+    m_inodes.clear();
+    Q_EMIT clear();
+
+    // Watch the directory before listing it, so that no change gets lost
+    watch(isWatching() ? m_url.toLocalFile() : QString());
+    startListing(false);
+}
+
+void KLocalDirLister::stop()
+{
+    m_updateTimer->stop();
+    m_updatePending = false;
+    if (!m_listing) {
+        return;
+    }
+
+    const bool updating = m_updating;
+    cancelListing();
+    if (!updating) {
+        // Later changes of the directory are compared to the items
+        // that have been emitted until now
+        for (const KFileItem& item : qAsConst(m_listedItems)) {
+            m_items.insert(itemKey(item), item);
+        }
+        m_listedItems.clear();
+        Q_EMIT canceled();
+    }
+}
+
+void KLocalDirLister::close()
+{
+    cancelListing();
+    m_updateTimer->stop();
+    m_updatePending = false;
+    watch(QString());
+
+    m_url.clear();
+    m_directoryUrl.clear();
+    m_nameMatcher = KFileNameMatcher();
+    m_rootItem = KFileItem();
+    m_truncated = false;
+    m_items.clear();
+    m_listedItems.clear();
+    m_inodes.clear();
+}
+
+QUrl KLocalDirLister::url() const
+{
+    return m_url;
+}
+
+KFileItem KLocalDirLister::rootItem() const
+{
+    return m_rootItem;
+}
+
+bool KLocalDirLister::isFinished() const
+{
+    return !m_listing;
+}
+
+void KLocalDirLister::setShowingDotFiles(bool show)
+{
+    if (m_showingDotFiles == show) {
+        return;
+    }
+    m_showingDotFiles = show;
+
+    if (m_recursive || isSearching()) {
+        // Hidden directories are only read if hidden files are shown,
+        // and their files are not hidden themselves
+        if (!m_url.isEmpty()) {
+            openUrl(m_url);
+        }
+        return;
+    }
+
+    // While the directory is listed for the first time, the items
+    // listed so far have been emitted already
+    KFileItemList hiddenItems;
+    if (m_listing && !m_updating) {
+        for (const KFileItem& item : qAsConst(m_listedItems)) {
+            if (item.isHidden()) {
+                hiddenItems.append(item);
+            }
+        }
+    } else {
+        for (const KFileItem& item : qAsConst(m_items)) {
+            if (item.isHidden()) {
+                hiddenItems.append(item);
+            }
+        }
+    }
+
+    if (hiddenItems.isEmpty()) {
+        return;
+    }
+
+    if (show) {
+        Q_EMIT itemsAdded(m_url, hiddenItems);
+    } else {
+        Q_EMIT itemsDeleted(hiddenItems);
+    }
+}
+
+bool KLocalDirLister::showingDotFiles() const
+{
+    return m_showingDotFiles;
+}
+
+void KLocalDirLister::setAutoUpdate(bool enable)
+{
+    m_autoUpdate = enable;
+    watch(isWatching() && !m_url.isEmpty() ? m_url.toLocalFile() : QString());
+}
+
+bool KLocalDirLister::autoUpdate() const
+{
+    return m_autoUpdate;
+}
+
+void KLocalDirLister::setRecursive(bool recursive)
+{
+    m_recursive = recursive;
+    watch(isWatching() && !m_url.isEmpty() ? m_url.toLocalFile() : QString());
+}
+
+bool KLocalDirLister::isRecursive() const
+{
+    return m_recursive;
+}
+
+bool KLocalDirLister::isSearching() const
+{
+    return m_nameMatcher.isValid();
+}
+
+bool KLocalDirLister::isTruncated() const
+{
+    return m_truncated;
+}
+
+bool KLocalDirLister::canRefineSearch(const QUrl& url) const
+{
+    // The results of the previous search must be complete. A running
+    // update of the results is restarted after refining them.
+    if (!isSearching() || (m_listing && !m_updating) || m_truncated || !isSupported(url)
+        || !isFileNameSearchUrl(url)) {
+        return false;
+    }
+
+    const QUrl searchUrl = url.adjusted(QUrl::StripTrailingSlash);
+    if (searchedDirectory(searchUrl) != m_directoryUrl) {
+        return false;
+    }
+
+    // Every name that contains the new text contains the previous text, so
+    // the results of the new search are a subset of the previous results
+    const KFileNameMatcher matcher(QUrlQuery(searchUrl).queryItemValue(QStringLiteral("search")));
+    return matcher.mode() == KFileNameMatcher::SubString
+        && m_nameMatcher.mode() == KFileNameMatcher::SubString
+        && matcher.pattern().contains(m_nameMatcher.pattern(), Qt::CaseInsensitive);
+}
+
+bool KLocalDirLister::refineSearch(const QUrl& url)
+{
+    if (!canRefineSearch(url)) {
+        return false;
+    }
+
+    const QUrl searchUrl = url.adjusted(QUrl::StripTrailingSlash);
+    const KFileNameMatcher matcher(QUrlQuery(searchUrl).queryItemValue(QStringLiteral("search")));
+
+    cancelListing();
+    m_updateTimer->stop();
+    m_updatePending = false;
+
+    m_url = searchUrl;
+    m_nameMatcher = matcher;
+
+    const QList<KFileItem> items = QtConcurrent::blockingFiltered(m_items.values(), NameMatches(matcher));
+    m_items.clear();
+    m_items.reserve(items.count());
+
+    KFileItemList shownItems;
+    shownItems.reserve(items.count());
+    for (const KFileItem& item : items) {
+        m_items.insert(itemKey(item), item);
+        if (isShown(item)) {
+            shownItems.append(item);
+        }
+    }
+
+    // Files that have been created or renamed since the previous search
+    // are found by searching again in the background. The listing is
+    // completed when this search is done.
+    Q_EMIT clear();
+    startListing(true);
+
+    // The refined results replace the previous ones removed by clear()
+    if (!shownItems.isEmpty()) {
+        Q_EMIT itemsAdded(m_url, shownItems);
+    }
+    return true;
+}
+
+void KLocalDirLister::startListing(bool updating)
+{
+    m_updating = updating;
+    m_listedItems.clear();
+
+    m_listing = QSharedPointer<Listing>::create();
+    m_listing->recursive = m_recursive || isSearching();
+    m_listing->showingDotFiles = m_showingDotFiles;
+    m_listing->nameMatcher = m_nameMatcher;
+    m_listing->lister = this;
+    m_listing->batchTimer.start();
+
+    if (updating && isWatching()) {
+        // Only new, replaced and changed entries are stated again. If no entry
+        // has been added or removed, the other entries are not read at all.
+        m_listing->knownItems = m_items;
+        m_listing->knownInodes = m_inodes;
+        m_listing->changedNames = m_changedNames;
+        m_listing->changedEntriesOnly = !m_directoryChanged;
+    }
+    m_directoryChanged = false;
+    m_changedNames.clear();
+
+    Q_EMIT started(m_url);
+
+#ifdef Q_OS_UNIX
+    threadPool()->start(new LocalDirectoryReader(m_listing, m_directoryUrl, 0));
+#else
+    QTimer::singleShot(0, this, [this, listing = m_listing]() {
+        slotListingFinished(listing, KFileItem(), false);
+    });
+#endif
+}
+
+void KLocalDirLister::cancelListing()
+{
+    if (!m_listing) {
+        return;
+    }
+
+    m_listing->canceled.storeRelaxed(1);
+    QMutexLocker locker(&m_listing->mutex);
+    m_listing->lister = nullptr;
+    locker.unlock();
+    m_listing.reset();
+}
+
+void KLocalDirLister::slotItemsListed(const QSharedPointer<Listing>& listing, const KFileItemList& items)
+{
+    if (listing != m_listing) {
+        return;
+    }
+
+    m_listedItems.append(items);
+    if (m_updating) {
+        return;
+    }
+
+    KFileItemList shownItems;
+    shownItems.reserve(items.count());
+    for (const KFileItem& item : items) {
+        if (isShown(item)) {
+            shownItems.append(item);
+        }
+    }
+    if (!shownItems.isEmpty()) {
+        Q_EMIT itemsAdded(m_url, shownItems);
+    }
+}
+
+void KLocalDirLister::slotListingFinished(const QSharedPointer<Listing>& listing, const KFileItem& rootItem, bool success)
+{
+    if (listing != m_listing) {
+        return;
+    }
+    m_listing.reset();
+
+    if (!success) {
+        const QUrl url = m_url;
+        close();
+        Q_EMIT failed(url);
+        return;
+    }
+
+    if (isSearching()) {
+        // Like for the filenamesearch worker, the search results are no
+        // directory where items can be created
+        m_rootItem = KFileItem(m_url, QStringLiteral("inode/directory"), QT_STAT_DIR);
+    } else {
+        m_rootItem = rootItem;
+    }
+
+    QHash<QString, KFileItem> items;
+    if (listing->changedEntriesOnly) {
+        items = m_items;
+        for (const QString& name : qAsConst(listing->changedNames)) {
+            items.remove(name);
+            m_inodes.remove(name);
+        }
+        m_inodes.insert(listing->inodes);
+    } else {
+        items.reserve(m_listedItems.count());
+        m_inodes = listing->inodes;
+    }
+    for (const KFileItem& item : qAsConst(m_listedItems)) {
+        items.insert(itemKey(item), item);
+    }
+    m_listedItems.clear();
+
+    if (m_updating) {
+        emitDifferences(items);
+    }
+    m_items.swap(items);
+
+    const bool wasTruncated = m_truncated;
+    m_truncated = listing->truncated.loadRelaxed();
+    if (m_truncated && !(m_updating && wasTruncated)) {
+        Q_EMIT truncated(MaxRecursiveItemCount);
+    }
+
+    Q_EMIT listingDirCompleted(m_url);
+
+    if (m_updatePending) {
+        m_updatePending = false;
+        m_updateTimer->start();
+    }
+}
+
+void KLocalDirLister::slotDirectoryChanged(const QString& path)
+{
+    if (m_watchedPath.isEmpty()) {
+        return;
+    }
+
+    // Adding, removing or renaming entries changes the directory. Changes of
+    // the contained files are reported for the files, which are stated again.
+    const int separatorIndex = path.lastIndexOf(QLatin1Char('/'));
+    if (path == m_watchedPath) {
+        m_directoryChanged = true;
+    } else if (path.left(separatorIndex) == m_watchedPath) {
+        m_changedNames.insert(path.mid(separatorIndex + 1));
+    } else {
+        return;
+    }
+
+    scheduleUpdate();
+}
+
+void KLocalDirLister::slotUpdateTimeout()
+{
+    if (m_url.isEmpty()) {
+        return;
+    }
+
+    if (m_listing) {
+        // List the directory again when the running listing has been finished
+        m_updatePending = true;
+        return;
+    }
+
+    startListing(true);
+}
+
+void KLocalDirLister::scheduleUpdate()
+{
+    if (!m_updateTimer->isActive()) {
+        m_updateTimer->start();
+    }
+}
+
+void KLocalDirLister::slotFilesAdded(const QString& directory)
+{
+    if (isNotified(QUrl(directory))) {
+        scheduleUpdate();
+    }
+}
+
+void KLocalDirLister::slotFilesRemoved(const QStringList& fileList)
+{
+    QStringList removedPaths;
+    for (const QString& file : fileList) {
+        const QUrl url = QUrl(file).adjusted(QUrl::StripTrailingSlash);
+        if (isNotified(url)) {
+            removedPaths.append(url.path());
+        }
+    }
+    if (removedPaths.isEmpty()) {
+        return;
+    }
+
+    if (m_listing) {
+        // The removed items might have been listed already
+        scheduleUpdate();
+        return;
+    }
+
+    // The items of recursive listings are identified by their paths.
+    // Removing a directory removes the items below it, too.
+    KFileItemList deletedItems;
+    for (auto it = m_items.begin(); it != m_items.end();) {
+        const QString& key = it.key();
+        const bool removed = std::any_of(removedPaths.cbegin(), removedPaths.cend(), [&key](const QString& path) {
+            return key.startsWith(path) && (key.length() == path.length() || key.at(path.length()) == QLatin1Char('/'));
+        });
+        if (removed) {
+            if (isShown(it.value())) {
+                deletedItems.append(it.value());
+            }
+            it = m_items.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (!deletedItems.isEmpty()) {
+        Q_EMIT itemsDeleted(deletedItems);
+    }
+}
+
+void KLocalDirLister::slotFileRenamed(const QString& src, const QString& dst)
+{
+    if (isNotified(QUrl(src)) || isNotified(QUrl(dst))) {
+        scheduleUpdate();
+    }
+}
+
+void KLocalDirLister::emitDifferences(const QHash<QString, KFileItem>& items)
+{
+    KFileItemList deletedItems;
+    QList<QPair<KFileItem, KFileItem>> refreshedItems;
+    for (auto it = m_items.constBegin(); it != m_items.constEnd(); ++it) {
+        const KFileItem& oldItem = it.value();
+        const auto newIt = items.constFind(it.key());
+        if (newIt == items.constEnd()) {
+            if (isShown(oldItem)) {
+                deletedItems.append(oldItem);
+            }
+        } else if (!oldItem.cmp(newIt.value()) && isShown(oldItem)) {
+            refreshedItems.append(qMakePair(oldItem, newIt.value()));
+        }
+    }
+
+    KFileItemList addedItems;
+    for (auto it = items.constBegin(); it != items.constEnd(); ++it) {
+        if (!m_items.contains(it.key()) && isShown(it.value())) {
+            addedItems.append(it.value());
+        }
+    }
+
+    if (!deletedItems.isEmpty()) {
+        Q_EMIT itemsDeleted(deletedItems);
+    }
+    if (!refreshedItems.isEmpty()) {
+        Q_EMIT refreshItems(refreshedItems);
+    }
+    if (!addedItems.isEmpty()) {
+        Q_EMIT itemsAdded(m_url, addedItems);
+    }
+}
+
+QString KLocalDirLister::itemKey(const KFileItem& item) const
+{
+    // The names of the items of recursive listings are not unique
+    return (m_recursive || isSearching()) ? item.url().path() : item.name();
+}
+
+bool KLocalDirLister::isShown(const KFileItem& item) const
+{
+    return m_showingDotFiles || !item.isHidden();
+}
+
+bool KLocalDirLister::isWatching() const
+{
+    // Watching all directories of a tree would exhaust the inotify watches
+    return m_autoUpdate && !m_recursive && !isSearching();
+}
+
+bool KLocalDirLister::isNotified(const QUrl& url) const
+{
+    // Directories that are watched by KDirWatch get notified by it
+    if (!m_autoUpdate || m_url.isEmpty() || isWatching()) {
+        return false;
+    }
+
+    const QUrl notifiedUrl = url.adjusted(QUrl::StripTrailingSlash);
+    if (notifiedUrl != m_directoryUrl && !m_directoryUrl.isParentOf(notifiedUrl)) {
+        return false;
+    }
+
+    // Hidden directories are only read if hidden files are shown
+    if (!m_showingDotFiles) {
+        const QString relativePath = notifiedUrl.path().mid(m_directoryUrl.path().length());
+        if (relativePath.startsWith(QLatin1Char('.')) || relativePath.contains(QLatin1String("/."))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void KLocalDirLister::watch(const QString& path)
+{
+    if (path == m_watchedPath) {
+        return;
+    }
+
+    KDirWatch* dirWatch = KDirWatch::self();
+    if (!m_watchedPath.isEmpty()) {
+        dirWatch->removeDir(m_watchedPath);
+    }
+    m_watchedPath = path;
+    if (!m_watchedPath.isEmpty()) {
+        dirWatch->addDir(m_watchedPath);
+    }
+}
@@ -0,0 +1,252 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KLOCALDIRLISTER_H
+#define KLOCALDIRLISTER_H
+
+#include "dolphin_export.h"
+#include "kfilenamematcher.h"
+
+#include <KFileItem>
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QUrl>
+
+class QTimer;
+
+/**
+ * @brief Lists local directories without a KIO worker.
+ *
+ * KDirLister lists local directories by the file worker, which runs in
+ * another process and sends the entries in small batches over a socket.
+ * For directories with hundreds of thousands of entries the listing is
+ * dominated by this transport. KLocalDirLister reads the entries in a
+ * thread with large getdents64() buffers and statx() on Linux, or with
+ * readdir() and fstatat() on other Unix systems, and emits the items in
+ * large batches.
+ *
+ * The signals behave like the equally named signals of KCoreDirLister, so
+ * that KFileItemModel can use both listers as source of its items. The
+ * listed directory is watched by KDirWatch, which uses inotify on Linux.
+ * If the directory changes, only the new and changed entries are stated
+ * again, and the differences are emitted by itemsAdded(), itemsDeleted()
+ * and refreshItems().
+ *
+ * Only one directory is listed. Expanded folders are listed by KDirLister.
+ * A recursive listing lists the files of all sub-directories as items of
+ * the directory, see setRecursive(). Watching all directories of a tree
+ * would exhaust the inotify watches, so recursive listings are updated if
+ * KIO reports changes below the directory by OrgKdeKDirNotify, e.g. for
+ * files that have been copied, renamed or deleted by Dolphin.
+ *
+ * filenamesearch URLs are supported, too, unless the contents of the files
+ * should be searched. The searched directory tree is read like by a recursive
+ * listing, and the matching files and directories are listed. Only matching
+ * entries are stated, if the file system tells the type of the entries.
+ */
+class DOLPHIN_EXPORT KLocalDirLister : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KLocalDirLister(QObject* parent = nullptr);
+    ~KLocalDirLister() override;
+
+    /**
+     * @return True if the directory \a url can be listed by KLocalDirLister,
+     *         or if \a url is a filenamesearch URL that can be searched.
+     */
+    static bool isSupported(const QUrl& url);
+
+    /**
+     * Starts listing the directory \a url. The items of the previously
+     * listed directory are removed by emitting clear().
+     *
+     * If \a url is a search for a text that contains the text of the
+     * completed previous search in the same directory, the previous results
+     * are filtered instead of searching again, and emitted at once. The
+     * directory is searched again in the background afterwards, and the
+     * differences are emitted like for an updated directory before
+     * listingDirCompleted().
+     */
+    void openUrl(const QUrl& url);
+
+    /**
+     * Stops listing the directory. The directory is still watched for changes.
+     */
+    void stop();
+
+    /**
+     * Stops listing and watching the directory and forgets it,
+     * without emitting any signal.
+     */
+    void close();
+
+    /**
+     * @return The listed directory or an empty URL if no directory is listed.
+     */
+    QUrl url() const;
+
+    /**
+     * @return The item of the listed directory. It is null until the
+     *         listing has been completed.
+     */
+    KFileItem rootItem() const;
+
+    /**
+     * @return True if the listing of the directory has been completed
+     *         or stopped.
+     */
+    bool isFinished() const;
+
+    /**
+     * Shows or hides the hidden files. The changes are emitted
+     * immediately by itemsAdded() or itemsDeleted().
+     */
+    void setShowingDotFiles(bool show);
+    bool showingDotFiles() const;
+
+    /**
+     * Enables or disables updating the items if the directory changes.
+     */
+    void setAutoUpdate(bool enable);
+    bool autoUpdate() const;
+
+    /**
+     * Lists the files of all sub-directories too, which are read by several
+     * threads. The sub-directories themselves are not listed, and symbolic
+     * links to directories are not followed. Hidden sub-directories are only
+     * read if hidden files are shown. The depth and the number of items of
+     * a recursive listing are limited, see isTruncated(). Recursive listings
+     * are only updated for changes reported by KIO. Takes effect with the
+     * next openUrl().
+     */
+    void setRecursive(bool recursive);
+    bool isRecursive() const;
+
+    /**
+     * @return True if the listed URL is a filenamesearch URL. Searches are
+     *         recursive and updated like recursive listings, independent
+     *         from setRecursive().
+     */
+    bool isSearching() const;
+
+    /**
+     * @return True if the last recursive listing or search has been cut off,
+     *         because it contains more items than the limit.
+     */
+    bool isTruncated() const;
+
+    /**
+     * @return True if the search \a url can be done by refining the complete
+     *         results of the current search, which is fast enough for
+     *         searching while the text is typed. See openUrl().
+     */
+    bool canRefineSearch(const QUrl& url) const;
+
+Q_SIGNALS:
+    void started(const QUrl& url);
+    void clear();
+    void itemsAdded(const QUrl& directoryUrl, const KFileItemList& items);
+    void itemsDeleted(const KFileItemList& items);
+    void refreshItems(const QList<QPair<KFileItem, KFileItem>>& items);
+    void listingDirCompleted(const QUrl& url);
+    void canceled();
+
+    /**
+     * Is emitted if the directory \a url cannot be listed, e.g. because it
+     * does not exist or is not readable. The directory has been closed. It
+     * should be listed by KDirLister, which reports the error properly.
+     */
+    void failed(const QUrl& url);
+
+    /**
+     * Is emitted if a recursive listing or search has been cut off after
+     * \a itemCount items. Updates of the listing only emit the signal if
+     * the previous listing has not been cut off.
+     */
+    void truncated(int itemCount);
+
+private:
+    struct Listing;
+
+    /**
+     * Refines the results of the previous search, if the search \a url is
+     * a refinement of it. See openUrl().
+     * @return True if the results have been refined.
+     */
+    bool refineSearch(const QUrl& url);
+
+    void startListing(bool updating);
+    void cancelListing();
+    void slotItemsListed(const QSharedPointer<Listing>& listing, const KFileItemList& items);
+    void slotListingFinished(const QSharedPointer<Listing>& listing, const KFileItem& rootItem, bool success);
+    void slotDirectoryChanged(const QString& path);
+    void slotUpdateTimeout();
+    void scheduleUpdate();
+
+    /**
+     * Slots for the changes reported by KIO, which update recursive
+     * listings and searches. Deleted items are removed immediately,
+     * otherwise the directory is listed again.
+     */
+    void slotFilesAdded(const QString& directory);
+    void slotFilesRemoved(const QStringList& fileList);
+    void slotFileRenamed(const QString& src, const QString& dst);
+
+    /**
+     * Emits the differences between the items of the previous
+     * listing and the items \a items.
+     */
+    void emitDifferences(const QHash<QString, KFileItem>& items);
+
+    QString itemKey(const KFileItem& item) const;
+    bool isShown(const KFileItem& item) const;
+    bool isWatching() const;
+    void watch(const QString& path);
+
+    /**
+     * @return True if changes of \a url reported by KIO affect the
+     *         recursive listing or search.
+     */
+    bool isNotified(const QUrl& url) const;
+
+private:
+    QUrl m_url;
+    QUrl m_directoryUrl; // Differs from m_url for searches
+    KFileNameMatcher m_nameMatcher;
+    KFileItem m_rootItem;
+
+    QSharedPointer<Listing> m_listing;
+    bool m_updating;
+
+    // Items of the last completed listing and of the running listing
+    QHash<QString, KFileItem> m_items;
+    KFileItemList m_listedItems;
+
+    bool m_showingDotFiles;
+    bool m_autoUpdate;
+    bool m_recursive;
+    bool m_truncated;
+    bool m_updatePending;
+
+    // Changes of the watched directory since the last listing, and
+    // the inodes of the entries of the last listing
+    bool m_directoryChanged;
+    QSet<QString> m_changedNames;
+    QHash<QString, quint64> m_inodes;
+
+    QString m_watchedPath;
+    QTimer* m_updateTimer;
+
+    friend class LocalDirectoryReader;
+    friend class KFileItemModelTest; // For unit testing
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include "informationpanel.h"
 
 #include "informationpanelcontent.h"
+#include "kitemviews/private/kdirectorysizecounter.h"
 
 #include <KIO/Job>
 #include <KIO/JobUiDelegate>
@@ -36,12 +37,15 @@ InformationPanel::InformationPanel(QWidget* parent) :
     m_fileItem(),
     m_selection(),
     m_folderStatJob(nullptr),
+    m_folderEntry(),
+    m_folderSizePath(),
     m_content(nullptr)
 {
 }
 
 InformationPanel::~InformationPanel()
 {
+    cancelFolderSizeRequest();
 }
 
 void InformationPanel::setSelection(const KFileItemList& selection)
@@ -237,7 +241,14 @@ void InformationPanel::showItemInfo()
             // No item is hovered and no selection has been done: provide
             // an item for the currently shown directory.
             m_shownUrl = url();
-            m_folderStatJob = KIO::statDetails(url(), KIO::StatJob::SourceSide, KIO::StatDefaultDetails | KIO::StatRecursiveSize, KIO::HideProgressInfo);
+
+            // The recursive size of local folders is calculated by the shared
+            // KDirectorySizeCounter after the folder has been shown.
+            KIO::StatDetails details = KIO::StatDefaultDetails;
+            if (!KDirectorySizeCounter::isSupported(m_shownUrl)) {
+                details |= KIO::StatRecursiveSize;
+            }
+            m_folderStatJob = KIO::statDetails(url(), KIO::StatJob::SourceSide, details, KIO::HideProgressInfo);
             if (m_folderStatJob->uiDelegate()) {
                 KJobWidgets::setWindow(m_folderStatJob, this);
             }
@@ -253,8 +264,32 @@ void InformationPanel::showItemInfo()
 void InformationPanel::slotFolderStatFinished(KJob* job)
 {
     m_folderStatJob = nullptr;
-    const KIO::UDSEntry entry = static_cast<KIO::StatJob*>(job)->statResult();
-    m_content->showItem(KFileItem(entry, m_shownUrl));
+    m_folderEntry = static_cast<KIO::StatJob*>(job)->statResult();
+
+    if (KDirectorySizeCounter::isSupported(m_shownUrl) && m_folderEntry.isDir()) {
+        const QString path = m_shownUrl.adjusted(QUrl::StripTrailingSlash).toLocalFile();
+        KIO::filesize_t size = 0;
+        if (KDirectorySizeCounter::instance()->request(path, size)) {
+            m_folderEntry.replace(KIO::UDSEntry::UDS_RECURSIVE_SIZE, static_cast<long long>(size));
+        } else {
+            m_folderSizePath = path;
+        }
+    }
+
+    m_content->showItem(KFileItem(m_folderEntry, m_shownUrl));
+}
+
+void InformationPanel::slotFolderSizeChanged(const QString& path, KIO::filesize_t size, bool finished)
+{
+    // Showing the item again refreshes the preview and the meta data,
+    // hence partial sizes are not shown.
+    if (!finished || path != m_folderSizePath) {
+        return;
+    }
+
+    m_folderSizePath.clear();
+    m_folderEntry.replace(KIO::UDSEntry::UDS_RECURSIVE_SIZE, static_cast<long long>(size));
+    m_content->showItem(KFileItem(m_folderEntry, m_shownUrl));
 }
 
 void InformationPanel::slotInfoTimeout()
@@ -360,6 +395,7 @@ void InformationPanel::cancelRequest()
 {
     delete m_folderStatJob;
     m_folderStatJob = nullptr;
+    cancelFolderSizeRequest();
 
     m_infoTimer->stop();
     m_resetUrlTimer->stop();
@@ -371,6 +407,14 @@ void InformationPanel::cancelRequest()
     m_urlCandidate.clear();
 }
 
+void InformationPanel::cancelFolderSizeRequest()
+{
+    if (!m_folderSizePath.isEmpty()) {
+        KDirectorySizeCounter::instance()->cancel(m_folderSizePath);
+        m_folderSizePath.clear();
+    }
+}
+
 bool InformationPanel::isEqualToShownUrl(const QUrl& url) const
 {
     return m_shownUrl.matches(url, QUrl::StripTrailingSlash);
@@ -414,6 +458,9 @@ void InformationPanel::init()
     connect(dirNotify, &OrgKdeKDirNotifyInterface::enteredDirectory, this, &InformationPanel::slotEnteredDirectory);
     connect(dirNotify, &OrgKdeKDirNotifyInterface::leftDirectory, this, &InformationPanel::slotLeftDirectory);
 
+    connect(KDirectorySizeCounter::instance(), &KDirectorySizeCounter::sizeChanged,
+            this, &InformationPanel::slotFolderSizeChanged);
+
     m_content = new InformationPanelContent(this);
     connect(m_content, &InformationPanelContent::urlActivated, this, &InformationPanel::urlActivated);
     connect(m_content, &InformationPanelContent::configurationFinished, this, [this]() { m_inConfigurationMode = false; });
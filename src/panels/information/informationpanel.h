@@ -10,6 +10,7 @@
 #include "panels/panel.h"
 
 #include <KFileItem>
+#include <KIO/UDSEntry>
 
 class InformationPanelContent;
 namespace KIO
@@ -74,6 +75,12 @@ private Q_SLOTS:
      */
     void slotFolderStatFinished(KJob* job);
 
+    /**
+     * Shows the recursive size of the currently displayed folder
+     * when its calculation has been finished.
+     */
+    void slotFolderSizeChanged(const QString& path, KIO::filesize_t size, bool finished);
+
     /**
      * Triggered if the request for item information has timed out.
      * @see InformationPanel::requestDelayedItemInfo()
@@ -98,6 +105,9 @@ private:
     /** Assures that any pending item information request is cancelled. */
     void cancelRequest();
 
+    /** Cancels the request for the recursive size of the displayed folder. */
+    void cancelFolderSizeRequest();
+
     /**
      * Returns true, if \a url is equal to the shown URL m_shownUrl.
      */
@@ -142,6 +152,8 @@ private:
     KFileItemList m_selection;
 
     KIO::Job* m_folderStatJob;
+    KIO::UDSEntry m_folderEntry;
+    QString m_folderSizePath;
 
     InformationPanelContent* m_content;
     bool m_inConfigurationMode = false;
@@ -11,6 +11,7 @@
 #include "dolphinfacetswidget.h"
 #include "dolphinplacesmodelsingleton.h"
 #include "dolphinquery.h"
+#include "views/dolphinview.h"
 
 #include <KLocalizedString>
 #include <KNS3/KMoreToolsMenuFactory>
@@ -50,6 +51,7 @@ DolphinSearchBox::DolphinSearchBox(QWidget* parent) :
     m_everywhereButton(nullptr),
     m_facetsWidget(nullptr),
     m_searchPath(),
+    m_view(nullptr),
     m_startSearchTimer(nullptr)
 {
 }
@@ -107,6 +109,11 @@ QUrl DolphinSearchBox::searchPath() const
     return m_everywhereButton->isChecked() ? QUrl::fromLocalFile(QDir::homePath()) : m_searchPath;
 }
 
+void DolphinSearchBox::setView(DolphinView* view)
+{
+    m_view = view;
+}
+
 QUrl DolphinSearchBox::urlForSearching() const
 {
     QUrl url;
@@ -265,6 +272,10 @@ void DolphinSearchBox::slotSearchTextChanged(const QString& text)
 
     if (text.isEmpty()) {
         m_startSearchTimer->stop();
+    } else if (refinesSearch()) {
+        // Narrowing the results is fast enough for doing it while typing
+        m_startSearchTimer->stop();
+        Q_EMIT searchRefinementRequest();
     } else {
         m_startSearchTimer->start();
     }
@@ -532,6 +543,13 @@ void DolphinSearchBox::updateFacetsVisible()
     m_facetsWidget->setVisible(indexingEnabled);
 }
 
+bool DolphinSearchBox::refinesSearch() const
+{
+    // Only the view knows whether the results of the previous
+    // search are complete and can be refined
+    return m_startedSearching && m_view && m_view->canRefineSearch(urlForSearching());
+}
+
 bool DolphinSearchBox::isIndexingEnabled() const
 {
 #ifdef HAVE_BALOO
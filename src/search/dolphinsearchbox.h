@@ -12,6 +12,7 @@
 
 class DolphinFacetsWidget;
 class DolphinQuery;
+class DolphinView;
 class QLineEdit;
 class KSeparator;
 class QToolButton;
@@ -56,6 +57,13 @@ public:
     void setSearchPath(const QUrl& url);
     QUrl searchPath() const;
 
+    /**
+     * Sets the view that shows the search results. If the view can refine
+     * its results for the changed text, the search is refined immediately
+     * instead of waiting until the typing has been stopped.
+     */
+    void setView(DolphinView* view);
+
     /** @return URL that will start the searching of files. */
     QUrl urlForSearching() const;
 
@@ -99,6 +107,13 @@ Q_SIGNALS:
      */
     void searchRequest();
 
+    /**
+     * Is emitted when the results of the current search should be refined
+     * for the changed text while the text is typed. The refined search
+     * should replace the current search in the history.
+     */
+    void searchRefinementRequest();
+
     /**
      * Is emitted when the user has changed a character of
      * the text that should be used as input for searching.
@@ -147,6 +162,12 @@ private:
 
     bool isIndexingEnabled() const;
 
+    /**
+     * @return True if the search for the current text only narrows the
+     *         results of the search shown by the view, see setView().
+     */
+    bool refinesSearch() const;
+
 private:
     QString queryTitle(const QString& text) const;
 
@@ -166,6 +187,7 @@ private:
     DolphinFacetsWidget* m_facetsWidget;
 
     QUrl m_searchPath;
+    DolphinView* m_view;
     QScopedPointer<KMoreToolsMenuFactory> m_menuFactory;
 
     QTimer* m_startSearchTimer;
@@ -9,6 +9,8 @@
 #include "dolphintabpage.h"
 #include "dolphintabwidget.h"
 #include "dolphinviewcontainer.h"
+#include "testdir.h"
+#include "views/dolphinview.h"
 
 #include <KActionCollection>
 
@@ -33,6 +35,8 @@ private Q_SLOTS:
     void testNewFileMenuEnabled();
     void testWindowTitle_data();
     void testWindowTitle();
+    void testSaveLazilyRestoredTabState();
+    void testRestoreCachedDirectory();
 
 
 
@@ -264,6 +268,75 @@ void DolphinMainWindowTest::testWindowTitle()
     QCOMPARE(m_mainWindow->windowTitle(), expectedWindowTitle);
 }
 
+void DolphinMainWindowTest::testSaveLazilyRestoredTabState()
+{
+    m_mainWindow->openDirectories({ QUrl::fromLocalFile(QDir::homePath()) }, false);
+    m_mainWindow->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_mainWindow.data()));
+    QVERIFY(m_mainWindow->isVisible());
+
+    auto tabWidget = m_mainWindow->findChild<DolphinTabWidget*>("tabWidget");
+    QVERIFY(tabWidget);
+
+    const QUrl tempUrl = QUrl::fromLocalFile(QDir::tempPath());
+    tabWidget->openNewTab(tempUrl);
+    QCOMPARE(tabWidget->count(), 2);
+
+    // Use a split view, so that a wrongly saved state of the primary
+    // view also breaks the state of the secondary view
+    DolphinTabPage* tabPage = tabWidget->tabPageAt(1);
+    tabPage->setSplitViewEnabled(true, WithoutAnimation, tempUrl);
+    QVERIFY(tabPage->splitViewEnabled());
+    const QByteArray state = tabPage->saveState();
+
+    // Saving a tab that has been restored lazily, e.g. when the session
+    // is saved again before the tab has been activated, must not change
+    // the state
+    tabPage->restoreStateLazily(state);
+    QVERIFY(tabPage->activeViewContainer()->view()->itemsReleased());
+    QCOMPARE(tabPage->saveState(), state);
+
+    tabPage->restoreStateLazily(tabPage->saveState());
+    QCOMPARE(tabPage->saveState(), state);
+
+    // The state is restored when the tab gets activated
+    tabWidget->setCurrentIndex(1);
+    QVERIFY(!tabPage->activeViewContainer()->view()->itemsReleased());
+    QVERIFY(tabPage->splitViewEnabled());
+    QCOMPARE(tabPage->activeViewContainer()->url(), tempUrl);
+}
+
+void DolphinMainWindowTest::testRestoreCachedDirectory()
+{
+    TestDir testDir;
+    testDir.createFiles({"a.txt", "b.txt", "subdir/c.txt"});
+    QUrl subdirUrl = testDir.url();
+    subdirUrl.setPath(subdirUrl.path() + "/subdir");
+
+    m_mainWindow->openDirectories({ testDir.url() }, false);
+    m_mainWindow->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_mainWindow.data()));
+    QVERIFY(m_mainWindow->isVisible());
+
+    auto tabWidget = m_mainWindow->findChild<DolphinTabWidget*>("tabWidget");
+    QVERIFY(tabWidget);
+    DolphinView* view = tabWidget->currentTabPage()->activeViewContainer()->view();
+    QSignalSpy loadingCompletedSpy(view, &DolphinView::directoryLoadingCompleted);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(view->itemsCount(), 3);
+
+    view->setUrl(subdirUrl);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(view->itemsCount(), 1);
+
+    // The items of the left directory are shown immediately when going back
+    view->setUrl(testDir.url());
+    QCOMPARE(view->itemsCount(), 3);
+
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(view->itemsCount(), 3);
+}
+
 QTEST_MAIN(DolphinMainWindowTest)
 
 #include "dolphinmainwindowtest.moc"
@@ -0,0 +1,202 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kdirectorysizecounter.h"
+#include "testdir.h"
+
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTest>
+
+class KDirectorySizeCounterTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testSize();
+    void testSharedRequests();
+    void testCancel();
+    void testInvalidate();
+    void testCachedSubdirectories();
+
+private:
+    /**
+     * Waits until the calculation for \a path has been finished.
+     * @return Size of \a path or -1 if the calculation did not finish.
+     */
+    KIO::filesize_t waitForSize(QSignalSpy& spy, const QString& path);
+
+private:
+    KDirectorySizeCounter* m_counter;
+    TestDir* m_testDir;
+};
+
+void KDirectorySizeCounterTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void KDirectorySizeCounterTest::init()
+{
+    m_counter = KDirectorySizeCounter::instance();
+
+    // Each test uses a new directory, so the sizes cached by the
+    // previous tests are not used
+    m_testDir = new TestDir();
+    m_testDir->createFile("a", QByteArray(100, 'x'));
+    m_testDir->createFile("b/c", QByteArray(200, 'x'));
+    m_testDir->createFile("b/d/e", QByteArray(300, 'x'));
+    m_testDir->createFile(".hidden", QByteArray(50, 'x'));
+}
+
+void KDirectorySizeCounterTest::cleanup()
+{
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KDirectorySizeCounterTest::testSize()
+{
+    QSignalSpy sizeChangedSpy(m_counter, &KDirectorySizeCounter::sizeChanged);
+    const QString path = m_testDir->path();
+
+    KIO::filesize_t size = 0;
+    QVERIFY(!m_counter->request(path, size));
+    QCOMPARE(waitForSize(sizeChangedSpy, path), KIO::filesize_t(650));
+
+    // The size of the requested directory is cached
+    sizeChangedSpy.clear();
+    QVERIFY(m_counter->request(path, size));
+    QCOMPARE(size, KIO::filesize_t(650));
+    QVERIFY(!sizeChangedSpy.wait(100));
+
+    const QString subDirectoryPath = path + QLatin1String("/b");
+    QVERIFY(!m_counter->request(subDirectoryPath, size));
+    QCOMPARE(waitForSize(sizeChangedSpy, subDirectoryPath), KIO::filesize_t(500));
+}
+
+void KDirectorySizeCounterTest::testSharedRequests()
+{
+    QSignalSpy sizeChangedSpy(m_counter, &KDirectorySizeCounter::sizeChanged);
+    const QString path = m_testDir->path();
+
+    // All requests for a directory share one calculation, which is only
+    // finished once
+    KIO::filesize_t size = 0;
+    QVERIFY(!m_counter->request(path, size));
+    QVERIFY(!m_counter->request(path, size));
+    QVERIFY(!m_counter->request(path, size));
+
+    // Canceling some of the requests does not stop the calculation
+    m_counter->cancel(path);
+    m_counter->cancel(path);
+
+    QCOMPARE(waitForSize(sizeChangedSpy, path), KIO::filesize_t(650));
+    QVERIFY(!sizeChangedSpy.wait(100));
+    QCOMPARE(sizeChangedSpy.count(), 0);
+}
+
+void KDirectorySizeCounterTest::testCancel()
+{
+    QSignalSpy sizeChangedSpy(m_counter, &KDirectorySizeCounter::sizeChanged);
+    const QString path = m_testDir->path();
+
+    // No size is announced for a canceled request, even if the
+    // calculation has already been finished
+    KIO::filesize_t size = 0;
+    QVERIFY(!m_counter->request(path, size));
+    m_counter->cancel(path);
+    QVERIFY(!sizeChangedSpy.wait(200));
+    QCOMPARE(sizeChangedSpy.count(), 0);
+
+    // Canceling a directory that is not requested is ignored
+    m_counter->cancel(path);
+
+    // A new request after canceling works as usual
+    if (m_counter->request(path, size)) {
+        QCOMPARE(size, KIO::filesize_t(650));
+    } else {
+        QCOMPARE(waitForSize(sizeChangedSpy, path), KIO::filesize_t(650));
+    }
+}
+
+void KDirectorySizeCounterTest::testInvalidate()
+{
+    QSignalSpy sizeChangedSpy(m_counter, &KDirectorySizeCounter::sizeChanged);
+    const QString path = m_testDir->path();
+
+    KIO::filesize_t size = 0;
+    QVERIFY(!m_counter->request(path, size));
+    QCOMPARE(waitForSize(sizeChangedSpy, path), KIO::filesize_t(650));
+    QVERIFY(m_counter->request(path, size));
+
+    // Invalidating a subdirectory removes the cached sizes of its parents
+    m_testDir->createFile("b/d/f", QByteArray(400, 'x'));
+    m_counter->invalidate(path + QLatin1String("/b/d"));
+
+    QVERIFY(!m_counter->request(path, size));
+    QCOMPARE(waitForSize(sizeChangedSpy, path), KIO::filesize_t(1050));
+}
+
+void KDirectorySizeCounterTest::testCachedSubdirectories()
+{
+    QSignalSpy sizeChangedSpy(m_counter, &KDirectorySizeCounter::sizeChanged);
+    const QString path = m_testDir->path();
+
+    // Big subdirectories are cached while walking the parent directory
+    QStringList files;
+    for (int i = 0; i < 1000; ++i) {
+        files.append(QStringLiteral("big/%1").arg(i));
+    }
+    m_testDir->createFiles(files);
+    const KIO::filesize_t bigSize = 1000 * QByteArray("test").size();
+
+    KIO::filesize_t size = 0;
+    QVERIFY(!m_counter->request(path, size));
+    QCOMPARE(waitForSize(sizeChangedSpy, path), 650 + bigSize);
+
+    QVERIFY(m_counter->request(path + QLatin1String("/big"), size));
+    QCOMPARE(size, bigSize);
+
+    // Small subdirectories are not cached
+    QVERIFY(!m_counter->request(path + QLatin1String("/b"), size));
+    QCOMPARE(waitForSize(sizeChangedSpy, path + QLatin1String("/b")), KIO::filesize_t(500));
+
+    // Walking the parent directory again reuses the cached size of the
+    // big subdirectory: Its changed contents are not noticed until the
+    // subdirectory is invalidated.
+    m_testDir->createFile("big/new", QByteArray(1000, 'x'));
+    m_counter->invalidate(path + QLatin1String("/b"));
+
+    QVERIFY(!m_counter->request(path, size));
+    QCOMPARE(waitForSize(sizeChangedSpy, path), 650 + bigSize);
+
+    m_counter->invalidate(path + QLatin1String("/big"));
+    QVERIFY(!m_counter->request(path, size));
+    QCOMPARE(waitForSize(sizeChangedSpy, path), 650 + bigSize + 1000);
+}
+
+KIO::filesize_t KDirectorySizeCounterTest::waitForSize(QSignalSpy& spy, const QString& path)
+{
+    do {
+        while (!spy.isEmpty()) {
+            const QList<QVariant> arguments = spy.takeFirst();
+            if (arguments.at(0).toString() == path && arguments.at(2).toBool()) {
+                return arguments.at(1).value<KIO::filesize_t>();
+            }
+        }
+    } while (spy.wait());
+
+    return KIO::filesize_t(-1);
+}
+
+QTEST_GUILESS_MAIN(KDirectorySizeCounterTest)
+
+#include "kdirectorysizecountertest.moc"
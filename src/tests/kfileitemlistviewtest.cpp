@@ -5,12 +5,17 @@
  */
 
 #include "kitemviews/kfileitemlistview.h"
+#include "kitemviews/kfileitemlistwidget.h"
 #include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kitemlistcontroller.h"
+#include "kitemviews/private/kitemlistsizehintresolver.h"
 #include "testdir.h"
 
 #include <KDirLister>
 
 #include <QGraphicsView>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QTest>
 #include <QSignalSpy>
 #include <QStandardPaths>
@@ -24,8 +29,18 @@ private Q_SLOTS:
     void init();
     void cleanup();
     void testGroupedItemChanges();
+    void testConcurrentSizeHints_data();
+    void testConcurrentSizeHints();
+    void testDeferredSizeHints();
+    void testRenderCacheInvalidation();
 
 private:
+    /**
+     * Creates \a shortCount files with short names and \a longCount files
+     * with long names, which are sorted behind the short ones, and loads them.
+     */
+    void loadFiles(int shortCount, int longCount);
+
     KFileItemListView* m_listView;
     KFileItemModel* m_model;
     TestDir* m_testDir;
@@ -105,6 +120,162 @@ void KFileItemListViewTest::testGroupedItemChanges()
     QCOMPARE(m_model->count(), 2);
 }
 
+Q_DECLARE_METATYPE(KFileItemListView::ItemLayout)
+
+void KFileItemListViewTest::testConcurrentSizeHints_data()
+{
+    QTest::addColumn<KFileItemListView::ItemLayout>("layout");
+
+    QTest::newRow("Icons") << KFileItemListView::IconsLayout;
+    QTest::newRow("Compact") << KFileItemListView::CompactLayout;
+}
+
+/**
+ * The size hints measured on the worker threads must be
+ * equal to the size hints calculated in the GUI thread.
+ */
+void KFileItemListViewTest::testConcurrentSizeHints()
+{
+    QFETCH(KFileItemListView::ItemLayout, layout);
+
+    KItemListController controller(m_model, m_listView);
+    m_listView->setItemLayout(layout);
+    loadFiles(20, 20);
+
+    const int count = m_model->count();
+    QVector<std::pair<qreal, bool>> expectedHints(count);
+    qreal expectedWidthHint = 0.0;
+    m_listView->calculateItemSizeHints(expectedHints, expectedWidthHint);
+
+    QVector<int> indexes;
+    for (int index = count - 1; index >= 0; --index) {
+        indexes.append(index);
+    }
+
+    qreal widthHint = 0.0;
+    QFuture<std::pair<qreal, bool>> future = m_listView->calculateItemSizeHintsConcurrently(indexes, widthHint);
+    QVERIFY(!future.isCanceled());
+    future.waitForFinished();
+
+    QCOMPARE(widthHint, expectedWidthHint);
+    QCOMPARE(future.resultCount(), count);
+    for (int i = 0; i < indexes.count(); ++i) {
+        QCOMPARE(future.resultAt(i), expectedHints.at(indexes.at(i)));
+    }
+}
+
+/**
+ * If many items are unresolved, only the items around the visible range get
+ * resolved synchronously. The other ones get estimated size hints until the
+ * calculation in the background is finished, and the view is relayouted then.
+ */
+void KFileItemListViewTest::testDeferredSizeHints()
+{
+    KItemListController controller(m_model, m_listView);
+    m_listView->setItemLayout(KFileItemListView::IconsLayout);
+    m_listView->setGeometry(QRectF(0, 0, 800, 600));
+    loadFiles(2500, 100);
+
+    const int count = m_model->count();
+    QVector<std::pair<qreal, bool>> expectedHints(count);
+    qreal widthHint = 0.0;
+    m_listView->calculateItemSizeHints(expectedHints, widthHint);
+
+    KItemListSizeHintResolver resolver(m_listView);
+    resolver.itemsInserted({KItemRange(0, count)});
+    resolver.setVisibleRange(0, 9);
+
+    QSignalSpy sizeHintsChangedSpy(&resolver, &KItemListSizeHintResolver::sizeHintsChanged);
+    const qreal estimatedHeight = resolver.sizeHint(count - 1).height();
+    QVERIFY(estimatedHeight > 0.0);
+    QVERIFY(estimatedHeight < expectedHints.last().first);
+    QCOMPARE(resolver.sizeHint(0).height(), expectedHints.first().first);
+
+    QVERIFY(sizeHintsChangedSpy.wait());
+    for (int index = 0; index < count; ++index) {
+        QCOMPARE(resolver.sizeHint(index).height(), expectedHints.at(index).first);
+    }
+
+    // The view must be relayouted with the calculated size hints,
+    // otherwise the rows of the long items overlap
+    QTRY_COMPARE(m_listView->itemRect(count - 1).height(), expectedHints.last().first);
+    qreal rowTop = m_listView->itemRect(0).top();
+    qreal rowBottom = m_listView->itemRect(0).bottom();
+    for (int index = 1; index < count; ++index) {
+        const QRectF rect = m_listView->itemRect(index);
+        if (rect.top() > rowTop) {
+            QVERIFY(rect.top() >= rowBottom);
+            rowTop = rect.top();
+        }
+        rowBottom = qMax(rowBottom, rect.bottom());
+    }
+}
+
+/**
+ * The pixmap of an item with an enabled render cache must be rendered
+ * again if the hover or selection state or the shown roles change.
+ */
+void KFileItemListViewTest::testRenderCacheInvalidation()
+{
+    KFileItemListWidgetInformant informant;
+    QScopedPointer<KFileItemListWidget> widget(new KFileItemListWidget(&informant, m_listView));
+    widget->setStyleOption(m_listView->styleOption());
+    widget->setVisibleRoles({"text"});
+    widget->setIndex(0);
+    widget->setData({{"text", QStringLiteral("a")}, {"size", 1024}});
+    widget->resize(200, 100);
+    widget->setRenderCacheEnabled(true);
+
+    auto render = [&widget]() {
+        QImage image(widget->size().toSize(), QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        QStyleOptionGraphicsItem option;
+        widget->paint(&painter, &option);
+        return image;
+    };
+
+    const QImage initialImage = render();
+    QCOMPARE(render(), initialImage);
+
+    widget->setSelected(true);
+    QVERIFY(render() != initialImage);
+    widget->setSelected(false);
+    QCOMPARE(render(), initialImage);
+
+    // Skip the hover animation, the item is not cached while it is running
+    widget->setHovered(true);
+    widget->setProperty("hoverOpacity", 1.0);
+    QVERIFY(render() != initialImage);
+    widget->setHovered(false);
+    widget->setProperty("hoverOpacity", 0.0);
+    QCOMPARE(render(), initialImage);
+
+    widget->setVisibleRoles({"text", "size"});
+    const QImage sizeShownImage = render();
+    QVERIFY(sizeShownImage != initialImage);
+
+    widget->setData({{"text", QStringLiteral("b")}, {"size", 1024}}, {"text"});
+    QVERIFY(render() != sizeShownImage);
+}
+
+void KFileItemListViewTest::loadFiles(int shortCount, int longCount)
+{
+    QStringList files;
+    for (int i = 0; i < shortCount; ++i) {
+        files.append(QStringLiteral("a%1").arg(i, 4, 10, QLatin1Char('0')));
+    }
+    for (int i = 0; i < longCount; ++i) {
+        files.append(QStringLiteral("z%1 with a name that is too long for a single line").arg(i, 4, 10, QLatin1Char('0')));
+    }
+    m_testDir->createFiles(files);
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(m_model->count(), shortCount + longCount);
+}
+
 QTEST_MAIN(KFileItemListViewTest)
 
 #include "kfileitemlistviewtest.moc"
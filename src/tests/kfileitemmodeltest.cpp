@@ -5,17 +5,25 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+#include <QDir>
 #include <QRandomGenerator>
 #include <QTest>
 #include <QSignalSpy>
 #include <QStandardPaths>
 #include <QTimer>
+#include <QUrlQuery>
 #include <QMimeData>
+#include <QPixmap>
 
 #include <KDirLister>
 #include <kio/job.h>
 
+#include "dolphin_generalsettings.h"
 #include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kitemset.h"
+#include "kitemviews/private/kfileitemmimetyperesolver.h"
+#include "kitemviews/private/kfileitemselectionsummary.h"
+#include "kitemviews/private/klocaldirlister.h"
 #include "testdir.h"
 
 void myMessageOutput(QtMsgType type, const QMessageLogContext& context, const QString& msg)
@@ -90,13 +98,34 @@ private Q_SLOTS:
     void testCollapseFolderWhileLoading();
     void testCreateMimeData();
     void testDeleteFileMoreThanOnce();
+    void testReleaseDirectory();
+    void testRestoreCachedDirectory();
+    void testPrefetchDirectory();
+    void testLocalDirLister();
+    void testLocalDirListerUpdates();
+    void testChangeCoalescing();
+    void testMimeTypeResolver();
+    void testMimeTypeFilterSniffing();
+    void testSetRoleValues();
+    void testExpandSubtree();
+    void testFlattenedListing();
+    void testFlattenedListingUpdates();
+    void testFileNameSearch();
+    void testFileNameSearchRefinement();
+    void testSelectionSummary();
 
 private:
     QStringList itemsInModel() const;
 
+    /**
+     * @return URL of a file name search for \a text in the test directory.
+     */
+    QUrl fileNameSearchUrl(const QString& text) const;
+
 private:
     KFileItemModel* m_model;
     TestDir* m_testDir;
+    bool m_useLocalDirLister;
 };
 
 void KFileItemModelTest::initTestCase()
@@ -114,6 +143,9 @@ void KFileItemModelTest::init()
     qRegisterMetaType<KItemRangeList>("KItemRangeList");
     qRegisterMetaType<KFileItemList>("KFileItemList");
 
+    // Tests that change the setting must not affect the other tests
+    m_useLocalDirLister = GeneralSettings::useLocalDirLister();
+
     m_testDir = new TestDir();
     m_model = new KFileItemModel();
     m_model->m_dirLister->setAutoUpdate(false);
@@ -129,6 +161,8 @@ void KFileItemModelTest::cleanup()
 
     delete m_testDir;
     m_testDir = nullptr;
+
+    GeneralSettings::setUseLocalDirLister(m_useLocalDirLister);
 }
 
 void KFileItemModelTest::testDefaultRoles()
@@ -1929,6 +1963,11 @@ void KFileItemModelTest::testCreateMimeData()
     KItemSet selection;
     selection.insert(1);
     QMimeData* mimeData = m_model->createMimeData(selection);
+
+    // The URLs are serialized when they are requested the first time
+    QVERIFY(mimeData->hasUrls());
+    QCOMPARE(mimeData->urls(), QList<QUrl>() << m_model->fileItem(1).url());
+    QCOMPARE(mimeData->urls(), QList<QUrl>() << m_model->fileItem(1).url());
     delete mimeData;
 }
 
@@ -2031,6 +2070,533 @@ void KFileItemModelTest::testDeleteFileMoreThanOnce()
     QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "c.txt" << "d.txt");
 }
 
+void KFileItemModelTest::testReleaseDirectory()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+
+    m_testDir->createFiles({"a.txt", "b.txt", ".hidden"});
+
+    m_model->setShowHiddenFiles(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << ".hidden" << "a.txt" << "b.txt");
+
+    // Releasing the directory removes all items, but keeps the settings of the dir lister
+    m_model->releaseDirectory();
+    QCOMPARE(m_model->count(), 0);
+    QVERIFY(m_model->showHiddenFiles());
+    QVERIFY(!m_model->m_dirLister->autoUpdate());
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << ".hidden" << "a.txt" << "b.txt");
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testRestoreCachedDirectory()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "subdir/c.txt"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "subdir" << "a.txt" << "b.txt");
+
+    QPixmap preview(16, 16);
+    preview.fill(Qt::red);
+    m_model->setData(1, {{"iconPixmap", preview}});
+    QVERIFY(m_model->data(1).contains("iconPixmap"));
+
+    QUrl subdirUrl = m_testDir->url();
+    subdirUrl.setPath(subdirUrl.path() + "/subdir");
+    m_model->loadDirectory(subdirUrl);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "c.txt");
+
+    // The items of the left directory are shown immediately when going back.
+    // Their previews are not cached and must be generated again.
+    itemsInsertedSpy.clear();
+    m_model->loadDirectory(m_testDir->url());
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    QCOMPARE(itemsInModel(), QStringList() << "subdir" << "a.txt" << "b.txt");
+    QVERIFY(!m_model->data(1).contains("iconPixmap"));
+
+    // Reconciling the restored items with the listed items must not add them twice
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "subdir" << "a.txt" << "b.txt");
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testPrefetchDirectory()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a.txt", "subdir/c.txt", "subdir/b.txt"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "subdir" << "a.txt");
+
+    QUrl subdirUrl = m_testDir->url();
+    subdirUrl.setPath(subdirUrl.path() + "/subdir");
+    m_model->prefetchDirectory(subdirUrl);
+    QTRY_COMPARE(m_model->m_cachedDirectories.count(), 1);
+
+    // Prefetching must not touch the shown items
+    QCOMPARE(itemsInModel(), QStringList() << "subdir" << "a.txt");
+
+    // The prefetched items are sorted and shown immediately
+    m_model->loadDirectory(subdirUrl);
+    QCOMPARE(itemsInModel(), QStringList() << "b.txt" << "c.txt");
+
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "b.txt" << "c.txt");
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testLocalDirLister()
+{
+    GeneralSettings::setUseLocalDirLister(true);
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a", "b", ".c", "d/e"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(m_model->usesLocalDirLister());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a" << "b");
+    QCOMPARE(m_model->rootItem().url().adjusted(QUrl::StripTrailingSlash), m_testDir->url().adjusted(QUrl::StripTrailingSlash));
+    QVERIFY(m_model->rootItem().isDir());
+
+    QUrl hiddenUrl = m_testDir->url();
+    hiddenUrl.setPath(hiddenUrl.path() + "/.c");
+    m_model->setShowHiddenFiles(true);
+    QCOMPARE(m_model->count(), 4);
+    QVERIFY(m_model->index(hiddenUrl) >= 0);
+
+    m_model->setShowHiddenFiles(false);
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a" << "b");
+
+    m_testDir->createFile("f");
+    m_model->refreshDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a" << "b" << "f");
+    QVERIFY(m_model->isConsistent());
+
+    // Directories that cannot be listed are passed to KDirLister, which reports the error
+    QUrl missingUrl = m_testDir->url();
+    missingUrl.setPath(missingUrl.path() + "/missing");
+    m_model->loadDirectory(missingUrl);
+    QTRY_VERIFY(!m_model->usesLocalDirLister());
+}
+
+void KFileItemModelTest::testLocalDirListerUpdates()
+{
+    GeneralSettings::setUseLocalDirLister(true);
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a", "b"});
+
+    m_model->m_dirLister->setAutoUpdate(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b");
+
+    KLocalDirLister* lister = m_model->m_localDirLister;
+    QVERIFY(lister->isWatching());
+
+    // Files that are changed in place are stated again without reading the directory
+    m_testDir->createFile("a", QByteArray("changed"));
+    lister->slotDirectoryChanged(m_testDir->path() + "/a");
+    QTRY_COMPARE(m_model->fileItem(0).size(), KIO::filesize_t(7));
+    QCOMPARE(m_model->fileItem(1).size(), KIO::filesize_t(4));
+
+    // Added and removed entries are found by reading the directory
+    m_testDir->createFile("c");
+    m_testDir->removeFile("b");
+    lister->slotDirectoryChanged(m_testDir->path());
+    QTRY_COMPARE(itemsInModel(), QStringList() << "a" << "c");
+    QCOMPARE(m_model->fileItem(0).size(), KIO::filesize_t(7));
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testChangeCoalescing()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
+    QSignalSpy itemsChangedSpy(m_model, &KFileItemModel::itemsChanged);
+
+    m_testDir->createFiles({"a", "b", "c"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c");
+    itemsInsertedSpy.clear();
+
+    m_testDir->createFiles({"d", "e"});
+
+    const KFileItem fileItemA = m_model->fileItem(0);
+    const KFileItem fileItemB = m_model->fileItem(1);
+    const KFileItem fileItemC = m_model->fileItem(2);
+    const KFileItem fileItemD(QUrl::fromLocalFile(m_testDir->path() + "/d"));
+    const KFileItem fileItemE(QUrl::fromLocalFile(m_testDir->path() + "/e"));
+
+    // Adding and deleting an item in between cancel each other out
+    m_model->slotListerItemsAdded(m_model->directory(), {fileItemD});
+    m_model->slotListerItemsDeleted({fileItemD});
+    QVERIFY(m_model->m_pendingChanges.isEmpty());
+
+    m_model->slotListerItemsDeleted({fileItemA});
+    m_model->slotListerRefreshItems({qMakePair(fileItemB, fileItemB)});
+    m_model->slotListerRefreshItems({qMakePair(fileItemB, fileItemB)});
+    m_model->slotListerItemsAdded(m_model->directory(), {fileItemE});
+    m_model->slotListerCompleted();
+    QCOMPARE(m_model->m_pendingChanges.count(), 3);
+
+    // The changes are not applied before the coalescing interval has passed
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c");
+
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "b" << "c" << "e");
+    QCOMPARE(itemsRemovedSpy.count(), 1);
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    QVERIFY(itemsChangedSpy.count() <= 1);
+    QVERIFY(m_model->isConsistent());
+
+    // Deleting and adding an item in between refreshes it
+    itemsRemovedSpy.clear();
+    itemsInsertedSpy.clear();
+    m_model->slotListerItemsDeleted({fileItemC});
+    m_model->slotListerItemsAdded(m_model->directory(), {fileItemC});
+    m_model->applyPendingChanges();
+    QCOMPARE(itemsInModel(), QStringList() << "b" << "c" << "e");
+    QCOMPARE(itemsRemovedSpy.count(), 0);
+    QCOMPARE(itemsInsertedSpy.count(), 0);
+}
+
+void KFileItemModelTest::testMimeTypeResolver()
+{
+    m_testDir->createFile("a.txt");
+    m_testDir->createFile("script", "#!/bin/sh\necho a\n");
+
+    const KFileItem textItem(QUrl::fromLocalFile(m_testDir->path() + "/a.txt"));
+    const KFileItem scriptItem(QUrl::fromLocalFile(m_testDir->path() + "/script"));
+
+    // Only the contents of files without a meaningful name must be read
+    QVERIFY(!KFileItemMimeTypeResolver::needsContentSniffing(textItem));
+    QVERIFY(KFileItemMimeTypeResolver::needsContentSniffing(scriptItem));
+
+    KFileItemMimeTypeResolver resolver;
+    QSignalSpy mimeTypesResolvedSpy(&resolver, &KFileItemMimeTypeResolver::mimeTypesResolved);
+    resolver.resolve(scriptItem);
+    resolver.resolve(scriptItem);
+    QVERIFY(mimeTypesResolvedSpy.wait());
+    QCOMPARE(mimeTypesResolvedSpy.count(), 1);
+    const KFileItemList resolvedItems = mimeTypesResolvedSpy.takeFirst().at(0).value<KFileItemList>();
+    QCOMPARE(resolvedItems.count(), 1);
+
+    // The file is not read again in the GUI thread: The requested item is
+    // left untouched, and a copy with the sniffed MIME type is passed
+    QVERIFY(!scriptItem.isMimeTypeKnown());
+    const KFileItem resolvedItem = resolvedItems.first();
+    QCOMPARE(resolvedItem.url(), scriptItem.url());
+    QVERIFY(resolvedItem.isMimeTypeKnown());
+    QCOMPARE(resolvedItem.mimetype(), QStringLiteral("application/x-shellscript"));
+    QVERIFY(!KFileItemMimeTypeResolver::needsContentSniffing(resolvedItem));
+}
+
+void KFileItemModelTest::testMimeTypeFilterSniffing()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+
+    m_testDir->createFile("a.txt");
+    m_testDir->createFile("script", "#!/bin/sh\necho a\n");
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "script");
+
+    const int scriptIndex = m_model->index(QUrl::fromLocalFile(m_testDir->path() + "/script"));
+    const KFileItem scriptItem = m_model->fileItem(scriptIndex);
+    QVERIFY(!scriptItem.isMimeTypeKnown());
+    QVERIFY(scriptItem.currentMimeType().name() != QLatin1String("application/x-shellscript"));
+
+    // Files without a meaningful name are filtered by their contents. A wrong
+    // guess would hide them, and filtered items are never refined.
+    m_model->setMimeTypeFilters({QStringLiteral("application/x-shellscript")});
+    QCOMPARE(itemsInModel(), QStringList() << "script");
+
+    m_model->setMimeTypeFilters({QStringLiteral("text/plain")});
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt");
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testSetRoleValues()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsChangedSpy(m_model, &KFileItemModel::itemsChanged);
+    QSignalSpy itemsMovedSpy(m_model, &KFileItemModel::itemsMoved);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "c.txt");
+
+    m_model->setSortRole("rating");
+    itemsChangedSpy.clear();
+
+    // All values are set by one change, and the items are resorted once
+    m_model->setRoleValues("rating", {0, 1, 2, 5}, {6, 4, 2, 8});
+    QCOMPARE(itemsChangedSpy.count(), 1);
+    QCOMPARE(itemsChangedSpy.first().at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(0, 3));
+
+    QVERIFY(itemsMovedSpy.wait());
+    QCOMPARE(itemsMovedSpy.count(), 1);
+    QCOMPARE(itemsInModel(), QStringList() << "c.txt" << "b.txt" << "a.txt");
+    QCOMPARE(m_model->data(0).value("rating").toInt(), 2);
+
+    // Unchanged values do not result in a change
+    m_model->setRoleValues("rating", {0}, {2});
+    QCOMPARE(itemsChangedSpy.count(), 1);
+}
+
+void KFileItemModelTest::testExpandSubtree()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+
+    QSet<QByteArray> modelRoles = m_model->roles();
+    modelRoles << "isExpanded" << "isExpandable" << "expandedParentsCount";
+    m_model->setRoles(modelRoles);
+
+    m_testDir->createFiles({"a/b/c/1", "a/b/2", "a/d/3", "a/4", "e"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "e");
+    itemsInsertedSpy.clear();
+
+    // Expand "a" and its sub-folders "b" and "d", but not "b/c"
+    QVERIFY(m_model->expandSubtree(0, 2));
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    QCOMPARE(itemsInsertedSpy.takeFirst().at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(1, 7));
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c" << "2" << "d" << "3" << "4" << "e");
+    QVERIFY(m_model->isExpanded(0));
+    QVERIFY(m_model->isExpanded(1));
+    QVERIFY(!m_model->isExpanded(2));
+    QCOMPARE(m_model->expandedParentsCount(2), 2);
+    QCOMPARE(m_model->expandedDirectories(), QSet<QUrl>() << QUrl::fromLocalFile(m_testDir->path() + "/a")
+                                                          << QUrl::fromLocalFile(m_testDir->path() + "/a/b")
+                                                          << QUrl::fromLocalFile(m_testDir->path() + "/a/d"));
+    QVERIFY(m_model->isConsistent());
+
+    // The folders are watched by the dir lister, which must not insert the items again
+    QTest::qWait(100);
+    QCOMPARE(m_model->count(), 8);
+
+    // Collapsing works like for folders expanded by setExpanded()
+    QVERIFY(m_model->setExpanded(0, false));
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "e");
+    QVERIFY(m_model->expandedDirectories().isEmpty());
+}
+
+void KFileItemModelTest::testFlattenedListing()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    QSet<QByteArray> modelRoles = m_model->roles();
+    modelRoles << "path";
+    m_model->setRoles(modelRoles);
+
+    m_testDir->createFiles({"a/1", "a/b/2", ".h/3", "4"});
+
+    // Only the files are shown, and hidden folders are skipped
+    m_model->setSubfoldersFlattened(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QVERIFY(m_model->usesLocalDirLister());
+    QCOMPARE(itemsInModel(), QStringList() << "1" << "2" << "4");
+    QVERIFY(m_model->data(1).value("path").toString().endsWith(QLatin1String("/a/b")));
+    QVERIFY(m_model->isConsistent());
+
+    // Refreshing the directory switches back to the normal listing
+    m_model->setSubfoldersFlattened(false);
+    m_model->refreshDirectory(m_testDir->url());
+    QTRY_COMPARE(itemsInModel(), QStringList() << "a" << "4");
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testFlattenedListingUpdates()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a/1", "a/b/2", "c/3", "4"});
+
+    m_model->m_dirLister->setAutoUpdate(true);
+    m_model->setSubfoldersFlattened(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "1" << "2" << "3" << "4");
+
+    // The sub-directories are not watched, the changes reported by KIO
+    // are used instead. Removing a folder removes the files below it.
+    KLocalDirLister* lister = m_model->m_localDirLister;
+    m_testDir->removeFiles({"a/1", "a/b/2"});
+    lister->slotFilesRemoved({QUrl::fromLocalFile(m_testDir->path() + "/a").toString()});
+    QCOMPARE(itemsInModel(), QStringList() << "3" << "4");
+
+    // Changes in hidden folders and outside of the listed folder are ignored
+    QVERIFY(!lister->isNotified(QUrl::fromLocalFile(m_testDir->path() + "/.h")));
+    QVERIFY(!lister->isNotified(QUrl::fromLocalFile(QDir::tempPath())));
+
+    // Added files are found by listing the folder again
+    m_testDir->createFile("c/5");
+    lister->slotFilesAdded(QUrl::fromLocalFile(m_testDir->path() + "/c").toString());
+    QTRY_COMPARE(itemsInModel(), QStringList() << "3" << "4" << "5");
+    QVERIFY(!lister->isTruncated());
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testFileNameSearch()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a/foo.txt", "a/b/bar.txt", "a/foobar/1", "xfoo2", ".h/foo3", "c/x"});
+
+    // Matching folders are listed and searched, too
+    m_model->loadDirectory(fileNameSearchUrl(QStringLiteral("FOO")));
+    QVERIFY(loadingCompletedSpy.wait());
+    QVERIFY(m_model->usesLocalDirLister());
+    QCOMPARE(itemsInModel(), QStringList() << "foobar" << "foo.txt" << "xfoo2");
+    QVERIFY(m_model->isConsistent());
+
+    // A pattern that is no valid regular expression is used as wildcard pattern
+    m_model->loadDirectory(fileNameSearchUrl(QStringLiteral("*.txt")));
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "bar.txt" << "foo.txt");
+
+    m_model->loadDirectory(fileNameSearchUrl(QStringLiteral("^xfoo\\d$")));
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "xfoo2");
+}
+
+void KFileItemModelTest::testFileNameSearchRefinement()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a/foo", "a/b/foobar", "fob", "foobaz"});
+
+    // The results cannot be refined until the search has been completed
+    m_model->loadDirectory(fileNameSearchUrl(QStringLiteral("fo")));
+    QVERIFY(!m_model->canRefineSearch(fileNameSearchUrl(QStringLiteral("foo"))));
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "fob" << "foo" << "foobar" << "foobaz");
+    QVERIFY(m_model->canRefineSearch(fileNameSearchUrl(QStringLiteral("foo"))));
+    QVERIFY(!m_model->canRefineSearch(fileNameSearchUrl(QStringLiteral("f"))));
+    QVERIFY(!m_model->canRefineSearch(fileNameSearchUrl(QStringLiteral("fo*"))));
+
+    // The previous results are filtered immediately, and the
+    // files created meanwhile are found by searching again
+    m_testDir->createFile("a/foobat");
+    m_model->loadDirectory(fileNameSearchUrl(QStringLiteral("OOB")));
+    QCOMPARE(itemsInModel(), QStringList() << "foobar" << "foobaz");
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "foobar" << "foobat" << "foobaz");
+    QVERIFY(m_model->isConsistent());
+
+    // Searching for a text that is no refinement starts a new search
+    m_model->loadDirectory(fileNameSearchUrl(QStringLiteral("fob")));
+    QCOMPARE(m_model->count(), 0);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "fob");
+}
+
+void KFileItemModelTest::testSelectionSummary()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
+
+    // Mix folders and files of different sizes, so that each range of
+    // the selection contains folders and files
+    QStringList files;
+    for (int i = 0; i < 30; ++i) {
+        const QString name = QStringLiteral("%1").arg(i, 2, 10, QLatin1Char('0'));
+        if (i % 4 == 0) {
+            m_testDir->createDir(name);
+        } else {
+            m_testDir->createFile(name, QByteArray(i * 100, 'x'));
+            files.append(name);
+        }
+    }
+
+    m_model->setSortDirectoriesFirst(false);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(m_model->count(), 30);
+
+    KFileItemSelectionSummary selectionSummary(m_model);
+
+    // Summarizes the items per item like DolphinView did before
+    auto expectedSummary = [this](const KItemSet& items) {
+        KFileItemSelectionSummary::Summary summary{0, 0, 0};
+        for (const int index : items) {
+            const KFileItem item = m_model->fileItem(index);
+            if (item.isDir()) {
+                ++summary.folderCount;
+            } else {
+                ++summary.fileCount;
+                summary.totalFileSize += item.size();
+            }
+        }
+        return summary;
+    };
+
+    auto verifySummary = [&](const KItemSet& items) {
+        const KFileItemSelectionSummary::Summary summary = selectionSummary.summary(items);
+        const KFileItemSelectionSummary::Summary expected = expectedSummary(items);
+        QCOMPARE(summary.folderCount, expected.folderCount);
+        QCOMPARE(summary.fileCount, expected.fileCount);
+        QCOMPARE(summary.totalFileSize, expected.totalFileSize);
+    };
+
+    KItemSet allItems;
+    for (int i = 0; i < m_model->count(); ++i) {
+        allItems.insert(i);
+    }
+
+    KItemSet someItems;
+    someItems << 0 << 1 << 2 << 7 << 11 << 12 << 13 << 14 << 29;
+
+    verifySummary(KItemSet());
+    verifySummary(allItems);
+    verifySummary(someItems);
+
+    const KFileItemSelectionSummary::Summary total = selectionSummary.totalSummary();
+    const KFileItemSelectionSummary::Summary expectedTotal = expectedSummary(allItems);
+    QCOMPARE(total.folderCount, expectedTotal.folderCount);
+    QCOMPARE(total.fileCount, expectedTotal.fileCount);
+    QCOMPARE(total.totalFileSize, expectedTotal.totalFileSize);
+
+    // The summary must be updated after the items of the model have been changed
+    m_testDir->removeFiles({files.at(0), files.at(5), files.at(10)});
+    m_model->m_dirLister->updateDirectory(m_testDir->url());
+    QVERIFY(itemsRemovedSpy.wait());
+    QCOMPARE(m_model->count(), 27);
+
+    someItems.clear();
+    someItems << 0 << 3 << 4 << 5 << 20 << 26;
+    verifySummary(someItems);
+
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QCOMPARE(itemsInModel().first(), QStringLiteral("29"));
+    verifySummary(someItems);
+}
+
 QStringList KFileItemModelTest::itemsInModel() const
 {
     QStringList items;
@@ -2040,6 +2606,18 @@ QStringList KFileItemModelTest::itemsInModel() const
     return items;
 }
 
+QUrl KFileItemModelTest::fileNameSearchUrl(const QString& text) const
+{
+    QUrlQuery query;
+    query.addQueryItem(QStringLiteral("search"), text);
+    query.addQueryItem(QStringLiteral("url"), m_testDir->url().url());
+
+    QUrl url;
+    url.setScheme(QStringLiteral("filenamesearch"));
+    url.setQuery(query);
+    return url;
+}
+
 QTEST_MAIN(KFileItemModelTest)
 
 #include "kfileitemmodeltest.moc"
@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QTest>
+
+#include <random>
+
+#include "kitemviews/private/kitemlistadvancetable.h"
+
+class KItemListAdvanceTableBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void fontMetricsHorizontalAdvance();
+    void advanceTableHorizontalAdvance();
+    void compareWidths();
+
+private:
+    QFont m_font;
+    QStringList m_fileNames;
+};
+
+void KItemListAdvanceTableBenchmark::initTestCase()
+{
+    m_font = QFontDatabase::systemFont(QFontDatabase::GeneralFont);
+
+    // Create 1 million file names that are similar to real file names: Mostly
+    // ASCII characters with an extension, only a few with non-ASCII characters.
+    const QString characters = QStringLiteral("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 _-()");
+    const QStringList extensions = {".txt", ".jpg", ".png", ".pdf", ".cpp", ".h", ".tar.gz", ".odt", ""};
+
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> lengthDistribution(3, 40);
+    std::uniform_int_distribution<int> characterDistribution(0, characters.length() - 1);
+    std::uniform_int_distribution<int> extensionDistribution(0, extensions.count() - 1);
+    std::uniform_int_distribution<int> percentDistribution(0, 99);
+
+    const int count = 1000000;
+    m_fileNames.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const int length = lengthDistribution(generator);
+        QString fileName;
+        fileName.reserve(length + 8);
+        for (int j = 0; j < length; ++j) {
+            fileName.append(characters.at(characterDistribution(generator)));
+        }
+        if (percentDistribution(generator) < 5) {
+            fileName.append(QStringLiteral("äöü"));
+        }
+        fileName.append(extensions.at(extensionDistribution(generator)));
+        m_fileNames.append(fileName);
+    }
+
+    // Create the table before benchmarking
+    KItemListAdvanceTable::forFont(m_font);
+}
+
+void KItemListAdvanceTableBenchmark::fontMetricsHorizontalAdvance()
+{
+    const QFontMetrics fontMetrics(m_font);
+    qint64 sum = 0;
+    QBENCHMARK_ONCE {
+        for (const QString& fileName : qAsConst(m_fileNames)) {
+            sum += fontMetrics.horizontalAdvance(fileName);
+        }
+    }
+    QVERIFY(sum > 0);
+}
+
+void KItemListAdvanceTableBenchmark::advanceTableHorizontalAdvance()
+{
+    qint64 sum = 0;
+    QBENCHMARK_ONCE {
+        for (const QString& fileName : qAsConst(m_fileNames)) {
+            sum += KItemListAdvanceTable::horizontalAdvance(fileName, m_font);
+        }
+    }
+    QVERIFY(sum > 0);
+}
+
+void KItemListAdvanceTableBenchmark::compareWidths()
+{
+    const QFontMetrics fontMetrics(m_font);
+    const KItemListAdvanceTable* table = KItemListAdvanceTable::forFont(m_font);
+
+    int measuredByTable = 0;
+    for (const QString& fileName : qAsConst(m_fileNames)) {
+        const int width = table->horizontalAdvance(fileName);
+        if (width >= 0) {
+            QCOMPARE(width, fontMetrics.horizontalAdvance(fileName));
+            ++measuredByTable;
+        }
+    }
+
+    // Most generated names only consist of ASCII characters, which the table covers
+    QVERIFY(measuredByTable > 0);
+}
+
+QTEST_MAIN(KItemListAdvanceTableBenchmark)
+
+#include "kitemlistadvancetablebenchmark.moc"
@@ -0,0 +1,203 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/kitemset.h"
+
+#include <QStandardPaths>
+#include <QTest>
+
+#include <random>
+
+namespace {
+    const int ItemCount = 1000000;
+
+    /**
+     * Returns the items from [0, itemCount[ of a pattern:
+     * "checkerboard" contains every second item, "percent" contains each item
+     * with the probability \a percent / 100.
+     */
+    QVector<int> itemsOfPattern(const QByteArray& pattern, int itemCount, int percent, quint32 seed)
+    {
+        QVector<int> result;
+        if (pattern == "checkerboard") {
+            for (int i = 0; i < itemCount; i += 2) {
+                result.append(i);
+            }
+        } else {
+            std::mt19937 generator(seed);
+            std::uniform_int_distribution<int> distribution(0, 99);
+            for (int i = 0; i < itemCount; ++i) {
+                if (distribution(generator) < percent) {
+                    result.append(i);
+                }
+            }
+        }
+        return result;
+    }
+
+    KItemSet itemSetOfPattern(const QByteArray& pattern, int percent, quint32 seed)
+    {
+        KItemSet itemSet;
+        for (int i : itemsOfPattern(pattern, ItemCount, percent, seed)) {
+            itemSet.insert(i);
+        }
+        return itemSet;
+    }
+}
+
+/**
+ * Benchmarks the operations of KItemSet on large fragmented sets,
+ * which are stored as bitmaps internally.
+ */
+class KItemSetBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void insert_data();
+    void insert();
+    void contains_data();
+    void contains();
+    void addSets_data();
+    void addSets();
+    void symmetricDifference_data();
+    void symmetricDifference();
+    void intersection_data();
+    void intersection();
+
+private:
+    void addPatternData();
+};
+
+void KItemSetBenchmark::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void KItemSetBenchmark::insert_data()
+{
+    addPatternData();
+}
+
+void KItemSetBenchmark::insert()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, percent);
+
+    const QVector<int> items = itemsOfPattern(pattern, ItemCount, percent, 1);
+
+    QBENCHMARK {
+        KItemSet itemSet;
+        for (int i : items) {
+            itemSet.insert(i);
+        }
+    }
+}
+
+void KItemSetBenchmark::contains_data()
+{
+    addPatternData();
+}
+
+void KItemSetBenchmark::contains()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, percent);
+
+    const KItemSet itemSet = itemSetOfPattern(pattern, percent, 1);
+
+    int containedCount = 0;
+    QBENCHMARK {
+        containedCount = 0;
+        for (int i = 0; i < ItemCount; ++i) {
+            if (itemSet.contains(i)) {
+                ++containedCount;
+            }
+        }
+    }
+    QCOMPARE(containedCount, itemSet.count());
+}
+
+void KItemSetBenchmark::addSets_data()
+{
+    addPatternData();
+}
+
+void KItemSetBenchmark::addSets()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, percent);
+
+    const KItemSet itemSet1 = itemSetOfPattern(pattern, percent, 1);
+    const KItemSet itemSet2 = itemSetOfPattern("random", percent, 2);
+
+    KItemSet sum;
+    QBENCHMARK {
+        sum = itemSet1 + itemSet2;
+    }
+    QVERIFY(sum.count() >= itemSet1.count());
+}
+
+void KItemSetBenchmark::symmetricDifference_data()
+{
+    addPatternData();
+}
+
+/**
+ * Toggling the items of a rubberband selection in a fragmented
+ * selection is done by KItemListController with operator^().
+ */
+void KItemSetBenchmark::symmetricDifference()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, percent);
+
+    const KItemSet itemSet1 = itemSetOfPattern(pattern, percent, 1);
+    const KItemSet itemSet2 = itemSetOfPattern("random", percent, 2);
+
+    KItemSet symmetricDifference;
+    QBENCHMARK {
+        symmetricDifference = itemSet1 ^ itemSet2;
+    }
+    QCOMPARE(symmetricDifference ^ itemSet2, itemSet1);
+}
+
+void KItemSetBenchmark::intersection_data()
+{
+    addPatternData();
+}
+
+void KItemSetBenchmark::intersection()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, percent);
+
+    const KItemSet itemSet1 = itemSetOfPattern(pattern, percent, 1);
+    const KItemSet itemSet2 = itemSetOfPattern("random", percent, 2);
+
+    KItemSet intersection;
+    QBENCHMARK {
+        intersection = itemSet1 & itemSet2;
+    }
+    QVERIFY(intersection.count() <= itemSet1.count());
+}
+
+void KItemSetBenchmark::addPatternData()
+{
+    QTest::addColumn<QByteArray>("pattern");
+    QTest::addColumn<int>("percent");
+
+    QTest::newRow("checkerboard") << QByteArray("checkerboard") << 50;
+    QTest::newRow("random 1%") << QByteArray("random") << 1;
+    QTest::newRow("random 50%") << QByteArray("random") << 50;
+    QTest::newRow("random 99%") << QByteArray("random") << 99;
+}
+
+QTEST_GUILESS_MAIN(KItemSetBenchmark)
+
+#include "kitemsetbenchmark.moc"
@@ -9,6 +9,8 @@
 #include <QStandardPaths>
 #include <QTest>
 
+#include <random>
+
 Q_DECLARE_METATYPE(KItemRangeList)
 
 /**
@@ -78,6 +80,30 @@ static QSet<int> KItemSet2QSet(const KItemSet& itemSet)
 }
 
 
+/**
+ * Returns the items from [0, itemCount[ of a pattern:
+ * "checkerboard" contains every second item, "percent" contains each item
+ * with the probability \a percent / 100.
+ */
+static QVector<int> itemsOfPattern(const QByteArray& pattern, int itemCount, int percent, quint32 seed)
+{
+    QVector<int> result;
+    if (pattern == "checkerboard") {
+        for (int i = 0; i < itemCount; i += 2) {
+            result.append(i);
+        }
+    } else {
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<int> distribution(0, 99);
+        for (int i = 0; i < itemCount; ++i) {
+            if (distribution(generator) < percent) {
+                result.append(i);
+            }
+        }
+    }
+    return result;
+}
+
 /**
  * The main test class.
  */
@@ -104,8 +130,14 @@ private Q_SLOTS:
     */
     void testSymmetricDifference_data();
     void testSymmetricDifference();
+    void testIntersection_data();
+    void testIntersection();
+
+    void testLargeSets_data();
+    void testLargeSets();
 
 private:
+
     QHash<const char*, KItemRangeList> m_testCases;
 };
 
@@ -594,6 +626,137 @@ void KItemSetTest::testSymmetricDifference()
     QCOMPARE(itemSet2 ^ symmetricDifference, itemSet1);
 }
 
+void KItemSetTest::testIntersection_data()
+{
+    QTest::addColumn<KItemRangeList>("itemRanges1");
+    QTest::addColumn<KItemRangeList>("itemRanges2");
+
+    QHash<const char*, KItemRangeList>::const_iterator it1 = m_testCases.constBegin();
+    const QHash<const char*, KItemRangeList>::const_iterator end = m_testCases.constEnd();
+
+    while (it1 != end) {
+        QHash<const char*, KItemRangeList>::const_iterator it2 = m_testCases.constBegin();
+
+        while (it2 != end) {
+            QByteArray name = it1.key() + QByteArray(" & ") + it2.key();
+            QTest::newRow(name) << it1.value() << it2.value();
+            ++it2;
+        }
+
+        ++it1;
+    }
+}
+
+void KItemSetTest::testIntersection()
+{
+    QFETCH(KItemRangeList, itemRanges1);
+    QFETCH(KItemRangeList, itemRanges2);
+
+    KItemSet itemSet1 = KItemRangeList2KItemSet(itemRanges1);
+    QSet<int> itemsQSet1 = KItemRangeList2QSet(itemRanges1);
+
+    KItemSet itemSet2 = KItemRangeList2KItemSet(itemRanges2);
+    QSet<int> itemsQSet2 = KItemRangeList2QSet(itemRanges2);
+
+    KItemSet intersection = itemSet1 & itemSet2;
+    QSet<int> intersectionQSet = itemsQSet1 & itemsQSet2;
+
+    QVERIFY(intersection.isValid());
+    QCOMPARE(intersection.count(), intersectionQSet.count());
+    QCOMPARE(KItemSet2QSet(intersection), intersectionQSet);
+
+    // Check commutativity.
+    QCOMPARE(itemSet2 & itemSet1, intersection);
+
+    // Some more checks:
+    // itemSet1 & itemSet1 == itemSet1,
+    // (itemSet1 ^ itemSet2) + intersection == itemSet1 + itemSet2.
+    QCOMPARE(itemSet1 & itemSet1, itemSet1);
+    QCOMPARE((itemSet1 ^ itemSet2) + intersection, itemSet1 + itemSet2);
+}
+
+void KItemSetTest::testLargeSets_data()
+{
+    QTest::addColumn<QByteArray>("pattern");
+    QTest::addColumn<int>("percent");
+
+    QTest::newRow("checkerboard") << QByteArray("checkerboard") << 50;
+    QTest::newRow("random 1%") << QByteArray("random") << 1;
+    QTest::newRow("random 50%") << QByteArray("random") << 50;
+    QTest::newRow("random 99%") << QByteArray("random") << 99;
+}
+
+/**
+ * Verify that large fragmented sets, which are stored as bitmaps
+ * internally, behave exactly like the equivalent QSet<int>.
+ */
+void KItemSetTest::testLargeSets()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, percent);
+
+    const int itemCount = 200000;
+    const QVector<int> items1 = itemsOfPattern(pattern, itemCount, percent, 1);
+    const QVector<int> items2 = itemsOfPattern("random", itemCount, percent, 2);
+
+    KItemSet itemSet1;
+    QSet<int> itemsQSet1;
+    for (int i : items1) {
+        itemSet1.insert(i);
+        itemsQSet1.insert(i);
+    }
+    QVERIFY(itemSet1.isValid());
+
+    KItemSet itemSet2;
+    QSet<int> itemsQSet2;
+    for (int i : items2) {
+        itemSet2.insert(i);
+        itemsQSet2.insert(i);
+    }
+    QVERIFY(itemSet2.isValid());
+
+    QCOMPARE(itemSet1.count(), items1.count());
+    QCOMPARE(itemSet1.ranges(), KItemRangeList::fromSortedContainer(items1));
+
+    QVector<int> testQVector;
+    for (int i : qAsConst(itemSet1)) {
+        testQVector.append(i);
+    }
+    QCOMPARE(testQVector, items1);
+
+    for (int i = -1; i <= itemCount; ++i) {
+        QCOMPARE(itemSet1.contains(i), itemsQSet1.contains(i));
+    }
+
+    const KItemSet sum = itemSet1 + itemSet2;
+    QVERIFY(sum.isValid());
+    QCOMPARE(KItemSet2QSet(sum), itemsQSet1 + itemsQSet2);
+
+    const KItemSet symmetricDifference = itemSet1 ^ itemSet2;
+    QVERIFY(symmetricDifference.isValid());
+    QCOMPARE(KItemSet2QSet(symmetricDifference), (itemsQSet1 - itemsQSet2) + (itemsQSet2 - itemsQSet1));
+    QCOMPARE(itemSet1 ^ symmetricDifference, itemSet2);
+
+    const KItemSet intersection = itemSet1 & itemSet2;
+    QVERIFY(intersection.isValid());
+    QCOMPARE(KItemSet2QSet(intersection), itemsQSet1 & itemsQSet2);
+    QCOMPARE(symmetricDifference + intersection, sum);
+
+    // Remove every third item.
+    KItemSet::iterator it = itemSet1.begin();
+    int index = 0;
+    while (it != itemSet1.end()) {
+        if (index % 3 == 0) {
+            itemsQSet1.remove(*it);
+            it = itemSet1.erase(it);
+        } else {
+            ++it;
+        }
+        ++index;
+    }
+    QVERIFY(itemSet1.isValid());
+    QCOMPARE(KItemSet2QSet(itemSet1), itemsQSet1);
+}
 
 QTEST_GUILESS_MAIN(KItemSetTest)
 
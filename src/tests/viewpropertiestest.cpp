@@ -6,8 +6,10 @@
 
 #include "dolphin_generalsettings.h"
 #include "views/viewproperties.h"
+#include "views/viewpropertiescache.h"
 #include "testdir.h"
 
+#include <QSignalSpy>
 #include <QTest>
 
 class ViewPropertiesTest : public QObject
@@ -21,6 +23,7 @@ private Q_SLOTS:
 
     void testReadOnlyBehavior();
     void testAutoSave();
+    void testSaveBeforeDirectoryChecked();
 
 private:
     bool m_globalViewProps;
@@ -78,12 +81,64 @@ void ViewPropertiesTest::testAutoSave()
     QString dotDirectoryFile = m_testDir->url().toLocalFile() + "/.directory";
     QVERIFY(!QFile::exists(dotDirectoryFile));
 
+    // The directory is checked in the background. As long as the check has
+    // not been finished, the view properties are not stored inside the directory.
+    ViewPropertiesCache* cache = ViewPropertiesCache::instance();
+    QSignalSpy localDirectoryChangedSpy(cache, &ViewPropertiesCache::localDirectoryChanged);
+    const QString path = m_testDir->url().toLocalFile();
+    ViewPropertiesCache::LocalDirectory directory;
+    QVERIFY(!cache->localDirectory(path, directory));
+    QVERIFY(localDirectoryChangedSpy.wait());
+    QCOMPARE(localDirectoryChangedSpy.first().first().toString(), path);
+    QVERIFY(cache->localDirectory(path, directory));
+    QVERIFY(!directory.useDestinationDir);
+    QVERIFY(!directory.fileExists);
+
     QScopedPointer<ViewProperties> props(new ViewProperties(m_testDir->url()));
     QVERIFY(props->isAutoSaveEnabled());
     props->setSortRole("someNewSortRole");
     props.reset();
 
+    // The file is written with a small delay
+    QTRY_VERIFY(QFile::exists(dotDirectoryFile));
+}
+
+/**
+ * Test whether view properties that are saved before the directory has
+ * been checked are stored inside the directory after the check.
+ */
+void ViewPropertiesTest::testSaveBeforeDirectoryChecked()
+{
+    const QString path = m_testDir->url().toLocalFile();
+    const QString dotDirectoryFile = path + "/.directory";
+    QVERIFY(!QFile::exists(dotDirectoryFile));
+
+    ViewPropertiesCache* cache = ViewPropertiesCache::instance();
+    QSignalSpy localDirectoryChangedSpy(cache, &ViewPropertiesCache::localDirectoryChanged);
+
+    // Constructing the view properties starts the check of the directory
+    QScopedPointer<ViewProperties> props(new ViewProperties(m_testDir->url()));
+    props->setSortRole("someNewSortRole");
+    props.reset();
+
+    props.reset(new ViewProperties(m_testDir->url()));
+    QVERIFY(props->exist());
+    QCOMPARE(props->sortRole(), QByteArray("someNewSortRole"));
+    props.reset();
+
+    if (cache->isDeferredSyncPending(path)) {
+        QVERIFY(localDirectoryChangedSpy.wait());
+    }
+    QVERIFY(!cache->isDeferredSyncPending(path));
+
+    cache->syncPendingConfigs();
     QVERIFY(QFile::exists(dotDirectoryFile));
+
+    const QString destinationDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/view_properties/local";
+    QVERIFY(!QFile::exists(destinationDir + path + "/.directory"));
+
+    props.reset(new ViewProperties(m_testDir->url()));
+    QCOMPARE(props->sortRole(), QByteArray("someNewSortRole"));
 }
 
 QTEST_GUILESS_MAIN(ViewPropertiesTest)
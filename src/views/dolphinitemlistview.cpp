@@ -74,6 +74,7 @@ void DolphinItemListView::readSettings()
 
     setEnabledSelectionToggles(GeneralSettings::showSelectionToggle());
     setHighlightEntireRow(DetailsModeSettings::leadingPadding());
+    setItemRenderCacheEnabled(GeneralSettings::cacheRenderedItems());
     setSupportsItemExpanding(itemLayoutSupportsItemExpanding(itemLayout()));
 
     updateFont();
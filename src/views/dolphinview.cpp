@@ -18,10 +18,13 @@
 #include "kitemviews/kitemlistcontroller.h"
 #include "kitemviews/kitemlistheader.h"
 #include "kitemviews/kitemlistselectionmanager.h"
+#include "kitemviews/private/kdirectorysizecounter.h"
+#include "kitemviews/private/kfileitemselectionsummary.h"
 #include "kitemviews/private/kitemlistroleeditor.h"
 #include "settings/viewmodes/viewmodesettings.h"
 #include "versioncontrol/versioncontrolobserver.h"
 #include "viewproperties.h"
+#include "viewpropertiescache.h"
 #include "views/tooltips/tooltipmanager.h"
 #include "zoomlevelinfo.h"
 
@@ -77,10 +80,13 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     m_visibleRoles(),
     m_topLayout(nullptr),
     m_model(nullptr),
+    m_selectionSummary(nullptr),
     m_view(nullptr),
     m_container(nullptr),
     m_toolTipManager(nullptr),
     m_selectionChangedTimer(nullptr),
+    m_prefetchTimer(nullptr),
+    m_prefetchUrl(),
     m_currentItemUrl(),
     m_scrollToCurrentItem(false),
     m_restoredContentsPosition(),
@@ -90,7 +96,12 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     m_versionControlObserver(nullptr),
     m_twoClicksRenamingTimer(nullptr),
     m_placeholderLabel(nullptr),
-    m_showLoadingPlaceholderTimer(nullptr)
+    m_showLoadingPlaceholderTimer(nullptr),
+    m_directorySizePath(),
+    m_directorySize(0),
+    m_hibernated(false),
+    m_itemsReleased(false),
+    m_hibernationState()
 {
     m_topLayout = new QVBoxLayout(this);
     m_topLayout->setSpacing(0);
@@ -108,7 +119,14 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     connect(m_selectionChangedTimer, &QTimer::timeout,
             this, &DolphinView::emitSelectionChangedSignal);
 
+    m_prefetchTimer = new QTimer(this);
+    m_prefetchTimer->setSingleShot(true);
+    m_prefetchTimer->setInterval(400);
+    connect(m_prefetchTimer, &QTimer::timeout,
+            this, &DolphinView::prefetchFolder);
+
     m_model = new KFileItemModel(this);
+    m_selectionSummary = new KFileItemSelectionSummary(m_model, this);
     m_view = new DolphinItemListView();
     m_view->setEnabledSelectionToggles(GeneralSettings::showSelectionToggle());
     m_view->setVisibleRoles({"text"});
@@ -182,6 +200,8 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
             this, &DolphinView::slotItemsChanged);
     connect(m_model, &KFileItemModel::itemsRemoved,    this, &DolphinView::itemCountChanged);
     connect(m_model, &KFileItemModel::itemsInserted,   this, &DolphinView::itemCountChanged);
+    connect(m_model, &KFileItemModel::itemsRemoved,    this, &DolphinView::invalidateDirectorySize);
+    connect(m_model, &KFileItemModel::itemsInserted,   this, &DolphinView::invalidateDirectorySize);
     connect(m_model, &KFileItemModel::infoMessage,            this, &DolphinView::infoMessage);
     connect(m_model, &KFileItemModel::errorMessage,           this, &DolphinView::errorMessage);
     connect(m_model, &KFileItemModel::directoryRedirection, this, &DolphinView::slotDirectoryRedirection);
@@ -191,6 +211,11 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     connect(this, &DolphinView::itemCountChanged,
             this, &DolphinView::updatePlaceholderLabel);
 
+    connect(KDirectorySizeCounter::instance(), &KDirectorySizeCounter::sizeChanged,
+            this, &DolphinView::slotDirectorySizeChanged);
+    connect(ViewPropertiesCache::instance(), &ViewPropertiesCache::localDirectoryChanged,
+            this, &DolphinView::slotViewPropertiesDirectoryChanged);
+
     m_view->installEventFilter(this);
     connect(m_view, &DolphinItemListView::sortOrderChanged,
             this, &DolphinView::slotSortOrderChangedByHeader);
@@ -208,6 +233,8 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     KItemListSelectionManager* selectionManager = controller->selectionManager();
     connect(selectionManager, &KItemListSelectionManager::selectionChanged,
             this, &DolphinView::slotSelectionChanged);
+    connect(selectionManager, &KItemListSelectionManager::currentChanged,
+            this, &DolphinView::slotCurrentChanged);
 
 #ifdef HAVE_BALOO
     m_toolTipManager = new ToolTipManager(this);
@@ -233,6 +260,7 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
 
 DolphinView::~DolphinView()
 {
+    cancelDirectorySizeRequest();
 }
 
 QUrl DolphinView::url() const
@@ -240,6 +268,11 @@ QUrl DolphinView::url() const
     return m_url;
 }
 
+bool DolphinView::canRefineSearch(const QUrl& url) const
+{
+    return !m_itemsReleased && m_model->canRefineSearch(url);
+}
+
 void DolphinView::setActive(bool active)
 {
     if (active == m_active) {
@@ -327,6 +360,23 @@ bool DolphinView::hiddenFilesShown() const
     return m_model->showHiddenFiles();
 }
 
+void DolphinView::setSubfoldersFlattened(bool flattened)
+{
+    if (m_model->subfoldersFlattened() == flattened) {
+        return;
+    }
+
+    m_model->setSubfoldersFlattened(flattened);
+    m_view->setVisibleRoles(viewRoles(m_visibleRoles));
+    loadDirectory(url(), true);
+    Q_EMIT subfoldersFlattenedChanged(flattened);
+}
+
+bool DolphinView::subfoldersFlattened() const
+{
+    return m_model->subfoldersFlattened();
+}
+
 void DolphinView::setGroupedSorting(bool grouped)
 {
     if (grouped == groupedSorting()) {
@@ -486,7 +536,7 @@ void DolphinView::setVisibleRoles(const QList<QByteArray>& roles)
     props.setVisibleRoles(roles);
 
     m_visibleRoles = roles;
-    m_view->setVisibleRoles(roles);
+    m_view->setVisibleRoles(viewRoles(roles));
 
     Q_EMIT visibleRolesChanged(m_visibleRoles, previousRoles);
 }
@@ -559,35 +609,51 @@ void DolphinView::requestStatusBarText()
         m_statJobForStatusBarText->kill();
     }
 
-    if (m_container->controller()->selectionManager()->hasSelection()) {
-        int folderCount = 0;
-        int fileCount = 0;
-        KIO::filesize_t totalFileSize = 0;
+    const KItemListSelectionManager* selectionManager = m_container->controller()->selectionManager();
+    if (selectionManager->hasSelection()) {
+        cancelDirectorySizeRequest();
 
-        // Give a summary of the status of the selected files
-        const KFileItemList list = selectedItems();
-        for (const KFileItem& item : list) {
-            if (item.isDir()) {
-                ++folderCount;
-            } else {
-                ++fileCount;
-                totalFileSize += item.size();
-            }
-        }
+        // Give a summary of the status of the selected files. The summary
+        // only depends on the number of selected ranges, not on the number
+        // of selected items.
+        const KItemSet selectedItems = selectionManager->selectedItems();
+        const KFileItemSelectionSummary::Summary summary = m_selectionSummary->summary(selectedItems);
 
-        if (folderCount + fileCount == 1) {
+        if (summary.folderCount + summary.fileCount == 1) {
             // If only one item is selected, show info about it
-            Q_EMIT statusBarTextChanged(list.first().getStatusBarInfo());
+            Q_EMIT statusBarTextChanged(m_model->fileItem(selectedItems.first()).getStatusBarInfo());
         } else {
             // At least 2 items are selected
-            emitStatusBarText(folderCount, fileCount, totalFileSize, HasSelection);
+            emitStatusBarText(summary.folderCount, summary.fileCount, summary.totalFileSize, HasSelection);
         }
     } else { // has no selection
-        if (!m_model->rootItem().url().isValid()) {
+        const QUrl url = m_model->rootItem().url();
+        if (!url.isValid()) {
+            return;
+        }
+
+        if (KDirectorySizeCounter::isSupported(url)) {
+            // Local folders are walked in-process by the shared counter, which
+            // caches the sizes and announces partial sizes while walking.
+            const QString path = url.adjusted(QUrl::StripTrailingSlash).toLocalFile();
+            if (path != m_directorySizePath) {
+                cancelDirectorySizeRequest();
+
+                KIO::filesize_t size = 0;
+                if (KDirectorySizeCounter::instance()->request(path, size)) {
+                    emitFolderStatusBarText(size);
+                    return;
+                }
+                m_directorySizePath = path;
+            }
+
+            // Until a partial size is known, show the sum of the file sizes
+            emitFolderStatusBarText(m_directorySize > 0 ? static_cast<qint64>(m_directorySize) : -1);
             return;
         }
 
-        m_statJobForStatusBarText = KIO::statDetails(m_model->rootItem().url(),
+        cancelDirectorySizeRequest();
+        m_statJobForStatusBarText = KIO::statDetails(url,
                         KIO::StatJob::SourceSide, KIO::StatRecursiveSize, KIO::HideProgressInfo);
         connect(m_statJobForStatusBarText, &KJob::result,
                 this, &DolphinView::slotStatJobResult);
@@ -595,6 +661,34 @@ void DolphinView::requestStatusBarText()
     }
 }
 
+void DolphinView::emitFolderStatusBarText(qint64 recursiveSize)
+{
+    const KFileItemSelectionSummary::Summary summary = m_selectionSummary->totalSummary();
+    const KIO::filesize_t totalFileSize = (recursiveSize >= 0) ? static_cast<KIO::filesize_t>(recursiveSize)
+                                                               : summary.totalFileSize;
+    emitStatusBarText(summary.folderCount, summary.fileCount, totalFileSize, NoSelection);
+}
+
+void DolphinView::cancelDirectorySizeRequest()
+{
+    if (!m_directorySizePath.isEmpty()) {
+        KDirectorySizeCounter::instance()->cancel(m_directorySizePath);
+        m_directorySizePath.clear();
+        m_directorySize = 0;
+    }
+}
+
+void DolphinView::schedulePrefetching(const KFileItem& item)
+{
+    if (!GeneralSettings::prefetchFolders() || item.isNull() || !item.isDir()) {
+        m_prefetchTimer->stop();
+        return;
+    }
+
+    m_prefetchUrl = item.targetUrl();
+    m_prefetchTimer->start();
+}
+
 void DolphinView::emitStatusBarText(const int folderCount, const int fileCount,
                                     KIO::filesize_t totalFileSize, const Selection selection)
 {
@@ -656,6 +750,12 @@ void DolphinView::setUrl(const QUrl& url)
 
     hideToolTip();
 
+    if (m_model->subfoldersFlattened()) {
+        m_model->setSubfoldersFlattened(false);
+        m_view->setVisibleRoles(m_visibleRoles);
+        Q_EMIT subfoldersFlattenedChanged(false);
+    }
+
     disconnect(m_view, &DolphinItemListView::roleEditingFinished,
                this, &DolphinView::slotRoleEditingFinished);
 
@@ -664,7 +764,9 @@ void DolphinView::setUrl(const QUrl& url)
     // might be done on the existing items although they get cleared
     // anyhow afterwards by loadDirectory().
     m_model->clear();
-    applyViewProperties();
+    if (!m_itemsReleased) {
+        applyViewProperties();
+    }
     loadDirectory(url);
 
     Q_EMIT urlChanged(url);
@@ -1229,6 +1331,7 @@ void DolphinView::slotItemHovered(int index)
 #endif
     }
 
+    schedulePrefetching(item);
     Q_EMIT requestItemInfo(item);
 }
 
@@ -1236,9 +1339,20 @@ void DolphinView::slotItemUnhovered(int index)
 {
     Q_UNUSED(index)
     hideToolTip();
+    m_prefetchTimer->stop();
     Q_EMIT requestItemInfo(KFileItem());
 }
 
+void DolphinView::slotCurrentChanged(int current, int previous)
+{
+    Q_UNUSED(previous)
+
+    // Only prefetch folders the user navigates to with the keyboard
+    if (m_container->hasFocus()) {
+        schedulePrefetching(m_model->fileItem(current));
+    }
+}
+
 void DolphinView::slotItemDropEvent(int index, QGraphicsSceneDragDropEvent* event)
 {
     QUrl destUrl;
@@ -1359,6 +1473,13 @@ void DolphinView::slotSelectionChanged(const KItemSet& current, const KItemSet&
     m_selectionChangedTimer->start();
 }
 
+void DolphinView::prefetchFolder()
+{
+    if (!m_hibernated) {
+        m_model->prefetchDirectory(m_prefetchUrl);
+    }
+}
+
 void DolphinView::emitSelectionChangedSignal()
 {
     m_selectionChangedTimer->stop();
@@ -1367,32 +1488,47 @@ void DolphinView::emitSelectionChangedSignal()
 
 void DolphinView::slotStatJobResult(KJob *job)
 {
-    int folderCount = 0;
-    int fileCount = 0;
-    KIO::filesize_t totalFileSize = 0;
-    bool countFileSize = true;
-
     const auto entry =  static_cast<KIO::StatJob *>(job)->statResult();
     if (entry.contains(KIO::UDSEntry::UDS_RECURSIVE_SIZE)) {
         // We have a precomputed value.
-        totalFileSize = static_cast<KIO::filesize_t>(
-                                entry.numberValue(KIO::UDSEntry::UDS_RECURSIVE_SIZE));
-        countFileSize = false;
+        emitFolderStatusBarText(entry.numberValue(KIO::UDSEntry::UDS_RECURSIVE_SIZE));
+    } else {
+        emitFolderStatusBarText(-1);
     }
+}
 
-    const int itemCount = m_model->count();
-    for (int i = 0; i < itemCount; ++i) {
-        const KFileItem item = m_model->fileItem(i);
-        if (item.isDir()) {
-            ++folderCount;
-        } else {
-            ++fileCount;
-            if (countFileSize) {
-                totalFileSize += item.size();
-            }
-        }
+void DolphinView::slotDirectorySizeChanged(const QString& path, KIO::filesize_t size, bool finished)
+{
+    if (path != m_directorySizePath) {
+        return;
+    }
+
+    m_directorySize = size;
+    if (finished) {
+        m_directorySizePath.clear();
+        m_directorySize = 0;
+    }
+    emitFolderStatusBarText(size);
+}
+
+void DolphinView::slotViewPropertiesDirectoryChanged(const QString& path)
+{
+    const QUrl url = viewPropertiesUrl();
+    if (m_itemsReleased || !url.isLocalFile() || url.toLocalFile() != path) {
+        return;
+    }
+
+    applyViewProperties();
+}
+
+void DolphinView::invalidateDirectorySize()
+{
+    // The items get inserted while loading a directory, which must not
+    // invalidate the size of the directory
+    const QUrl url = m_model->rootItem().url();
+    if (!m_loading && KDirectorySizeCounter::isSupported(url)) {
+        KDirectorySizeCounter::instance()->invalidate(url.adjusted(QUrl::StripTrailingSlash).toLocalFile());
     }
-    emitStatusBarText(folderCount, fileCount, totalFileSize, NoSelection);
 }
 
 void DolphinView::updateSortRole(const QByteArray& role)
@@ -1462,6 +1598,11 @@ bool DolphinView::itemsExpandable() const
 
 void DolphinView::restoreState(QDataStream& stream)
 {
+    if (m_itemsReleased) {
+        // The restored state replaces the state of the hibernated view
+        m_hibernationState.clear();
+    }
+
     // Read the version number of the view state and check if the version is supported.
     quint32 version = 0;
     stream >> version;
@@ -1470,23 +1611,40 @@ void DolphinView::restoreState(QDataStream& stream)
         return;
     }
 
+    QUrl currentItemUrl;
+    QList<QUrl> selectedUrls;
+    QPoint contentsPosition;
+    QSet<QUrl> expandedUrls;
+    stream >> currentItemUrl >> selectedUrls >> contentsPosition >> expandedUrls;
+
+    if (m_itemsReleased) {
+        // The state gets restored when the view is woken up. Until then
+        // saveState() must provide the same state again.
+        QDataStream hibernationStream(&m_hibernationState, QIODevice::WriteOnly);
+        hibernationStream << version << currentItemUrl << selectedUrls << contentsPosition << expandedUrls;
+        return;
+    }
+
     // Restore the current item that had the keyboard focus
-    stream >> m_currentItemUrl;
+    m_currentItemUrl = currentItemUrl;
 
     // Restore the previously selected items
-    stream >> m_selectedUrls;
+    m_selectedUrls = selectedUrls;
 
     // Restore the view position
-    stream >> m_restoredContentsPosition;
+    m_restoredContentsPosition = contentsPosition;
 
     // Restore expanded folders (only relevant for the details view - will be ignored by the view in other view modes)
-    QSet<QUrl> urls;
-    stream >> urls;
-    m_model->restoreExpandedDirectories(urls);
+    m_model->restoreExpandedDirectories(expandedUrls);
 }
 
 void DolphinView::saveState(QDataStream& stream)
 {
+    if (m_itemsReleased && !m_hibernationState.isEmpty()) {
+        stream.writeRawData(m_hibernationState.constData(), m_hibernationState.size());
+        return;
+    }
+
     stream << quint32(1); // View state version
 
     // Save the current item that has the keyboard focus
@@ -1512,6 +1670,56 @@ void DolphinView::saveState(QDataStream& stream)
     stream << m_model->expandedDirectories();
 }
 
+void DolphinView::setHibernated(bool hibernated, bool releaseItems)
+{
+    if (hibernated) {
+        if (!m_hibernated) {
+            m_hibernated = true;
+            m_view->setHibernated(true);
+            m_prefetchTimer->stop();
+            m_model->cancelPrefetching();
+        }
+
+        if (releaseItems && !m_itemsReleased) {
+            QByteArray state;
+            QDataStream stream(&state, QIODevice::WriteOnly);
+            saveState(stream);
+
+            cancelDirectorySizeRequest();
+            m_model->releaseDirectory();
+            m_hibernationState = state;
+            m_itemsReleased = true;
+        }
+    } else if (m_hibernated) {
+        m_hibernated = false;
+
+        if (m_itemsReleased) {
+            // The URL might have been changed while the items were released
+            m_itemsReleased = false;
+            const QByteArray state = m_hibernationState;
+            m_hibernationState.clear();
+
+            applyViewProperties();
+            loadDirectory(m_url);
+            if (!state.isEmpty()) {
+                QDataStream stream(state);
+                restoreState(stream);
+            }
+        }
+        m_view->setHibernated(false);
+    }
+}
+
+bool DolphinView::isHibernated() const
+{
+    return m_hibernated;
+}
+
+bool DolphinView::itemsReleased() const
+{
+    return m_itemsReleased;
+}
+
 KFileItem DolphinView::rootItem() const
 {
     return m_model->rootItem();
@@ -1761,9 +1969,22 @@ void DolphinView::slotDirectoryLoadingCanceled()
     Q_EMIT directoryLoadingCanceled();
 }
 
-void DolphinView::slotItemsChanged()
+void DolphinView::slotItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& roles)
 {
     m_assureVisibleCurrentIndex = false;
+
+    // Changed sizes of files require recalculating the size of the directory.
+    // The sizes of folders are the number of their items and are ignored.
+    if (roles.isEmpty() || roles.contains("size")) {
+        for (const KItemRange& range : itemRanges) {
+            for (int i = range.index; i < range.index + range.count; ++i) {
+                if (!m_model->fileItem(i).isDir()) {
+                    invalidateDirectorySize();
+                    return;
+                }
+            }
+        }
+    }
 }
 
 void DolphinView::slotSortOrderChangedByHeader(Qt::SortOrder current, Qt::SortOrder previous)
@@ -1797,6 +2018,10 @@ void DolphinView::slotVisibleRolesChangedByHeader(const QList<QByteArray>& curre
     const QList<QByteArray> previousVisibleRoles = m_visibleRoles;
 
     m_visibleRoles = current;
+    if (m_model->subfoldersFlattened() && !previousVisibleRoles.contains("path")) {
+        // The path is only shown temporarily for the files of subfolders
+        m_visibleRoles.removeOne("path");
+    }
 
     ViewProperties props(viewPropertiesUrl());
     props.setVisibleRoles(m_visibleRoles);
@@ -1900,6 +2125,11 @@ void DolphinView::loadDirectory(const QUrl& url, bool reload)
         return;
     }
 
+    if (m_itemsReleased) {
+        // The directory gets loaded when the view is woken up
+        return;
+    }
+
     if (reload) {
         m_model->refreshDirectory(url);
     } else {
@@ -1907,6 +2137,17 @@ void DolphinView::loadDirectory(const QUrl& url, bool reload)
     }
 }
 
+QList<QByteArray> DolphinView::viewRoles(const QList<QByteArray>& roles) const
+{
+    if (!m_model->subfoldersFlattened() || roles.contains("path")) {
+        return roles;
+    }
+
+    QList<QByteArray> flattenedRoles = roles;
+    flattenedRoles.insert(qMin(1, flattenedRoles.count()), "path");
+    return flattenedRoles;
+}
+
 void DolphinView::applyViewProperties()
 {
     const ViewProperties props(viewPropertiesUrl());
@@ -1975,7 +2216,7 @@ void DolphinView::applyViewProperties(const ViewProperties& props)
     if (visibleRoles != m_visibleRoles) {
         const QList<QByteArray> previousVisibleRoles = m_visibleRoles;
         m_visibleRoles = visibleRoles;
-        m_view->setVisibleRoles(visibleRoles);
+        m_view->setVisibleRoles(viewRoles(visibleRoles));
         Q_EMIT visibleRolesChanged(m_visibleRoles, previousVisibleRoles);
     }
 
@@ -10,6 +10,7 @@
 
 #include "dolphintabwidget.h"
 #include "dolphin_export.h"
+#include "kitemviews/kitemrange.h"
 #include "tooltips/tooltipmanager.h"
 
 #include <KFileItem>
@@ -27,6 +28,7 @@ typedef KIO::FileUndoManager::CommandType CommandType;
 class QVBoxLayout;
 class DolphinItemListView;
 class KFileItemModel;
+class KFileItemSelectionSummary;
 class KItemListContainer;
 class KItemModelBase;
 class KItemSet;
@@ -92,6 +94,13 @@ public:
      */
     QUrl url() const;
 
+    /**
+     * @return True if showing the search \a url only refines the results
+     *         of the current search, which is fast enough for searching
+     *         while the text is typed.
+     */
+    bool canRefineSearch(const QUrl& url) const;
+
     /**
      * If \a active is true, the view will marked as active. The active
      * view is defined as view where all actions are applied to.
@@ -128,6 +137,15 @@ public:
     void setHiddenFilesShown(bool show);
     bool hiddenFilesShown() const;
 
+    /**
+     * Shows the files of all subfolders of the current local directory
+     * in one flat list, if \a flattened is true. The path of the items
+     * is shown in addition to the visible roles. The setting is not
+     * remembered and gets reset when the URL is changed.
+     */
+    void setSubfoldersFlattened(bool flattened);
+    bool subfoldersFlattened() const;
+
     /**
      * Turns on sorting by groups if \a enable is true.
      */
@@ -291,6 +309,22 @@ public:
      */
     void saveState(QDataStream& stream);
 
+    /**
+     * Hibernates the view while it is not shown for a longer time: The resolving
+     * of the item roles is paused and the previews are released. If \a releaseItems
+     * is true, also the items are released and the directory is not watched
+     * anymore. The view state (see saveState()) is kept in this case. Changing
+     * the URL or restoring a state of a view with released items does not load
+     * the directory before the view is woken up.
+     */
+    void setHibernated(bool hibernated, bool releaseItems = false);
+    bool isHibernated() const;
+
+    /**
+     * @return True if the items have been released by setHibernated().
+     */
+    bool itemsReleased() const;
+
     /**
      * Returns the root item which represents the current URL.
      */
@@ -465,6 +499,9 @@ Q_SIGNALS:
     /** Is emitted if the 'show hidden files' property has been changed. */
     void hiddenFilesShownChanged(bool shown);
 
+    /** Is emitted if showing the files of subfolders has been toggled. */
+    void subfoldersFlattenedChanged(bool flattened);
+
     /** Is emitted if the 'grouped sorting' property has been changed. */
     void groupedSortingChanged(bool groupedSorting);
 
@@ -638,6 +675,7 @@ private Q_SLOTS:
     void slotLeadingPaddingWidthChanged(qreal width);
     void slotItemHovered(int index);
     void slotItemUnhovered(int index);
+    void slotCurrentChanged(int current, int previous);
     void slotItemDropEvent(int index, QGraphicsSceneDragDropEvent* event);
     void slotModelChanged(KItemModelBase* current, KItemModelBase* previous);
     void slotMouseButtonPressed(int itemIndex, Qt::MouseButtons buttons);
@@ -666,6 +704,13 @@ private Q_SLOTS:
      */
     void slotSelectionChanged(const KItemSet& current, const KItemSet& previous);
 
+    /**
+     * Lets the model prefetch the folder the mouse or the keyboard focus
+     * has been resting on, so that it can be shown immediately when
+     * it gets entered.
+     */
+    void prefetchFolder();
+
     /**
      * Is called by emitDelayedSelectionChangedSignal() and emits the
      * signal \a selectionChanged() with all selected file items as parameter.
@@ -681,6 +726,24 @@ private Q_SLOTS:
      */
     void slotStatJobResult(KJob *job);
 
+    /**
+     * Emits the status bar text for the recursive size \a size of the
+     * directory \a path, if it has been requested by requestStatusBarText().
+     */
+    void slotDirectorySizeChanged(const QString& path, KIO::filesize_t size, bool finished);
+
+    /**
+     * Applies the view properties again if they are stored in the local
+     * directory \a path, which has been checked in the background.
+     */
+    void slotViewPropertiesDirectoryChanged(const QString& path);
+
+    /**
+     * Removes the cached recursive size of the current directory after
+     * items have been added, removed or changed.
+     */
+    void invalidateDirectorySize();
+
     /**
      * Updates the view properties of the current URL to the
      * sorting given by \a role.
@@ -743,7 +806,7 @@ private Q_SLOTS:
     /**
      * Is invoked when items of KFileItemModel have been changed.
      */
-    void slotItemsChanged();
+    void slotItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& roles);
 
     /**
      * Is invoked when the sort order has been changed by the user by clicking
@@ -785,6 +848,13 @@ private Q_SLOTS:
 private:
     void loadDirectory(const QUrl& url, bool reload = false);
 
+    /**
+     * @return The roles that are shown by the item list view for the
+     *         visible roles \a roles. The path is added if the files of
+     *         subfolders are shown.
+     */
+    QList<QByteArray> viewRoles(const QList<QByteArray>& roles) const;
+
     /**
      * Applies the view properties which are defined by the current URL
      * to the DolphinView properties. The view properties are read from a
@@ -819,6 +889,26 @@ private:
     void emitStatusBarText(const int folderCount, const int fileCount,
                            KIO::filesize_t totalFileSize, const Selection selection);
 
+    /**
+     * Helper method for DolphinView::requestStatusBarText().
+     * Emits the status bar text for all items of the current directory.
+     * @param recursiveSize the size of the directory including its subdirectories.
+     *                      If negative, the sizes of the files are summed up.
+     */
+    void emitFolderStatusBarText(qint64 recursiveSize);
+
+    /**
+     * Cancels the request for the recursive size of the current
+     * directory started by requestStatusBarText().
+     */
+    void cancelDirectorySizeRequest();
+
+    /**
+     * Starts m_prefetchTimer if \a item is a folder and prefetching is
+     * enabled. Otherwise a scheduled prefetching is stopped.
+     */
+    void schedulePrefetching(const KFileItem& item);
+
     /**
      * Helper method for DolphinView::paste() and DolphinView::pasteIntoFolder().
      * Pastes the clipboard data into the URL \a url.
@@ -887,6 +977,7 @@ private:
     QVBoxLayout* m_topLayout;
 
     KFileItemModel* m_model;
+    KFileItemSelectionSummary* m_selectionSummary;
     DolphinItemListView* m_view;
     KItemListContainer* m_container;
 
@@ -894,6 +985,10 @@ private:
 
     QTimer* m_selectionChangedTimer;
 
+    // Delays prefetching the hovered or current folder m_prefetchUrl
+    QTimer* m_prefetchTimer;
+    QUrl m_prefetchUrl;
+
     QUrl m_currentItemUrl; // Used for making the view to remember the current URL after F5
     bool m_scrollToCurrentItem; // Used for marking we need to scroll to current item or not
     QPoint m_restoredContentsPosition;
@@ -909,6 +1004,15 @@ private:
     QLabel* m_placeholderLabel;
     QTimer* m_showLoadingPlaceholderTimer;
 
+    // Directory of the pending KDirectorySizeCounter request and its partial size
+    QString m_directorySizePath;
+    KIO::filesize_t m_directorySize;
+
+    // View state of the hibernated view, if its items have been released
+    bool m_hibernated;
+    bool m_itemsReleased;
+    QByteArray m_hibernationState;
+
     // For unit tests
     friend class TestBase;
     friend class DolphinDetailsViewTest;
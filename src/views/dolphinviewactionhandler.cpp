@@ -65,6 +65,8 @@ void DolphinViewActionHandler::setCurrentView(DolphinView* view)
             this, &DolphinViewActionHandler::slotGroupedSortingChanged);
     connect(view, &DolphinView::hiddenFilesShownChanged,
             this, &DolphinViewActionHandler::slotHiddenFilesShownChanged);
+    connect(view, &DolphinView::subfoldersFlattenedChanged,
+            this, &DolphinViewActionHandler::slotSubfoldersFlattenedChanged);
     connect(view, &DolphinView::sortRoleChanged,
             this, &DolphinViewActionHandler::slotSortRoleChanged);
     connect(view, &DolphinView::zoomLevelChanged,
@@ -326,6 +328,14 @@ void DolphinViewActionHandler::createActions()
     m_actionCollection->setDefaultShortcuts(showHiddenFiles, KStandardShortcut::showHideHiddenFiles());
     connect(showHiddenFiles, &KToggleAction::triggered, this, &DolphinViewActionHandler::toggleShowHiddenFiles);
 
+    KToggleAction* flattenSubfolders = m_actionCollection->add<KToggleAction>(QStringLiteral("flatten_subfolders"));
+    flattenSubfolders->setText(i18nc("@action:inmenu View", "Show Files of Subfolders"));
+    flattenSubfolders->setWhatsThis(xi18nc("@info:whatsthis", "<para>When "
+        "this is enabled the files of all subfolders of the current local "
+        "folder are shown in one flat list together with their path.</para>"
+        "<para>This is reset when another folder is opened.</para>"));
+    connect(flattenSubfolders, &KToggleAction::triggered, this, &DolphinViewActionHandler::toggleSubfoldersFlattened);
+
     QAction* adjustViewProps = m_actionCollection->addAction(QStringLiteral("view_properties"));
     adjustViewProps->setText(i18nc("@action:inmenu View", "Adjust View Display Style..."));
     adjustViewProps->setIcon(QIcon::fromTheme(QStringLiteral("view-choose")));
@@ -496,6 +506,7 @@ void DolphinViewActionHandler::updateViewActions()
 
     // Updates the "show_hidden_files" action state and icon
     slotHiddenFilesShownChanged(m_currentView->hiddenFilesShown());
+    slotSubfoldersFlattenedChanged(m_currentView->subfoldersFlattened());
 }
 
 void DolphinViewActionHandler::zoomIn()
@@ -609,6 +620,17 @@ void DolphinViewActionHandler::slotHiddenFilesShownChanged(bool shown)
     showHiddenFilesAction->setChecked(shown);
 }
 
+void DolphinViewActionHandler::toggleSubfoldersFlattened(bool flattened)
+{
+    Q_EMIT actionBeingHandled();
+    m_currentView->setSubfoldersFlattened(flattened);
+}
+
+void DolphinViewActionHandler::slotSubfoldersFlattenedChanged(bool flattened)
+{
+    m_actionCollection->action(QStringLiteral("flatten_subfolders"))->setChecked(flattened);
+}
+
 void DolphinViewActionHandler::slotWriteStateChanged(bool isFolderWritable)
 {
     m_actionCollection->action(QStringLiteral("create_dir"))->setEnabled(isFolderWritable &&
@@ -193,6 +193,16 @@ private Q_SLOTS:
      */
     void slotHiddenFilesShownChanged(bool shown);
 
+    /**
+     * Switches between showing and hiding the files of subfolders.
+     */
+    void toggleSubfoldersFlattened(bool);
+
+    /**
+     * Updates the state of the 'Show Files of Subfolders' menu action.
+     */
+    void slotSubfoldersFlattenedChanged(bool flattened);
+
     /**
      * Updates the state of the 'Create Folder...' action.
      */
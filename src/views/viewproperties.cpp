@@ -10,10 +10,11 @@
 #include "dolphin_directoryviewpropertysettings.h"
 #include "dolphin_generalsettings.h"
 #include "dolphindebug.h"
+#include "viewpropertiescache.h"
 
-#include <QCryptographicHash>
+#include <KConfigGroup>
 
-#include <KFileItem>
+#include <QCryptographicHash>
 
 namespace {
     const int AdditionalInfoViewPropertiesVersion = 1;
@@ -33,6 +34,7 @@ namespace {
 ViewProperties::ViewProperties(const QUrl& url) :
     m_changedProps(false),
     m_autoSave(true),
+    m_saveDeferred(false),
     m_node(nullptr)
 {
     GeneralSettings* settings = GeneralSettings::self();
@@ -40,6 +42,8 @@ ViewProperties::ViewProperties(const QUrl& url) :
     bool useDetailsViewWithPath = false;
     bool useRecentDocumentsView = false;
     bool useDownloadsView = false;
+    bool fileExistenceKnown = false;
+    bool fileExists = false;
 
     // We try and save it to the file .directory in the directory being viewed.
     // If the directory is not writable by the user or the directory is not local,
@@ -63,14 +67,19 @@ ViewProperties::ViewProperties(const QUrl& url) :
 
         bool useDestinationDir = !isPartOfHome(m_filePath);
         if (!useDestinationDir) {
-            const KFileItem fileItem(url);
-            useDestinationDir = fileItem.isSlow();
-        }
-
-        if (!useDestinationDir) {
-            const QFileInfo dirInfo(m_filePath);
-            const QFileInfo fileInfo(m_filePath + QDir::separator() + ViewPropertiesFileName);
-            useDestinationDir = !dirInfo.isWritable() || (dirInfo.size() > 0 && fileInfo.exists() && !(fileInfo.isReadable() && fileInfo.isWritable()));
+            // Checking the directory might block on slow or dead mounts. As long
+            // as the directory has not been checked, it is unknown where the view
+            // properties are stored: The defaults are used and saving is deferred
+            // until the check has been finished. DolphinView applies the view
+            // properties again then.
+            ViewPropertiesCache::LocalDirectory directory;
+            if (ViewPropertiesCache::instance()->localDirectory(m_filePath, directory)) {
+                useDestinationDir = directory.useDestinationDir;
+                fileExistenceKnown = !useDestinationDir;
+                fileExists = directory.fileExists;
+            } else {
+                m_saveDeferred = true;
+            }
         }
 
         if (useDestinationDir) {
@@ -88,13 +97,27 @@ ViewProperties::ViewProperties(const QUrl& url) :
         m_filePath = destinationDir(QStringLiteral("remote")) + m_filePath;
     }
 
-    const QString file = m_filePath + QDir::separator() + ViewPropertiesFileName;
-    m_node = new ViewPropertySettings(KSharedConfig::openConfig(file));
+    if (m_saveDeferred) {
+        // The config is never written: ViewPropertiesCache keeps the saved properties
+        // until the directory has been checked and saveDeferredConfig() copies them.
+        // Instances for the same directory share the config by its file name.
+        const QString file = destinationDir(QStringLiteral("deferred")) + m_filePath + QDir::separator() + ViewPropertiesFileName;
+        m_node = new ViewPropertySettings(KSharedConfig::openConfig(file, KConfig::SimpleConfig));
+        fileExists = ViewPropertiesCache::instance()->isDeferredSyncPending(m_filePath);
+    } else {
+        const QString file = m_filePath + QDir::separator() + ViewPropertiesFileName;
+        m_node = new ViewPropertySettings(KSharedConfig::openConfig(file));
+
+        if (!fileExistenceKnown) {
+            fileExists = QFile::exists(file);
+        }
+        fileExists = fileExists || ViewPropertiesCache::instance()->isSyncPending(m_filePath);
+    }
 
     // If the .directory file does not exist or the timestamp is too old,
     // use default values instead.
     const bool useDefaultProps = (!useGlobalViewProps || useDetailsViewWithPath) &&
-                                 (!QFile::exists(file) ||
+                                 (!fileExists ||
                                   (m_node->timestamp() < settings->viewPropsTimestamp()));
     if (useDefaultProps) {
         if (useDetailsViewWithPath) {
@@ -394,17 +417,51 @@ void ViewProperties::update()
 void ViewProperties::save()
 {
     qCDebug(DolphinDebug) << "Saving view-properties to" << m_filePath;
-    QDir dir;
-    dir.mkpath(m_filePath);
     m_node->setVersion(CurrentViewPropertiesVersion);
-    m_node->save();
+
+    // Only write the values to the config. The file is written by
+    // ViewPropertiesCache, which batches the writes.
+    const KConfigSkeletonItem::List items = m_node->items();
+    for (KConfigSkeletonItem* item : items) {
+        item->writeConfig(m_node->config());
+    }
+    if (m_saveDeferred) {
+        ViewPropertiesCache::instance()->scheduleDeferredSync(m_node->sharedConfig(), m_filePath);
+    } else {
+        ViewPropertiesCache::instance()->scheduleSync(m_node->sharedConfig(), m_filePath);
+    }
+
     m_changedProps = false;
 }
 
 bool ViewProperties::exist() const
 {
+    if (m_saveDeferred) {
+        return ViewPropertiesCache::instance()->isDeferredSyncPending(m_filePath);
+    }
+
     const QString file = m_filePath + QDir::separator() + ViewPropertiesFileName;
-    return QFile::exists(file);
+    return QFile::exists(file) || ViewPropertiesCache::instance()->isSyncPending(m_filePath);
+}
+
+void ViewProperties::saveDeferredConfig(const QString& path, const KSharedConfig::Ptr& config)
+{
+    if (GeneralSettings::self()->globalViewProps()) {
+        return;
+    }
+
+    // The deferred config contains all properties, as save() writes all of them
+    ViewProperties props(QUrl::fromLocalFile(path));
+    const QStringList groups = config->groupList();
+    for (const QString& group : groups) {
+        const QMap<QString, QString> entries = config->group(group).entryMap();
+        KConfigGroup targetGroup = props.m_node->config()->group(group);
+        for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+            targetGroup.writeEntry(it.key(), it.value());
+        }
+    }
+    props.m_node->read();
+    props.m_changedProps = true;
 }
 
 QString ViewProperties::destinationDir(const QString& subDir) const
@@ -11,6 +11,8 @@
 #include "dolphin_export.h"
 #include "views/dolphinview.h"
 
+#include <KSharedConfig>
+
 #include <QUrl>
 
 class ViewPropertySettings;
@@ -124,6 +126,13 @@ private:
      */
     QString destinationDir(const QString& subDir) const;
 
+    /**
+     * Saves the view properties \a config of the local directory \a path,
+     * which have been saved before the directory had been checked by
+     * ViewPropertiesCache.
+     */
+    static void saveDeferredConfig(const QString& path, const KSharedConfig::Ptr& config);
+
     /**
      * Returns the view-mode prefix when storing additional properties for
      * a view-mode.
@@ -163,9 +172,12 @@ private:
 
     Q_DISABLE_COPY(ViewProperties)
 
+    friend class ViewPropertiesCache;
+
 private:
     bool m_changedProps;
     bool m_autoSave;
+    bool m_saveDeferred;
     QString m_filePath;
     ViewPropertySettings* m_node;
 };
@@ -0,0 +1,277 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "viewpropertiescache.h"
+
+#include "viewproperties.h"
+
+#include <KConfig>
+#include <KFileItem>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace {
+    // Time in ms a checked directory is used without revalidation
+    const int CacheLifetime = 5000;
+
+    // Delay in ms for writing the saved view properties
+    const int SyncDelay = 1000;
+
+    // The pending view properties are written immediately if there are
+    // more, e.g. while applying view properties to a directory tree
+    const int MaxPendingConfigCount = 50;
+
+    // Filename that is used for storing the properties
+    const char ViewPropertiesFileName[] = ".directory";
+}
+
+struct ViewPropertiesCache::State
+{
+    struct Entry
+    {
+        LocalDirectory directory;
+        QDateTime modificationTime;
+        QElapsedTimer age;
+    };
+
+    QMutex mutex;
+    ViewPropertiesCache* owner = nullptr; // Is null after the cache has been destroyed
+    QHash<QString, Entry> entries;
+    QSet<QString> pendingPaths;
+};
+
+class ViewPropertiesCacheSingleton
+{
+public:
+    ViewPropertiesCache instance;
+};
+Q_GLOBAL_STATIC(ViewPropertiesCacheSingleton, s_ViewPropertiesCache)
+
+/**
+ * Checks a local directory in a thread of the pool of ViewPropertiesCache.
+ * The state is shared, so that a check that hangs on a dead mount cannot
+ * access the cache after it has been destroyed.
+ */
+class DirectoryChecker : public QRunnable
+{
+public:
+    DirectoryChecker(const QSharedPointer<ViewPropertiesCache::State>& state, const QString& path);
+
+    void run() override;
+
+private:
+    QSharedPointer<ViewPropertiesCache::State> m_state;
+    QString m_path;
+};
+
+DirectoryChecker::DirectoryChecker(const QSharedPointer<ViewPropertiesCache::State>& state, const QString& path) :
+    m_state(state),
+    m_path(path)
+{
+}
+
+void DirectoryChecker::run()
+{
+    const QFileInfo dirInfo(m_path);
+    const QDateTime modificationTime = dirInfo.lastModified();
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        auto it = m_state->entries.find(m_path);
+        if (it != m_state->entries.end() && modificationTime.isValid() && it->modificationTime == modificationTime) {
+            // Adding or removing the .directory file would have changed
+            // the modification time of the directory
+            it->age.start();
+            m_state->pendingPaths.remove(m_path);
+            return;
+        }
+    }
+
+    ViewPropertiesCache::State::Entry entry;
+    entry.modificationTime = modificationTime;
+
+    const QFileInfo fileInfo(m_path + QDir::separator() + ViewPropertiesFileName);
+    entry.directory.useDestinationDir = KFileItem(QUrl::fromLocalFile(m_path)).isSlow();
+    if (!entry.directory.useDestinationDir) {
+        entry.directory.useDestinationDir = !dirInfo.isWritable() || (dirInfo.size() > 0 && fileInfo.exists() && !(fileInfo.isReadable() && fileInfo.isWritable()));
+    }
+    entry.directory.fileExists = fileInfo.exists();
+    entry.age.start();
+
+    QMutexLocker locker(&m_state->mutex);
+    auto it = m_state->entries.constFind(m_path);
+    const bool changed = (it == m_state->entries.constEnd())
+                         || it->directory.useDestinationDir != entry.directory.useDestinationDir
+                         || it->directory.fileExists != entry.directory.fileExists;
+
+    m_state->entries.insert(m_path, entry);
+    m_state->pendingPaths.remove(m_path);
+
+    ViewPropertiesCache* owner = m_state->owner;
+    if (changed && owner) {
+        const QString path = m_path;
+        QMetaObject::invokeMethod(owner, [owner, path]() {
+            owner->syncDeferredConfig(path);
+            Q_EMIT owner->localDirectoryChanged(path);
+        }, Qt::QueuedConnection);
+    }
+}
+
+ViewPropertiesCache* ViewPropertiesCache::instance()
+{
+    return &s_ViewPropertiesCache->instance;
+}
+
+bool ViewPropertiesCache::localDirectory(const QString& path, LocalDirectory& directory)
+{
+    QMutexLocker locker(&m_state->mutex);
+    const auto it = m_state->entries.constFind(path);
+    const bool known = (it != m_state->entries.constEnd());
+    if (known) {
+        directory = it->directory;
+    }
+
+    // Checking the directory might block on slow or dead mounts, so the
+    // GUI thread never waits for it. A check that hangs keeps the path
+    // pending, so no further checks are started for it.
+    if ((!known || it->age.elapsed() >= CacheLifetime) && !m_state->pendingPaths.contains(path)) {
+        m_state->pendingPaths.insert(path);
+        m_threadPool->start(new DirectoryChecker(m_state, path));
+    }
+    locker.unlock();
+
+    if (known && m_deferredConfigs.contains(path)) {
+        // The check has been finished, but its result has not been
+        // delivered yet
+        syncDeferredConfig(path);
+    }
+
+    return known;
+}
+
+void ViewPropertiesCache::scheduleSync(const KSharedConfig::Ptr& config, const QString& filePath)
+{
+    // Keeping a reference to the config assures that ViewProperties
+    // instances for the same directory share its unwritten changes
+    m_pendingConfigs.insert(filePath, config);
+
+    if (m_pendingConfigs.count() > MaxPendingConfigCount) {
+        syncPendingConfigs();
+    } else if (!m_syncTimer->isActive()) {
+        m_syncTimer->start();
+    }
+}
+
+bool ViewPropertiesCache::isSyncPending(const QString& filePath) const
+{
+    return m_pendingConfigs.contains(filePath);
+}
+
+void ViewPropertiesCache::scheduleDeferredSync(const KSharedConfig::Ptr& config, const QString& path)
+{
+    m_deferredConfigs.insert(path, config);
+
+    // The check might have been finished since the view properties have been read
+    bool known;
+    {
+        QMutexLocker locker(&m_state->mutex);
+        known = m_state->entries.contains(path);
+    }
+    if (known) {
+        syncDeferredConfig(path);
+    }
+}
+
+bool ViewPropertiesCache::isDeferredSyncPending(const QString& path) const
+{
+    return m_deferredConfigs.contains(path);
+}
+
+void ViewPropertiesCache::syncDeferredConfig(const QString& path)
+{
+    const KSharedConfig::Ptr config = m_deferredConfigs.take(path);
+    if (config) {
+        ViewProperties::saveDeferredConfig(path, config);
+
+        // The deferred config only serves as storage and must not be written
+        config->markAsClean();
+    }
+}
+
+void ViewPropertiesCache::syncPendingConfigs()
+{
+    m_syncTimer->stop();
+
+    const QHash<QString, KSharedConfig::Ptr> pendingConfigs = m_pendingConfigs;
+    m_pendingConfigs.clear();
+
+    QDir dir;
+    for (auto it = pendingConfigs.constBegin(); it != pendingConfigs.constEnd(); ++it) {
+        dir.mkpath(it.key());
+        it.value()->sync();
+
+        // The .directory file exists now. Adding it has changed the
+        // modification time of the directory, so the next revalidation
+        // checks the directory again.
+        QMutexLocker locker(&m_state->mutex);
+        auto entry = m_state->entries.find(it.key());
+        if (entry != m_state->entries.end()) {
+            entry->directory.fileExists = true;
+        }
+    }
+}
+
+ViewPropertiesCache::~ViewPropertiesCache()
+{
+    syncPendingConfigs();
+
+    // The view properties of directories that are still being checked are
+    // dropped, as the checks might hang on dead mounts
+    for (const KSharedConfig::Ptr& config : qAsConst(m_deferredConfigs)) {
+        config->markAsClean();
+    }
+    m_deferredConfigs.clear();
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        m_state->owner = nullptr;
+    }
+
+    // Don't wait for checks that hang on dead mounts when quitting. The
+    // pool is leaked intentionally, as deleting it would wait, too.
+    m_threadPool->clear();
+}
+
+ViewPropertiesCache::ViewPropertiesCache() :
+    QObject(),
+    m_state(QSharedPointer<State>::create()),
+    m_threadPool(new QThreadPool()),
+    m_pendingConfigs(),
+    m_deferredConfigs(),
+    m_syncTimer(nullptr)
+{
+    m_state->owner = this;
+    m_threadPool->setMaxThreadCount(2);
+
+    m_syncTimer = new QTimer(this);
+    m_syncTimer->setSingleShot(true);
+    m_syncTimer->setInterval(SyncDelay);
+    connect(m_syncTimer, &QTimer::timeout, this, &ViewPropertiesCache::syncPendingConfigs);
+
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+                this, &ViewPropertiesCache::syncPendingConfigs);
+    }
+}
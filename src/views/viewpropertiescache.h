@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2022 The Dolphin developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef VIEWPROPERTIESCACHE_H
+#define VIEWPROPERTIESCACHE_H
+
+#include "dolphin_export.h"
+
+#include <KSharedConfig>
+
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+
+class QThreadPool;
+class QTimer;
+
+/**
+ * @brief Keeps ViewProperties independent from the responsiveness of the
+ *        file systems of the viewed directories.
+ *
+ * Deciding whether the view properties of a local directory are stored
+ * inside the directory requires checking the type of the file system and the
+ * permissions of the directory and its .directory file. These checks are done
+ * by a small thread pool, and the GUI thread never waits for them: As long as
+ * a directory has not been checked, its result is unknown, and
+ * localDirectoryChanged() is emitted when the check has been finished. View
+ * properties that are saved meanwhile are kept until the check has been
+ * finished. The results are cached and revalidated in the background by comparing the
+ * modification time of the directory.
+ *
+ * Saved view properties are written to their files in batches, so that
+ * changing several properties in a row results in one write per file.
+ *
+ * The cache may only be used from the GUI thread.
+ */
+class DOLPHIN_EXPORT ViewPropertiesCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct LocalDirectory
+    {
+        // True if the view properties must not be stored inside the directory
+        bool useDestinationDir;
+        // True if the directory contains a .directory file
+        bool fileExists;
+    };
+
+    static ViewPropertiesCache* instance();
+
+    /**
+     * Checks where the view properties of the local directory \a path
+     * are stored. Outdated results are returned until they have been
+     * revalidated.
+     * @return False if the directory has not been checked yet. The check
+     *         is started and \a directory is not set in this case.
+     */
+    bool localDirectory(const QString& path, LocalDirectory& directory);
+
+    /**
+     * Writes the config \a config, which stores the view properties in
+     * the directory \a filePath, to disk with a small delay.
+     */
+    void scheduleSync(const KSharedConfig::Ptr& config, const QString& filePath);
+
+    /**
+     * @return True if the view properties stored in the directory
+     *         \a filePath have not been written yet.
+     */
+    bool isSyncPending(const QString& filePath) const;
+
+    /**
+     * Keeps the config \a config, which stores the view properties saved for
+     * the local directory \a path before the directory has been checked.
+     * The properties are saved to the right location when the check has
+     * been finished, see ViewProperties::saveDeferredConfig().
+     */
+    void scheduleDeferredSync(const KSharedConfig::Ptr& config, const QString& path);
+
+    /**
+     * @return True if view properties have been saved for the local
+     *         directory \a path, which wait for the check of the directory.
+     */
+    bool isDeferredSyncPending(const QString& path) const;
+
+    /**
+     * Writes all view properties that have not been written yet.
+     */
+    void syncPendingConfigs();
+
+Q_SIGNALS:
+    /**
+     * Is emitted if checking the local directory \a path has been finished,
+     * and the result differs from the result that localDirectory() has
+     * returned before, or localDirectory() did not know the result yet.
+     */
+    void localDirectoryChanged(const QString& path);
+
+protected:
+    ~ViewPropertiesCache() override;
+
+private:
+    ViewPropertiesCache();
+
+    /**
+     * Saves the view properties that have been deferred until the
+     * local directory \a path has been checked.
+     */
+    void syncDeferredConfig(const QString& path);
+
+    struct State;
+
+private:
+    QSharedPointer<State> m_state;
+    QThreadPool* m_threadPool;
+
+    QHash<QString, KSharedConfig::Ptr> m_pendingConfigs;
+    QHash<QString, KSharedConfig::Ptr> m_deferredConfigs;
+    QTimer* m_syncTimer;
+
+    friend class ViewPropertiesCacheSingleton;
+    friend class DirectoryChecker;
+};
+
+#endif